@@ -0,0 +1,129 @@
+﻿#include "AsyncFileLoader.h"
+
+#include "FileSystem.h"
+
+AsyncFileLoader::AsyncFileLoader(unsigned threadCount)
+	: m_pendingCount(0)
+	, m_isQuit(false)
+{
+	if (threadCount == 0)
+	{
+		threadCount = 1;
+	}
+	for (unsigned i = 0; i < threadCount; i++)
+	{
+		m_workers.emplace_back(&AsyncFileLoader::WorkerMain, this);
+	}
+}
+
+AsyncFileLoader::~AsyncFileLoader()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_isQuit = true;
+		// まだ始まっていない読み込みは取りやめる
+		m_requests.clear();
+	}
+	m_requested.notify_all();
+	for (std::thread& worker : m_workers)
+	{
+		worker.join();
+	}
+}
+
+void AsyncFileLoader::Load(const std::wstring& path, Completion onComplete, Decoder decode)
+{
+	Request request;
+	request.path = path;
+	request.decode = decode;
+	request.onComplete = onComplete;
+	request.isSucceeded = false;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_requests.push_back(std::move(request));
+		m_pendingCount++;
+	}
+	m_requested.notify_one();
+}
+
+size_t AsyncFileLoader::DispatchCompletions()
+{
+	std::vector<Request> completions;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		completions.swap(m_completions);
+	}
+
+	// 通知中に新しい依頼が来てもよいようにロックの外で呼ぶ
+	for (Request& request : completions)
+	{
+		request.onComplete(request.isSucceeded, request.data);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_pendingCount -= completions.size();
+	}
+	return completions.size();
+}
+
+void AsyncFileLoader::Flush()
+{
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_completed.wait(lock, [this]()
+			{
+				return m_pendingCount == m_completions.size();
+			});
+			if (m_pendingCount == 0)
+			{
+				return;
+			}
+		}
+		// 通知の中で新しい依頼が来ることがあるので、無くなるまで繰り返す
+		DispatchCompletions();
+	}
+}
+
+size_t AsyncFileLoader::GetPendingCount() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_pendingCount;
+}
+
+void AsyncFileLoader::WorkerMain()
+{
+	for (;;)
+	{
+		Request request;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_requested.wait(lock, [this]()
+			{
+				return m_isQuit || !m_requests.empty();
+			});
+			if (m_isQuit)
+			{
+				return;
+			}
+			request = std::move(m_requests.front());
+			m_requests.pop_front();
+		}
+
+		// 読み込みと解析（ロックの外で行う）
+		request.isSucceeded = ReadWholeFile(request.path, request.data);
+		if (request.isSucceeded && request.decode)
+		{
+			request.isSucceeded = request.decode(request.data);
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_completions.push_back(std::move(request));
+		}
+		m_completed.notify_all();
+	}
+}
@@ -0,0 +1,75 @@
+﻿/// <summary>
+/// バックグラウンドのスレッドでファイルを読み込むクラス
+/// </summary>
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// 読み込みと解析はワーカースレッドで行い、
+// 完了の通知は DispatchCompletions を呼んだスレッド（ゲームスレッド）で行う
+class AsyncFileLoader
+{
+public:
+	// ワーカースレッドで読み込んだデータを解析・検証する関数（失敗したら false）
+	typedef std::function<bool(std::vector<uint8_t>& data)> Decoder;
+	// 完了時にゲームスレッドで呼ばれる関数
+	typedef std::function<void(bool isSucceeded, std::vector<uint8_t>& data)> Completion;
+
+	// threadCount 個のワーカースレッドを起動
+	explicit AsyncFileLoader(unsigned threadCount = 1);
+	~AsyncFileLoader();
+
+	// 読み込みを依頼してすぐに戻る
+	void Load(const std::wstring& path, Completion onComplete, Decoder decode = nullptr);
+
+	// 完了した読み込みの通知を呼び出し、呼んだ数を返す
+	size_t DispatchCompletions();
+
+	// 全ての読み込みが終わるまで待ってから通知を呼び出す
+	void Flush();
+
+	// 依頼されてまだ通知していない数
+	size_t GetPendingCount() const;
+
+private:
+	AsyncFileLoader(const AsyncFileLoader&) = delete;
+	AsyncFileLoader& operator=(const AsyncFileLoader&) = delete;
+
+	// 読み込みの依頼
+	struct Request
+	{
+		std::wstring path;
+		Decoder decode;
+		Completion onComplete;
+		std::vector<uint8_t> data;
+		bool isSucceeded;
+	};
+
+	// ワーカースレッドの処理
+	void WorkerMain();
+
+	// ワーカースレッド
+	std::vector<std::thread> m_workers;
+
+	// 排他制御
+	mutable std::mutex m_mutex;
+	// 依頼が来たことの通知
+	std::condition_variable m_requested;
+	// 読み込みが終わったことの通知
+	std::condition_variable m_completed;
+	// 読み込み待ちの依頼
+	std::deque<Request> m_requests;
+	// 通知待ちの依頼
+	std::vector<Request> m_completions;
+	// 依頼されてまだ通知していない数
+	size_t m_pendingCount;
+	// 終了要求
+	bool m_isQuit;
+};
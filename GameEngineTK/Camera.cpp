@@ -82,3 +82,38 @@ void Camera::SetFarClip(float farclip)
 {
 	m_farclip = farclip;
 }
+
+const DirectX::SimpleMath::Vector3& Camera::GetEyePos() const
+{
+	return m_eyepos;
+}
+
+const DirectX::SimpleMath::Vector3& Camera::GetRefPos() const
+{
+	return m_refpos;
+}
+
+const DirectX::SimpleMath::Vector3& Camera::GetUpVec() const
+{
+	return m_upvec;
+}
+
+float Camera::GetFovY() const
+{
+	return m_fovY;
+}
+
+float Camera::GetAspect() const
+{
+	return m_aspect;
+}
+
+float Camera::GetNearClip() const
+{
+	return m_nearclip;
+}
+
+float Camera::GetFarClip() const
+{
+	return m_farclip;
+}
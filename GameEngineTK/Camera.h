@@ -43,6 +43,27 @@ public:
 	// t@[NbvZbg
 	void SetFarClip(float farclip);
 
+	// _W擾
+	const DirectX::SimpleMath::Vector3& GetEyePos() const;
+
+	// QƓ_W擾
+	const DirectX::SimpleMath::Vector3& GetRefPos() const;
+
+	// xNg擾
+	const DirectX::SimpleMath::Vector3& GetUpVec() const;
+
+	// p擾
+	float GetFovY() const;
+
+	// AXyNg擾
+	float GetAspect() const;
+
+	// jANbv擾
+	float GetNearClip() const;
+
+	// t@[Nbv擾
+	float GetFarClip() const;
+
 protected:
 	// r[s
 	DirectX::SimpleMath::Matrix m_view;
@@ -0,0 +1,67 @@
+﻿#include "Clock.h"
+
+#include <chrono>
+#include <stdexcept>
+
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__linux__)
+#include <time.h>
+#endif
+
+#if defined(_WIN32)
+QpcClock::QpcClock()
+{
+	LARGE_INTEGER frequency;
+	if (!QueryPerformanceFrequency(&frequency))
+	{
+		throw std::runtime_error("QueryPerformanceFrequency");
+	}
+	m_frequency = static_cast<uint64_t>(frequency.QuadPart);
+}
+
+uint64_t QpcClock::GetCounter()
+{
+	LARGE_INTEGER counter;
+	if (!QueryPerformanceCounter(&counter))
+	{
+		throw std::runtime_error("QueryPerformanceCounter");
+	}
+	return static_cast<uint64_t>(counter.QuadPart);
+}
+#endif
+
+#if defined(__linux__)
+uint64_t MonotonicRawClock::GetCounter()
+{
+	timespec time;
+	if (clock_gettime(CLOCK_MONOTONIC_RAW, &time) != 0)
+	{
+		throw std::runtime_error("clock_gettime");
+	}
+	return static_cast<uint64_t>(time.tv_sec) * 1000000000 + static_cast<uint64_t>(time.tv_nsec);
+}
+#endif
+
+uint64_t ChronoClock::GetFrequency() const
+{
+	typedef std::chrono::steady_clock::period Period;
+	return static_cast<uint64_t>(Period::den / Period::num);
+}
+
+uint64_t ChronoClock::GetCounter()
+{
+	return static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+}
+
+Clock& GetDefaultClock()
+{
+#if defined(_WIN32)
+	static QpcClock clock;
+#elif defined(__linux__)
+	static MonotonicRawClock clock;
+#else
+	static ChronoClock clock;
+#endif
+	return clock;
+}
@@ -0,0 +1,79 @@
+﻿/// <summary>
+/// 経過時間の計測に使う時計
+/// </summary>
+#pragma once
+
+#include <cstdint>
+
+// カウンターの値と１秒あたりのカウント数を返す時計
+// DX::StepTimer はこれを通して時刻を取得するので、環境ごとの時計や、テスト用に手で進める時計に差し替えられる
+class Clock
+{
+public:
+	virtual ~Clock() {}
+
+	// １秒あたりのカウント数
+	virtual uint64_t GetFrequency() const = 0;
+	// 現在のカウンターの値（単調増加）
+	virtual uint64_t GetCounter() = 0;
+};
+
+#if defined(_WIN32)
+// QueryPerformanceCounter による時計
+class QpcClock : public Clock
+{
+public:
+	// 取得に失敗したら std::runtime_error を投げる
+	QpcClock();
+
+	uint64_t GetFrequency() const override { return m_frequency; }
+	uint64_t GetCounter() override;
+
+private:
+	uint64_t m_frequency;
+};
+#endif
+
+#if defined(__linux__)
+// clock_gettime(CLOCK_MONOTONIC_RAW) による時計（NTP による速さの調整を受けない）
+class MonotonicRawClock : public Clock
+{
+public:
+	uint64_t GetFrequency() const override { return 1000000000; }
+	uint64_t GetCounter() override;
+};
+#endif
+
+// std::chrono::steady_clock による時計
+class ChronoClock : public Clock
+{
+public:
+	uint64_t GetFrequency() const override;
+	uint64_t GetCounter() override;
+};
+
+// Advance で進めたときだけ進む時計（テストや再現可能な計測用）
+class FakeClock : public Clock
+{
+public:
+	explicit FakeClock(uint64_t frequency = 10000000)
+		: m_frequency(frequency)
+		, m_counter(0)
+	{
+	}
+
+	uint64_t GetFrequency() const override { return m_frequency; }
+	uint64_t GetCounter() override { return m_counter; }
+
+	// カウントで進める
+	void Advance(uint64_t counts) { m_counter += counts; }
+	// 秒で進める
+	void AdvanceSeconds(double seconds) { m_counter += static_cast<uint64_t>(seconds * m_frequency); }
+
+private:
+	uint64_t m_frequency;
+	uint64_t m_counter;
+};
+
+// 環境で最も精度の良い時計（Windows は QPC、Linux は CLOCK_MONOTONIC_RAW、それ以外は std::chrono）
+Clock& GetDefaultClock();
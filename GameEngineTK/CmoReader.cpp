@@ -0,0 +1,401 @@
+﻿#include "CmoReader.h"
+
+// 範囲を確認しながら先頭から順に読み取る
+class CmoReader::Cursor
+{
+public:
+	Cursor(const uint8_t* data, size_t size)
+		: m_data(data)
+		, m_size(size)
+		, m_offset(0)
+	{
+	}
+
+	// 値を１つ読み取る
+	template<typename T>
+	bool Read(T& value)
+	{
+		if (m_size - m_offset < sizeof(T))
+		{
+			return false;
+		}
+		std::memcpy(&value, m_data + m_offset, sizeof(T));
+		m_offset += sizeof(T);
+		return true;
+	}
+
+	// 要素数に続く配列を参照する
+	template<typename T>
+	bool ReadArray(CmoArray<T>& array)
+	{
+		uint32_t count;
+		if (!Read(count))
+		{
+			return false;
+		}
+		if (!Skip(count, sizeof(T), array.data))
+		{
+			return false;
+		}
+		array.count = count;
+		return true;
+	}
+
+	// 文字数に続く名前を参照する
+	bool ReadString(CmoString& string)
+	{
+		uint32_t length;
+		if (!Read(length))
+		{
+			return false;
+		}
+		if (!Skip(length, sizeof(uint16_t), string.data))
+		{
+			return false;
+		}
+		// 文字数は終端の 0 を含む
+		string.length = length;
+		if (length > 0 && string.data[(length - 1) * 2] == 0 && string.data[(length - 1) * 2 + 1] == 0)
+		{
+			string.length--;
+		}
+		return true;
+	}
+
+	// count * stride バイトを読み飛ばし、その先頭を返す
+	bool Skip(uint32_t count, size_t stride, const uint8_t*& data)
+	{
+		// 32bit 環境でも桁あふれしないように 64bit で計算する
+		uint64_t bytes = static_cast<uint64_t>(count) * stride;
+		if (bytes > m_size - m_offset)
+		{
+			return false;
+		}
+		data = m_data + m_offset;
+		m_offset += static_cast<size_t>(bytes);
+		return true;
+	}
+
+private:
+	const uint8_t* m_data;
+	size_t m_size;
+	size_t m_offset;
+};
+
+std::wstring CmoString::ToWString() const
+{
+	std::wstring result;
+	result.reserve(length);
+	for (uint32_t i = 0; i < length; i++)
+	{
+		uint16_t code;
+		std::memcpy(&code, data + i * 2, sizeof(code));
+		// wchar_t が 32bit の環境でもサロゲートペアはそのまま並べる
+		result += static_cast<wchar_t>(code);
+	}
+	return result;
+}
+
+CmoReader::CmoReader()
+	: m_data(nullptr)
+	, m_size(0)
+{
+}
+
+bool CmoReader::Open(const std::wstring& path)
+{
+	m_meshes.clear();
+	m_error.clear();
+	m_data = nullptr;
+	m_size = 0;
+
+	if (!m_file.Open(path))
+	{
+		return Fail("cannot map file");
+	}
+	return Parse(m_file.GetData(), m_file.GetSize());
+}
+
+bool CmoReader::Parse(const uint8_t* data, size_t size)
+{
+	m_meshes.clear();
+	m_error.clear();
+	m_data = data;
+	m_size = size;
+
+	Cursor cursor(data, size);
+	uint32_t meshCount;
+	if (!cursor.Read(meshCount))
+	{
+		return Fail("missing mesh count");
+	}
+	if (meshCount == 0)
+	{
+		return Fail("no meshes");
+	}
+
+	// 要素数は壊れていることがあるので、読み取れた分だけ確保する
+	for (uint32_t i = 0; i < meshCount; i++)
+	{
+		m_meshes.emplace_back();
+		if (!ParseMesh(cursor, m_meshes.back()))
+		{
+			return false;
+		}
+		if (!ValidateMesh(m_meshes.back()))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+size_t CmoReader::GetGeometryBytes() const
+{
+	size_t bytes = 0;
+	for (const CmoMesh& mesh : m_meshes)
+	{
+		for (const auto& ib : mesh.indexBuffers)
+		{
+			bytes += ib.GetBytes();
+		}
+		for (const auto& vb : mesh.vertexBuffers)
+		{
+			bytes += vb.GetBytes();
+		}
+		for (const auto& vb : mesh.skinningVertexBuffers)
+		{
+			bytes += vb.GetBytes();
+		}
+	}
+	return bytes;
+}
+
+bool CmoReader::ParseMesh(Cursor& cursor, CmoMesh& mesh)
+{
+	if (!cursor.ReadString(mesh.name))
+	{
+		return Fail("truncated mesh name");
+	}
+
+	// マテリアル
+	uint32_t materialCount;
+	if (!cursor.Read(materialCount))
+	{
+		return Fail("truncated material count");
+	}
+	for (uint32_t i = 0; i < materialCount; i++)
+	{
+		CmoMaterialInfo info;
+		if (!cursor.ReadString(info.name)
+			|| !cursor.Read(info.material)
+			|| !cursor.ReadString(info.pixelShader))
+		{
+			return Fail("truncated material");
+		}
+		for (int t = 0; t < CmoMaterialInfo::MAX_TEXTURE; t++)
+		{
+			if (!cursor.ReadString(info.textures[t]))
+			{
+				return Fail("truncated texture name");
+			}
+		}
+		mesh.materials.push_back(info);
+	}
+
+	uint8_t hasSkeleton;
+	if (!cursor.Read(hasSkeleton))
+	{
+		return Fail("truncated skeleton flag");
+	}
+	mesh.hasSkeleton = hasSkeleton != 0;
+
+	// サブメッシュ
+	if (!cursor.ReadArray(mesh.submeshes))
+	{
+		return Fail("truncated submeshes");
+	}
+
+	// インデックスバッファ
+	uint32_t ibCount;
+	if (!cursor.Read(ibCount))
+	{
+		return Fail("truncated index buffer count");
+	}
+	for (uint32_t i = 0; i < ibCount; i++)
+	{
+		CmoArray<uint16_t> ib;
+		if (!cursor.ReadArray(ib))
+		{
+			return Fail("truncated index buffer");
+		}
+		mesh.indexBuffers.push_back(ib);
+	}
+
+	// 頂点バッファ
+	uint32_t vbCount;
+	if (!cursor.Read(vbCount))
+	{
+		return Fail("truncated vertex buffer count");
+	}
+	for (uint32_t i = 0; i < vbCount; i++)
+	{
+		CmoArray<CmoVertex> vb;
+		if (!cursor.ReadArray(vb))
+		{
+			return Fail("truncated vertex buffer");
+		}
+		mesh.vertexBuffers.push_back(vb);
+	}
+
+	// スキニング用の頂点バッファ
+	uint32_t skinningVbCount;
+	if (!cursor.Read(skinningVbCount))
+	{
+		return Fail("truncated skinning vertex buffer count");
+	}
+	for (uint32_t i = 0; i < skinningVbCount; i++)
+	{
+		CmoArray<CmoSkinningVertex> vb;
+		if (!cursor.ReadArray(vb))
+		{
+			return Fail("truncated skinning vertex buffer");
+		}
+		mesh.skinningVertexBuffers.push_back(vb);
+	}
+
+	if (!cursor.Read(mesh.extents))
+	{
+		return Fail("truncated extents");
+	}
+
+	if (!mesh.hasSkeleton)
+	{
+		return true;
+	}
+
+	// ボーン
+	uint32_t boneCount;
+	if (!cursor.Read(boneCount))
+	{
+		return Fail("truncated bone count");
+	}
+	for (uint32_t i = 0; i < boneCount; i++)
+	{
+		CmoBoneInfo info;
+		if (!cursor.ReadString(info.name) || !cursor.Read(info.bone))
+		{
+			return Fail("truncated bone");
+		}
+		mesh.bones.push_back(info);
+	}
+
+	// アニメーションクリップ
+	uint32_t clipCount;
+	if (!cursor.Read(clipCount))
+	{
+		return Fail("truncated clip count");
+	}
+	for (uint32_t i = 0; i < clipCount; i++)
+	{
+		CmoClipInfo info;
+		if (!cursor.ReadString(info.name) || !cursor.Read(info.clip))
+		{
+			return Fail("truncated clip");
+		}
+		info.keyframes.count = info.clip.keys;
+		if (!cursor.Skip(info.clip.keys, sizeof(CmoKeyframe), info.keyframes.data))
+		{
+			return Fail("truncated keyframes");
+		}
+		mesh.clips.push_back(info);
+	}
+	return true;
+}
+
+bool CmoReader::ValidateMesh(const CmoMesh& mesh)
+{
+	if (!mesh.skinningVertexBuffers.empty())
+	{
+		// スキニング情報は頂点バッファと１対１
+		if (mesh.skinningVertexBuffers.size() != mesh.vertexBuffers.size())
+		{
+			return Fail("skinning vertex buffer count mismatch");
+		}
+		for (size_t i = 0; i < mesh.vertexBuffers.size(); i++)
+		{
+			if (mesh.skinningVertexBuffers[i].count != mesh.vertexBuffers[i].count)
+			{
+				return Fail("skinning vertex count mismatch");
+			}
+		}
+	}
+
+	// 参照される範囲のインデックスが頂点数未満か確かめる
+	for (uint32_t i = 0; i < mesh.submeshes.count; i++)
+	{
+		CmoSubMesh submesh = mesh.submeshes.Get(i);
+		// マテリアルが無い時は既定のマテリアルが１つ作られる
+		size_t materialCount = mesh.materials.empty() ? 1 : mesh.materials.size();
+		if (submesh.materialIndex >= materialCount)
+		{
+			return Fail("material index out of range");
+		}
+		if (submesh.indexBufferIndex >= mesh.indexBuffers.size())
+		{
+			return Fail("index buffer index out of range");
+		}
+		if (submesh.vertexBufferIndex >= mesh.vertexBuffers.size())
+		{
+			return Fail("vertex buffer index out of range");
+		}
+
+		const CmoArray<uint16_t>& ib = mesh.indexBuffers[submesh.indexBufferIndex];
+		uint64_t end = static_cast<uint64_t>(submesh.startIndex) + static_cast<uint64_t>(submesh.primCount) * 3;
+		if (end > ib.count)
+		{
+			return Fail("submesh index range out of range");
+		}
+
+		const uint32_t vertexCount = mesh.vertexBuffers[submesh.vertexBufferIndex].count;
+		uint16_t maxIndex = 0;
+		for (uint32_t j = submesh.startIndex; j < end; j++)
+		{
+			uint16_t index = ib.Get(j);
+			maxIndex = index > maxIndex ? index : maxIndex;
+		}
+		if (end > submesh.startIndex && maxIndex >= vertexCount)
+		{
+			return Fail("vertex index out of range");
+		}
+	}
+
+	// ボーンとキーフレームの参照先
+	for (size_t i = 0; i < mesh.bones.size(); i++)
+	{
+		int32_t parent = mesh.bones[i].bone.parentIndex;
+		if (parent >= static_cast<int32_t>(mesh.bones.size()))
+		{
+			return Fail("bone parent out of range");
+		}
+	}
+	for (const CmoClipInfo& clip : mesh.clips)
+	{
+		for (uint32_t k = 0; k < clip.keyframes.count; k++)
+		{
+			if (clip.keyframes.Get(k).boneIndex >= mesh.bones.size())
+			{
+				return Fail("keyframe bone out of range");
+			}
+		}
+	}
+	return true;
+}
+
+bool CmoReader::Fail(const char* error)
+{
+	m_error = error;
+	m_meshes.clear();
+	return false;
+}
@@ -0,0 +1,223 @@
+﻿/// <summary>
+/// CMO（Visual Studio のメッシュ形式）を読み取るクラス
+/// </summary>
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "FileSystem.h"
+
+// ファイル上のデータ構造（DirectXTK の ModelLoadCMO と同じ配置）
+#pragma pack(push, 4)
+
+// マテリアル
+struct CmoMaterial
+{
+	float ambient[4];
+	float diffuse[4];
+	float specular[4];
+	float specularPower;
+	float emissive[4];
+	float uvTransform[16];
+};
+
+// サブメッシュ（インデックスバッファの一部を１つのマテリアルで描画する単位）
+struct CmoSubMesh
+{
+	uint32_t materialIndex;
+	uint32_t indexBufferIndex;
+	uint32_t vertexBufferIndex;
+	uint32_t startIndex;
+	uint32_t primCount;
+};
+
+// 頂点（VertexPositionNormalTangentColorTexture と同じ配置）
+struct CmoVertex
+{
+	float position[3];
+	float normal[3];
+	float tangent[4];
+	uint32_t color;
+	float textureCoordinate[2];
+};
+
+// スキニング用の頂点情報
+struct CmoSkinningVertex
+{
+	uint32_t boneIndex[4];
+	float boneWeight[4];
+};
+
+// 境界
+struct CmoMeshExtents
+{
+	float centerX, centerY, centerZ;
+	float radius;
+	float minX, minY, minZ;
+	float maxX, maxY, maxZ;
+};
+
+// ボーン
+struct CmoBone
+{
+	int32_t parentIndex;
+	float invBindPos[16];
+	float bindPos[16];
+	float localTransform[16];
+};
+
+// アニメーションクリップ
+struct CmoClip
+{
+	float startTime;
+	float endTime;
+	uint32_t keys;
+};
+
+// キーフレーム
+struct CmoKeyframe
+{
+	uint32_t boneIndex;
+	float time;
+	float transform[16];
+};
+
+#pragma pack(pop)
+
+static_assert(sizeof(CmoMaterial) == 132, "CMO material size mismatch");
+static_assert(sizeof(CmoSubMesh) == 20, "CMO submesh size mismatch");
+static_assert(sizeof(CmoVertex) == 52, "CMO vertex size mismatch");
+static_assert(sizeof(CmoSkinningVertex) == 32, "CMO skinning vertex size mismatch");
+static_assert(sizeof(CmoMeshExtents) == 40, "CMO extents size mismatch");
+static_assert(sizeof(CmoBone) == 196, "CMO bone size mismatch");
+static_assert(sizeof(CmoClip) == 12, "CMO clip size mismatch");
+static_assert(sizeof(CmoKeyframe) == 72, "CMO keyframe size mismatch");
+
+// ファイル上の配列を指す（コピーしない）
+// 名前の長さによって４バイト境界に揃っていないことがあるので、要素は Get でコピーして取り出す
+template<typename T>
+struct CmoArray
+{
+	// 先頭
+	const uint8_t* data;
+	// 要素数
+	uint32_t count;
+
+	// i 番目の要素
+	T Get(uint32_t i) const
+	{
+		T value;
+		std::memcpy(&value, data + static_cast<size_t>(i) * sizeof(T), sizeof(T));
+		return value;
+	}
+	// バイト数（そのままバッファの初期データに渡せる）
+	size_t GetBytes() const { return static_cast<size_t>(count) * sizeof(T); }
+};
+
+// ファイル上の UTF-16 の名前を指す（終端の 0 を含まない）
+struct CmoString
+{
+	// 先頭
+	const uint8_t* data;
+	// 文字数
+	uint32_t length;
+
+	// ワイド文字列に変換
+	std::wstring ToWString() const;
+};
+
+// マテリアルと参照するシェーダー、テクスチャ
+struct CmoMaterialInfo
+{
+	// 最大テクスチャ数
+	static const int MAX_TEXTURE = 8;
+
+	CmoString name;
+	CmoMaterial material;
+	CmoString pixelShader;
+	CmoString textures[MAX_TEXTURE];
+};
+
+// ボーン
+struct CmoBoneInfo
+{
+	CmoString name;
+	CmoBone bone;
+};
+
+// アニメーションクリップ
+struct CmoClipInfo
+{
+	CmoString name;
+	CmoClip clip;
+	CmoArray<CmoKeyframe> keyframes;
+};
+
+// メッシュ
+struct CmoMesh
+{
+	CmoString name;
+	std::vector<CmoMaterialInfo> materials;
+	bool hasSkeleton;
+	CmoArray<CmoSubMesh> submeshes;
+	std::vector<CmoArray<uint16_t>> indexBuffers;
+	std::vector<CmoArray<CmoVertex>> vertexBuffers;
+	// 無いか、vertexBuffers と同じ数
+	std::vector<CmoArray<CmoSkinningVertex>> skinningVertexBuffers;
+	CmoMeshExtents extents;
+	std::vector<CmoBoneInfo> bones;
+	std::vector<CmoClipInfo> clips;
+};
+
+// 全ての読み取りで範囲を確認し、サブメッシュとインデックスが
+// 存在するバッファ・頂点を指していることも確かめる
+// 頂点やインデックスはファイル上のデータを指すだけで、コピーしない
+class CmoReader
+{
+public:
+	CmoReader();
+
+	// ファイルをメモリにマップして解析する（失敗したら false）
+	bool Open(const std::wstring& path);
+	// メモリ上のデータを解析する（data は解析結果を使う間、有効でなければならない）
+	bool Parse(const uint8_t* data, size_t size);
+
+	// 解析したデータの先頭（Model::CreateFromCMO にそのまま渡せる）
+	const uint8_t* GetData() const { return m_data; }
+	// 解析したデータのバイト数
+	size_t GetSize() const { return m_size; }
+	// メッシュ
+	const std::vector<CmoMesh>& GetMeshes() const { return m_meshes; }
+	// 頂点とインデックスの合計バイト数
+	size_t GetGeometryBytes() const;
+	// 失敗した理由
+	const std::string& GetError() const { return m_error; }
+
+private:
+	CmoReader(const CmoReader&) = delete;
+	CmoReader& operator=(const CmoReader&) = delete;
+
+	// 読み取り位置
+	class Cursor;
+
+	// メッシュを１つ読み取る
+	bool ParseMesh(Cursor& cursor, CmoMesh& mesh);
+	// サブメッシュの参照先を確認
+	bool ValidateMesh(const CmoMesh& mesh);
+	// 失敗した理由を設定して false を返す
+	bool Fail(const char* error);
+
+	// マップしたファイル
+	MappedFile m_file;
+	// 解析したデータ
+	const uint8_t* m_data;
+	size_t m_size;
+	// メッシュ
+	std::vector<CmoMesh> m_meshes;
+	// 失敗した理由
+	std::string m_error;
+};
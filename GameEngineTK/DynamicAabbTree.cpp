@@ -0,0 +1,527 @@
+﻿#include "DynamicAabbTree.h"
+
+#include <algorithm>
+#include <cmath>
+#include <queue>
+#include <utility>
+
+namespace
+{
+	// 動きに合わせて太ったボックスを進行方向へ伸ばす倍率
+	const float DISPLACEMENT_MULTIPLIER = 2.0f;
+
+	// 両方を囲むボックス
+	Aabb Union(const Aabb& a, const Aabb& b)
+	{
+		Aabb result =
+		{
+			{ std::min(a.min.x, b.min.x), std::min(a.min.y, b.min.y), std::min(a.min.z, b.min.z) },
+			{ std::max(a.max.x, b.max.x), std::max(a.max.y, b.max.y), std::max(a.max.z, b.max.z) },
+		};
+		return result;
+	}
+
+	// 表面積の半分（挿入先を選ぶコスト）
+	float HalfSurfaceArea(const Aabb& aabb)
+	{
+		const float x = aabb.max.x - aabb.min.x;
+		const float y = aabb.max.y - aabb.min.y;
+		const float z = aabb.max.z - aabb.min.z;
+		return x * y + y * z + z * x;
+	}
+
+	// 全方向に広げる
+	Aabb Expand(const Aabb& aabb, float amount)
+	{
+		Aabb result =
+		{
+			{ aabb.min.x - amount, aabb.min.y - amount, aabb.min.z - amount },
+			{ aabb.max.x + amount, aabb.max.y + amount, aabb.max.z + amount },
+		};
+		return result;
+	}
+
+	// 進行方向にだけ広げる
+	void ExtendAlong(float displacement, float* minValue, float* maxValue)
+	{
+		if (displacement < 0.0f)
+		{
+			*minValue += displacement;
+		}
+		else
+		{
+			*maxValue += displacement;
+		}
+	}
+}
+
+DynamicAabbTree::DynamicAabbTree(float margin)
+	: m_root(NULL_NODE)
+	, m_freeList(NULL_NODE)
+	, m_proxyCount(0)
+	, m_margin(margin)
+{
+}
+
+int32_t DynamicAabbTree::CreateProxy(const Aabb& aabb, void* userData)
+{
+	const int32_t proxy = AllocateNode();
+	Node& node = m_nodes[proxy];
+	node.aabb = aabb;
+	node.fatAabb = Expand(aabb, m_margin);
+	node.userData = userData;
+	node.height = 0;
+	InsertLeaf(proxy);
+	m_proxyCount++;
+	return proxy;
+}
+
+void DynamicAabbTree::DestroyProxy(int32_t proxy)
+{
+	RemoveLeaf(proxy);
+	FreeNode(proxy);
+	m_proxyCount--;
+}
+
+bool DynamicAabbTree::MoveProxy(int32_t proxy, const Aabb& aabb)
+{
+	Node& node = m_nodes[proxy];
+	const Aabb previous = node.aabb;
+	node.aabb = aabb;
+
+	// 次の太ったボックス（余白に加えて今回の移動量の分だけ進行方向へ伸ばす）
+	Aabb fatAabb = Expand(aabb, m_margin);
+	const float dx = DISPLACEMENT_MULTIPLIER * ((aabb.min.x + aabb.max.x) - (previous.min.x + previous.max.x)) * 0.5f;
+	const float dy = DISPLACEMENT_MULTIPLIER * ((aabb.min.y + aabb.max.y) - (previous.min.y + previous.max.y)) * 0.5f;
+	const float dz = DISPLACEMENT_MULTIPLIER * ((aabb.min.z + aabb.max.z) - (previous.min.z + previous.max.z)) * 0.5f;
+	ExtendAlong(dx, &fatAabb.min.x, &fatAabb.max.x);
+	ExtendAlong(dy, &fatAabb.min.y, &fatAabb.max.y);
+	ExtendAlong(dz, &fatAabb.min.z, &fatAabb.max.z);
+
+	// 今の太ったボックスに収まっていて、大きすぎもしなければ木はそのまま
+	if (Contains(node.fatAabb, aabb))
+	{
+		const Aabb hugeAabb = Expand(fatAabb, 4.0f * m_margin);
+		if (Contains(hugeAabb, node.fatAabb))
+		{
+			return false;
+		}
+	}
+
+	RemoveLeaf(proxy);
+	m_nodes[proxy].fatAabb = fatAabb;
+	InsertLeaf(proxy);
+	return true;
+}
+
+size_t DynamicAabbTree::QueryNearest(const Float3& point, size_t k, int32_t* proxies, float* distances) const
+{
+	if (m_root == NULL_NODE || k == 0)
+	{
+		return 0;
+	}
+
+	// 距離の二乗とノード
+	typedef std::pair<float, int32_t> Entry;
+	// 近いノードから調べる
+	std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> open;
+	// 見つかった中で最も遠いものが先頭
+	std::priority_queue<Entry> found;
+
+	open.push(Entry(DistanceSquared(m_nodes[m_root].fatAabb, point), m_root));
+	while (!open.empty())
+	{
+		const Entry entry = open.top();
+		open.pop();
+		// 残りは全て今の k 番目より遠い
+		if (found.size() == k && entry.first > found.top().first)
+		{
+			break;
+		}
+
+		const Node& node = m_nodes[entry.second];
+		if (node.IsLeaf())
+		{
+			const float distance = DistanceSquared(node.aabb, point);
+			if (found.size() < k)
+			{
+				found.push(Entry(distance, entry.second));
+			}
+			else if (distance < found.top().first)
+			{
+				found.pop();
+				found.push(Entry(distance, entry.second));
+			}
+			continue;
+		}
+
+		const int32_t children[2] = { node.child1, node.child2 };
+		for (int32_t child : children)
+		{
+			const Node& childNode = m_nodes[child];
+			const float distance = DistanceSquared(childNode.IsLeaf() ? childNode.aabb : childNode.fatAabb, point);
+			if (found.size() < k || distance < found.top().first)
+			{
+				open.push(Entry(distance, child));
+			}
+		}
+	}
+
+	// 遠い順に取り出されるので後ろから詰める
+	const size_t count = found.size();
+	for (size_t i = count; i > 0; i--)
+	{
+		proxies[i - 1] = found.top().second;
+		if (distances)
+		{
+			distances[i - 1] = std::sqrt(found.top().first);
+		}
+		found.pop();
+	}
+	return count;
+}
+
+bool DynamicAabbTree::Validate() const
+{
+	if (m_root == NULL_NODE)
+	{
+		return m_proxyCount == 0;
+	}
+	if (m_nodes[m_root].parent != NULL_NODE)
+	{
+		return false;
+	}
+
+	size_t leafCount = 0;
+	std::vector<int32_t> stack(1, m_root);
+	while (!stack.empty())
+	{
+		const int32_t index = stack.back();
+		stack.pop_back();
+		const Node& node = m_nodes[index];
+		if (node.IsLeaf())
+		{
+			if (node.height != 0 || node.child2 != NULL_NODE || !Contains(node.fatAabb, node.aabb))
+			{
+				return false;
+			}
+			leafCount++;
+			continue;
+		}
+
+		const Node& child1 = m_nodes[node.child1];
+		const Node& child2 = m_nodes[node.child2];
+		if (child1.parent != index || child2.parent != index)
+		{
+			return false;
+		}
+		if (node.height != 1 + std::max(child1.height, child2.height))
+		{
+			return false;
+		}
+		if (!Contains(node.fatAabb, child1.fatAabb) || !Contains(node.fatAabb, child2.fatAabb))
+		{
+			return false;
+		}
+		stack.push_back(node.child1);
+		stack.push_back(node.child2);
+	}
+	return leafCount == m_proxyCount;
+}
+
+bool DynamicAabbTree::Overlaps(const Aabb& a, const Aabb& b)
+{
+	return a.min.x <= b.max.x && b.min.x <= a.max.x
+		&& a.min.y <= b.max.y && b.min.y <= a.max.y
+		&& a.min.z <= b.max.z && b.min.z <= a.max.z;
+}
+
+bool DynamicAabbTree::Overlaps(const Aabb& aabb, const Frustum& frustum)
+{
+	// 各平面について、法線方向に最も進んだ頂点が外側なら重ならない
+	for (const FrustumPlane& plane : frustum.planes)
+	{
+		const float x = plane.a >= 0.0f ? aabb.max.x : aabb.min.x;
+		const float y = plane.b >= 0.0f ? aabb.max.y : aabb.min.y;
+		const float z = plane.c >= 0.0f ? aabb.max.z : aabb.min.z;
+		if (plane.a * x + plane.b * y + plane.c * z + plane.d < 0.0f)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+bool DynamicAabbTree::Contains(const Aabb& outer, const Aabb& inner)
+{
+	return outer.min.x <= inner.min.x && outer.min.y <= inner.min.y && outer.min.z <= inner.min.z
+		&& inner.max.x <= outer.max.x && inner.max.y <= outer.max.y && inner.max.z <= outer.max.z;
+}
+
+float DynamicAabbTree::DistanceSquared(const Aabb& aabb, const Float3& point)
+{
+	const float dx = std::max(std::max(aabb.min.x - point.x, point.x - aabb.max.x), 0.0f);
+	const float dy = std::max(std::max(aabb.min.y - point.y, point.y - aabb.max.y), 0.0f);
+	const float dz = std::max(std::max(aabb.min.z - point.z, point.z - aabb.max.z), 0.0f);
+	return dx * dx + dy * dy + dz * dz;
+}
+
+int32_t DynamicAabbTree::AllocateNode()
+{
+	int32_t index;
+	if (m_freeList != NULL_NODE)
+	{
+		index = m_freeList;
+		m_freeList = m_nodes[index].parent;
+	}
+	else
+	{
+		index = static_cast<int32_t>(m_nodes.size());
+		m_nodes.push_back(Node());
+	}
+
+	Node& node = m_nodes[index];
+	node.userData = nullptr;
+	node.parent = NULL_NODE;
+	node.child1 = NULL_NODE;
+	node.child2 = NULL_NODE;
+	node.height = 0;
+	return index;
+}
+
+void DynamicAabbTree::FreeNode(int32_t node)
+{
+	m_nodes[node].parent = m_freeList;
+	m_nodes[node].child1 = NULL_NODE;
+	m_nodes[node].height = -1;
+	m_freeList = node;
+}
+
+void DynamicAabbTree::InsertLeaf(int32_t leaf)
+{
+	if (m_root == NULL_NODE)
+	{
+		m_root = leaf;
+		m_nodes[leaf].parent = NULL_NODE;
+		return;
+	}
+
+	// 表面積の増え方が最も小さくなる兄弟を探す
+	const Aabb leafAabb = m_nodes[leaf].fatAabb;
+	int32_t index = m_root;
+	while (!m_nodes[index].IsLeaf())
+	{
+		const Node& node = m_nodes[index];
+		const float area = HalfSurfaceArea(node.fatAabb);
+		const float combinedArea = HalfSurfaceArea(Union(node.fatAabb, leafAabb));
+
+		// ここに新しい親を作る場合のコスト
+		const float cost = 2.0f * combinedArea;
+		// 下に降りる場合に、このノードが大きくなる分
+		const float inheritanceCost = 2.0f * (combinedArea - area);
+
+		float childCosts[2];
+		const int32_t children[2] = { node.child1, node.child2 };
+		for (int i = 0; i < 2; i++)
+		{
+			const Node& child = m_nodes[children[i]];
+			const float unionArea = HalfSurfaceArea(Union(child.fatAabb, leafAabb));
+			childCosts[i] = (child.IsLeaf() ? unionArea : unionArea - HalfSurfaceArea(child.fatAabb)) + inheritanceCost;
+		}
+
+		if (cost < childCosts[0] && cost < childCosts[1])
+		{
+			break;
+		}
+		index = childCosts[0] < childCosts[1] ? children[0] : children[1];
+	}
+	const int32_t sibling = index;
+
+	// 兄弟と新しい葉をまとめる親を作る（確保で配列が伸びるので参照は後で取る）
+	const int32_t newParent = AllocateNode();
+	const int32_t oldParent = m_nodes[sibling].parent;
+	Node& parentNode = m_nodes[newParent];
+	parentNode.parent = oldParent;
+	parentNode.fatAabb = Union(leafAabb, m_nodes[sibling].fatAabb);
+	parentNode.height = m_nodes[sibling].height + 1;
+	parentNode.child1 = sibling;
+	parentNode.child2 = leaf;
+	m_nodes[sibling].parent = newParent;
+	m_nodes[leaf].parent = newParent;
+
+	if (oldParent == NULL_NODE)
+	{
+		m_root = newParent;
+	}
+	else if (m_nodes[oldParent].child1 == sibling)
+	{
+		m_nodes[oldParent].child1 = newParent;
+	}
+	else
+	{
+		m_nodes[oldParent].child2 = newParent;
+	}
+
+	FixUpwards(m_nodes[leaf].parent);
+}
+
+void DynamicAabbTree::RemoveLeaf(int32_t leaf)
+{
+	if (leaf == m_root)
+	{
+		m_root = NULL_NODE;
+		return;
+	}
+
+	// 親を取り除き、兄弟を祖父の子にする
+	const int32_t parent = m_nodes[leaf].parent;
+	const int32_t grandParent = m_nodes[parent].parent;
+	const int32_t sibling = m_nodes[parent].child1 == leaf ? m_nodes[parent].child2 : m_nodes[parent].child1;
+
+	if (grandParent == NULL_NODE)
+	{
+		m_root = sibling;
+		m_nodes[sibling].parent = NULL_NODE;
+		FreeNode(parent);
+	}
+	else
+	{
+		if (m_nodes[grandParent].child1 == parent)
+		{
+			m_nodes[grandParent].child1 = sibling;
+		}
+		else
+		{
+			m_nodes[grandParent].child2 = sibling;
+		}
+		m_nodes[sibling].parent = grandParent;
+		FreeNode(parent);
+		FixUpwards(grandParent);
+	}
+	m_nodes[leaf].parent = NULL_NODE;
+}
+
+void DynamicAabbTree::FixUpwards(int32_t node)
+{
+	while (node != NULL_NODE)
+	{
+		node = Balance(node);
+		Node& current = m_nodes[node];
+		const Node& child1 = m_nodes[current.child1];
+		const Node& child2 = m_nodes[current.child2];
+		current.height = 1 + std::max(child1.height, child2.height);
+		current.fatAabb = Union(child1.fatAabb, child2.fatAabb);
+		node = current.parent;
+	}
+}
+
+int32_t DynamicAabbTree::Balance(int32_t iA)
+{
+	Node& a = m_nodes[iA];
+	if (a.IsLeaf() || a.height < 2)
+	{
+		return iA;
+	}
+
+	const int32_t iB = a.child1;
+	const int32_t iC = a.child2;
+	Node& b = m_nodes[iB];
+	Node& c = m_nodes[iC];
+	const int32_t balance = c.height - b.height;
+
+	// 右の子 C が高すぎるときは C を A の位置に上げ、A を C の左の子にする
+	if (balance > 1)
+	{
+		const int32_t iF = c.child1;
+		const int32_t iG = c.child2;
+		Node& f = m_nodes[iF];
+		Node& g = m_nodes[iG];
+
+		c.child1 = iA;
+		c.parent = a.parent;
+		a.parent = iC;
+		if (c.parent == NULL_NODE)
+		{
+			m_root = iC;
+		}
+		else if (m_nodes[c.parent].child1 == iA)
+		{
+			m_nodes[c.parent].child1 = iC;
+		}
+		else
+		{
+			m_nodes[c.parent].child2 = iC;
+		}
+
+		// 高い方の孫を C に残し、低い方を A に移す
+		if (f.height > g.height)
+		{
+			c.child2 = iF;
+			a.child2 = iG;
+			g.parent = iA;
+			a.fatAabb = Union(b.fatAabb, g.fatAabb);
+			c.fatAabb = Union(a.fatAabb, f.fatAabb);
+			a.height = 1 + std::max(b.height, g.height);
+			c.height = 1 + std::max(a.height, f.height);
+		}
+		else
+		{
+			c.child2 = iG;
+			a.child2 = iF;
+			f.parent = iA;
+			a.fatAabb = Union(b.fatAabb, f.fatAabb);
+			c.fatAabb = Union(a.fatAabb, g.fatAabb);
+			a.height = 1 + std::max(b.height, f.height);
+			c.height = 1 + std::max(a.height, g.height);
+		}
+		return iC;
+	}
+
+	// 左右を入れ替えた同じ回転
+	if (balance < -1)
+	{
+		const int32_t iD = b.child1;
+		const int32_t iE = b.child2;
+		Node& d = m_nodes[iD];
+		Node& e = m_nodes[iE];
+
+		b.child1 = iA;
+		b.parent = a.parent;
+		a.parent = iB;
+		if (b.parent == NULL_NODE)
+		{
+			m_root = iB;
+		}
+		else if (m_nodes[b.parent].child1 == iA)
+		{
+			m_nodes[b.parent].child1 = iB;
+		}
+		else
+		{
+			m_nodes[b.parent].child2 = iB;
+		}
+
+		if (d.height > e.height)
+		{
+			b.child2 = iD;
+			a.child1 = iE;
+			e.parent = iA;
+			a.fatAabb = Union(c.fatAabb, e.fatAabb);
+			b.fatAabb = Union(a.fatAabb, d.fatAabb);
+			a.height = 1 + std::max(c.height, e.height);
+			b.height = 1 + std::max(a.height, d.height);
+		}
+		else
+		{
+			b.child2 = iE;
+			a.child1 = iD;
+			d.parent = iA;
+			a.fatAabb = Union(c.fatAabb, d.fatAabb);
+			b.fatAabb = Union(a.fatAabb, e.fatAabb);
+			a.height = 1 + std::max(c.height, d.height);
+			b.height = 1 + std::max(a.height, e.height);
+		}
+		return iB;
+	}
+	return iA;
+}
@@ -0,0 +1,177 @@
+﻿/// <summary>
+/// 動的 AABB 木（オブジェクトの境界ボックスを検索するための空間インデックス）
+/// </summary>
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "FrustumCulling.h"
+#include "TransformMath.h"
+
+// 軸に平行な境界ボックス
+struct Aabb
+{
+	Float3 min;
+	Float3 max;
+};
+
+// 中心と半径の球を囲むボックス
+inline Aabb AabbFromSphere(const Float3& center, float radius)
+{
+	Aabb aabb =
+	{
+		{ center.x - radius, center.y - radius, center.z - radius },
+		{ center.x + radius, center.y + radius, center.z + radius },
+	};
+	return aabb;
+}
+
+// 葉にオブジェクト（プロキシ）を１つずつ持つ二分木
+// 葉には余白を付けた「太った」ボックスを登録し、オブジェクトが少し動いただけなら木を変更しない
+// はみ出したときだけ取り外して挿入し直し、挿入・削除の経路上で回転して高さの偏りを抑える
+// 検索では内部ノードを太ったボックスで絞り込み、葉は実際のボックスで判定する
+class DynamicAabbTree
+{
+public:
+	// 無効なノード
+	static const int32_t NULL_NODE = -1;
+
+	// margin は太ったボックスの余白
+	explicit DynamicAabbTree(float margin = 0.1f);
+
+	// プロキシを追加してその番号を返す
+	int32_t CreateProxy(const Aabb& aabb, void* userData);
+	// プロキシを削除
+	void DestroyProxy(int32_t proxy);
+	// プロキシのボックスを更新する（木を組み替えたら true）
+	bool MoveProxy(int32_t proxy, const Aabb& aabb);
+
+	// プロキシの情報
+	void* GetUserData(int32_t proxy) const { return m_nodes[proxy].userData; }
+	void SetUserData(int32_t proxy, void* userData) { m_nodes[proxy].userData = userData; }
+	const Aabb& GetAabb(int32_t proxy) const { return m_nodes[proxy].aabb; }
+	const Aabb& GetFatAabb(int32_t proxy) const { return m_nodes[proxy].fatAabb; }
+
+	// ボックスと重なるプロキシを callback(proxy) に渡す（callback が false を返したら打ち切る）
+	template<typename Callback>
+	void QueryAabb(const Aabb& aabb, const Callback& callback) const
+	{
+		Query([&aabb](const Aabb& box) { return Overlaps(box, aabb); }, callback);
+	}
+	// 球と重なるプロキシを callback(proxy) に渡す
+	template<typename Callback>
+	void QuerySphere(const Float3& center, float radius, const Callback& callback) const
+	{
+		const float radiusSquared = radius * radius;
+		Query([&center, radiusSquared](const Aabb& box) { return DistanceSquared(box, center) <= radiusSquared; }, callback);
+	}
+	// 視錐台と重なるプロキシを callback(proxy) に渡す
+	template<typename Callback>
+	void QueryFrustum(const Frustum& frustum, const Callback& callback) const
+	{
+		Query([&frustum](const Aabb& box) { return Overlaps(box, frustum); }, callback);
+	}
+	// point に近い順に最大 k 個のプロキシを求める（距離はボックスまでの距離、中にあれば 0）
+	// proxies と distances（nullptr 可）は k 個分の大きさが必要で、見つかった数を返す
+	size_t QueryNearest(const Float3& point, size_t k, int32_t* proxies, float* distances) const;
+
+	// 全てのプロキシを callback(proxy) に渡す（callback 内で MoveProxy してよい）
+	template<typename Callback>
+	void ForEachProxy(const Callback& callback) const
+	{
+		for (size_t i = 0; i < m_nodes.size(); i++)
+		{
+			if (m_nodes[i].height == 0)
+			{
+				callback(static_cast<int32_t>(i));
+			}
+		}
+	}
+
+	// プロキシの数
+	size_t GetProxyCount() const { return m_proxyCount; }
+	// 木の高さ（葉だけなら 0）
+	int32_t GetHeight() const { return m_root == NULL_NODE ? 0 : m_nodes[m_root].height; }
+	// 親子関係・高さ・ボックスが正しいか確かめる（デバッグ用）
+	bool Validate() const;
+
+	// 判定
+	static bool Overlaps(const Aabb& a, const Aabb& b);
+	static bool Overlaps(const Aabb& aabb, const Frustum& frustum);
+	static bool Contains(const Aabb& outer, const Aabb& inner);
+	static float DistanceSquared(const Aabb& aabb, const Float3& point);
+
+private:
+	// ノード（空いているノードは parent を次の空きノードとして使う）
+	struct Node
+	{
+		// 葉は太ったボックス、内部ノードは子を囲むボックス
+		Aabb fatAabb;
+		// 葉の実際のボックス
+		Aabb aabb;
+		void* userData;
+		int32_t parent;
+		int32_t child1;
+		int32_t child2;
+		// 葉は 0、空きノードは -1
+		int32_t height;
+
+		bool IsLeaf() const { return child1 == NULL_NODE; }
+	};
+
+	// 検索で使うスタックの大きさ（高さの釣り合いが取れていれば足りる）
+	static const int QUERY_STACK_SIZE = 128;
+
+	// test(ボックス) が真になる葉を callback に渡す
+	template<typename Test, typename Callback>
+	void Query(const Test& test, const Callback& callback) const
+	{
+		if (m_root == NULL_NODE)
+		{
+			return;
+		}
+		int32_t stack[QUERY_STACK_SIZE];
+		int count = 0;
+		stack[count++] = m_root;
+		while (count > 0)
+		{
+			const Node& node = m_nodes[stack[--count]];
+			if (node.IsLeaf())
+			{
+				if (test(node.aabb) && !callback(static_cast<int32_t>(&node - m_nodes.data())))
+				{
+					return;
+				}
+			}
+			else if (test(node.fatAabb))
+			{
+				stack[count++] = node.child1;
+				stack[count++] = node.child2;
+			}
+		}
+	}
+
+	// ノードの確保と解放
+	int32_t AllocateNode();
+	void FreeNode(int32_t node);
+	// 葉を挿入・取り外し
+	void InsertLeaf(int32_t leaf);
+	void RemoveLeaf(int32_t leaf);
+	// node から根まで、ボックスと高さを直しながら回転する
+	void FixUpwards(int32_t node);
+	// 高さの差が 2 以上なら回転して、部分木の新しい根を返す
+	int32_t Balance(int32_t node);
+
+	// ノード
+	std::vector<Node> m_nodes;
+	// 根
+	int32_t m_root;
+	// 空きノードのリスト
+	int32_t m_freeList;
+	// プロキシの数
+	size_t m_proxyCount;
+	// 太ったボックスの余白
+	float m_margin;
+};
@@ -0,0 +1,349 @@
+﻿#include "FileSystem.h"
+
+#include <algorithm>
+#include <cstdio>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	// パスを指定してファイルを開く
+	FILE* OpenFile(const std::wstring& path, const wchar_t* mode)
+	{
+#if defined(_WIN32)
+		FILE* file = nullptr;
+		if (_wfopen_s(&file, path.c_str(), mode) != 0)
+		{
+			return nullptr;
+		}
+		return file;
+#else
+		return std::fopen(ToUtf8(path).c_str(), ToUtf8(mode).c_str());
+#endif
+	}
+}
+
+std::string ToUtf8(const std::wstring& text)
+{
+	std::string result;
+	result.reserve(text.size());
+	for (size_t i = 0; i < text.size(); i++)
+	{
+		uint32_t code = static_cast<uint32_t>(text[i]);
+		// UTF-16 のサロゲートペアを１文字にまとめる
+		if (code >= 0xD800 && code <= 0xDBFF && i + 1 < text.size())
+		{
+			uint32_t low = static_cast<uint32_t>(text[i + 1]);
+			if (low >= 0xDC00 && low <= 0xDFFF)
+			{
+				code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+				i++;
+			}
+		}
+
+		if (code < 0x80)
+		{
+			result += static_cast<char>(code);
+		}
+		else if (code < 0x800)
+		{
+			result += static_cast<char>(0xC0 | (code >> 6));
+			result += static_cast<char>(0x80 | (code & 0x3F));
+		}
+		else if (code < 0x10000)
+		{
+			result += static_cast<char>(0xE0 | (code >> 12));
+			result += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+			result += static_cast<char>(0x80 | (code & 0x3F));
+		}
+		else
+		{
+			result += static_cast<char>(0xF0 | (code >> 18));
+			result += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+			result += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+			result += static_cast<char>(0x80 | (code & 0x3F));
+		}
+	}
+	return result;
+}
+
+std::wstring FromUtf8(const std::string& text)
+{
+	std::wstring result;
+	result.reserve(text.size());
+	for (size_t i = 0; i < text.size();)
+	{
+		const uint32_t lead = static_cast<uint8_t>(text[i]);
+		// 先頭バイトから後続バイトの数を求める
+		uint32_t code = lead;
+		size_t extra = 0;
+		if ((lead & 0xE0) == 0xC0)
+		{
+			code = lead & 0x1F;
+			extra = 1;
+		}
+		else if ((lead & 0xF0) == 0xE0)
+		{
+			code = lead & 0x0F;
+			extra = 2;
+		}
+		else if ((lead & 0xF8) == 0xF0)
+		{
+			code = lead & 0x07;
+			extra = 3;
+		}
+		// 途中で切れている時はそのまま１文字とする
+		if (i + extra >= text.size())
+		{
+			code = lead;
+			extra = 0;
+		}
+		for (size_t j = 1; j <= extra; j++)
+		{
+			code = (code << 6) | (static_cast<uint8_t>(text[i + j]) & 0x3F);
+		}
+		i += extra + 1;
+
+		// wchar_t が 16bit の環境ではサロゲートペアにする
+		if (code >= 0x10000 && sizeof(wchar_t) == 2)
+		{
+			code -= 0x10000;
+			result += static_cast<wchar_t>(0xD800 + (code >> 10));
+			result += static_cast<wchar_t>(0xDC00 + (code & 0x3FF));
+		}
+		else
+		{
+			result += static_cast<wchar_t>(code);
+		}
+	}
+	return result;
+}
+
+bool ReadWholeFile(const std::wstring& path, std::vector<uint8_t>& data)
+{
+	FILE* file = OpenFile(path, L"rb");
+	if (!file)
+	{
+		return false;
+	}
+
+	// サイズを調べて一度に読み込む
+	bool isSucceeded = false;
+	if (std::fseek(file, 0, SEEK_END) == 0)
+	{
+		long size = std::ftell(file);
+		if (size >= 0 && std::fseek(file, 0, SEEK_SET) == 0)
+		{
+			data.resize(static_cast<size_t>(size));
+			isSucceeded = size == 0 || std::fread(data.data(), 1, data.size(), file) == data.size();
+		}
+	}
+	std::fclose(file);
+	return isSucceeded;
+}
+
+bool WriteWholeFile(const std::wstring& path, const void* data, size_t size)
+{
+	FILE* file = OpenFile(path, L"wb");
+	if (!file)
+	{
+		return false;
+	}
+	bool isSucceeded = size == 0 || std::fwrite(data, 1, size, file) == size;
+	// 書き込みの失敗は閉じる時に分かることもある
+	isSucceeded = std::fclose(file) == 0 && isSucceeded;
+	return isSucceeded;
+}
+
+bool AppendToFile(const std::wstring& path, const void* data, size_t size)
+{
+	FILE* file = OpenFile(path, L"ab");
+	if (!file)
+	{
+		return false;
+	}
+	bool isSucceeded = size == 0 || std::fwrite(data, 1, size, file) == size;
+	isSucceeded = std::fclose(file) == 0 && isSucceeded;
+	return isSucceeded;
+}
+
+bool PathExists(const std::wstring& path)
+{
+#if defined(_WIN32)
+	return GetFileAttributesW(path.c_str()) != INVALID_FILE_ATTRIBUTES;
+#else
+	struct stat status;
+	return stat(ToUtf8(path).c_str(), &status) == 0;
+#endif
+}
+
+bool IsDirectory(const std::wstring& path)
+{
+#if defined(_WIN32)
+	DWORD attributes = GetFileAttributesW(path.c_str());
+	return attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+#else
+	struct stat status;
+	return stat(ToUtf8(path).c_str(), &status) == 0 && S_ISDIR(status.st_mode);
+#endif
+}
+
+bool ListFiles(const std::wstring& directory, std::vector<std::wstring>& files)
+{
+	std::vector<std::wstring> names;
+#if defined(_WIN32)
+	WIN32_FIND_DATAW data;
+	HANDLE find = FindFirstFileW((directory + L"\\*").c_str(), &data);
+	if (find == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+	do
+	{
+		names.push_back(data.cFileName);
+	} while (FindNextFileW(find, &data));
+	FindClose(find);
+#else
+	DIR* dir = opendir(ToUtf8(directory).c_str());
+	if (!dir)
+	{
+		return false;
+	}
+	while (dirent* entry = readdir(dir))
+	{
+		names.push_back(FromUtf8(entry->d_name));
+	}
+	closedir(dir);
+#endif
+
+	// 列挙の順はシステムによって違うので名前順にする
+	std::sort(names.begin(), names.end());
+	for (const std::wstring& name : names)
+	{
+		if (name == L"." || name == L"..")
+		{
+			continue;
+		}
+		std::wstring path = directory + L"/" + name;
+		if (IsDirectory(path))
+		{
+			if (!ListFiles(path, files))
+			{
+				return false;
+			}
+		}
+		else
+		{
+			files.push_back(path);
+		}
+	}
+	return true;
+}
+
+MappedFile::MappedFile()
+	: m_data(nullptr)
+	, m_size(0)
+#if defined(_WIN32)
+	, m_mapping(nullptr)
+#endif
+{
+}
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+bool MappedFile::Open(const std::wstring& path)
+{
+	Close();
+
+#if defined(_WIN32)
+	HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || size.QuadPart == 0
+		|| static_cast<unsigned long long>(size.QuadPart) > static_cast<size_t>(-1))
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	// マッピングオブジェクトがファイルを参照し続けるので、ファイルのハンドルは閉じてよい
+	HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	CloseHandle(file);
+	if (!mapping)
+	{
+		return false;
+	}
+
+	void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!data)
+	{
+		CloseHandle(mapping);
+		return false;
+	}
+
+	m_mapping = mapping;
+	m_data = static_cast<const uint8_t*>(data);
+	m_size = static_cast<size_t>(size.QuadPart);
+#else
+	int file = open(ToUtf8(path).c_str(), O_RDONLY);
+	if (file < 0)
+	{
+		return false;
+	}
+
+	struct stat status;
+	if (fstat(file, &status) != 0 || status.st_size <= 0)
+	{
+		close(file);
+		return false;
+	}
+
+	// マップはファイルを閉じても有効
+	void* data = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+	close(file);
+	if (data == MAP_FAILED)
+	{
+		return false;
+	}
+	// 先頭から順に読むので先読みさせる
+	madvise(data, static_cast<size_t>(status.st_size), MADV_SEQUENTIAL);
+
+	m_data = static_cast<const uint8_t*>(data);
+	m_size = static_cast<size_t>(status.st_size);
+#endif
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (!m_data)
+	{
+		return;
+	}
+
+#if defined(_WIN32)
+	UnmapViewOfFile(m_data);
+	CloseHandle(m_mapping);
+	m_mapping = nullptr;
+#else
+	munmap(const_cast<uint8_t*>(m_data), m_size);
+#endif
+	m_data = nullptr;
+	m_size = 0;
+}
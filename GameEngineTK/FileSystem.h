@@ -0,0 +1,64 @@
+﻿/// <summary>
+/// プラットフォームに依存しないファイル操作
+/// </summary>
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// ワイド文字列のパスを UTF-8 に変換
+std::string ToUtf8(const std::wstring& text);
+
+// UTF-8 の文字列をワイド文字列に変換
+std::wstring FromUtf8(const std::string& text);
+
+// ファイル全体を読み込む（失敗したら false）
+bool ReadWholeFile(const std::wstring& path, std::vector<uint8_t>& data);
+
+// データをファイルに書き込む（失敗したら false）
+bool WriteWholeFile(const std::wstring& path, const void* data, size_t size);
+
+// データをファイルの末尾に追加する（無ければ作る、失敗したら false）
+bool AppendToFile(const std::wstring& path, const void* data, size_t size);
+
+// ファイルかフォルダがあるか
+bool PathExists(const std::wstring& path);
+
+// パスがフォルダか
+bool IsDirectory(const std::wstring& path);
+
+// フォルダ以下（サブフォルダを含む）のファイルを列挙する（失敗したら false）
+bool ListFiles(const std::wstring& directory, std::vector<std::wstring>& files);
+
+// ファイルをメモリにマップして読み取り専用で参照するクラス
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+
+	// ファイルをマップする（失敗したら false）
+	bool Open(const std::wstring& path);
+	// マップを解除する
+	void Close();
+
+	// マップしたデータの先頭
+	const uint8_t* GetData() const { return m_data; }
+	// マップしたデータのバイト数
+	size_t GetSize() const { return m_size; }
+
+private:
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	// マップしたデータ
+	const uint8_t* m_data;
+	// バイト数
+	size_t m_size;
+#if defined(_WIN32)
+	// ファイルマッピングオブジェクト
+	void* m_mapping;
+#endif
+};
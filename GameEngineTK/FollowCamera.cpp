@@ -1,114 +0,0 @@
-#include "FollowCamera.h"
-
-using namespace DirectX;
-using namespace DirectX::SimpleMath;
-
-// ÓIoϐ̏
-const float FollowCamera::CAMERA_DISTANCE = 5.0f;
-
-FollowCamera::FollowCamera(int width, int height)
-	: Camera(width, height)
-{
-	m_targetPos = Vector3::Zero;
-	m_targetAngle = 0.0f;
-	m_keyboard = nullptr;
-	isFPS = false;
-	InitializeTPS();
-}
-
-void FollowCamera::Update()
-{
-	Vector3 eyepos, refpos;
-
-	// L[{[h̏Ԃ擾
-	Keyboard::State keystate = m_keyboard->GetState();
-	m_keyboardTracker.Update(keystate);
-
-	// CL[
-	if (m_keyboardTracker.IsKeyPressed(Keyboard::Keyboard::C))
-	{
-		// tO؂ւ
-		isFPS = !isFPS;
-		if (!isFPS)
-		{
-			InitializeTPS();
-		}
-	}
-
-	if (isFPS)
-	{ // FPSJ
-		Vector3 position;
-		// @̏0.2̈ʒuɃJu
-		position = m_targetPos + Vector3(0, 0.2f, 0);
-		// QƓ_王_ւ̍
-		Vector3 cameraV(0, 0, -CAMERA_DISTANCE);
-		// @̌ɉ荞ނ߂̉]
-		Matrix rotmat = Matrix::CreateRotationY(m_targetAngle);
-		// xNg]
-		cameraV = Vector3::TransformNormal(cameraV, rotmat);
-		// Ɛi񂾈ʒu_
-		eyepos = position + cameraV * 0.1f;
-		// i񂾈ʒuQƓ_
-		refpos = position + cameraV;
-	}
-	else 
-	{ // TPSJ
-		// @̏Q̈ʒu𑨂
-		refpos = m_targetPos + Vector3(0, 2, 0);
-		// QƓ_王_ւ̍
-		Vector3 cameraV(0, 0, CAMERA_DISTANCE);
-		// @̌ɉ荞ނ߂̉]
-		Matrix rotmat = Matrix::CreateRotationY(m_targetAngle);
-		// xNg]
-		cameraV = Vector3::TransformNormal(cameraV, rotmat);
-		// _WvZ
-		eyepos = refpos + cameraV;
-		// _݈ʒu
-		eyepos = m_eyepos + (eyepos - m_eyepos) * 0.05f;
-		// QƓ_݈ʒu
-		refpos = m_refpos + (refpos - m_refpos) * 0.20f;
-	}
-
-	
-
-
-	SetEyePos(eyepos);
-	SetRefPos(refpos);
-
-	// NX̍XV
-	Camera::Update();
-}
-
-void FollowCamera::InitializeTPS()
-{
-	Vector3 eyepos, refpos;
-
-	// @̏Q̈ʒu𑨂
-	refpos = m_targetPos + Vector3(0, 2, 0);
-	// QƓ_王_ւ̍
-	Vector3 cameraV(0, 0, CAMERA_DISTANCE);
-	// @̌ɉ荞ނ߂̉]
-	Matrix rotmat = Matrix::CreateRotationY(m_targetAngle);
-	// xNg]
-	cameraV = Vector3::TransformNormal(cameraV, rotmat);
-	// _WvZ
-	eyepos = refpos + cameraV;
-
-	SetEyePos(eyepos);
-	SetRefPos(refpos);
-}
-
-void FollowCamera::SetTargetPos(const DirectX::SimpleMath::Vector3 & targetpos)
-{
-	m_targetPos = targetpos;
-}
-
-void FollowCamera::SetTargetAngle(float targetAngle)
-{
-	m_targetAngle = targetAngle;
-}
-
-void FollowCamera::SetKeyboard(DirectX::Keyboard * keyboard)
-{
-	m_keyboard = keyboard;
-}
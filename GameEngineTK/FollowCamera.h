@@ -1,42 +0,0 @@
-/// <summary>
-/// @ɒǏ]JNX
-/// </summary>
-#pragma once
-
-#include "Camera.h"
-#include <Keyboard.h>
-
-class FollowCamera : public Camera
-{
-public:
-	// JƎ@̋
-	static const float CAMERA_DISTANCE;
-	// RXgN^
-	FollowCamera(int width, int height);
-	// t[XV
-	void Update() override;
-
-	// TPSJ̏
-	void InitializeTPS();
-
-	// Ǐ]ΏۍWZbg
-	void SetTargetPos(const DirectX::SimpleMath::Vector3& targetpos);
-
-	// Ǐ]ΏۊpxZbg
-	void SetTargetAngle(float targetAngle);
-
-	// L[{[hZbg
-	void SetKeyboard(DirectX::Keyboard* keyboard);
-
-protected:
-	// Ǐ]Ώۂ̍W
-	DirectX::SimpleMath::Vector3 m_targetPos;
-	// Ǐ]Ώۂ̊px
-	float m_targetAngle;
-	// L[{[h
-	DirectX::Keyboard* m_keyboard;
-	// L[{[hgbJ[
-	DirectX::Keyboard::KeyboardStateTracker m_keyboardTracker;
-	// FPSJtO
-	bool isFPS;
-};
@@ -0,0 +1,132 @@
+﻿#include "FrameArena.h"
+
+#include <algorithm>
+#include <new>
+
+namespace
+{
+	// address を alignment（２の累乗）の境界に切り上げる
+	uintptr_t AlignUp(uintptr_t address, size_t alignment)
+	{
+		return (address + alignment - 1) & ~static_cast<uintptr_t>(alignment - 1);
+	}
+}
+
+FrameArena::FrameArena(size_t capacity)
+	: m_base(nullptr)
+	, m_offset(0)
+	, m_overflowUsed(0)
+	, m_overflowBlocks(nullptr)
+	, m_generation(0)
+	, m_statistics()
+{
+	// 領域は初めて使うときに確保する（使わないスレッドでは確保しない）
+	m_statistics.capacity = capacity;
+}
+
+FrameArena::~FrameArena()
+{
+	while (m_overflowBlocks)
+	{
+		OverflowBlock* next = m_overflowBlocks->next;
+		::operator delete(m_overflowBlocks);
+		m_overflowBlocks = next;
+	}
+	delete[] m_base;
+}
+
+void* FrameArena::Allocate(size_t size, size_t alignment)
+{
+	assert(alignment > 0 && (alignment & (alignment - 1)) == 0);
+	if (!m_base && m_statistics.capacity > 0)
+	{
+		Reserve(m_statistics.capacity);
+	}
+
+	const uintptr_t base = reinterpret_cast<uintptr_t>(m_base);
+	const uintptr_t address = AlignUp(base + m_offset, alignment);
+	const size_t end = static_cast<size_t>(address - base) + size;
+	if (!m_base || end > m_statistics.capacity)
+	{
+		return AllocateOverflow(size, alignment);
+	}
+	m_offset = end;
+	m_statistics.used = m_offset + m_overflowUsed;
+	m_statistics.highWaterMark = std::max(m_statistics.highWaterMark, m_statistics.used);
+	return reinterpret_cast<void*>(address);
+}
+
+void* FrameArena::AllocateOverflow(size_t size, size_t alignment)
+{
+	// 先頭に塊のつなぎを置き、その後ろを境界に揃えて渡す
+	uint8_t* block = static_cast<uint8_t*>(::operator new(sizeof(OverflowBlock) + alignment + size));
+	OverflowBlock* header = reinterpret_cast<OverflowBlock*>(block);
+	header->next = m_overflowBlocks;
+	m_overflowBlocks = header;
+
+	m_overflowUsed += size;
+	m_statistics.overflowCount++;
+	m_statistics.overflowBytes += size;
+	m_statistics.used = m_offset + m_overflowUsed;
+	m_statistics.highWaterMark = std::max(m_statistics.highWaterMark, m_statistics.used);
+	return reinterpret_cast<void*>(AlignUp(reinterpret_cast<uintptr_t>(block + sizeof(OverflowBlock)), alignment));
+}
+
+void FrameArena::Reset()
+{
+#if FRAME_ARENA_POISON
+	if (m_base)
+	{
+		std::memset(m_base, POISON_BYTE, m_offset);
+	}
+#endif
+	while (m_overflowBlocks)
+	{
+		OverflowBlock* next = m_overflowBlocks->next;
+		::operator delete(m_overflowBlocks);
+		m_overflowBlocks = next;
+	}
+
+	// 溢れたフレームがあれば、次からは収まるように広げる
+	const size_t used = m_offset + m_overflowUsed;
+	const bool isOverflowed = m_overflowUsed > 0;
+	m_offset = 0;
+	m_overflowUsed = 0;
+	if (isOverflowed)
+	{
+		Reserve(std::max(m_statistics.capacity * 2, used));
+	}
+
+	m_generation++;
+	m_statistics.used = 0;
+	m_statistics.resetCount++;
+}
+
+void FrameArena::Rewind(size_t marker)
+{
+	assert(marker <= m_offset);
+#if FRAME_ARENA_POISON
+	std::memset(m_base + marker, POISON_BYTE, m_offset - marker);
+#endif
+	m_offset = marker;
+	m_statistics.used = m_offset + m_overflowUsed;
+}
+
+void FrameArena::Reserve(size_t size)
+{
+	// 使っている途中では呼ばない（中身は写さない）
+	assert(m_offset == 0 || !m_base);
+	delete[] m_base;
+	m_base = new uint8_t[size];
+	m_statistics.capacity = size;
+#if FRAME_ARENA_POISON
+	std::memset(m_base, POISON_BYTE, size);
+#endif
+}
+
+FrameArena& FrameArena::GetThreadArena()
+{
+	// スレッドが終わるときに解放する
+	thread_local FrameArena t_threadArena;
+	return t_threadArena;
+}
@@ -0,0 +1,372 @@
+﻿/// <summary>
+/// フレームの間だけ使うデータ用の線形アロケータと、それを使うコンテナ
+/// </summary>
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+
+// 1 にすると捨てた領域を FrameArena::POISON_BYTE で埋め、捨てた後に読んだ値が分かるようにする（デバッグビルドでは既定で有効）
+#ifndef FRAME_ARENA_POISON
+#if defined(_DEBUG)
+#define FRAME_ARENA_POISON 1
+#else
+#define FRAME_ARENA_POISON 0
+#endif
+#endif
+
+// アリーナの統計
+struct FrameArenaStatistics
+{
+	// 確保してある領域のバイト数
+	size_t capacity;
+	// 今使っているバイト数（溢れた分を含む）
+	size_t used;
+	// 今までの Reset の間に使った最大のバイト数（溢れた分を含む）
+	size_t highWaterMark;
+	// 領域が足りずに一般のヒープから確保した回数とバイト数（累計）
+	uint64_t overflowCount;
+	uint64_t overflowBytes;
+	// Reset した回数
+	uint64_t resetCount;
+};
+
+// 先頭から順に切り出すだけのアロケータ（個別には解放せず、Reset でまとめて捨てる）
+// 領域が足りないときは一般のヒープから確保し、次の Reset でその分だけ領域を広げるので、
+// 同じくらいの量を使うフレームが続けば一般のヒープを使わなくなる
+// 確保したメモリにはコンストラクタもデストラクタも呼ばないので、置くのはトリビアルな型だけにする
+class FrameArena
+{
+public:
+	// 最初に確保する領域
+	static const size_t DEFAULT_CAPACITY = 256 * 1024;
+	// 捨てた領域を埋める値
+	static const uint8_t POISON_BYTE = 0xCD;
+
+	explicit FrameArena(size_t capacity = DEFAULT_CAPACITY);
+	~FrameArena();
+
+	// size バイトを alignment（２の累乗）の境界で確保する
+	void* Allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+	// T を count 個分確保する（初期化しない）
+	template<typename T>
+	T* AllocateArray(size_t count)
+	{
+		static_assert(std::is_trivially_destructible<T>::value, "FrameArena holds trivially destructible types only");
+		return static_cast<T*>(Allocate(sizeof(T) * count, alignof(T)));
+	}
+
+	// 確保したものを全て捨てる（フレームの終わりに呼ぶ）
+	void Reset();
+	// 今の位置を取得し、後で Rewind でその位置まで戻す（溢れて確保した分は Reset まで残る）
+	size_t GetMarker() const { return m_offset; }
+	void Rewind(size_t marker);
+
+	// Reset のたびに増える番号（コンテナが Reset の後に使われていないかを確かめる）
+	uint32_t GetGeneration() const { return m_generation; }
+	// 統計
+	const FrameArenaStatistics& GetStatistics() const { return m_statistics; }
+
+	// 呼び出し元のスレッドのアリーナ（初めて呼んだときに作る）
+	// メインスレッドは Game::Tick の終わりに、FramePipeline のスレッドは１回の実行ごとに Reset する
+	// ジョブシステムのワーカーは Reset しないので、ジョブの中では FrameArenaScope で戻す
+	static FrameArena& GetThreadArena();
+
+private:
+	FrameArena(const FrameArena&) = delete;
+	FrameArena& operator=(const FrameArena&) = delete;
+
+	// 溢れたときに一般のヒープから確保した塊（次の塊へのポインタを先頭に置く）
+	struct OverflowBlock
+	{
+		OverflowBlock* next;
+	};
+
+	// 領域を size バイトで確保し直す
+	void Reserve(size_t size);
+	// 一般のヒープから確保する
+	void* AllocateOverflow(size_t size, size_t alignment);
+
+	uint8_t* m_base;
+	size_t m_offset;
+	// 今のフレームで溢れたバイト数と塊
+	size_t m_overflowUsed;
+	OverflowBlock* m_overflowBlocks;
+	uint32_t m_generation;
+	FrameArenaStatistics m_statistics;
+};
+
+// スコープを抜けるときにアリーナを入ったときの位置まで戻す（関数の中だけで使う作業用のメモリ向け）
+class FrameArenaScope
+{
+public:
+	explicit FrameArenaScope(FrameArena& arena)
+		: m_arena(arena)
+		, m_marker(arena.GetMarker())
+	{
+	}
+	~FrameArenaScope()
+	{
+		m_arena.Rewind(m_marker);
+	}
+
+private:
+	FrameArenaScope(const FrameArenaScope&) = delete;
+	FrameArenaScope& operator=(const FrameArenaScope&) = delete;
+
+	FrameArena& m_arena;
+	size_t m_marker;
+};
+
+// アリーナの中の配列の範囲
+template<typename T>
+class ArenaSpan
+{
+public:
+	ArenaSpan()
+		: m_data(nullptr)
+		, m_size(0)
+		, m_arena(nullptr)
+		, m_generation(0)
+	{
+	}
+	ArenaSpan(T* data, size_t size, const FrameArena* arena)
+		: m_data(data)
+		, m_size(size)
+		, m_arena(arena)
+		, m_generation(arena ? arena->GetGeneration() : 0)
+	{
+	}
+
+	size_t size() const { return m_size; }
+	bool empty() const { return m_size == 0; }
+	T* data() const { CheckGeneration(); return m_data; }
+	T& operator[](size_t index) const { CheckGeneration(); assert(index < m_size); return m_data[index]; }
+	T* begin() const { return data(); }
+	T* end() const { return data() + m_size; }
+
+private:
+	// アリーナが Reset された後に使っていないか
+	void CheckGeneration() const
+	{
+		assert(!m_arena || m_generation == m_arena->GetGeneration());
+	}
+
+	T* m_data;
+	size_t m_size;
+	const FrameArena* m_arena;
+	uint32_t m_generation;
+};
+
+// アリーナに要素を置く可変長の配列（std::vector と同じ名前の操作だけ持つ）
+// 広げるときは新しい領域に写し、古い領域は Reset まで残る
+template<typename T>
+class ArenaVector
+{
+	static_assert(std::is_trivially_copyable<T>::value && std::is_trivially_destructible<T>::value,
+		"ArenaVector holds trivially copyable types only");
+
+public:
+	ArenaVector()
+		: m_arena(nullptr)
+		, m_data(nullptr)
+		, m_size(0)
+		, m_capacity(0)
+		, m_generation(0)
+	{
+	}
+	explicit ArenaVector(FrameArena& arena, size_t capacity = 0)
+		: m_arena(&arena)
+		, m_data(nullptr)
+		, m_size(0)
+		, m_capacity(0)
+		, m_generation(arena.GetGeneration())
+	{
+		reserve(capacity);
+	}
+
+	void reserve(size_t capacity)
+	{
+		CheckGeneration();
+		if (capacity <= m_capacity)
+		{
+			return;
+		}
+		T* data = m_arena->AllocateArray<T>(capacity);
+		if (m_size > 0)
+		{
+			std::memcpy(data, m_data, sizeof(T) * m_size);
+		}
+		m_data = data;
+		m_capacity = capacity;
+	}
+	void push_back(const T& value)
+	{
+		if (m_size == m_capacity)
+		{
+			// value が自分の要素でも写す前に読めるように、先に取っておく
+			const T copy = value;
+			reserve(m_capacity ? m_capacity * 2 : 16);
+			m_data[m_size++] = copy;
+			return;
+		}
+		CheckGeneration();
+		m_data[m_size++] = value;
+	}
+	void resize(size_t size, const T& value = T())
+	{
+		if (size > m_capacity)
+		{
+			reserve(size > m_capacity * 2 ? size : m_capacity * 2);
+		}
+		for (size_t i = m_size; i < size; i++)
+		{
+			m_data[i] = value;
+		}
+		m_size = size;
+	}
+	void clear() { m_size = 0; }
+
+	size_t size() const { return m_size; }
+	size_t capacity() const { return m_capacity; }
+	bool empty() const { return m_size == 0; }
+	T* data() { CheckGeneration(); return m_data; }
+	const T* data() const { CheckGeneration(); return m_data; }
+	T& operator[](size_t index) { CheckGeneration(); assert(index < m_size); return m_data[index]; }
+	const T& operator[](size_t index) const { CheckGeneration(); assert(index < m_size); return m_data[index]; }
+	T& back() { return (*this)[m_size - 1]; }
+	T* begin() { return data(); }
+	T* end() { return data() + m_size; }
+	const T* begin() const { return data(); }
+	const T* end() const { return data() + m_size; }
+
+	// 要素の範囲（同じアリーナが Reset されるまで使える）
+	ArenaSpan<T> GetSpan() { return ArenaSpan<T>(data(), m_size, m_arena); }
+	ArenaSpan<const T> GetSpan() const { return ArenaSpan<const T>(data(), m_size, m_arena); }
+
+private:
+	void CheckGeneration() const
+	{
+		assert(!m_arena || m_generation == m_arena->GetGeneration());
+	}
+
+	FrameArena* m_arena;
+	T* m_data;
+	size_t m_size;
+	size_t m_capacity;
+	uint32_t m_generation;
+};
+
+// アリーナに置くハッシュ表（オープンアドレス法、要素の削除は無い）
+// フレームの間だけ使う小さな検索表向けで、std::unordered_map と違って要素ごとに確保しない
+template<typename Key, typename Value, typename Hash>
+class ArenaHashMap
+{
+	static_assert(std::is_trivially_copyable<Key>::value && std::is_trivially_copyable<Value>::value,
+		"ArenaHashMap holds trivially copyable types only");
+
+public:
+	ArenaHashMap()
+		: m_slots(nullptr)
+		, m_mask(0)
+		, m_size(0)
+		, m_arena(nullptr)
+		, m_generation(0)
+	{
+	}
+	explicit ArenaHashMap(FrameArena& arena)
+		: m_slots(nullptr)
+		, m_mask(0)
+		, m_size(0)
+		, m_arena(&arena)
+		, m_generation(arena.GetGeneration())
+	{
+	}
+
+	// 見つからなければ nullptr
+	Value* find(const Key& key)
+	{
+		CheckGeneration();
+		if (!m_slots)
+		{
+			return nullptr;
+		}
+		Slot* slot = FindSlot(m_slots, m_mask, key);
+		return slot->isUsed ? &slot->value : nullptr;
+	}
+	// 無ければ追加する（値へのポインタと、追加したかを返す）
+	std::pair<Value*, bool> emplace(const Key& key, const Value& value)
+	{
+		CheckGeneration();
+		// 半分を超えたら広げる
+		if ((m_size + 1) * 2 > m_mask + 1)
+		{
+			Grow();
+		}
+		Slot* slot = FindSlot(m_slots, m_mask, key);
+		if (slot->isUsed)
+		{
+			return std::make_pair(&slot->value, false);
+		}
+		slot->key = key;
+		slot->value = value;
+		slot->isUsed = true;
+		m_size++;
+		return std::make_pair(&slot->value, true);
+	}
+
+	size_t size() const { return m_size; }
+	bool empty() const { return m_size == 0; }
+
+private:
+	struct Slot
+	{
+		Key key;
+		Value value;
+		bool isUsed;
+	};
+
+	static Slot* FindSlot(Slot* slots, size_t mask, const Key& key)
+	{
+		size_t index = Hash()(key) & mask;
+		while (slots[index].isUsed && !(slots[index].key == key))
+		{
+			index = (index + 1) & mask;
+		}
+		return &slots[index];
+	}
+
+	void Grow()
+	{
+		const size_t capacity = m_slots ? (m_mask + 1) * 2 : 16;
+		Slot* slots = m_arena->AllocateArray<Slot>(capacity);
+		for (size_t i = 0; i < capacity; i++)
+		{
+			slots[i].isUsed = false;
+		}
+		for (size_t i = 0; m_slots && i <= m_mask; i++)
+		{
+			if (m_slots[i].isUsed)
+			{
+				*FindSlot(slots, capacity - 1, m_slots[i].key) = m_slots[i];
+			}
+		}
+		m_slots = slots;
+		m_mask = capacity - 1;
+	}
+
+	void CheckGeneration() const
+	{
+		assert(!m_arena || m_generation == m_arena->GetGeneration());
+	}
+
+	Slot* m_slots;
+	size_t m_mask;
+	size_t m_size;
+	FrameArena* m_arena;
+	uint32_t m_generation;
+};
@@ -0,0 +1,96 @@
+﻿#include "FramePipeline.h"
+
+#include <cassert>
+
+#include "FrameArena.h"
+#include "JobSystem.h"
+#include "Profiler.h"
+
+FramePipeline::FramePipeline(Task task, const char* threadName, JobSystem* jobs)
+	: m_task(task)
+	, m_threadName(threadName)
+	, m_jobs(jobs)
+	, m_isBusy(false)
+	, m_isQuit(false)
+{
+	m_thread = std::thread(&FramePipeline::ThreadMain, this);
+}
+
+FramePipeline::~FramePipeline()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_isQuit = true;
+	}
+	m_kicked.notify_one();
+	// 実行中の処理は最後まで終わらせる
+	m_thread.join();
+}
+
+bool FramePipeline::Kick()
+{
+	if (IsBusy())
+	{
+		return false;
+	}
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_isBusy.store(true, std::memory_order_relaxed);
+	}
+	m_kicked.notify_one();
+	return true;
+}
+
+void FramePipeline::Wait()
+{
+	if (!IsBusy())
+	{
+		return;
+	}
+	PROFILE_SCOPE("FramePipeline::Wait");
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_finished.wait(lock, [this]()
+	{
+		return !m_isBusy.load(std::memory_order_acquire);
+	});
+}
+
+void FramePipeline::ThreadMain()
+{
+	Profiler::SetThreadName(m_threadName.c_str());
+	if (m_jobs)
+	{
+		// 属していないスレッドから積んだジョブはその場で実行されるので、並列にならない
+		const bool isAttached = m_jobs->AttachThread();
+		assert(isAttached && "JobSystem has no attachable queue left");
+		(void)isAttached;
+	}
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_kicked.wait(lock, [this]()
+			{
+				return m_isQuit || m_isBusy.load(std::memory_order_relaxed);
+			});
+			if (m_isQuit)
+			{
+				break;
+			}
+		}
+
+		m_task();
+		// 処理の中で使った一時的なデータは、次に実行するまでに捨てる
+		FrameArena::GetThreadArena().Reset();
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_isBusy.store(false, std::memory_order_release);
+		}
+		m_finished.notify_all();
+	}
+	if (m_jobs)
+	{
+		m_jobs->DetachThread();
+	}
+}
@@ -0,0 +1,61 @@
+﻿/// <summary>
+/// 毎フレームの処理を専用のスレッドで実行し、呼び出し元の処理と重ねるクラス
+/// </summary>
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+class JobSystem;
+
+// Kick するたびに専用のスレッドで処理を１回実行する
+// 呼び出し元は実行中に別の処理（描画）を進め、結果が必要になったら Wait で待つ
+// Kick の前に書いた値は処理から見え、処理が書いた値は Wait から戻るか IsBusy が false を返した後に見える
+// 処理の中で FrameArena::GetThreadArena() から確保したものは、１回実行するたびに捨てる
+// jobs を渡すと専用のスレッドをそのジョブシステムに加え、処理の中から積んだジョブも並列に実行する
+class FramePipeline
+{
+public:
+	// 専用のスレッドで実行する処理
+	typedef std::function<void()> Task;
+
+	// threadName はプロファイラに表示するスレッド名
+	// jobs には AttachThread できるキューを用意しておくこと（FramePipeline より長く残すこと）
+	FramePipeline(Task task, const char* threadName, JobSystem* jobs = nullptr);
+	~FramePipeline();
+
+	// 前回の実行が終わっていれば次の実行を始めて true（実行中なら何もしないで false）
+	bool Kick();
+	// 実行中か
+	bool IsBusy() const { return m_isBusy.load(std::memory_order_acquire); }
+	// 実行が終わるまで待つ
+	void Wait();
+
+private:
+	FramePipeline(const FramePipeline&) = delete;
+	FramePipeline& operator=(const FramePipeline&) = delete;
+
+	// 専用スレッドの処理
+	void ThreadMain();
+
+	Task m_task;
+	std::string m_threadName;
+	JobSystem* m_jobs;
+
+	// 排他制御（Kick と終了の通知だけに使い、処理の結果の受け渡しには使わない）
+	std::mutex m_mutex;
+	// 実行の依頼の通知
+	std::condition_variable m_kicked;
+	// 実行が終わったことの通知
+	std::condition_variable m_finished;
+	// 依頼されてまだ終わっていない
+	std::atomic<bool> m_isBusy;
+	// 終了要求
+	bool m_isQuit;
+
+	std::thread m_thread;
+};
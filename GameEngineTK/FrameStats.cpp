@@ -0,0 +1,251 @@
+﻿#include "FrameStats.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <ctime>
+
+#include "FileSystem.h"
+
+namespace
+{
+	// SUB_BUCKET_HALF の２を底とする対数
+	const uint32_t SUB_BUCKET_HALF_BITS = 7;
+	static_assert((1u << SUB_BUCKET_HALF_BITS) == FrameTimeHistogram::SUB_BUCKET_HALF, "SUB_BUCKET_HALF must match its bit count");
+	// 線形に数える範囲（この値未満は 1 刻み）
+	const uint64_t LINEAR_LIMIT = 2 * FrameTimeHistogram::SUB_BUCKET_HALF;
+
+	// 最上位ビットの位置
+	uint32_t HighestBit(uint64_t value)
+	{
+		uint32_t bit = 0;
+		while (value >>= 1)
+		{
+			bit++;
+		}
+		return bit;
+	}
+
+	// 秒をマイクロ秒の整数に
+	uint64_t ToMicroseconds(double seconds)
+	{
+		return seconds > 0.0 ? static_cast<uint64_t>(seconds * 1e6 + 0.5) : 0;
+	}
+
+	// ヒストグラムの要約（ミリ秒）
+	FrameTimeSummary Summarize(const FrameTimeHistogram& histogram)
+	{
+		FrameTimeSummary summary;
+		summary.p50 = histogram.GetPercentile(50.0) * 1e-3;
+		summary.p95 = histogram.GetPercentile(95.0) * 1e-3;
+		summary.p99 = histogram.GetPercentile(99.0) * 1e-3;
+		summary.max = histogram.GetMax() * 1e-3;
+		summary.mean = histogram.GetMean() * 1e-3;
+		return summary;
+	}
+
+	void AppendSummary(std::string& text, const FrameTimeSummary& summary)
+	{
+		char fields[160];
+		std::snprintf(fields, sizeof(fields), ",%.3f,%.3f,%.3f,%.3f,%.3f",
+			summary.p50, summary.p95, summary.p99, summary.max, summary.mean);
+		text += fields;
+	}
+}
+
+FrameTimeHistogram::FrameTimeHistogram()
+	: m_counts(GetBucketIndex(MAX_VALUE) + 1, 0)
+{
+	Reset();
+}
+
+size_t FrameTimeHistogram::GetBucketIndex(uint64_t value)
+{
+	if (value < LINEAR_LIMIT)
+	{
+		return static_cast<size_t>(value);
+	}
+	// 最上位ビットから SUB_BUCKET_HALF_BITS + 1 ビットだけ残す（上の桁ほど粗くなる）
+	const uint32_t shift = HighestBit(value) - SUB_BUCKET_HALF_BITS;
+	const uint64_t subBucket = (value >> shift) - SUB_BUCKET_HALF;
+	return static_cast<size_t>(LINEAR_LIMIT + (shift - 1) * SUB_BUCKET_HALF + subBucket);
+}
+
+uint64_t FrameTimeHistogram::GetBucketUpperValue(size_t index)
+{
+	if (index < LINEAR_LIMIT)
+	{
+		return index;
+	}
+	const uint64_t shift = (index - LINEAR_LIMIT) / SUB_BUCKET_HALF + 1;
+	const uint64_t subBucket = (index - LINEAR_LIMIT) % SUB_BUCKET_HALF + SUB_BUCKET_HALF;
+	return ((subBucket + 1) << shift) - 1;
+}
+
+void FrameTimeHistogram::Record(uint64_t value)
+{
+	value = value < MAX_VALUE ? value : MAX_VALUE;
+	m_counts[GetBucketIndex(value)]++;
+	m_count++;
+	m_sum += value;
+	m_min = std::min(m_min, value);
+	m_max = std::max(m_max, value);
+}
+
+void FrameTimeHistogram::Reset()
+{
+	std::fill(m_counts.begin(), m_counts.end(), 0);
+	m_count = 0;
+	m_sum = 0;
+	m_min = UINT64_MAX;
+	m_max = 0;
+}
+
+uint64_t FrameTimeHistogram::GetPercentile(double percentile) const
+{
+	if (m_count == 0)
+	{
+		return 0;
+	}
+	// 小さい方から数えて rank 個目の値が入るバケット
+	const double clamped = std::min(std::max(percentile, 0.0), 100.0);
+	const uint64_t rank = std::max<uint64_t>(static_cast<uint64_t>(std::ceil(clamped / 100.0 * m_count)), 1);
+	uint64_t total = 0;
+	for (size_t i = 0; i < m_counts.size(); i++)
+	{
+		total += m_counts[i];
+		if (total >= rank)
+		{
+			return std::min(std::max(GetBucketUpperValue(i), m_min), m_max);
+		}
+	}
+	return m_max;
+}
+
+FrameStats::FrameStats()
+	: m_budget(1.0 / 60.0)
+	, m_tolerance(0.1)
+	, m_overBudgetCount(0)
+	, m_cpuOverBudgetCount(0)
+{
+}
+
+void FrameStats::SetBudget(double seconds, double tolerance)
+{
+	m_budget = seconds;
+	m_tolerance = tolerance;
+}
+
+void FrameStats::RecordFrame(double frameSeconds, double updateSeconds, double renderSeconds, double presentWaitSeconds)
+{
+	m_frame.Record(ToMicroseconds(frameSeconds));
+	m_update.Record(ToMicroseconds(updateSeconds));
+	m_render.Record(ToMicroseconds(renderSeconds));
+	m_presentWait.Record(ToMicroseconds(presentWaitSeconds));
+
+	const double limit = m_budget * (1.0 + m_tolerance);
+	if (frameSeconds > limit)
+	{
+		m_overBudgetCount++;
+	}
+	if (updateSeconds + renderSeconds > limit)
+	{
+		m_cpuOverBudgetCount++;
+	}
+}
+
+void FrameStats::Reset()
+{
+	m_frame.Reset();
+	m_update.Reset();
+	m_render.Reset();
+	m_presentWait.Reset();
+	m_overBudgetCount = 0;
+	m_cpuOverBudgetCount = 0;
+}
+
+FrameStatsReport FrameStats::GetReport() const
+{
+	FrameStatsReport report;
+	report.frameCount = m_frame.GetCount();
+	report.budgetMs = m_budget * 1e3;
+	report.overBudgetCount = m_overBudgetCount;
+	report.cpuOverBudgetCount = m_cpuOverBudgetCount;
+	report.frame = Summarize(m_frame);
+	report.update = Summarize(m_update);
+	report.render = Summarize(m_render);
+	report.presentWait = Summarize(m_presentWait);
+	return report;
+}
+
+bool FrameStats::AppendCsv(const std::wstring& path, const std::string& label) const
+{
+	const FrameStatsReport report = GetReport();
+
+	std::string text;
+	if (!PathExists(path))
+	{
+		text = "date,label,frames,budget_ms,over_budget,cpu_over_budget";
+		for (const char* name : { "frame", "update", "render", "present_wait" })
+		{
+			for (const char* field : { "p50", "p95", "p99", "max", "mean" })
+			{
+				text += std::string(",") + name + "_" + field + "_ms";
+			}
+		}
+		text += "\n";
+	}
+
+	// 日時（ローカル時刻）
+	char date[32];
+	const std::time_t now = std::time(nullptr);
+	std::tm local;
+#if defined(_WIN32)
+	localtime_s(&local, &now);
+#else
+	localtime_r(&now, &local);
+#endif
+	std::strftime(date, sizeof(date), "%Y-%m-%d %H:%M:%S", &local);
+	text += date;
+
+	std::string safeLabel = label;
+	std::replace_if(safeLabel.begin(), safeLabel.end(), [](char c) { return c == ',' || c == '\n' || c == '\r' || c == '"'; }, ' ');
+	char fields[128];
+	std::snprintf(fields, sizeof(fields), ",%s,%llu,%.3f,%llu,%llu", safeLabel.c_str(),
+		static_cast<unsigned long long>(report.frameCount), report.budgetMs,
+		static_cast<unsigned long long>(report.overBudgetCount), static_cast<unsigned long long>(report.cpuOverBudgetCount));
+	text += fields;
+	AppendSummary(text, report.frame);
+	AppendSummary(text, report.update);
+	AppendSummary(text, report.render);
+	AppendSummary(text, report.presentWait);
+	text += "\n";
+
+	return AppendToFile(path, text.data(), text.size());
+}
+
+std::string FrameStats::FormatReport(const FrameStatsReport& report)
+{
+	std::string text;
+	char line[160];
+	std::snprintf(line, sizeof(line), "frames %llu, over budget (%.2f ms) %llu (%.2f%%), cpu over budget %llu\n",
+		static_cast<unsigned long long>(report.frameCount), report.budgetMs,
+		static_cast<unsigned long long>(report.overBudgetCount),
+		report.frameCount ? 100.0 * report.overBudgetCount / report.frameCount : 0.0,
+		static_cast<unsigned long long>(report.cpuOverBudgetCount));
+	text += line;
+	const struct { const char* name; const FrameTimeSummary* summary; } rows[] =
+	{
+		{ "frame", &report.frame },
+		{ "update", &report.update },
+		{ "render", &report.render },
+		{ "present wait", &report.presentWait },
+	};
+	for (const auto& row : rows)
+	{
+		std::snprintf(line, sizeof(line), "  %-12s p50 %8.3f  p95 %8.3f  p99 %8.3f  max %8.3f  mean %8.3f ms\n",
+			row.name, row.summary->p50, row.summary->p95, row.summary->p99, row.summary->max, row.summary->mean);
+		text += line;
+	}
+	return text;
+}
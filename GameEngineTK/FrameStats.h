@@ -0,0 +1,116 @@
+﻿/// <summary>
+/// フレーム時間の分布（パーセンタイル）と予算超えを記録するクラス
+/// </summary>
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// 一定のメモリで値の分布を記録するヒストグラム（HDR Histogram と同じ対数と線形の組み合わせのバケット）
+// 値はマイクロ秒の整数で、どの大きさでも相対誤差は 1/SUB_BUCKET_HALF 以下
+class FrameTimeHistogram
+{
+public:
+	// 各２の累乗の区間を分割する数
+	static const uint32_t SUB_BUCKET_HALF = 128;
+	// 記録できる最大値（マイクロ秒、これより大きい値はこの値として数える）
+	static const uint64_t MAX_VALUE = (1ull << 40) - 1;
+
+	FrameTimeHistogram();
+
+	// 値を１つ記録
+	void Record(uint64_t value);
+	// 全て消す
+	void Reset();
+
+	// 記録した数
+	uint64_t GetCount() const { return m_count; }
+	// 最小値・最大値・平均（何も無ければ 0）
+	uint64_t GetMin() const { return m_count ? m_min : 0; }
+	uint64_t GetMax() const { return m_max; }
+	double GetMean() const { return m_count ? static_cast<double>(m_sum) / m_count : 0.0; }
+	// percentile（0 ～ 100）％の値がこれ以下になる値（バケットの上端、最大値を超えない）
+	uint64_t GetPercentile(double percentile) const;
+
+private:
+	// 値を入れるバケットの番号
+	static size_t GetBucketIndex(uint64_t value);
+	// バケットに入る最大の値
+	static uint64_t GetBucketUpperValue(size_t index);
+
+	std::vector<uint32_t> m_counts;
+	uint64_t m_count;
+	uint64_t m_sum;
+	uint64_t m_min;
+	uint64_t m_max;
+};
+
+// １つの時間の分布の要約（ミリ秒）
+struct FrameTimeSummary
+{
+	double p50;
+	double p95;
+	double p99;
+	double max;
+	double mean;
+};
+
+// フレーム時間の記録の要約
+struct FrameStatsReport
+{
+	// 記録したフレーム数
+	uint64_t frameCount;
+	// 予算（ミリ秒、許容する超過を含まない）
+	double budgetMs;
+	// フレーム時間が予算を超えたフレーム数
+	uint64_t overBudgetCount;
+	// 更新と描画の CPU 時間だけで予算を超えたフレーム数（Present を待たなくても間に合わなかった）
+	uint64_t cpuOverBudgetCount;
+	// 前のフレームの開始からの時間
+	FrameTimeSummary frame;
+	// Update にかかった時間（そのフレームの全ての Update の合計）
+	FrameTimeSummary update;
+	// Update 以外の CPU 時間（フレームの開始から Present を呼ぶまで）
+	FrameTimeSummary render;
+	// Present で待った時間
+	FrameTimeSummary presentWait;
+};
+
+// フレームごとの時間を記録し、パーセンタイルと予算超えを集計する
+// メモリはコンストラクタで確保した分だけで、フレーム数によらない
+class FrameStats
+{
+public:
+	FrameStats();
+
+	// １フレームの予算（秒）を設定
+	// フレーム時間が budget * (1 + tolerance) を超えたら予算超えとする（垂直同期のゆらぎで数えないように）
+	void SetBudget(double seconds, double tolerance = 0.1);
+	// １フレーム分を記録（秒）
+	void RecordFrame(double frameSeconds, double updateSeconds, double renderSeconds, double presentWaitSeconds);
+	// 全て消す
+	void Reset();
+
+	// 記録したフレーム数
+	uint64_t GetFrameCount() const { return m_frame.GetCount(); }
+	// 要約を取得
+	FrameStatsReport GetReport() const;
+	// 要約を CSV の１行として path に追加する（ファイルが無ければ見出しの行から書く、失敗したら false）
+	// label は実行を区別する名前（カンマや改行は空白に置き換える）
+	bool AppendCsv(const std::wstring& path, const std::string& label) const;
+
+	// 要約を読める形にする（複数行）
+	static std::string FormatReport(const FrameStatsReport& report);
+
+private:
+	FrameTimeHistogram m_frame;
+	FrameTimeHistogram m_update;
+	FrameTimeHistogram m_render;
+	FrameTimeHistogram m_presentWait;
+	double m_budget;
+	double m_tolerance;
+	uint64_t m_overBudgetCount;
+	uint64_t m_cpuOverBudgetCount;
+};
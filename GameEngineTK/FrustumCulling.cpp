@@ -0,0 +1,275 @@
+﻿#include "FrustumCulling.h"
+
+#include <cmath>
+
+#if FRUSTUM_CULLING_SSE2
+#include <emmintrin.h>
+#endif
+#if FRUSTUM_CULLING_AVX2
+#include <immintrin.h>
+#endif
+
+#include "JobSystem.h"
+#include "Profiler.h"
+
+namespace
+{
+	// 並列に判定するときの１ジョブあたりの球の数
+	const size_t CULL_BLOCK_SIZE = 4096;
+
+	// 平面の法線を長さ１にする
+	FrustumPlane NormalizePlane(float a, float b, float c, float d)
+	{
+		const float length = std::sqrt(a * a + b * b + c * c);
+		const float scale = length > 0.0f ? 1.0f / length : 0.0f;
+		FrustumPlane plane = { a * scale, b * scale, c * scale, d * scale };
+		return plane;
+	}
+}
+
+Frustum ExtractFrustum(const Float4x4& viewProjection)
+{
+	// 行ベクトル形式なのでクリップ座標の各成分は列との内積になる
+	const float(&m)[4][4] = viewProjection.m;
+	Frustum frustum;
+	for (int axis = 0; axis < 2; axis++)
+	{
+		// -w <= x, x <= w（y も同様）
+		frustum.planes[axis * 2 + 0] = NormalizePlane(
+			m[0][3] + m[0][axis], m[1][3] + m[1][axis], m[2][3] + m[2][axis], m[3][3] + m[3][axis]);
+		frustum.planes[axis * 2 + 1] = NormalizePlane(
+			m[0][3] - m[0][axis], m[1][3] - m[1][axis], m[2][3] - m[2][axis], m[3][3] - m[3][axis]);
+	}
+	// 0 <= z
+	frustum.planes[4] = NormalizePlane(m[0][2], m[1][2], m[2][2], m[3][2]);
+	// z <= w
+	frustum.planes[5] = NormalizePlane(m[0][3] - m[0][2], m[1][3] - m[1][2], m[2][3] - m[2][2], m[3][3] - m[3][2]);
+	return frustum;
+}
+
+void TransformSphere(const Float3& center, float radius, const Float4x4& world, Float3* worldCenter, float* worldRadius)
+{
+	const float(&m)[4][4] = world.m;
+	worldCenter->x = center.x * m[0][0] + center.y * m[1][0] + center.z * m[2][0] + m[3][0];
+	worldCenter->y = center.x * m[0][1] + center.y * m[1][1] + center.z * m[2][1] + m[3][1];
+	worldCenter->z = center.x * m[0][2] + center.y * m[1][2] + center.z * m[2][2] + m[3][2];
+
+	// 各軸の拡大率の二乗の最大
+	float scale = 0.0f;
+	for (int i = 0; i < 3; i++)
+	{
+		const float lengthSquared = m[i][0] * m[i][0] + m[i][1] * m[i][1] + m[i][2] * m[i][2];
+		scale = lengthSquared > scale ? lengthSquared : scale;
+	}
+	*worldRadius = radius * std::sqrt(scale);
+}
+
+size_t CullSpheresScalar(const Frustum& frustum, const float* x, const float* y, const float* z, const float* radius,
+	size_t count, uint32_t* visible)
+{
+	size_t visibleCount = 0;
+	for (size_t i = 0; i < count; i++)
+	{
+		bool inside = true;
+		for (const FrustumPlane& plane : frustum.planes)
+		{
+			// SIMD 実装と同じ順に足して、平面に接する球でも結果を揃える
+			float distance = plane.a * x[i] + plane.d;
+			distance += plane.b * y[i];
+			distance += plane.c * z[i];
+			inside = inside && distance >= -radius[i];
+		}
+		// 分岐せずに書き込み、見えるときだけ数を進める
+		visible[visibleCount] = static_cast<uint32_t>(i);
+		visibleCount += inside ? 1 : 0;
+	}
+	return visibleCount;
+}
+
+#if FRUSTUM_CULLING_SSE2
+size_t CullSpheresSSE2(const Frustum& frustum, const float* x, const float* y, const float* z, const float* radius,
+	size_t count, uint32_t* visible)
+{
+	// 平面の係数は全要素に広げておく
+	__m128 planes[Frustum::PLANE_COUNT][4];
+	for (int p = 0; p < Frustum::PLANE_COUNT; p++)
+	{
+		planes[p][0] = _mm_set1_ps(frustum.planes[p].a);
+		planes[p][1] = _mm_set1_ps(frustum.planes[p].b);
+		planes[p][2] = _mm_set1_ps(frustum.planes[p].c);
+		planes[p][3] = _mm_set1_ps(frustum.planes[p].d);
+	}
+
+	size_t visibleCount = 0;
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		const __m128 cx = _mm_loadu_ps(x + i);
+		const __m128 cy = _mm_loadu_ps(y + i);
+		const __m128 cz = _mm_loadu_ps(z + i);
+		const __m128 negativeRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(radius + i));
+
+		__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for (int p = 0; p < Frustum::PLANE_COUNT; p++)
+		{
+			__m128 distance = _mm_add_ps(_mm_mul_ps(cx, planes[p][0]), planes[p][3]);
+			distance = _mm_add_ps(distance, _mm_mul_ps(cy, planes[p][1]));
+			distance = _mm_add_ps(distance, _mm_mul_ps(cz, planes[p][2]));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negativeRadius));
+		}
+
+		// 見えるものの番号だけが前に詰まるように書き込む
+		const int mask = _mm_movemask_ps(inside);
+		for (int k = 0; k < 4; k++)
+		{
+			visible[visibleCount] = static_cast<uint32_t>(i + k);
+			visibleCount += (mask >> k) & 1;
+		}
+	}
+
+	// 端数
+	if (i < count)
+	{
+		const size_t rest = CullSpheresScalar(frustum, x + i, y + i, z + i, radius + i, count - i, visible + visibleCount);
+		for (size_t k = 0; k < rest; k++)
+		{
+			visible[visibleCount + k] += static_cast<uint32_t>(i);
+		}
+		visibleCount += rest;
+	}
+	return visibleCount;
+}
+#endif
+
+#if FRUSTUM_CULLING_AVX2
+size_t CullSpheresAVX2(const Frustum& frustum, const float* x, const float* y, const float* z, const float* radius,
+	size_t count, uint32_t* visible)
+{
+	__m256 planes[Frustum::PLANE_COUNT][4];
+	for (int p = 0; p < Frustum::PLANE_COUNT; p++)
+	{
+		planes[p][0] = _mm256_set1_ps(frustum.planes[p].a);
+		planes[p][1] = _mm256_set1_ps(frustum.planes[p].b);
+		planes[p][2] = _mm256_set1_ps(frustum.planes[p].c);
+		planes[p][3] = _mm256_set1_ps(frustum.planes[p].d);
+	}
+
+	size_t visibleCount = 0;
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		const __m256 cx = _mm256_loadu_ps(x + i);
+		const __m256 cy = _mm256_loadu_ps(y + i);
+		const __m256 cz = _mm256_loadu_ps(z + i);
+		const __m256 negativeRadius = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(radius + i));
+
+		__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		for (int p = 0; p < Frustum::PLANE_COUNT; p++)
+		{
+			__m256 distance = _mm256_add_ps(_mm256_mul_ps(cx, planes[p][0]), planes[p][3]);
+			distance = _mm256_add_ps(distance, _mm256_mul_ps(cy, planes[p][1]));
+			distance = _mm256_add_ps(distance, _mm256_mul_ps(cz, planes[p][2]));
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, negativeRadius, _CMP_GE_OQ));
+		}
+
+		const int mask = _mm256_movemask_ps(inside);
+		for (int k = 0; k < 8; k++)
+		{
+			visible[visibleCount] = static_cast<uint32_t>(i + k);
+			visibleCount += (mask >> k) & 1;
+		}
+	}
+
+	if (i < count)
+	{
+		const size_t rest = CullSpheresScalar(frustum, x + i, y + i, z + i, radius + i, count - i, visible + visibleCount);
+		for (size_t k = 0; k < rest; k++)
+		{
+			visible[visibleCount + k] += static_cast<uint32_t>(i);
+		}
+		visibleCount += rest;
+	}
+	return visibleCount;
+}
+#endif
+
+size_t CullSpheres(const Frustum& frustum, const float* x, const float* y, const float* z, const float* radius,
+	size_t count, uint32_t* visible)
+{
+#if FRUSTUM_CULLING_AVX2
+	return CullSpheresAVX2(frustum, x, y, z, radius, count, visible);
+#elif FRUSTUM_CULLING_SSE2
+	return CullSpheresSSE2(frustum, x, y, z, radius, count, visible);
+#else
+	return CullSpheresScalar(frustum, x, y, z, radius, count, visible);
+#endif
+}
+
+FrustumCuller::FrustumCuller()
+	: m_statistics()
+{
+}
+
+void FrustumCuller::Clear()
+{
+	m_x.clear();
+	m_y.clear();
+	m_z.clear();
+	m_radius.clear();
+	m_visible.clear();
+}
+
+uint32_t FrustumCuller::Add(const Float3& center, float radius)
+{
+	m_x.push_back(center.x);
+	m_y.push_back(center.y);
+	m_z.push_back(center.z);
+	m_radius.push_back(radius);
+	return static_cast<uint32_t>(m_x.size() - 1);
+}
+
+void FrustumCuller::Cull(const Float4x4& viewProjection, JobSystem* jobs)
+{
+	PROFILE_SCOPE("FrustumCuller::Cull");
+	const Frustum frustum = ExtractFrustum(viewProjection);
+	const size_t count = m_x.size();
+	m_visible.resize(count);
+
+	size_t visibleCount = 0;
+	if (!jobs || count <= CULL_BLOCK_SIZE)
+	{
+		visibleCount = CullSpheres(frustum, m_x.data(), m_y.data(), m_z.data(), m_radius.data(), count, m_visible.data());
+	}
+	else
+	{
+		// ブロックごとに m_visible の同じ位置へ書き出す（番号はブロックの先頭からの相対）
+		const size_t blockCount = (count + CULL_BLOCK_SIZE - 1) / CULL_BLOCK_SIZE;
+		m_blockVisibleCounts.resize(blockCount);
+		jobs->ParallelFor(blockCount, 1, [this, &frustum, count](size_t beginBlock, size_t endBlock)
+		{
+			for (size_t block = beginBlock; block < endBlock; block++)
+			{
+				const size_t begin = block * CULL_BLOCK_SIZE;
+				const size_t blockSize = count - begin < CULL_BLOCK_SIZE ? count - begin : CULL_BLOCK_SIZE;
+				m_blockVisibleCounts[block] = CullSpheres(frustum, m_x.data() + begin, m_y.data() + begin, m_z.data() + begin,
+					m_radius.data() + begin, blockSize, m_visible.data() + begin);
+			}
+		});
+
+		// 前に詰めながら番号を全体の番号に直す（書き込み先は読み出し元より後ろにならない）
+		for (size_t block = 0; block < blockCount; block++)
+		{
+			const uint32_t begin = static_cast<uint32_t>(block * CULL_BLOCK_SIZE);
+			const size_t blockVisibleCount = m_blockVisibleCounts[block];
+			for (size_t i = 0; i < blockVisibleCount; i++)
+			{
+				m_visible[visibleCount + i] = m_visible[begin + i] + begin;
+			}
+			visibleCount += blockVisibleCount;
+		}
+	}
+	m_visible.resize(visibleCount);
+
+	m_statistics.visible = static_cast<uint32_t>(visibleCount);
+	m_statistics.culled = static_cast<uint32_t>(count - visibleCount);
+}
@@ -0,0 +1,102 @@
+﻿/// <summary>
+/// 視錐台カリング（境界球をまとめて判定する）
+/// </summary>
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "TransformMath.h"
+
+class JobSystem;
+
+// 使用できる SIMD 命令セット
+#if defined(__AVX2__)
+#define FRUSTUM_CULLING_AVX2 1
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FRUSTUM_CULLING_SSE2 1
+#endif
+
+// 平面（ax + by + cz + d = 0、法線は視錐台の内側向きで長さ１）
+struct FrustumPlane
+{
+	float a, b, c, d;
+};
+
+// 視錐台（左・右・下・上・手前・奥）
+struct Frustum
+{
+	static const int PLANE_COUNT = 6;
+	FrustumPlane planes[PLANE_COUNT];
+};
+
+// ビュー行列×射影行列から視錐台を取り出す（行ベクトル形式、深度 0～1 の射影）
+Frustum ExtractFrustum(const Float4x4& viewProjection);
+
+// モデル空間の境界球をワールド行列で変換する（半径は最も大きい軸の拡大率を掛ける）
+void TransformSphere(const Float3& center, float radius, const Float4x4& world, Float3* worldCenter, float* worldRadius);
+
+// 球（x[i], y[i], z[i], radius[i]）のうち視錐台と重なるものの番号を visible に詰めて、その数を返す
+// visible は count 個分の大きさが必要
+// 使用できる中で最も速い実装を呼ぶ
+size_t CullSpheres(const Frustum& frustum, const float* x, const float* y, const float* z, const float* radius,
+	size_t count, uint32_t* visible);
+
+// 基準となるスカラー実装
+size_t CullSpheresScalar(const Frustum& frustum, const float* x, const float* y, const float* z, const float* radius,
+	size_t count, uint32_t* visible);
+
+#if FRUSTUM_CULLING_SSE2
+// ４個ずつ判定する SSE2 実装
+size_t CullSpheresSSE2(const Frustum& frustum, const float* x, const float* y, const float* z, const float* radius,
+	size_t count, uint32_t* visible);
+#endif
+
+#if FRUSTUM_CULLING_AVX2
+// ８個ずつ判定する AVX2 実装
+size_t CullSpheresAVX2(const Frustum& frustum, const float* x, const float* y, const float* z, const float* radius,
+	size_t count, uint32_t* visible);
+#endif
+
+// フレームごとに境界球を集めてまとめて判定するクラス
+// 座標は成分ごとの配列に持ち、SIMD でそのまま読めるようにする
+class FrustumCuller
+{
+public:
+	// 直前の Cull の結果
+	struct Statistics
+	{
+		uint32_t visible;
+		uint32_t culled;
+	};
+
+	FrustumCuller();
+
+	// 全ての球を捨てる（確保したメモリは再利用する）
+	void Clear();
+	// 球を追加してその番号を返す
+	uint32_t Add(const Float3& center, float radius);
+	// 判定する
+	// jobs を渡すと球が多いときはブロックに分けて複数スレッドで判定する（結果は同じ）
+	void Cull(const Float4x4& viewProjection, JobSystem* jobs = nullptr);
+
+	// 見える球の番号（追加した順）
+	const std::vector<uint32_t>& GetVisible() const { return m_visible; }
+	// 統計
+	const Statistics& GetStatistics() const { return m_statistics; }
+
+private:
+	// 球
+	std::vector<float> m_x;
+	std::vector<float> m_y;
+	std::vector<float> m_z;
+	std::vector<float> m_radius;
+	// 見える球の番号
+	std::vector<uint32_t> m_visible;
+	// ブロックごとの見える球の数（並列に判定するとき）
+	std::vector<size_t> m_blockVisibleCounts;
+	// 統計
+	Statistics m_statistics;
+};
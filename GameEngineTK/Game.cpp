@@ -12,11 +12,83 @@ using namespace DirectX::SimpleMath;
 
 using Microsoft::WRL::ComPtr;
 
+namespace
+{
+	// V~[V̕pxi/bj
+	const double SIMULATION_RATE = 60.0;
+	// ƂɂPt[Œǂ߂ Update Ăԍő
+	const uint32_t MAX_UPDATES_PER_FRAME = 4;
+	// F2 ŕۑg[X̃t[ƃt@C
+	const uint32_t PROFILE_CAPTURE_FRAMES = 120;
+	const wchar_t* PROFILE_CAPTURE_PATH = L"profile.json";
+	// vt@C̏WvEBhẼ^Cgɕ\Ԋuit[j
+	const uint64_t PROFILE_TITLE_INTERVAL = 30;
+	// Pt[̗\Zibj F3 Ńt[Ԃ̋L^ǉt@C
+	const double FRAME_BUDGET = 1.0 / 60.0;
+	const wchar_t* FRAME_STATS_PATH = L"frame_stats.csv";
+	// V~[Vp̃XbhŐi߂ĕ`Əd˂邩A`̒xPt[܂łɂ邩
+	const bool PIPELINED = true;
+	const bool PIPELINE_LATENCY_CAPPED = true;
+	// @̃p[c̃fiResources ̒̊gqOj
+	const wchar_t* const PLAYER_PARTS_MODELS[PLAYER_PARTS_NUM] =
+	{
+		L"tower", L"base", L"engine", L"engine", L"fan", L"score",
+	};
+	// @̃p[c̊ȗڍדx̐iTkmCooker -lod 0.5,0.25  O_lod1.tkm 珑ój
+	const int PLAYER_LOD_LEVEL_COUNT = 2;
+
+	Vector3 ToVector3(const Float3& v)
+	{
+		return Vector3(v.x, v.y, v.z);
+	}
+
+	Float3 ToFloat3(const Vector3& v)
+	{
+		return Float3{ v.x, v.y, v.z };
+	}
+
+	// }EX̃{^̃bZ[Wǂ̃{^̂̂
+	INPUT_MOUSE_BUTTON ToMouseButton(UINT message, WPARAM wParam)
+	{
+		switch (message)
+		{
+		case WM_LBUTTONDOWN:
+		case WM_LBUTTONUP:
+			return INPUT_MOUSE_LEFT;
+		case WM_RBUTTONDOWN:
+		case WM_RBUTTONUP:
+			return INPUT_MOUSE_RIGHT;
+		case WM_MBUTTONDOWN:
+		case WM_MBUTTONUP:
+			return INPUT_MOUSE_MIDDLE;
+		default:
+			return GET_XBUTTON_WPARAM(wParam) == XBUTTON1 ? INPUT_MOUSE_X1 : INPUT_MOUSE_X2;
+		}
+	}
+}
+
 Game::Game() :
     m_window(0),
     m_outputWidth(800),
     m_outputHeight(600),
-    m_featureLevel(D3D_FEATURE_LEVEL_9_1)
+    m_featureLevel(D3D_FEATURE_LEVEL_9_1),
+    m_scrollWheelValue(0),
+    m_isProfileCapturing(false),
+    m_hasSnapshot(false),
+    m_stepCount(0),
+    m_isPipelined(false),
+    m_isLatencyCapped(true),
+    m_pendingInput(),
+    m_pendingInputTime(0),
+    m_kickElapsedTime(0.0f),
+    m_kickAlpha(1.0f),
+    m_kickInputTime(0),
+    m_isRecording(false),
+    m_isReplaying(false),
+    m_replayFrame(0),
+    m_replayStep(0),
+    m_frameStepCount(0),
+    m_replayMismatchCount(0)
 {
 }
 
@@ -27,25 +99,29 @@ void Game::Initialize(HWND window, int width, int height)
     m_outputWidth = std::max(width, 1);
     m_outputHeight = std::max(height, 1);
 
+    Profiler::SetThreadName("Main");
+
     CreateDevice();
 
     CreateResources();
 
-    // TODO: Change the timer settings if you want something other than the default variable timestep mode.
-    // e.g. for 60 FPS fixed timestep update logic, call:
-    /*
-    m_timer.SetFixedTimeStep(true);
-    m_timer.SetTargetElapsedSeconds(1.0 / 60);
-    */
+	// V~[V͌Œ̊ԊuŐi߁A`͒Oƌ݂̏Ԃ̊ԂԂ
+	m_timer.SetFixedTimeStep(true);
+	SetSimulationRate(SIMULATION_RATE);
+	// Ăǂ߂ Update Ȃ悤ɂ
+	m_timer.SetMaxUpdatesPerTick(MAX_UPDATES_PER_FRAME);
+	// ̂P񕪂Ɏ܂Ȃt[𐔂
+	m_timer.GetFrameStats().SetBudget(FRAME_BUDGET);
 
-	// L[{[h̐
-	keyboard = std::make_unique<Keyboard>();
+	// WuVXe̐iCXbhWuj
+	// V~[ṼXbhɐς߂悤ɁÃXbh̃L[Ppӂ
+	unsigned threadCount = std::thread::hardware_concurrency();
+	m_jobSystem = std::make_unique<JobSystem>(threadCount > 1 ? threadCount - 1 : 0, 1);
 
 	// J̐
-	m_Camera = std::make_unique<FollowCamera>(
+	m_Camera = std::make_unique<Camera>(
 		m_outputWidth, m_outputHeight);
-	// JɃL[{[hZbg
-	m_Camera->SetKeyboard(keyboard.get());
+	m_snapshotProj = m_Camera->GetProj();
 
 	// 3DIuWFNgNX̐ÓIo
 	Obj3d::InitializeStatic(
@@ -70,15 +146,13 @@ void Game::Initialize(HWND window, int width, int height)
 		VertexPositionColor::InputElementCount,
 		shaderByteCode, byteCodeLength,
 		m_inputLayout.GetAddressOf());
-	// fobOJ̐
-	m_debugCamera = std::make_unique<DebugCamera>(m_outputWidth, m_outputHeight);
 
 	// GtFNgt@Ng
 	m_factory = std::make_unique<EffectFactory>(m_d3dDevice.Get());
 	// eNX`̓ǂݍ݃tH_w
 	m_factory->SetDirectory(L"Resources");
-	// f̓ǂݍ
-	m_objSkydome.LoadModel(L"Resources/skydome.cmo");
+	// f̓ǂݍ݁it@C͕ʃXbhœǂ݁Â\j
+	m_objSkydome.LoadModelAsync(L"Resources/skydome.cmo");
 	
 	m_modelGround = Model::CreateFromCMO(
 		m_d3dDevice.Get()
@@ -90,199 +164,230 @@ void Game::Initialize(HWND window, int width, int height)
 		, L"Resources/ball.cmo",
 		*m_factory
 	);
+	// ̓CX^X`悷
+	m_instancedRenderer = std::make_unique<InstancedRenderer>(m_d3dDevice.Get());
+	m_instancedRenderer->RegisterModel(m_modelBall.get(), L"Resources/ball.cmo", *m_factory);
+	// f̕`̓L[ɐςł܂Ƃ߂Ĕs
+	m_renderBackend = std::make_unique<ModelRenderBackend>(m_d3dDevice.Get(), m_d3dContext.Get());
+	Obj3d::SetRenderQueue(&m_renderQueue, m_renderBackend.get());
 	//m_modelHead = Model::CreateFromCMO(
 	//	m_d3dDevice.Get()
 	//	, L"Resources/head.cmo",
 	//	*m_factory
 	//);
 
-	m_AngleBall = 0.0f;
-
 	tank_angle = 0.0f;
 
 	// @p[c̃[h
+	// ȗڍדxo^i덷 TKM ̃wb_[Aǂݍ߂ȂΌ̃fŕ`悷j
 	m_ObjPlayer.resize(PLAYER_PARTS_NUM);
-	m_ObjPlayer[PLAYER_PARTS_TOWER].LoadModel(L"Resources/tower.cmo");
-	m_ObjPlayer[PLAYER_PARTS_BASE].LoadModel(L"Resources/base.cmo");
-	m_ObjPlayer[PLAYER_PARTS_ENGINE_R].LoadModel(L"Resources/engine.cmo");
-	m_ObjPlayer[PLAYER_PARTS_ENGINE_L].LoadModel(L"Resources/engine.cmo");
-	m_ObjPlayer[PLAYER_PARTS_FAN].LoadModel(L"Resources/fan.cmo");
-	m_ObjPlayer[PLAYER_PARTS_SCORE].LoadModel(L"Resources/score.cmo");
-	// eq֌W̍\ziqɐeZbgj
-	m_ObjPlayer[PLAYER_PARTS_BASE].SetObjParent(
-		&m_ObjPlayer[PLAYER_PARTS_TOWER]);
+	for (int i = 0; i < PLAYER_PARTS_NUM; i++)
+	{
+		const std::wstring path = std::wstring(L"Resources/") + PLAYER_PARTS_MODELS[i];
+		m_ObjPlayer[i].LoadModelAsync((path + L".cmo").c_str());
+		for (int level = 1; level <= PLAYER_LOD_LEVEL_COUNT; level++)
+		{
+			m_ObjPlayer[i].AddLodLevel((path + L"_lod" + std::to_wstring(level) + L".tkm").c_str());
+		}
+	}
+	// eq֌WƐẽItZbg̓V~[Vݒ肷
+	TransformHierarchy::Handle parts[PLAYER_PARTS_NUM];
+	for (int i = 0; i < PLAYER_PARTS_NUM; i++)
+	{
+		parts[i] = m_ObjPlayer[i].GetTransformHandle();
+	}
+	m_simulation = std::make_unique<GameSimulation>(
+		Obj3d::GetTransforms(), parts, m_outputWidth, m_outputHeight);
 
-	m_ObjPlayer[PLAYER_PARTS_SCORE].SetObjParent(
-		&m_ObjPlayer[PLAYER_PARTS_BASE]);
+	// V~[ṼXbhN
+	m_pipeline = std::make_unique<FramePipeline>([this]()
+	{
+		SimulateFrame();
+	}, "Simulation", m_jobSystem.get());
+	SetPipelining(PIPELINED, PIPELINE_LATENCY_CAPPED);
+}
 
-	m_ObjPlayer[PLAYER_PARTS_ENGINE_R].SetObjParent(
-		&m_ObjPlayer[PLAYER_PARTS_TOWER]);
-	m_ObjPlayer[PLAYER_PARTS_ENGINE_L].SetObjParent(
-		&m_ObjPlayer[PLAYER_PARTS_TOWER]);
+// Executes the basic game loop.
+void Game::Tick()
+{
+    {
+        PROFILE_SCOPE("Game::Tick");
+
+        // ͂̓t[ƂɂPǂݏoi܂V~[VɓnĂȂJ̐؂ւ͎cj
+        const InputSnapshot& inputSnapshot = m_inputState.Update(m_inputQueue);
+        SimulationInput input = ReadInput(inputSnapshot);
+        input.toggleCamera = input.toggleCamera || m_pendingInput.toggleCamera;
+        m_pendingInput = input;
+        if (m_pendingInputTime == 0)
+        {
+            m_pendingInputTime = inputSnapshot.oldestTimestamp;
+        }
 
-	m_ObjPlayer[PLAYER_PARTS_FAN].SetObjParent(
-		&m_ObjPlayer[PLAYER_PARTS_TOWER]);
+        BeginInputFrame();
+        if (m_isPipelined)
+        {
+            TickPipelined();
+        }
+        else
+        {
+            // ǂݍݏIf𐶐
+            Obj3d::ProcessLoadedModels();
 
-	// ẽItZbgi[J̍Wj
-	m_ObjPlayer[PLAYER_PARTS_TOWER].SetScale(
-		Vector3(2, 2, 2));
+            m_timer.Tick([&]()
+            {
+                RecordInputLatency(m_pendingInputTime);
+                m_pendingInputTime = 0;
+                Update(float(m_timer.GetElapsedSeconds()), TakeStepInput());
+            });
+            PublishSnapshot(static_cast<float>(m_timer.GetInterpolationAlpha()));
+        }
+        EndInputFrame();
 
-	m_ObjPlayer[PLAYER_PARTS_BASE].SetTranslation(
-		Vector3(0, 0.7f, 0));
+        Render();
+    }
 
-	m_ObjPlayer[PLAYER_PARTS_SCORE].SetTranslation(
-		Vector3(0, 1.0f, 0));
-	m_ObjPlayer[PLAYER_PARTS_SCORE].SetScale(
-		Vector3(2, 2, 2));
+    UpdateProfiler();
+    UpdateFrameStats();
+    UpdatePipelining();
 
-	m_ObjPlayer[PLAYER_PARTS_ENGINE_R].SetTranslation(
-		Vector3(0.22f, 0.3f, 0.22f));
-	m_ObjPlayer[PLAYER_PARTS_ENGINE_R].SetRotation(
-		Vector3(0, XMConvertToRadians(45), 0));
+	// ̃t[ŎgꎞIȃf[^SĎ̂Ă
+	FrameArena::GetThreadArena().Reset();
+}
 
-	m_ObjPlayer[PLAYER_PARTS_ENGINE_L].SetTranslation(
-		Vector3(-0.22f, 0.3f, 0.22f));
-	m_ObjPlayer[PLAYER_PARTS_ENGINE_L].SetRotation(
-		Vector3(0, XMConvertToRadians(-45), 0));
+// V~[Vp̃XbhɔCÅԂɑÕt[̏Ԃ`悷
+void Game::TickPipelined()
+{
+	// xPt[܂łɂȂAÕt[̃V~[VÎ҂
+	if (m_isLatencyCapped)
+	{
+		m_pipeline->Wait();
+	}
 
-	m_ObjPlayer[PLAYER_PARTS_FAN].SetTranslation(
-		Vector3(0, 0.3f, 1.0f));
+	// i߂Xebv͎ԂŌ߁AV~[VsȂ玟̃t[ɂ܂Ƃ߂ēn
+	m_timer.Tick([&]()
+	{
+		m_pendingInputs.push_back(TakeStepInput());
+	});
+	if (m_pipeline->IsBusy())
+	{
+		return;
+	}
 
-	m_sinAngle = 0.0f;
+	// ̃Xbhǂރf́AV~[V~܂ĂԂɍւ
+	Obj3d::ProcessLoadedModels();
+	TakePendingSteps();
+	m_pipeline->Kick();
 }
 
-// Executes the basic game loop.
-void Game::Tick()
+// ܂nĂȂXebv̓͂AɎsV~[Vɓn
+void Game::TakePendingSteps()
 {
-    m_timer.Tick([&]()
-    {
-        Update(m_timer);
-    });
+	// Œ̊ԊuŐi߂̂ŁAǂ̃Xebv
+	m_kickElapsedTime = float(m_timer.GetElapsedSeconds());
+	m_kickAlpha = static_cast<float>(m_timer.GetInterpolationAlpha());
+	m_kickInputs.swap(m_pendingInputs);
+	m_pendingInputs.clear();
+	m_kickInputTime = 0;
+	if (!m_kickInputs.empty())
+	{
+		m_kickInputTime = m_pendingInputTime;
+		m_pendingInputTime = 0;
+	}
+}
 
-    Render();
+// nꂽXebv̐V~[Vi߂ďԂJ
+void Game::SimulateFrame()
+{
+	RecordInputLatency(m_kickInputTime);
+	for (const SimulationInput& input : m_kickInputs)
+	{
+		Update(m_kickElapsedTime, input);
+	}
+	PublishSnapshot(m_kickAlpha);
 }
 
-// Updates the world.
-void Game::Update(DX::StepTimer const& timer)
+// ̃Xebv̓͂o
+SimulationInput Game::TakeStepInput()
 {
-    float elapsedTime = float(timer.GetElapsedSeconds());
+	SimulationInput input = m_pendingInput;
+	// J̐؂ւ͍ŏ̃Xebv
+	m_pendingInput.toggleCamera = false;
+	m_frameStepCount++;
+	if (m_isReplaying)
+	{
+		// L^葽i񂾂Ƃ EndInputFrame Ő
+		if (m_replayStep < m_recording.GetSteps().size())
+		{
+			input = m_recording.GetSteps()[m_replayStep++];
+		}
+	}
+	else if (m_isRecording)
+	{
+		m_recording.AddStep(input);
+	}
+	return input;
+}
 
-    // TODO: Add your game logic here.
-    elapsedTime;
-	// Q[̖t[
-	// fobOJ̍XV
-	m_debugCamera->Update();
+// Đ͋L^t[̎ԂŃ^C}[i߂
+void Game::BeginInputFrame()
+{
+	m_frameStepCount = 0;
+	if (!m_isReplaying)
+	{
+		return;
+	}
+	if (m_replayFrame >= m_recording.GetFrames().size())
+	{
+		FinishInputReplay();
+		return;
+	}
+	m_timer.SetNextTickDelta(m_recording.GetFrames()[m_replayFrame].tickDelta);
+}
 
-	// pxZ
-	m_AngleBall += 1.0f;
-	
-	// ̃[hsvZ
-	for (int i = 0; i < 10; i++)
-	{
-		// XP[O
-		Matrix scalemat = Matrix::CreateScale(1.0f);
-		// [
-		Matrix rotmatZ = Matrix::CreateRotationZ(XMConvertToRadians(0.0f));
-		// sb`ipj
-		Matrix rotmatX = Matrix::CreateRotationX(XMConvertToRadians(0.0f));
-		// [iʊpj
-		Matrix rotmatY = Matrix::CreateRotationY(XMConvertToRadians(360.0f/10.0f*i+ m_AngleBall));
-		// ]s̍
-		Matrix rotmat = rotmatZ * rotmatX * rotmatY;
-		// sړ
-		Matrix transmat = Matrix::CreateTranslation(20, 0, 0);
-		// [hs̍
-		m_worldBall[i] = rotmat * transmat;
-	}
-
-	for (int i = 0; i < 10; i++)
-	{
-		// XP[O
-		Matrix scalemat = Matrix::CreateScale(1.0f);
-		// [
-		Matrix rotmatZ = Matrix::CreateRotationZ(XMConvertToRadians(0.0f));
-		// sb`ipj
-		Matrix rotmatX = Matrix::CreateRotationX(XMConvertToRadians(0.0f));
-		// [iʊpj
-		Matrix rotmatY = Matrix::CreateRotationY(XMConvertToRadians(360.0f / 10.0f*i- m_AngleBall));
-		// ]s̍
-		Matrix rotmat = rotmatZ * rotmatX * rotmatY;
-		// sړ
-		Matrix transmat = Matrix::CreateTranslation(40, 0, 0);
-		// [hs̍
-		m_worldBall[10+i] = rotmat * transmat;
-	}
-
-	// @p[c̃M~bN
-	{
-		// @̊pxϓ
-		Vector3 angle;
-
-		angle = m_ObjPlayer[PLAYER_PARTS_SCORE].GetRotation();
-		m_ObjPlayer[PLAYER_PARTS_SCORE].SetRotation(
-			angle + Vector3(0.2f,0.1f,0));
-
-		// TC̈̊px񂾂񑝂
-		m_sinAngle += 0.1f;
-		// t@̊px肫肷(-1`+1)
-		float fan_angle = sinf(m_sinAngle) * 3.0f;
-		/*m_ObjPlayer[PLAYER_PARTS_FAN].SetRotation(
-			Vector3(0, 0, fan_angle));*/
-		m_ObjPlayer[PLAYER_PARTS_FAN].SetTranslation(
-			Vector3(sinf(m_sinAngle), 0, cosf(m_sinAngle)*3.0f));
-	}
-
-	// L[{[h̏Ԃ擾
-	Keyboard::State g_key = keyboard->GetState();
-	
-	// AL[Ă
-	if (g_key.A)
-	{		
-		// @̊pxϓ
-		float angle = m_ObjPlayer[0].GetRotation().y;
-		m_ObjPlayer[0].SetRotation(
-			Vector3(0,angle + 0.03f,0));
-	}
-
-	// DL[Ă
-	if (g_key.D)
-	{
-		// @̊pxϓ
-		float angle = m_ObjPlayer[0].GetRotation().y;
-		m_ObjPlayer[0].SetRotation(
-			Vector3(0, angle - 0.03f, 0));
-	}
-
-	// WL[Ă
-	if (g_key.W)
-	{
-		// ړxNg
-		Vector3 moveV(0, 0, -0.1f);
-		// ̊pxɍ킹ĈړxNg]
-		// ]s
-		float angle = m_ObjPlayer[0].GetRotation().y;
-		Matrix rotmat = Matrix::CreateRotationY(angle);
-		moveV = Vector3::TransformNormal(moveV, rotmat);
-		// @̍Wړ
-		Vector3 pos = m_ObjPlayer[0].GetTranslation();
-		pos += moveV;
-		m_ObjPlayer[0].SetTranslation(pos);
-	}
-
-	// SL[Ă
-	if (g_key.S)
-	{
-		// ړxNg
-		Vector3 moveV(0, 0, +0.1f);
-		// ]s
-		float angle = m_ObjPlayer[0].GetRotation().y;
-		Matrix rotmat = Matrix::CreateRotationY(angle);
-		moveV = Vector3::TransformNormal(moveV, rotmat);
-		// @̍Wړ
-		Vector3 pos = m_ObjPlayer[0].GetTranslation();
-		pos += moveV;
-		m_ObjPlayer[0].SetTranslation(pos);
+// ̃t[̃XebvL^邩AL^ƍĂ邩m߂
+void Game::EndInputFrame()
+{
+	if (m_isRecording)
+	{
+		m_recording.AddFrame(m_timer.GetLastTickDelta(), m_frameStepCount);
 	}
+	else if (m_isReplaying)
+	{
+		if (m_recording.GetFrames()[m_replayFrame].stepCount != m_frameStepCount)
+		{
+			m_replayMismatchCount++;
+		}
+		m_replayFrame++;
+	}
+}
+
+// ĐI猋ʂoďI
+void Game::FinishInputReplay()
+{
+	m_isReplaying = false;
+
+	// Đt[̎ԂPsǉ
+	FrameStats& stats = m_timer.GetFrameStats();
+	OutputDebugStringA(FrameStats::FormatReport(stats.GetReport()).c_str());
+	const bool isWritten = stats.AppendCsv(FRAME_STATS_PATH, "GameEngineTK replay");
+	OutputDebugString(isWritten ? L"frame_stats.csv written\n" : L"frame_stats.csv: cannot write\n");
+	char text[128];
+	sprintf_s(text, "replay: %zu frames, %zu steps, %u mismatched frames\n",
+		m_replayFrame, m_replayStep, m_replayMismatchCount);
+	OutputDebugStringA(text);
+
+	// L^ƐHoȂ΁AIR[h 1 ɂ
+	PostQuitMessage(m_replayMismatchCount == 0 && isWritten ? 0 : 1);
+}
+
+// Updates the world.
+void Game::Update(float elapsedTime, const SimulationInput& input)
+{
+    PROFILE_SCOPE("Game::Update");
+
+	// Q[̖t[i@EEJ̌vZ̓V~[VɔCj
+	m_simulation->SetCameraTarget(Float3{ tank_pos.x, tank_pos.y, tank_pos.z }, tank_angle);
+	m_simulation->Step(elapsedTime, input);
 
 	//{// @̃[hsvZ
 	//	// ]s
@@ -304,23 +409,261 @@ void Game::Update(DX::StepTimer const& timer)
 	//}
 
 	{// Ǐ]J
-		m_Camera->SetTargetPos(tank_pos);
-		m_Camera->SetTargetAngle(tank_angle);
+		// `掞ɕԂ̂ŁAOƌ݂̎_ƒ_c
+		m_previousEyePos = m_eyePos;
+		m_previousRefPos = m_refPos;
+		m_eyePos = ToVector3(m_simulation->GetEyePos());
+		m_refPos = ToVector3(m_simulation->GetRefPos());
+		if (m_stepCount == 0)
+		{
+			m_previousEyePos = m_eyePos;
+			m_previousRefPos = m_refPos;
+		}
+	}
+
+	// VƎ@p[c̃[hs܂Ƃ߂ČvZ
+	Obj3d::UpdateAll(m_jobSystem.get());
+
+	m_stepCount++;
+}
+
+// `ɕKvȏԂԂĎʂA`摤ɌJ
+void Game::PublishSnapshot(float alpha)
+{
+	PROFILE_SCOPE("Game::PublishSnapshot");
+	SceneSnapshot& snapshot = m_snapshots.GetWriteBuffer();
+	snapshot.stepCount = m_stepCount;
+
+	// ̃Aj[V̓WuŌvZÅԂɃIuWFNg̍i荞݂i߂
+	const float previousAngle = m_simulation->GetPreviousBallAngle();
+	const float ballAngle = previousAngle + (m_simulation->GetBallAngle() - previousAngle) * alpha;
+	snapshot.ballWorlds.resize(GameSimulation::BALL_COUNT);
+	Float4x4* ballWorlds = snapshot.ballWorlds.data();
+	auto computeBallWorlds = [ballAngle, ballWorlds]()
+	{
+		GameSimulation::ComputeBallWorlds(ballAngle, ballWorlds);
+	};
+	JobCounter ballCounter;
+	m_jobSystem->Run(computeBallWorlds, ballCounter);
+
+	// Oƌ݂̃V~[V̏Ԃ̊ԂAi񂾎Ԃ̊ŕԂ
+	const Vector3 eyePos = Vector3::Lerp(m_previousEyePos, m_eyePos, alpha);
+	const Vector3 refPos = Vector3::Lerp(m_previousRefPos, m_refPos, alpha);
+	const Matrix view = Matrix::CreateLookAt(eyePos, refPos, Vector3::Up);
+	static_assert(sizeof(Matrix) == sizeof(Float4x4), "Matrix layout mismatch");
+	snapshot.eyePosition = ToFloat3(eyePos);
+	snapshot.refPosition = ToFloat3(refPos);
+	snapshot.view = reinterpret_cast<const Float4x4&>(view);
+	snapshot.projection = reinterpret_cast<const Float4x4&>(m_snapshotProj);
+
+	// VƎ@͋ԃCfbNXŎƏdȂ̂ɍiA`悷郂f܂̂͏
+	Obj3d::SetInterpolationAlpha(alpha);
+	const Matrix viewProjection = view * m_snapshotProj;
+	m_cullObjects.clear();
+	Obj3d::QueryFrustum(ExtractFrustum(reinterpret_cast<const Float4x4&>(viewProjection)), m_cullObjects);
+	snapshot.items.clear();
+	for (Obj3d* obj : m_cullObjects)
+	{
+		SceneDrawItem item;
+		if (obj->GetBoundingSphere(&item.center, &item.radius))
+		{
+			item.object = obj;
+			const Matrix world = obj->GetDrawWorld();
+			item.world = reinterpret_cast<const Float4x4&>(world);
+			snapshot.items.push_back(item);
+		}
+	}
 
-		m_Camera->Update();
-		m_view = m_Camera->GetView();
-		m_proj = m_Camera->GetProj();
+	m_jobSystem->Wait(ballCounter);
+	m_snapshots.Publish();
+}
+
+// t[̓͂V~[V̓͂
+SimulationInput Game::ReadInput(const InputSnapshot& snapshot)
+{
+	// zC[Oɉ񂵂͗߂Ȃ
+	m_scrollWheelValue = std::min(m_scrollWheelValue + snapshot.wheelDelta, 0);
+
+	// t[̊ԂɉėL[Ãt[͉ĂƂɂ
+	SimulationInput input;
+	input.turnLeft = snapshot.IsKeyActive('A');
+	input.turnRight = snapshot.IsKeyActive('D');
+	input.moveForward = snapshot.IsKeyActive('W');
+	input.moveBackward = snapshot.IsKeyActive('S');
+	input.toggleCamera = snapshot.IsKeyPressed('C');
+	input.isDragging = snapshot.IsButtonDown(INPUT_MOUSE_LEFT) || snapshot.IsButtonPressed(INPUT_MOUSE_LEFT);
+	input.mouseX = snapshot.mouseX;
+	input.mouseY = snapshot.mouseY;
+	input.scrollWheelValue = m_scrollWheelValue;
+	return input;
+}
+
+// ͂V~[VɎg܂ł̒xL^
+void Game::RecordInputLatency(uint64_t eventTime)
+{
+	if (eventTime == 0)
+	{
+		return;
 	}
+	Clock& clock = GetDefaultClock();
+	const uint64_t now = clock.GetCounter();
+	const uint64_t elapsed = now > eventTime ? now - eventTime : 0;
+	m_inputLatency.Record(elapsed * 1000000 / clock.GetFrequency());
+}
 
-	m_objSkydome.Update();
+// L[{[hƃ}EX̃bZ[WCxgɂăL[ɐς
+void Game::OnInputMessage(UINT message, WPARAM wParam, LPARAM lParam)
+{
+	InputEvent event = {};
+	event.timestamp = GetDefaultClock().GetCounter();
+	// {^ƃ|C^̃bZ[W̓NCAgW
+	event.x = static_cast<short>(LOWORD(lParam));
+	event.y = static_cast<short>(HIWORD(lParam));
+	switch (message)
+	{
+	case WM_KEYDOWN:
+	case WM_SYSKEYDOWN:
+		event.type = INPUT_EVENT_KEY_DOWN;
+		event.code = static_cast<uint8_t>(wParam);
+		break;
+	case WM_KEYUP:
+	case WM_SYSKEYUP:
+		event.type = INPUT_EVENT_KEY_UP;
+		event.code = static_cast<uint8_t>(wParam);
+		break;
+	case WM_MOUSEMOVE:
+		event.type = INPUT_EVENT_MOUSE_MOVE;
+		break;
+	case WM_LBUTTONDOWN:
+	case WM_RBUTTONDOWN:
+	case WM_MBUTTONDOWN:
+	case WM_XBUTTONDOWN:
+		event.type = INPUT_EVENT_BUTTON_DOWN;
+		event.code = static_cast<uint8_t>(ToMouseButton(message, wParam));
+		break;
+	case WM_LBUTTONUP:
+	case WM_RBUTTONUP:
+	case WM_MBUTTONUP:
+	case WM_XBUTTONUP:
+		event.type = INPUT_EVENT_BUTTON_UP;
+		event.code = static_cast<uint8_t>(ToMouseButton(message, wParam));
+		break;
+	case WM_MOUSEWHEEL:
+		// W̓XN[WȂ̂ŎgȂ
+		event.type = INPUT_EVENT_WHEEL;
+		event.wheelDelta = GET_WHEEL_DELTA_WPARAM(wParam);
+		break;
+	case WM_ACTIVATEAPP:
+		// bZ[W͂ȂȂ̂ŁAtH[JXSėƂɂ
+		if (wParam)
+		{
+			return;
+		}
+		event.type = INPUT_EVENT_RELEASE_ALL;
+		break;
+	default:
+		return;
+	}
+	m_inputQueue.Push(event);
+}
 
-	for (std::vector<Obj3d>::iterator it = m_ObjPlayer.begin();
-		it != m_ObjPlayer.end();
-		it++)
+// vt@C̑ƏWv̕\
+void Game::UpdateProfiler()
+{
+	const InputSnapshot& input = m_inputState.GetSnapshot();
+	if (input.IsKeyPressed(VK_F1))
 	{
-		it->Update();
+		Profiler::SetEnabled(!Profiler::IsEnabled());
+		if (!Profiler::IsEnabled())
+		{
+			SetWindowText(m_window, L"GameEngineTK");
+		}
 	}
+	if (input.IsKeyPressed(VK_F2) && !m_isProfileCapturing)
+	{
+		Profiler::SetEnabled(true);
+		Profiler::StartCapture(PROFILE_CAPTURE_FRAMES);
+		m_isProfileCapturing = true;
+	}
+
+	// SẴXbh̋ԂWv
+	Profiler::EndFrame();
 
+	// ۑI珑o
+	if (m_isProfileCapturing && !Profiler::IsCapturing())
+	{
+		m_isProfileCapturing = false;
+		OutputDebugString(Profiler::WriteChromeTrace(PROFILE_CAPTURE_PATH)
+			? L"profile.json written\n" : L"profile.json: cannot write\n");
+	}
+
+	// ߂̃t[̏Wv̊ŐԂ^Cgɕ\
+	if (Profiler::IsEnabled() && m_timer.GetFrameCount() % PROFILE_TITLE_INTERVAL == 0)
+	{
+		std::vector<ProfileSummaryEntry> summary;
+		Profiler::GetSummary(summary);
+		std::string title = "GameEngineTK";
+		char item[96];
+		for (const ProfileSummaryEntry& entry : summary)
+		{
+			if (entry.depth <= 1)
+			{
+				sprintf_s(item, " | %s %.2f ms (max %.2f)", entry.name, entry.averageMs, entry.maxMs);
+				title += item;
+			}
+		}
+		SetWindowTextA(m_window, title.c_str());
+		OutputDebugStringA(Profiler::FormatSummary().c_str());
+	}
+}
+
+// t[Ԃ̋L^̑
+void Game::UpdateFrameStats()
+{
+	if (!m_inputState.GetSnapshot().IsKeyPressed(VK_F3))
+	{
+		return;
+	}
+	// ܂ł̋L^PsǉǍv̂߂ɏ
+	FrameStats& stats = m_timer.GetFrameStats();
+	OutputDebugStringA(FrameStats::FormatReport(stats.GetReport()).c_str());
+	OutputDebugString(stats.AppendCsv(FRAME_STATS_PATH, "GameEngineTK")
+		? L"frame_stats.csv written\n" : L"frame_stats.csv: cannot write\n");
+	stats.Reset();
+
+	// ͂̒x̓V~[ṼXbhL^̂ŁA~܂Ăǂ
+	m_pipeline->Wait();
+	char text[160];
+	sprintf_s(text, "input latency: p50 %.2f ms, p99 %.2f ms, max %.2f ms (%llu samples, %llu dropped events)\n",
+		m_inputLatency.GetPercentile(50.0) * 1e-3, m_inputLatency.GetPercentile(99.0) * 1e-3,
+		m_inputLatency.GetMax() * 1e-3, static_cast<unsigned long long>(m_inputLatency.GetCount()),
+		static_cast<unsigned long long>(m_inputQueue.TakeDroppedCount()));
+	OutputDebugStringA(text);
+	m_inputLatency.Reset();
+
+	// CXbh̃t[pA[iiꂪȂ DEFAULT_CAPACITY j
+	const FrameArenaStatistics& arena = FrameArena::GetThreadArena().GetStatistics();
+	sprintf_s(text, "frame arena: %llu KB capacity, %llu KB peak, %llu overflows (%llu KB)\n",
+		static_cast<unsigned long long>(arena.capacity / 1024), static_cast<unsigned long long>(arena.highWaterMark / 1024),
+		static_cast<unsigned long long>(arena.overflowCount), static_cast<unsigned long long>(arena.overflowBytes / 1024));
+	OutputDebugStringA(text);
+
+	// Õt[ŏڍדxČ炵Op`
+	const Obj3d::LodStatistics& lod = Obj3d::GetLodStatistics();
+	sprintf_s(text, "lod: %u triangles submitted of %u at full detail (%.1f%%)\n", lod.submittedTriangles,
+		lod.fullDetailTriangles, lod.fullDetailTriangles ? 100.0 * lod.submittedTriangles / lod.fullDetailTriangles : 100.0);
+	OutputDebugStringA(text);
+}
+
+// pCvC̑
+void Game::UpdatePipelining()
+{
+	if (!m_inputState.GetSnapshot().IsKeyPressed(VK_F4))
+	{
+		return;
+	}
+	SetPipelining(!m_isPipelined, m_isLatencyCapped);
+	OutputDebugString(m_isPipelined ? L"simulation: pipelined\n" : L"simulation: serial\n");
 }
 
 // Draws the scene.
@@ -348,11 +691,31 @@ void Game::Render()
         return;
     }
 
+    // V~[VVԂ͂ĂΎ󂯎i͂ĂȂΑOƓԂ`悷j
+    if (m_snapshots.Acquire())
+    {
+        m_hasSnapshot = true;
+    }
+    if (!m_hasSnapshot)
+    {
+        return;
+    }
+
+    PROFILE_SCOPE("Game::Render");
+
     Clear();
 
+	// `̓XibvVbgǂ
+	const SceneSnapshot& scene = m_snapshots.GetReadBuffer();
+	m_view = reinterpret_cast<const Matrix&>(scene.view);
+	m_proj = reinterpret_cast<const Matrix&>(scene.projection);
+	// ڍדx̑IɎgJ_ɂ
+	m_Camera->SetEyePos(ToVector3(scene.eyePosition));
+	m_Camera->SetRefPos(ToVector3(scene.refPosition));
+	m_Camera->Update();
+
     // TODO: Add your rendering code here.
 	// `͂ɏB
-	m_states = std::make_unique<CommonStates>(m_d3dDevice.Get());
 	m_d3dContext->OMSetBlendState(m_states->Opaque(), nullptr, 0xFFFFFFFF);
 	m_d3dContext->OMSetDepthStencilState(m_states->DepthNone(), 0);
 	m_d3dContext->RSSetState(m_states->Wireframe());
@@ -388,22 +751,51 @@ void Game::Render()
 	m_effect->Apply(m_d3dContext.Get());
 	m_d3dContext->IASetInputLayout(m_inputLayout.Get());
 
-	// V`
-	m_objSkydome.Draw();
-	// nʂ`
-	m_modelGround->Draw(m_d3dContext.Get(),
-		*m_states,
-		Matrix::Identity,
-		m_view,
-		m_proj);
-	// `
-	for (int i = 0; i < 20; i++)
+	// JOiEW߁Aǉ̔ԍŌ̂󂯎j
+	Float3 center;
+	float radius;
+	m_culler.Clear();
+	// VƎ@iԃCfbNXł̍i荞݂̓XibvVbgƂɍςłj
+	const Matrix viewProjection = m_view * m_proj;
+	for (const SceneDrawItem& item : scene.items)
+	{
+		m_culler.Add(item.center, item.radius);
+	}
+	// n
+	const uint32_t groundIndex = static_cast<uint32_t>(scene.items.size());
+	Obj3d::ComputeBoundingSphere(*m_modelGround, Matrix::Identity, &center, &radius);
+	m_culler.Add(center, radius);
+	// 
+	const uint32_t firstBallIndex = groundIndex + 1;
+	for (const Float4x4& ballWorld : scene.ballWorlds)
 	{
-		m_modelBall->Draw(m_d3dContext.Get(),
-			*m_states,
-			m_worldBall[i],
-			m_view,
-			m_proj);
+		Obj3d::ComputeBoundingSphere(*m_modelBall, reinterpret_cast<const Matrix&>(ballWorld), &center, &radius);
+		m_culler.Add(center, radius);
+	}
+	m_culler.Cull(reinterpret_cast<const Float4x4&>(viewProjection), m_jobSystem.get());
+
+	// ̂`R}hς
+	m_renderBackend->BeginFrame(m_view, m_proj);
+	m_renderQueue.Clear();
+	Obj3d::ResetLodStatistics();
+	m_instanceBatcher.Clear();
+	for (uint32_t index : m_culler.GetVisible())
+	{
+		if (index < groundIndex)
+		{
+			const SceneDrawItem& item = scene.items[index];
+			item.object->Draw(reinterpret_cast<const Matrix&>(item.world));
+		}
+		else if (index == groundIndex)
+		{
+			m_renderBackend->AddModel(m_renderQueue, *m_modelGround, Matrix::Identity);
+		}
+		else
+		{
+			// ͂܂Ƃ߂ăCX^X`悷
+			const Float4x4& world = scene.ballWorlds[index - firstBallIndex];
+			m_instanceBatcher.Add(m_modelBall.get(), nullptr, world);
+		}
 	}
 
 	//// p[cP`
@@ -420,12 +812,13 @@ void Game::Render()
 	//	m_view,
 	//	m_proj);
 
-	for (std::vector<Obj3d>::iterator it = m_ObjPlayer.begin();
-		it != m_ObjPlayer.end();
-		it++)
-	{
-		it->Draw();
-	}
+	// `îP̕`Ăяoɂ܂Ƃ߂j
+	m_instanceBatcher.Build();
+	m_instancedRenderer->Draw(m_d3dContext.Get(), *m_states, m_instanceBatcher, m_view, m_proj);
+
+	// Xe[gE}eAEbVE[x̏ɕבւĔs
+	m_renderQueue.Sort();
+	m_renderQueue.Submit(*m_renderBackend);
 
 	m_batch->Begin();
 
@@ -439,6 +832,7 @@ void Game::Render()
 // Helper method to clear the back buffers.
 void Game::Clear()
 {
+    PROFILE_SCOPE("Game::Clear");
     // Clear the views.
     m_d3dContext->ClearRenderTargetView(m_renderTargetView.Get(), Colors::CornflowerBlue);
     m_d3dContext->ClearDepthStencilView(m_depthStencilView.Get(), D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, 1.0f, 0);
@@ -453,10 +847,13 @@ void Game::Clear()
 // Presents the back buffer contents to the screen.
 void Game::Present()
 {
+    PROFILE_SCOPE("Game::Present");
     // The first argument instructs DXGI to block until VSync, putting the application
     // to sleep until the next VSync. This ensures we don't waste any cycles rendering
     // frames that will never be displayed to the screen.
+    m_timer.BeginPresent();
     HRESULT hr = m_swapChain->Present(1, 0);
+    m_timer.EndPresent();
 
     // If the device was reset we must completely reinitialize the renderer.
     if (hr == DXGI_ERROR_DEVICE_REMOVED || hr == DXGI_ERROR_DEVICE_RESET)
@@ -499,9 +896,96 @@ void Game::OnWindowSizeChanged(int width, int height)
 
     CreateResources();
 
+	// V~[ṼXbhǂޒlς̂ŁA~܂̂҂
+	if (m_pipeline)
+	{
+		m_pipeline->Wait();
+	}
+	// fobOJ̃hbO̊ʂ̑傫ɍ킹iL^EĐ͋L^傫̂܂܁j
+	if (m_simulation && !m_isRecording && !m_isReplaying)
+	{
+		m_simulation->SetScreenSize(m_outputWidth, m_outputHeight);
+	}
+
     // TODO: Game window is being resized.
 }
 
+// V~[V̕pxi/bjݒ
+void Game::SetSimulationRate(double updatesPerSecond)
+{
+	m_timer.SetTargetElapsedSeconds(1.0 / updatesPerSecond);
+}
+
+// V~[Vp̃XbhŐi߂ĕ`Əd˂邩
+void Game::SetPipelining(bool isPipelined, bool isLatencyCapped)
+{
+	if (m_pipeline)
+	{
+		// s̃V~[VI点A܂nĂȂXebv͂̃XbhŐi߂
+		m_pipeline->Wait();
+		if (!m_pendingInputs.empty())
+		{
+			TakePendingSteps();
+			SimulateFrame();
+		}
+	}
+	m_isPipelined = isPipelined;
+	m_isLatencyCapped = isLatencyCapped;
+}
+
+// V~[V̓͂ƃ^C}[̐iݕ̋L^n߂
+bool Game::StartInputRecording(const std::wstring& path)
+{
+	// Đ͋NԂn߂̂ŁAV~[Vi߂O
+	if (m_stepCount > 0 || m_isReplaying)
+	{
+		return false;
+	}
+	InputRecordingSettings settings;
+	settings.isFixedTimeStep = m_timer.IsFixedTimeStep();
+	settings.targetElapsedTicks = m_timer.GetTargetElapsedTicks();
+	settings.maxUpdatesPerTick = m_timer.GetMaxUpdatesPerTick();
+	settings.screenWidth = m_outputWidth;
+	settings.screenHeight = m_outputHeight;
+	m_recording.Reset(settings);
+	m_recordingPath = path;
+	m_isRecording = true;
+	return true;
+}
+
+// L^~߂ďo
+bool Game::StopInputRecording()
+{
+	if (!m_isRecording)
+	{
+		return false;
+	}
+	m_isRecording = false;
+	return m_recording.Save(m_recordingPath);
+}
+
+// L^Đ
+bool Game::StartInputReplay(const std::wstring& path)
+{
+	if (m_stepCount > 0 || m_isRecording || !m_recording.Load(path))
+	{
+		return false;
+	}
+	// L^ƂƓԊuƓʂ̑傫Ői߂
+	const InputRecordingSettings& settings = m_recording.GetSettings();
+	m_timer.SetFixedTimeStep(settings.isFixedTimeStep);
+	m_timer.SetTargetElapsedTicks(settings.targetElapsedTicks);
+	m_timer.SetMaxUpdatesPerTick(settings.maxUpdatesPerTick);
+	m_simulation->SetScreenSize(settings.screenWidth, settings.screenHeight);
+	// Đt[v
+	m_timer.GetFrameStats().Reset();
+	m_replayFrame = 0;
+	m_replayStep = 0;
+	m_replayMismatchCount = 0;
+	m_isReplaying = true;
+	return true;
+}
+
 // Properties
 void Game::GetDefaultSize(int& width, int& height) const
 {
@@ -592,6 +1076,8 @@ void Game::CreateDevice()
         (void)m_d3dContext.As(&m_d3dContext1);
 
     // TODO: Initialize device dependent objects here (independent of window size).
+	// Xe[g̓foCXƂɂP񂾂it[蒼Ȃj
+	m_states = std::make_unique<CommonStates>(m_d3dDevice.Get());
 }
 
 // Allocate all memory resources that change on a window SizeChanged event.
@@ -604,6 +1090,9 @@ void Game::CreateResources()
     m_depthStencilView.Reset();
     m_d3dContext->Flush();
 
+	// ڍדx͉ʏ̌덷isNZjőIԂ̂ŁAʂ̑傫`
+	Obj3d::SetLodParameters(static_cast<float>(m_outputWidth));
+
     UINT backBufferWidth = static_cast<UINT>(m_outputWidth);
     UINT backBufferHeight = static_cast<UINT>(m_outputHeight);
     DXGI_FORMAT backBufferFormat = DXGI_FORMAT_B8G8R8A8_UNORM;
@@ -716,6 +1205,7 @@ void Game::CreateResources()
 void Game::OnDeviceLost()
 {
     // TODO: Add Direct3D resource cleanup here.
+	m_states.reset();
 
     m_depthStencilView.Reset();
     m_renderTargetView.Reset();
@@ -11,10 +11,23 @@
 #include <CommonStates.h>
 #include <SimpleMath.h>
 #include <Model.h>
-#include <Keyboard.h>
-#include "DebugCamera.h"
-#include "FollowCamera.h"
+#include "Camera.h"
+#include "FrameArena.h"
+#include "FramePipeline.h"
+#include "FrustumCulling.h"
+#include "GameSimulation.h"
+#include "InputEventQueue.h"
+#include "InputRecording.h"
+#include "InstanceBatcher.h"
+#include "InstancedRenderer.h"
+#include "ModelRenderBackend.h"
+#include "RenderQueue.h"
 #include "Obj3d.h"
+#include "Profiler.h"
+#include "SceneSnapshot.h"
+#include "SnapshotBuffer.h"
+#include "TransformKernel.h"
+#include "JobSystem.h"
 #include <vector>
 
 // A basic game implementation that creates a D3D11 device and
@@ -23,18 +36,6 @@ class Game
 {
 public:
 
-	enum PLAYER_PARTS
-	{
-		PLAYER_PARTS_TOWER,	// 
-		PLAYER_PARTS_BASE,	// n
-		PLAYER_PARTS_ENGINE_R,	// EGW
-		PLAYER_PARTS_ENGINE_L,	// GW
-		PLAYER_PARTS_FAN,	// C
-		PLAYER_PARTS_SCORE,	// 
-
-		PLAYER_PARTS_NUM
-	};
-
     Game();
 
     // Initialization and management
@@ -49,14 +50,53 @@ public:
     void OnSuspending();
     void OnResuming();
     void OnWindowSizeChanged(int width, int height);
+	// L[{[hƃ}EX̃bZ[Wt̃CxgɂăL[ɐςށiEBhEvV[WĂԁj
+	void OnInputMessage(UINT message, WPARAM wParam, LPARAM lParam);
 
     // Properties
     void GetDefaultSize( int& width, int& height ) const;
+	// V~[V̕pxi/bjݒi`͕Ԃ̂ŉʂ̍XVpxƈĂ悢j
+	void SetSimulationRate(double updatesPerSecond);
+	// V~[Vp̃XbhŐi߂ĕ`Əd˂邩
+	// isLatencyCapped Ȃ疈t[Õt[̃V~[V҂A`̒xPt[܂łɂ
+	void SetPipelining(bool isPipelined, bool isLatencyCapped = true);
+	// V~[V̓͂ƃ^C}[̐iݕL^AStopInputRecording  path ɏo
+	// ĐœԂn߂邽߂ɁAŏ Tick ̑OɌĂԁis falsej
+	bool StartInputRecording(const std::wstring& path);
+	bool StopInputRecording();
+	// L^Điŏ Tick ̑OɌĂԁBIt[Ԃ̋L^oďIj
+	bool StartInputReplay(const std::wstring& path);
 
 private:
 
-    void Update(DX::StepTimer const& timer);
+    void Update(float elapsedTime, const SimulationInput& input);
     void Render();
+	// V~[Vp̃XbhɔCÅԂɑÕt[̏Ԃ`悷
+	void TickPipelined();
+	// ܂nĂȂXebv̓͂AɎsV~[Vɓn
+	void TakePendingSteps();
+	// nꂽXebv̐V~[Vi߂ďԂJipCvC̃XbhŎsj
+	void SimulateFrame();
+	// ̃Xebv̓͂oiĐ͋L^oAL^͋L^ɒǉj
+	SimulationInput TakeStepInput();
+	// Đ͋L^t[̎ԂŃ^C}[i߂
+	void BeginInputFrame();
+	// ̃t[̃XebvL^邩AĐȂL^ƍĂ邩m߂
+	void EndInputFrame();
+	// ĐI猋ʂoďI
+	void FinishInputReplay();
+	// `ɕKvȏԂԂĎʂA`摤ɌJ
+	void PublishSnapshot(float alpha);
+	// t[̓͂V~[V̓͂
+	SimulationInput ReadInput(const InputSnapshot& snapshot);
+	// eventTimei0 ȂL^Ȃjɓ͂͂V~[Vg܂ł̒xL^
+	void RecordInputLatency(uint64_t eventTime);
+	// vt@C̑iF1 Ōv̐؂ւAF2 Ńg[X̕ۑjƏWv̕\
+	void UpdateProfiler();
+	// t[Ԃ̋L^̑iF3  CSV ɒǉċL^j
+	void UpdateFrameStats();
+	// pCvC̑iF4 ŃV~[Vp̃XbhŐi߂邩؂ւj
+	void UpdatePipelining();
 
     void Clear();
     void Present();
@@ -94,8 +134,6 @@ private:
 	DirectX::SimpleMath::Matrix m_view;
 	DirectX::SimpleMath::Matrix m_proj;
 
-	// fobOJ
-	std::unique_ptr<DebugCamera> m_debugCamera;
 	// GtFNgt@Ng
 	std::unique_ptr<DirectX::EffectFactory> m_factory;
 	// f
@@ -103,12 +141,26 @@ private:
 	std::unique_ptr<DirectX::Model> m_modelGround;
 	std::unique_ptr<DirectX::Model> m_modelBall;
 	//std::unique_ptr<DirectX::Model> m_modelHead;
-	// ̃[hs
-	DirectX::SimpleMath::Matrix m_worldBall[20];
-	// px
-	float m_AngleBall;
-	// L[{[h
-	std::unique_ptr<DirectX::Keyboard> keyboard;
+	// f܂Ƃ߂ăCX^X`悷
+	InstanceBatcher m_instanceBatcher;
+	std::unique_ptr<InstancedRenderer> m_instancedRenderer;
+	// `R}hבւĔs
+	RenderQueue m_renderQueue;
+	std::unique_ptr<ModelRenderBackend> m_renderBackend;
+	// JO
+	FrustumCuller m_culler;
+	// ԃCfbNXŎƏdȂIuWFNgiXibvVbgƂɎgj
+	std::vector<Obj3d*> m_cullObjects;
+	// EBhEvV[W͂L[{[hƃ}EX̃Cxg
+	InputEventQueue m_inputQueue;
+	// t[ƂɂPCxgǂݏoč́iV~[VƃfobOp̃L[œ̂gj
+	InputState m_inputState;
+	// }EXzC[̗ݐρiOɉ񂵂͗߂Ȃj
+	int m_scrollWheelValue;
+	// ͂̃Cxg͂ĂV~[Vg܂ł̒xi}CNbj
+	FrameTimeHistogram m_inputLatency;
+	// g[XۑĂƂ납
+	bool m_isProfileCapturing;
 	// @̍W
 	DirectX::SimpleMath::Vector3 tank_pos;
 	// @̉]p
@@ -119,10 +171,52 @@ private:
 	//DirectX::SimpleMath::Matrix tank2_world;
 	// @̃IuWFNg
 	std::vector<Obj3d> m_ObjPlayer;
-	// @̃M~bNɎgpx
-	float m_sinAngle;
-
-	// J
-	std::unique_ptr<FollowCamera> m_Camera;
+	// `ɈˑȂQ[̌vZ
+	std::unique_ptr<GameSimulation> m_simulation;
+
+	// Ji`摤A_ƎQƓ_̓XibvVbg󂯎j
+	std::unique_ptr<Camera> m_Camera;
+	// XibvVbgɎʂˉesiV~[V~܂ĂԂj
+	DirectX::SimpleMath::Matrix m_snapshotProj;
+	// Oƌ݂̃J̎_ƒ_i`掞ɕԂj
+	DirectX::SimpleMath::Vector3 m_previousEyePos;
+	DirectX::SimpleMath::Vector3 m_eyePos;
+	DirectX::SimpleMath::Vector3 m_previousRefPos;
+	DirectX::SimpleMath::Vector3 m_refPos;
+	// ϊJOȂǂɏWuVXe
+	std::unique_ptr<JobSystem> m_jobSystem;
+
+	// V~[V`ɓn
+	SnapshotBuffer<SceneSnapshot> m_snapshots;
+	// `摤xłԂ󂯎
+	bool m_hasSnapshot;
+	// V~[Vi߂
+	uint32_t m_stepCount;
+	// V~[Vp̃XbhŐi߂邩AÕt[҂
+	bool m_isPipelined;
+	bool m_isLatencyCapped;
+	// ̃t[̓͂ƁAԂ܂V~[VɓnĂȂXebv̓
+	SimulationInput m_pendingInput;
+	std::vector<SimulationInput> m_pendingInputs;
+	// ܂V~[VɓnĂȂłÂCxg̎i 0j
+	uint64_t m_pendingInputTime;
+	// s̃V~[VɓnXebv̓́EPXebv̎ԁEԂ̊
+	std::vector<SimulationInput> m_kickInputs;
+	float m_kickElapsedTime;
+	float m_kickAlpha;
+	uint64_t m_kickInputTime;
+	// ͂̋L^ƍĐ
+	InputRecording m_recording;
+	std::wstring m_recordingPath;
+	bool m_isRecording;
+	bool m_isReplaying;
+	// Đt[ƃXebv̐Ãt[Ői߂Xebv
+	size_t m_replayFrame;
+	size_t m_replayStep;
+	uint32_t m_frameStepCount;
+	// ĐɋL^ƃXebvȂt[̐
+	uint32_t m_replayMismatchCount;
+	// V~[ṼXbhĩoɎ~߂̂ōŌɒuj
+	std::unique_ptr<FramePipeline> m_pipeline;
 
 };
\ No newline at end of file
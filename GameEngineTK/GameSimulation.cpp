@@ -0,0 +1,274 @@
+﻿#include "GameSimulation.h"
+
+#include "Profiler.h"
+#include "TransformKernel.h"
+
+namespace
+{
+	const float PI = 3.14159265358979f;
+
+	// 球の公転の速さ（度/秒）
+	const float BALL_ANGULAR_SPEED = 60.0f;
+	// 音符の回転の速さ（ラジアン/秒）
+	const Float3 SCORE_SPIN_SPEED = { 12.0f, 6.0f, 0.0f };
+	// ファンの往復の速さ（ラジアン/秒）
+	const float FAN_SPEED = 6.0f;
+	// 自機の旋回の速さ（ラジアン/秒）
+	const float TURN_SPEED = 1.8f;
+	// 自機の移動の速さ（/秒）
+	const float MOVE_SPEED = 6.0f;
+	// 追従カメラと自機の距離
+	const float CAMERA_DISTANCE = 5.0f;
+	// デバッグカメラと原点の距離
+	const float DEBUG_CAMERA_DISTANCE = 5.0f;
+	// 追従カメラの視点と参照点が 1/60 秒で目標に近づく割合
+	const float EYE_APPROACH_RATE = 0.05f;
+	const float REF_APPROACH_RATE = 0.20f;
+
+	Float3 Add(const Float3& a, const Float3& b)
+	{
+		return Float3{ a.x + b.x, a.y + b.y, a.z + b.z };
+	}
+
+	Float3 Scale(const Float3& v, float s)
+	{
+		return Float3{ v.x * s, v.y * s, v.z * s };
+	}
+
+	// a から b へ t の割合で近づける
+	Float3 Approach(const Float3& a, const Float3& b, float t)
+	{
+		return Float3{ a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t, a.z + (b.z - a.z) * t };
+	}
+
+	// 1/60 秒で rate の割合だけ近づくとき、elapsedTime 秒で近づく割合（更新の頻度によらず同じ速さで追いつく）
+	float ApproachFactor(float rate, float elapsedTime)
+	{
+		return 1.0f - std::pow(1.0f - rate, elapsedTime * 60.0f);
+	}
+
+	// 行ベクトルに Matrix::CreateRotationX(angle) を掛ける
+	Float3 RotateX(const Float3& v, float angle)
+	{
+		const float s = std::sin(angle), c = std::cos(angle);
+		return Float3{ v.x, v.y * c - v.z * s, v.y * s + v.z * c };
+	}
+
+	// 行ベクトルに Matrix::CreateRotationY(angle) を掛ける
+	Float3 RotateY(const Float3& v, float angle)
+	{
+		const float s = std::sin(angle), c = std::cos(angle);
+		return Float3{ v.x * c + v.z * s, v.y, -v.x * s + v.z * c };
+	}
+}
+
+GameSimulation::GameSimulation(TransformHierarchy& transforms, const TransformHierarchy::Handle (&parts)[PLAYER_PARTS_NUM],
+	int width, int height)
+	: m_transforms(transforms)
+	, m_ballAngle(0.0f)
+	, m_previousBallAngle(0.0f)
+	, m_sinAngle(0.0f)
+	, m_targetPos{ 0.0f, 0.0f, 0.0f }
+	, m_targetAngle(0.0f)
+	, m_isFPS(false)
+	, m_debugXAngle(0.0f)
+	, m_debugXTmp(0.0f)
+	, m_debugYAngle(0.0f)
+	, m_debugYTmp(0.0f)
+	, m_dragX(0)
+	, m_dragY(0)
+	, m_wasDragging(false)
+	, m_debugEyePos{ 0.0f, 0.0f, DEBUG_CAMERA_DISTANCE }
+	, m_debugUpVec{ 0.0f, 1.0f, 0.0f }
+{
+	for (int i = 0; i < PLAYER_PARTS_NUM; i++)
+	{
+		m_parts[i] = parts[i];
+	}
+	SetScreenSize(width, height);
+	InitializeTPS();
+
+	// 親子関係の構築（子供に親をセット）
+	m_transforms.SetParent(m_parts[PLAYER_PARTS_BASE], m_parts[PLAYER_PARTS_TOWER]);
+	m_transforms.SetParent(m_parts[PLAYER_PARTS_SCORE], m_parts[PLAYER_PARTS_BASE]);
+	m_transforms.SetParent(m_parts[PLAYER_PARTS_ENGINE_R], m_parts[PLAYER_PARTS_TOWER]);
+	m_transforms.SetParent(m_parts[PLAYER_PARTS_ENGINE_L], m_parts[PLAYER_PARTS_TOWER]);
+	m_transforms.SetParent(m_parts[PLAYER_PARTS_FAN], m_parts[PLAYER_PARTS_TOWER]);
+
+	// 親からのオフセット（ローカルの座標ずれ）
+	m_transforms.SetScale(m_parts[PLAYER_PARTS_TOWER], Float3{ 2.0f, 2.0f, 2.0f });
+	m_transforms.SetTranslation(m_parts[PLAYER_PARTS_BASE], Float3{ 0.0f, 0.7f, 0.0f });
+	m_transforms.SetTranslation(m_parts[PLAYER_PARTS_SCORE], Float3{ 0.0f, 1.0f, 0.0f });
+	m_transforms.SetScale(m_parts[PLAYER_PARTS_SCORE], Float3{ 2.0f, 2.0f, 2.0f });
+	m_transforms.SetTranslation(m_parts[PLAYER_PARTS_ENGINE_R], Float3{ 0.22f, 0.3f, 0.22f });
+	m_transforms.SetRotation(m_parts[PLAYER_PARTS_ENGINE_R], Float3{ 0.0f, PI / 4.0f, 0.0f });
+	m_transforms.SetTranslation(m_parts[PLAYER_PARTS_ENGINE_L], Float3{ -0.22f, 0.3f, 0.22f });
+	m_transforms.SetRotation(m_parts[PLAYER_PARTS_ENGINE_L], Float3{ 0.0f, -PI / 4.0f, 0.0f });
+	m_transforms.SetTranslation(m_parts[PLAYER_PARTS_FAN], Float3{ 0.0f, 0.3f, 1.0f });
+}
+
+void GameSimulation::Step(float elapsedTime, const SimulationInput& input)
+{
+	PROFILE_SCOPE("GameSimulation::Step");
+	// デバッグカメラの更新
+	UpdateDebugCamera(input);
+
+	// 角度を加算（球のワールド行列は描画時に補間した角度で計算する）
+	m_previousBallAngle = m_ballAngle;
+	m_ballAngle += BALL_ANGULAR_SPEED * elapsedTime;
+
+	UpdatePlayer(elapsedTime, input);
+	UpdateFollowCamera(elapsedTime, input);
+}
+
+void GameSimulation::SetCameraTarget(const Float3& position, float angle)
+{
+	m_targetPos = position;
+	m_targetAngle = angle;
+}
+
+void GameSimulation::SetScreenSize(int width, int height)
+{
+	// 画面サイズに対する相対的なスケールに調整
+	m_screenScaleX = 1.0f / static_cast<float>(width > 0 ? width : 1);
+	m_screenScaleY = 1.0f / static_cast<float>(height > 0 ? height : 1);
+}
+
+void GameSimulation::ComputeBallWorlds(float angle, Float4x4* worlds)
+{
+	// スケーリング→回転→平行移動をまとめて計算
+	Float3 scales[BALL_COUNT];
+	Float3 rotations[BALL_COUNT];
+	Float3 translations[BALL_COUNT];
+	const int half = BALL_COUNT / 2;
+	for (int i = 0; i < half; i++)
+	{
+		// 内側の球はヨー（方位角）を増やす
+		scales[i] = Float3{ 1.0f, 1.0f, 1.0f };
+		rotations[i] = Float3{ 0.0f, (360.0f / half * i + angle) * PI / 180.0f, 0.0f };
+		translations[i] = Float3{ 20.0f, 0.0f, 0.0f };
+		// 外側の球はヨーを減らす
+		scales[half + i] = Float3{ 1.0f, 1.0f, 1.0f };
+		rotations[half + i] = Float3{ 0.0f, (360.0f / half * i - angle) * PI / 180.0f, 0.0f };
+		translations[half + i] = Float3{ 40.0f, 0.0f, 0.0f };
+	}
+	ComposeTransforms(scales, rotations, translations, nullptr, worlds, BALL_COUNT);
+}
+
+void GameSimulation::UpdateDebugCamera(const SimulationInput& input)
+{
+	if (input.isDragging && !m_wasDragging)
+	{
+		// ドラッグの開始位置
+		m_dragX = input.mouseX;
+		m_dragY = input.mouseY;
+	}
+	else if (!input.isDragging && m_wasDragging)
+	{
+		// 現在の回転を保存
+		m_debugXAngle = m_debugXTmp;
+		m_debugYAngle = m_debugYTmp;
+	}
+	m_wasDragging = input.isDragging;
+
+	// ドラッグ開始位置からの変位（画面に対する相対値）で回す
+	if (input.isDragging)
+	{
+		const float dx = (input.mouseX - m_dragX) * m_screenScaleX;
+		const float dy = (input.mouseY - m_dragY) * m_screenScaleY;
+		if (dx != 0.0f || dy != 0.0f)
+		{
+			m_debugXTmp = m_debugXAngle + dy * PI;
+			m_debugYTmp = m_debugYAngle + dx * PI;
+		}
+	}
+
+	// ホイールを奥に回した分だけ離れる（手前は無視する）
+	const int scrollWheelValue = input.scrollWheelValue > 0 ? 0 : input.scrollWheelValue;
+	const float distance = DEBUG_CAMERA_DISTANCE - scrollWheelValue / 100;
+
+	// (rotY * rotX) の逆行列、つまり X、Y の順に逆回転させる
+	m_debugEyePos = Scale(RotateY(RotateX(Float3{ 0.0f, 0.0f, 1.0f }, -m_debugXTmp), -m_debugYTmp), distance);
+	m_debugUpVec = RotateY(RotateX(Float3{ 0.0f, 1.0f, 0.0f }, -m_debugXTmp), -m_debugYTmp);
+}
+
+void GameSimulation::UpdatePlayer(float elapsedTime, const SimulationInput& input)
+{
+	// 自機パーツのギミック
+	{
+		// 音符の角度を変動
+		Float3 angle = m_transforms.GetRotation(m_parts[PLAYER_PARTS_SCORE]);
+		m_transforms.SetRotation(m_parts[PLAYER_PARTS_SCORE], Add(angle, Scale(SCORE_SPIN_SPEED, elapsedTime)));
+
+		// サインの引数の角度がだんだん増える
+		m_sinAngle += FAN_SPEED * elapsedTime;
+		// ファンの位置がいったりきたりする
+		m_transforms.SetTranslation(m_parts[PLAYER_PARTS_FAN],
+			Float3{ std::sin(m_sinAngle), 0.0f, std::cos(m_sinAngle) * 3.0f });
+	}
+
+	const TransformHierarchy::Handle tower = m_parts[PLAYER_PARTS_TOWER];
+	// 旋回
+	if (input.turnLeft)
+	{
+		float angle = m_transforms.GetRotation(tower).y;
+		m_transforms.SetRotation(tower, Float3{ 0.0f, angle + TURN_SPEED * elapsedTime, 0.0f });
+	}
+	if (input.turnRight)
+	{
+		float angle = m_transforms.GetRotation(tower).y;
+		m_transforms.SetRotation(tower, Float3{ 0.0f, angle - TURN_SPEED * elapsedTime, 0.0f });
+	}
+
+	// 今の角度に合わせて移動ベクトルを回転させて移動
+	float move = 0.0f;
+	move += input.moveForward ? -MOVE_SPEED * elapsedTime : 0.0f;
+	move += input.moveBackward ? MOVE_SPEED * elapsedTime : 0.0f;
+	if (input.moveForward || input.moveBackward)
+	{
+		float angle = m_transforms.GetRotation(tower).y;
+		Float3 moveV = RotateY(Float3{ 0.0f, 0.0f, move }, angle);
+		m_transforms.SetTranslation(tower, Add(m_transforms.GetTranslation(tower), moveV));
+	}
+}
+
+void GameSimulation::UpdateFollowCamera(float elapsedTime, const SimulationInput& input)
+{
+	// Cキーを押したらフラグを切り替え
+	if (input.toggleCamera)
+	{
+		m_isFPS = !m_isFPS;
+		if (!m_isFPS)
+		{
+			InitializeTPS();
+		}
+	}
+
+	if (m_isFPS)
+	{ // FPSカメラ
+		// 自機の上方0.2ｍの位置にカメラを置く
+		Float3 position = Add(m_targetPos, Float3{ 0.0f, 0.2f, 0.0f });
+		// 自機の後ろに回り込むための回転をした、参照点から視点への差分
+		Float3 cameraV = RotateY(Float3{ 0.0f, 0.0f, -CAMERA_DISTANCE }, m_targetAngle);
+		// ちょっと進んだ位置が視点、がっつり進んだ位置が参照点
+		m_eyePos = Add(position, Scale(cameraV, 0.1f));
+		m_refPos = Add(position, cameraV);
+	}
+	else
+	{ // TPSカメラ
+		// 自機の上方２ｍの位置を捉える
+		Float3 refpos = Add(m_targetPos, Float3{ 0.0f, 2.0f, 0.0f });
+		Float3 cameraV = RotateY(Float3{ 0.0f, 0.0f, CAMERA_DISTANCE }, m_targetAngle);
+		Float3 eyepos = Add(refpos, cameraV);
+		// 視点と参照点を現在位置から補間
+		m_eyePos = Approach(m_eyePos, eyepos, ApproachFactor(EYE_APPROACH_RATE, elapsedTime));
+		m_refPos = Approach(m_refPos, refpos, ApproachFactor(REF_APPROACH_RATE, elapsedTime));
+	}
+}
+
+void GameSimulation::InitializeTPS()
+{
+	// 自機の上方２ｍの位置を捉え、後ろに回り込んだ位置を視点にする
+	m_refPos = Add(m_targetPos, Float3{ 0.0f, 2.0f, 0.0f });
+	m_eyePos = Add(m_refPos, RotateY(Float3{ 0.0f, 0.0f, CAMERA_DISTANCE }, m_targetAngle));
+}
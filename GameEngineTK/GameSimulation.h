@@ -0,0 +1,113 @@
+﻿/// <summary>
+/// 描画やデバイスに依存しないゲームのシミュレーション（自機・球・カメラの計算）
+/// </summary>
+#pragma once
+
+#include <cstdint>
+
+#include "TransformHierarchy.h"
+#include "TransformMath.h"
+
+// 自機のパーツ
+enum PLAYER_PARTS
+{
+	PLAYER_PARTS_TOWER,	// 塔
+	PLAYER_PARTS_BASE,	// 基地
+	PLAYER_PARTS_ENGINE_R,	// 右エンジン
+	PLAYER_PARTS_ENGINE_L,	// 左エンジン
+	PLAYER_PARTS_FAN,	// 換気扇
+	PLAYER_PARTS_SCORE,	// 音符
+
+	PLAYER_PARTS_NUM
+};
+
+// １回の Step に与える入力（キーボードやマウスの代わりに、記録や台本からも作れる）
+struct SimulationInput
+{
+	// 自機の旋回（A / D）
+	bool turnLeft;
+	bool turnRight;
+	// 自機の前後の移動（W / S）
+	bool moveForward;
+	bool moveBackward;
+	// 追従カメラの FPS / TPS の切り替え（C を押した瞬間だけ真）
+	bool toggleCamera;
+	// デバッグカメラのドラッグ（マウスの左ボタンとポインタの座標）
+	bool isDragging;
+	int mouseX;
+	int mouseY;
+	// マウスホイールの値
+	int scrollWheelValue;
+};
+
+// Game::Update の計算をまとめたクラス
+// 自機のパーツは渡された変換の階層のノードとして動かし、階層の Update は呼び出し側で行う
+class GameSimulation
+{
+public:
+	// 球の数
+	static const int BALL_COUNT = 20;
+
+	// parts のノードに親子関係と初期位置を設定する（width, height はデバッグカメラのドラッグの基準）
+	GameSimulation(TransformHierarchy& transforms, const TransformHierarchy::Handle (&parts)[PLAYER_PARTS_NUM],
+		int width, int height);
+
+	// elapsedTime 秒進める
+	void Step(float elapsedTime, const SimulationInput& input);
+
+	// 追従カメラが追う座標と角度を設定
+	void SetCameraTarget(const Float3& position, float angle);
+	// 画面の大きさを設定
+	void SetScreenSize(int width, int height);
+
+	// 球の公転の角度（度）と、直前の Step の前の角度
+	float GetBallAngle() const { return m_ballAngle; }
+	float GetPreviousBallAngle() const { return m_previousBallAngle; }
+	// 追従カメラの視点と参照点
+	const Float3& GetEyePos() const { return m_eyePos; }
+	const Float3& GetRefPos() const { return m_refPos; }
+	// デバッグカメラの視点と上方向（原点を見る）
+	const Float3& GetDebugEyePos() const { return m_debugEyePos; }
+	const Float3& GetDebugUpVec() const { return m_debugUpVec; }
+	// 自機のパーツのノード
+	TransformHierarchy::Handle GetPart(PLAYER_PARTS part) const { return m_parts[part]; }
+
+	// 公転の角度 angle（度）での球のワールド行列を worlds[BALL_COUNT] に計算する
+	static void ComputeBallWorlds(float angle, Float4x4* worlds);
+
+private:
+	// デバッグカメラの更新
+	void UpdateDebugCamera(const SimulationInput& input);
+	// 自機の更新
+	void UpdatePlayer(float elapsedTime, const SimulationInput& input);
+	// 追従カメラの更新（elapsedTime 秒の分だけ目標に近づける）
+	void UpdateFollowCamera(float elapsedTime, const SimulationInput& input);
+	// 追従カメラを自機の後ろに置き直す
+	void InitializeTPS();
+
+	// 変換の階層と自機のパーツ
+	TransformHierarchy& m_transforms;
+	TransformHierarchy::Handle m_parts[PLAYER_PARTS_NUM];
+
+	// 球の公転の角度（度）
+	float m_ballAngle;
+	float m_previousBallAngle;
+	// 自機のギミックに使う角度
+	float m_sinAngle;
+
+	// 追従カメラ
+	Float3 m_targetPos;
+	float m_targetAngle;
+	Float3 m_eyePos;
+	Float3 m_refPos;
+	bool m_isFPS;
+
+	// デバッグカメラ（ドラッグした量で原点の周りを回る）
+	float m_debugXAngle, m_debugXTmp;
+	float m_debugYAngle, m_debugYTmp;
+	int m_dragX, m_dragY;
+	bool m_wasDragging;
+	float m_screenScaleX, m_screenScaleY;
+	Float3 m_debugEyePos;
+	Float3 m_debugUpVec;
+};
@@ -0,0 +1,145 @@
+﻿#include "InputEventQueue.h"
+
+namespace
+{
+	// value 以上で最小の２の累乗
+	size_t RoundUpToPowerOfTwo(size_t value)
+	{
+		size_t result = 1;
+		while (result < value)
+		{
+			result <<= 1;
+		}
+		return result;
+	}
+}
+
+InputEventQueue::InputEventQueue(size_t capacity)
+	: m_events(RoundUpToPowerOfTwo(capacity))
+	, m_writeIndex(0)
+	, m_cachedReadIndex(0)
+	, m_readIndex(0)
+	, m_cachedWriteIndex(0)
+	, m_droppedCount(0)
+{
+}
+
+bool InputEventQueue::Push(const InputEvent& event)
+{
+	const uint64_t write = m_writeIndex.load(std::memory_order_relaxed);
+	if (write - m_cachedReadIndex >= m_events.size())
+	{
+		m_cachedReadIndex = m_readIndex.load(std::memory_order_acquire);
+		if (write - m_cachedReadIndex >= m_events.size())
+		{
+			// 読み出しが追いつくまで捨てる
+			m_droppedCount.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+	}
+	m_events[write & (m_events.size() - 1)] = event;
+	m_writeIndex.store(write + 1, std::memory_order_release);
+	return true;
+}
+
+bool InputEventQueue::Pop(InputEvent& event)
+{
+	const uint64_t read = m_readIndex.load(std::memory_order_relaxed);
+	if (read == m_cachedWriteIndex)
+	{
+		m_cachedWriteIndex = m_writeIndex.load(std::memory_order_acquire);
+		if (read == m_cachedWriteIndex)
+		{
+			return false;
+		}
+	}
+	event = m_events[read & (m_events.size() - 1)];
+	m_readIndex.store(read + 1, std::memory_order_release);
+	return true;
+}
+
+InputState::InputState()
+	: m_snapshot()
+{
+}
+
+const InputSnapshot& InputState::Update(InputEventQueue& queue)
+{
+	BeginFrame();
+	InputEvent event;
+	for (size_t i = 0; i < queue.GetCapacity() && queue.Pop(event); i++)
+	{
+		Apply(event);
+	}
+	return m_snapshot;
+}
+
+void InputState::BeginFrame()
+{
+	m_snapshot.keysPressed.reset();
+	m_snapshot.keysReleased.reset();
+	m_snapshot.buttonsPressed = 0;
+	m_snapshot.buttonsReleased = 0;
+	m_snapshot.wheelDelta = 0;
+	m_snapshot.eventCount = 0;
+	m_snapshot.oldestTimestamp = 0;
+}
+
+void InputState::Apply(const InputEvent& event)
+{
+	if (m_snapshot.eventCount++ == 0)
+	{
+		m_snapshot.oldestTimestamp = event.timestamp;
+	}
+
+	const uint32_t button = event.code < INPUT_MOUSE_BUTTON_NUM ? 1u << event.code : 0;
+	switch (event.type)
+	{
+	case INPUT_EVENT_KEY_DOWN:
+		// 押し続けて繰り返し届いたものは押した瞬間に数えない
+		if (!m_snapshot.keysDown[event.code])
+		{
+			m_snapshot.keysDown.set(event.code);
+			m_snapshot.keysPressed.set(event.code);
+		}
+		break;
+	case INPUT_EVENT_KEY_UP:
+		if (m_snapshot.keysDown[event.code])
+		{
+			m_snapshot.keysDown.reset(event.code);
+			m_snapshot.keysReleased.set(event.code);
+		}
+		break;
+	case INPUT_EVENT_MOUSE_MOVE:
+		m_snapshot.mouseX = event.x;
+		m_snapshot.mouseY = event.y;
+		break;
+	case INPUT_EVENT_BUTTON_DOWN:
+		m_snapshot.mouseX = event.x;
+		m_snapshot.mouseY = event.y;
+		if (!(m_snapshot.buttonsDown & button))
+		{
+			m_snapshot.buttonsDown |= button;
+			m_snapshot.buttonsPressed |= button;
+		}
+		break;
+	case INPUT_EVENT_BUTTON_UP:
+		m_snapshot.mouseX = event.x;
+		m_snapshot.mouseY = event.y;
+		if (m_snapshot.buttonsDown & button)
+		{
+			m_snapshot.buttonsDown &= ~button;
+			m_snapshot.buttonsReleased |= button;
+		}
+		break;
+	case INPUT_EVENT_WHEEL:
+		m_snapshot.wheelDelta += event.wheelDelta;
+		break;
+	case INPUT_EVENT_RELEASE_ALL:
+		m_snapshot.keysReleased |= m_snapshot.keysDown;
+		m_snapshot.keysDown.reset();
+		m_snapshot.buttonsReleased |= m_snapshot.buttonsDown;
+		m_snapshot.buttonsDown = 0;
+		break;
+	}
+}
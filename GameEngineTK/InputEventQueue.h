@@ -0,0 +1,136 @@
+﻿/// <summary>
+/// ウィンドウプロシージャからゲームのスレッドへ、時刻付きの入力イベントをロックせずに渡すキュー
+/// </summary>
+#pragma once
+
+#include <atomic>
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// 入力イベントの種類
+enum INPUT_EVENT_TYPE
+{
+	INPUT_EVENT_KEY_DOWN,	// キーを押した（code は仮想キーコード、押し続けると繰り返し届く）
+	INPUT_EVENT_KEY_UP,	// キーを離した
+	INPUT_EVENT_MOUSE_MOVE,	// ポインタを動かした（x, y はクライアント座標）
+	INPUT_EVENT_BUTTON_DOWN,	// マウスのボタンを押した（code は INPUT_MOUSE_BUTTON、x, y も設定する）
+	INPUT_EVENT_BUTTON_UP,	// マウスのボタンを離した
+	INPUT_EVENT_WHEEL,	// ホイールを回した（wheelDelta に回した量）
+	INPUT_EVENT_RELEASE_ALL,	// フォーカスを失った（全てのキーとボタンを離したことにする）
+};
+
+// マウスのボタン
+enum INPUT_MOUSE_BUTTON
+{
+	INPUT_MOUSE_LEFT,
+	INPUT_MOUSE_RIGHT,
+	INPUT_MOUSE_MIDDLE,
+	INPUT_MOUSE_X1,
+	INPUT_MOUSE_X2,
+
+	INPUT_MOUSE_BUTTON_NUM
+};
+
+// 入力イベント１つ
+struct InputEvent
+{
+	// 発生した時刻（GetDefaultClock のカウント）
+	uint64_t timestamp;
+	// INPUT_EVENT_TYPE
+	uint8_t type;
+	// 仮想キーコードか INPUT_MOUSE_BUTTON
+	uint8_t code;
+	// ポインタの座標
+	int32_t x;
+	int32_t y;
+	// ホイールを回した量
+	int32_t wheelDelta;
+};
+
+// 書き込み１スレッド・読み出し１スレッドの固定長のリングバッファ
+// 満杯のときは待たずに捨てて数える（ウィンドウプロシージャを止めない）
+class InputEventQueue
+{
+public:
+	// 既定の容量（１フレームに届くイベントの数より十分大きくする）
+	static const size_t DEFAULT_CAPACITY = 1024;
+
+	// capacity は２の累乗に切り上げる
+	explicit InputEventQueue(size_t capacity = DEFAULT_CAPACITY);
+
+	// 書き込み側のスレッドから呼ぶ（満杯なら捨てて false を返す）
+	bool Push(const InputEvent& event);
+	// 読み出し側のスレッドから呼ぶ（空なら false を返す）
+	bool Pop(InputEvent& event);
+	// 捨てたイベントの数を取得して 0 に戻す
+	uint64_t TakeDroppedCount() { return m_droppedCount.exchange(0, std::memory_order_relaxed); }
+
+	size_t GetCapacity() const { return m_events.size(); }
+
+private:
+	InputEventQueue(const InputEventQueue&) = delete;
+	InputEventQueue& operator=(const InputEventQueue&) = delete;
+
+	std::vector<InputEvent> m_events;
+	// 書き込み側が進める（読み出し位置は満杯に見えたときだけ読み直す）
+	std::atomic<uint64_t> m_writeIndex;
+	uint64_t m_cachedReadIndex;
+	// 同じキャッシュラインに載せない
+	char m_writePadding[64];
+	// 読み出し側が進める（書き込み位置は空に見えたときだけ読み直す）
+	std::atomic<uint64_t> m_readIndex;
+	uint64_t m_cachedWriteIndex;
+	char m_readPadding[64];
+	std::atomic<uint64_t> m_droppedCount;
+};
+
+// １フレーム分の入力（キューを１回読み出して作り、そのフレームの全ての利用者が同じものを読む）
+struct InputSnapshot
+{
+	// 押しているキーと、このフレームの間に押した・離したキー（押してすぐ離しても両方残る）
+	std::bitset<256> keysDown;
+	std::bitset<256> keysPressed;
+	std::bitset<256> keysReleased;
+	// マウスのボタン（INPUT_MOUSE_BUTTON のビット）
+	uint32_t buttonsDown;
+	uint32_t buttonsPressed;
+	uint32_t buttonsReleased;
+	// ポインタの座標
+	int32_t mouseX;
+	int32_t mouseY;
+	// このフレームの間にホイールを回した量
+	int32_t wheelDelta;
+	// このフレームで適用したイベントの数と、最も古いイベントの時刻（無ければ 0）
+	uint32_t eventCount;
+	uint64_t oldestTimestamp;
+
+	bool IsKeyDown(uint8_t key) const { return keysDown[key]; }
+	bool IsKeyPressed(uint8_t key) const { return keysPressed[key]; }
+	bool IsKeyReleased(uint8_t key) const { return keysReleased[key]; }
+	// 押しているか、このフレームの間に押した（短く叩いたキーも１フレームは押したことにする）
+	bool IsKeyActive(uint8_t key) const { return keysDown[key] || keysPressed[key]; }
+	bool IsButtonDown(INPUT_MOUSE_BUTTON button) const { return (buttonsDown & (1u << button)) != 0; }
+	bool IsButtonPressed(INPUT_MOUSE_BUTTON button) const { return (buttonsPressed & (1u << button)) != 0; }
+};
+
+// イベントを順に適用して InputSnapshot を作る
+class InputState
+{
+public:
+	InputState();
+
+	// 前のフレームの押した・離したを消して、キューに溜まったイベントを全て適用する
+	// 書き込みが止まらなくても終わるように、１回に読むのはキューの容量まで
+	const InputSnapshot& Update(InputEventQueue& queue);
+	// 前のフレームの押した・離したを消す（Apply で組み立てるとき）
+	void BeginFrame();
+	// イベントを１つ適用
+	void Apply(const InputEvent& event);
+
+	const InputSnapshot& GetSnapshot() const { return m_snapshot; }
+
+private:
+	InputSnapshot m_snapshot;
+};
@@ -0,0 +1,271 @@
+﻿#include "InputRecording.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "FileSystem.h"
+
+namespace
+{
+	// ファイルヘッダー
+	struct InputRecordingHeader
+	{
+		uint32_t magic;
+		uint16_t version;
+		uint16_t flags;
+		uint64_t targetElapsedTicks;
+		uint32_t maxUpdatesPerTick;
+		int32_t screenWidth;
+		int32_t screenHeight;
+		uint32_t frameCount;
+		uint32_t stepCount;
+		uint32_t reserved;
+	};
+
+	// ヘッダーのフラグ
+	enum InputRecordingFlags
+	{
+		INPUT_RECORDING_FLAG_FIXED_TIME_STEP = 0x0001,
+	};
+
+	// ステップの入力の先頭のバイト
+	enum InputStepFlags
+	{
+		INPUT_STEP_TURN_LEFT = 0x01,
+		INPUT_STEP_TURN_RIGHT = 0x02,
+		INPUT_STEP_MOVE_FORWARD = 0x04,
+		INPUT_STEP_MOVE_BACKWARD = 0x08,
+		INPUT_STEP_TOGGLE_CAMERA = 0x10,
+		INPUT_STEP_DRAGGING = 0x20,
+		// 続けてマウスの座標の差、ホイールの差を書く
+		INPUT_STEP_MOUSE_MOVED = 0x40,
+		INPUT_STEP_WHEEL_MOVED = 0x80,
+	};
+
+	// 可変長の数値の最大のバイト数
+	const int MAX_VARINT_SIZE = 10;
+
+	void WriteVarint(std::vector<uint8_t>& data, uint64_t value)
+	{
+		while (value >= 0x80)
+		{
+			data.push_back(static_cast<uint8_t>(value | 0x80));
+			value >>= 7;
+		}
+		data.push_back(static_cast<uint8_t>(value));
+	}
+
+	bool ReadVarint(const uint8_t*& p, const uint8_t* end, uint64_t& value)
+	{
+		value = 0;
+		for (int i = 0; i < MAX_VARINT_SIZE && p < end; i++)
+		{
+			const uint8_t byte = *p++;
+			value |= static_cast<uint64_t>(byte & 0x7F) << (7 * i);
+			if (!(byte & 0x80))
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// 符号付きの差は絶対値が小さいほど短くなるように並べ替える
+	void WriteSigned(std::vector<uint8_t>& data, int64_t value)
+	{
+		WriteVarint(data, (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+	}
+
+	bool ReadSigned(const uint8_t*& p, const uint8_t* end, int64_t& value)
+	{
+		uint64_t encoded;
+		if (!ReadVarint(p, end, encoded))
+		{
+			return false;
+		}
+		value = static_cast<int64_t>(encoded >> 1) ^ -static_cast<int64_t>(encoded & 1);
+		return true;
+	}
+}
+
+InputRecording::InputRecording()
+	: m_settings()
+{
+}
+
+void InputRecording::Reset(const InputRecordingSettings& settings)
+{
+	m_settings = settings;
+	m_frames.clear();
+	m_steps.clear();
+}
+
+void InputRecording::AddFrame(uint64_t tickDelta, uint32_t stepCount)
+{
+	InputRecordingFrame frame;
+	frame.tickDelta = tickDelta;
+	frame.stepCount = stepCount;
+	m_frames.push_back(frame);
+}
+
+void InputRecording::Encode(std::vector<uint8_t>& data) const
+{
+	// フレームに入っているステップだけ書く
+	size_t stepCount = 0;
+	size_t frameCount = 0;
+	for (const InputRecordingFrame& frame : m_frames)
+	{
+		if (stepCount + frame.stepCount > m_steps.size())
+		{
+			break;
+		}
+		stepCount += frame.stepCount;
+		frameCount++;
+	}
+
+	InputRecordingHeader header = {};
+	header.magic = INPUT_RECORDING_MAGIC;
+	header.version = INPUT_RECORDING_VERSION;
+	header.flags = m_settings.isFixedTimeStep ? INPUT_RECORDING_FLAG_FIXED_TIME_STEP : 0;
+	header.targetElapsedTicks = m_settings.targetElapsedTicks;
+	header.maxUpdatesPerTick = m_settings.maxUpdatesPerTick;
+	header.screenWidth = m_settings.screenWidth;
+	header.screenHeight = m_settings.screenHeight;
+	header.frameCount = static_cast<uint32_t>(frameCount);
+	header.stepCount = static_cast<uint32_t>(stepCount);
+
+	data.resize(sizeof(header));
+	std::memcpy(data.data(), &header, sizeof(header));
+	// 殆どのステップはボタンの 1 バイトだけになる
+	data.reserve(sizeof(header) + frameCount * 2 + stepCount);
+
+	SimulationInput previous = {};
+	const SimulationInput* step = m_steps.data();
+	for (size_t i = 0; i < frameCount; i++)
+	{
+		WriteVarint(data, m_frames[i].tickDelta);
+		WriteVarint(data, m_frames[i].stepCount);
+		for (uint32_t j = 0; j < m_frames[i].stepCount; j++, step++)
+		{
+			const bool isMouseMoved = step->mouseX != previous.mouseX || step->mouseY != previous.mouseY;
+			const bool isWheelMoved = step->scrollWheelValue != previous.scrollWheelValue;
+			data.push_back(static_cast<uint8_t>(
+				(step->turnLeft ? INPUT_STEP_TURN_LEFT : 0) |
+				(step->turnRight ? INPUT_STEP_TURN_RIGHT : 0) |
+				(step->moveForward ? INPUT_STEP_MOVE_FORWARD : 0) |
+				(step->moveBackward ? INPUT_STEP_MOVE_BACKWARD : 0) |
+				(step->toggleCamera ? INPUT_STEP_TOGGLE_CAMERA : 0) |
+				(step->isDragging ? INPUT_STEP_DRAGGING : 0) |
+				(isMouseMoved ? INPUT_STEP_MOUSE_MOVED : 0) |
+				(isWheelMoved ? INPUT_STEP_WHEEL_MOVED : 0)));
+			if (isMouseMoved)
+			{
+				WriteSigned(data, static_cast<int64_t>(step->mouseX) - previous.mouseX);
+				WriteSigned(data, static_cast<int64_t>(step->mouseY) - previous.mouseY);
+			}
+			if (isWheelMoved)
+			{
+				WriteSigned(data, static_cast<int64_t>(step->scrollWheelValue) - previous.scrollWheelValue);
+			}
+			previous = *step;
+		}
+	}
+}
+
+bool InputRecording::Decode(const uint8_t* data, size_t size)
+{
+	InputRecordingHeader header;
+	if (size < sizeof(header))
+	{
+		return false;
+	}
+	std::memcpy(&header, data, sizeof(header));
+	if (header.magic != INPUT_RECORDING_MAGIC || header.version != INPUT_RECORDING_VERSION)
+	{
+		return false;
+	}
+
+	InputRecordingSettings settings;
+	settings.isFixedTimeStep = (header.flags & INPUT_RECORDING_FLAG_FIXED_TIME_STEP) != 0;
+	settings.targetElapsedTicks = header.targetElapsedTicks;
+	settings.maxUpdatesPerTick = header.maxUpdatesPerTick;
+	settings.screenWidth = header.screenWidth;
+	settings.screenHeight = header.screenHeight;
+
+	const uint8_t* p = data + sizeof(header);
+	const uint8_t* end = data + size;
+	std::vector<InputRecordingFrame> frames;
+	std::vector<SimulationInput> steps;
+	// 壊れたヘッダーで大きく確保しないように、残りのバイト数を上限にする
+	frames.reserve(std::min<size_t>(header.frameCount, end - p));
+	steps.reserve(std::min<size_t>(header.stepCount, end - p));
+	SimulationInput previous = {};
+	for (uint32_t i = 0; i < header.frameCount; i++)
+	{
+		uint64_t tickDelta;
+		uint64_t stepCount;
+		if (!ReadVarint(p, end, tickDelta) || !ReadVarint(p, end, stepCount)
+			|| stepCount > header.stepCount - steps.size())
+		{
+			return false;
+		}
+		InputRecordingFrame frame;
+		frame.tickDelta = tickDelta;
+		frame.stepCount = static_cast<uint32_t>(stepCount);
+		frames.push_back(frame);
+
+		for (uint64_t j = 0; j < stepCount; j++)
+		{
+			if (p >= end)
+			{
+				return false;
+			}
+			const uint8_t flags = *p++;
+			SimulationInput step = previous;
+			step.turnLeft = (flags & INPUT_STEP_TURN_LEFT) != 0;
+			step.turnRight = (flags & INPUT_STEP_TURN_RIGHT) != 0;
+			step.moveForward = (flags & INPUT_STEP_MOVE_FORWARD) != 0;
+			step.moveBackward = (flags & INPUT_STEP_MOVE_BACKWARD) != 0;
+			step.toggleCamera = (flags & INPUT_STEP_TOGGLE_CAMERA) != 0;
+			step.isDragging = (flags & INPUT_STEP_DRAGGING) != 0;
+			int64_t dx = 0;
+			int64_t dy = 0;
+			int64_t dw = 0;
+			if ((flags & INPUT_STEP_MOUSE_MOVED) && !(ReadSigned(p, end, dx) && ReadSigned(p, end, dy)))
+			{
+				return false;
+			}
+			if ((flags & INPUT_STEP_WHEEL_MOVED) && !ReadSigned(p, end, dw))
+			{
+				return false;
+			}
+			step.mouseX = static_cast<int>(previous.mouseX + dx);
+			step.mouseY = static_cast<int>(previous.mouseY + dy);
+			step.scrollWheelValue = static_cast<int>(previous.scrollWheelValue + dw);
+			steps.push_back(step);
+			previous = step;
+		}
+	}
+	if (p != end || steps.size() != header.stepCount)
+	{
+		return false;
+	}
+
+	m_settings = settings;
+	m_frames.swap(frames);
+	m_steps.swap(steps);
+	return true;
+}
+
+bool InputRecording::Save(const std::wstring& path) const
+{
+	std::vector<uint8_t> data;
+	Encode(data);
+	return WriteWholeFile(path, data.data(), data.size());
+}
+
+bool InputRecording::Load(const std::wstring& path)
+{
+	std::vector<uint8_t> data;
+	return ReadWholeFile(path, data) && Decode(data.data(), data.size());
+}
@@ -0,0 +1,71 @@
+﻿/// <summary>
+/// シミュレーションの入力とタイマーの進み方の記録（再生すると同じステップと同じフレームを再現する）
+/// </summary>
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "GameSimulation.h"
+
+// ファイルはヘッダーに続けて、フレームごとに「進めた時間・ステップ数・各ステップの入力」を並べる
+// 数値は可変長（7bit ずつ）で、入力はボタンを 1 バイトにまとめ、マウスは前のステップからの差だけ書く
+
+// 識別子 "TKIR"
+const uint32_t INPUT_RECORDING_MAGIC = 0x52494B54;
+// 形式のバージョン（構造を変えたら上げる）
+const uint16_t INPUT_RECORDING_VERSION = 1;
+
+// 記録したときのタイマーとシミュレーションの設定（再生するときに同じにする）
+struct InputRecordingSettings
+{
+	bool isFixedTimeStep;
+	// 固定の間隔（StepTimer の単位）と、１フレームで進める最大のステップ数
+	uint64_t targetElapsedTicks;
+	uint32_t maxUpdatesPerTick;
+	// シミュレーションに渡した画面の大きさ（デバッグカメラのドラッグの基準）
+	int32_t screenWidth;
+	int32_t screenHeight;
+};
+
+// １フレーム分
+struct InputRecordingFrame
+{
+	// タイマーが進めた時間（StepTimer の単位）
+	uint64_t tickDelta;
+	// このフレームで進めたステップ数
+	uint32_t stepCount;
+};
+
+// 記録した入力（ステップの入力はフレームの順に続けて並ぶ）
+class InputRecording
+{
+public:
+	InputRecording();
+
+	// 全て消して設定を入れ直す
+	void Reset(const InputRecordingSettings& settings);
+	// ステップの入力を追加し、フレームの終わりにそのフレームのステップ数と一緒に時間を追加する
+	void AddStep(const SimulationInput& input) { m_steps.push_back(input); }
+	void AddFrame(uint64_t tickDelta, uint32_t stepCount);
+
+	const InputRecordingSettings& GetSettings() const { return m_settings; }
+	const std::vector<InputRecordingFrame>& GetFrames() const { return m_frames; }
+	const std::vector<SimulationInput>& GetSteps() const { return m_steps; }
+
+	// バイト列に変換する（どのフレームにも入っていない最後のステップは書かない）
+	void Encode(std::vector<uint8_t>& data) const;
+	// バイト列から復元する（形式が違えば false）
+	bool Decode(const uint8_t* data, size_t size);
+
+	// ファイルに書き出す・読み込む（失敗したら false）
+	bool Save(const std::wstring& path) const;
+	bool Load(const std::wstring& path);
+
+private:
+	InputRecordingSettings m_settings;
+	std::vector<InputRecordingFrame> m_frames;
+	std::vector<SimulationInput> m_steps;
+};
@@ -0,0 +1,55 @@
+﻿#include "InstanceBatcher.h"
+
+InstanceBatcher::InstanceBatcher()
+{
+	Clear();
+}
+
+void InstanceBatcher::Clear()
+{
+	m_batchIndices = ArenaHashMap<Key, uint32_t, KeyHash>(FrameArena::GetThreadArena());
+	m_entries.clear();
+	m_batches.clear();
+	m_instances.clear();
+}
+
+void InstanceBatcher::Add(const void* model, const void* material, const Float4x4& world)
+{
+	// 組の番号は追加した時に決めておく
+	Key key = { model, material };
+	auto result = m_batchIndices.emplace(key, static_cast<uint32_t>(m_batches.size()));
+	if (result.second)
+	{
+		Batch batch = { model, material, 0, 0 };
+		m_batches.push_back(batch);
+	}
+
+	const uint32_t index = *result.first;
+	m_batches[index].instanceCount++;
+
+	Entry entry = { index, world };
+	m_entries.push_back(entry);
+}
+
+void InstanceBatcher::Build()
+{
+	// 個数の累積から各組の先頭を求める
+	uint32_t offset = 0;
+	for (Batch& batch : m_batches)
+	{
+		batch.firstInstance = offset;
+		offset += batch.instanceCount;
+	}
+
+	// 組の中では追加された順に並べる
+	m_instances.resize(m_entries.size());
+	m_cursors.resize(m_batches.size());
+	for (size_t i = 0; i < m_batches.size(); i++)
+	{
+		m_cursors[i] = m_batches[i].firstInstance;
+	}
+	for (const Entry& entry : m_entries)
+	{
+		m_instances[m_cursors[entry.batch]++] = entry.world;
+	}
+}
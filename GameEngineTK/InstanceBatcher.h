@@ -0,0 +1,87 @@
+﻿/// <summary>
+/// 同じモデルのワールド行列を集めてインスタンス描画用にまとめるクラス
+/// </summary>
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "FrameArena.h"
+#include "TransformMath.h"
+
+// フレーム中に Add でモデルとマテリアルの組ごとにワールド行列を集め、
+// Build で組ごとに連続した配列に並べ直す（組の順番は最初に追加された順）
+// モデルやマテリアルの中身には触れないので、どんな型のポインタでもキーにできる
+class InstanceBatcher
+{
+public:
+	// 同じモデル・マテリアルのインスタンスのまとまり
+	struct Batch
+	{
+		const void* model;
+		const void* material;
+		// GetInstances() 内の先頭
+		uint32_t firstInstance;
+		uint32_t instanceCount;
+	};
+
+	InstanceBatcher();
+
+	// 集めたものを全て捨てる（確保したメモリは再利用する）
+	// 組の検索表は呼び出し元のスレッドのフレーム用アリーナに置くので、毎フレーム Add の前に呼ぶ
+	void Clear();
+	// インスタンスを１つ追加
+	void Add(const void* model, const void* material, const Float4x4& world);
+	// 組ごとに並べ直す
+	void Build();
+
+	// Build した結果
+	const std::vector<Batch>& GetBatches() const { return m_batches; }
+	const Float4x4* GetInstances() const { return m_instances.data(); }
+	// 追加されたインスタンスの数
+	size_t GetInstanceCount() const { return m_entries.size(); }
+	// １つずつ描画した場合と比べて減った描画の数（パーツが１つの場合）
+	size_t GetDrawsSaved() const { return m_entries.size() - m_batches.size(); }
+
+private:
+	// 組のキー
+	struct Key
+	{
+		const void* model;
+		const void* material;
+
+		bool operator==(const Key& other) const
+		{
+			return model == other.model && material == other.material;
+		}
+	};
+
+	struct KeyHash
+	{
+		size_t operator()(const Key& key) const
+		{
+			size_t a = reinterpret_cast<size_t>(key.model);
+			size_t b = reinterpret_cast<size_t>(key.material);
+			return a ^ (b + 0x9E3779B9 + (a << 6) + (a >> 2));
+		}
+	};
+
+	// 追加されたインスタンス
+	struct Entry
+	{
+		uint32_t batch;
+		Float4x4 world;
+	};
+
+	// キーから組の番号へ
+	ArenaHashMap<Key, uint32_t, KeyHash> m_batchIndices;
+	// 追加された順のインスタンス
+	std::vector<Entry> m_entries;
+	// 組
+	std::vector<Batch> m_batches;
+	// 組ごとに並べたワールド行列
+	std::vector<Float4x4> m_instances;
+	// Build で各組の次の書き込み位置
+	std::vector<uint32_t> m_cursors;
+};
@@ -0,0 +1,505 @@
+﻿#include "InstancedRenderer.h"
+
+#include <cstring>
+#include <cwctype>
+#include <iterator>
+#include <stdexcept>
+#include <d3dcompiler.h>
+
+#include "CmoReader.h"
+#include "FileSystem.h"
+#include "Profiler.h"
+#include "TkmReader.h"
+
+using namespace DirectX;
+using namespace DirectX::SimpleMath;
+using Microsoft::WRL::ComPtr;
+
+namespace
+{
+	// インスタンスごとのワールド行列を頂点データの WORLD0～3 として受け取り、
+	// BasicEffect の既定のライティング（平行光源３つ）と同じ計算をピクセル単位で行う
+	const char SHADER_SOURCE[] = R"(
+cbuffer Parameters : register(b0)
+{
+	float4x4 ViewProjection;
+	float4 DiffuseColor;
+	float4 EmissiveColor;
+	float4 SpecularColorAndPower;
+	float4 EyePositionAndTexture;
+	float4 LightDirection[3];
+	float4 LightDiffuseColor[3];
+	float4 LightSpecularColor[3];
+};
+
+Texture2D Texture : register(t0);
+SamplerState Sampler : register(s0);
+
+struct VSInput
+{
+	float4 Position : SV_Position;
+	float3 Normal : NORMAL;
+	float4 Color : COLOR;
+	float2 TexCoord : TEXCOORD0;
+	float4 World0 : WORLD0;
+	float4 World1 : WORLD1;
+	float4 World2 : WORLD2;
+	float4 World3 : WORLD3;
+};
+
+struct VSOutput
+{
+	float4 Position : SV_Position;
+	float4 Color : COLOR;
+	float2 TexCoord : TEXCOORD0;
+	float3 WorldPosition : TEXCOORD1;
+	float3 Normal : TEXCOORD2;
+};
+
+VSOutput VSMain(VSInput input)
+{
+	float4x4 world = float4x4(input.World0, input.World1, input.World2, input.World3);
+	float4 worldPosition = mul(input.Position, world);
+
+	VSOutput output;
+	output.Position = mul(worldPosition, ViewProjection);
+	output.Color = input.Color;
+	output.TexCoord = input.TexCoord;
+	output.WorldPosition = worldPosition.xyz;
+	output.Normal = mul(input.Normal, (float3x3)world);
+	return output;
+}
+
+float4 PSMain(VSOutput input) : SV_Target
+{
+	float3 normal = normalize(input.Normal);
+	float3 toEye = normalize(EyePositionAndTexture.xyz - input.WorldPosition);
+
+	float3 diffuse = 0;
+	float3 specular = 0;
+	[unroll]
+	for (int i = 0; i < 3; i++)
+	{
+		float3 toLight = -LightDirection[i].xyz;
+		float dotL = dot(normal, toLight);
+		float dotH = dot(normal, normalize(toEye + toLight));
+		float zeroL = step(0, dotL);
+		diffuse += LightDiffuseColor[i].rgb * (zeroL * dotL);
+		specular += LightSpecularColor[i].rgb * (pow(max(dotH, 0), SpecularColorAndPower.w) * zeroL);
+	}
+
+	float4 color = input.Color * float4(diffuse * DiffuseColor.rgb + EmissiveColor.rgb, DiffuseColor.a);
+	if (EyePositionAndTexture.w > 0)
+	{
+		color *= Texture.Sample(Sampler, input.TexCoord);
+	}
+	color.rgb += specular * SpecularColorAndPower.rgb * color.a;
+	return color;
+}
+)";
+
+	// 定数バッファ（シェーダーの Parameters と同じ配置）
+	struct Constants
+	{
+		float viewProjection[16];
+		float diffuseColor[4];
+		float emissiveColor[4];
+		float specularColorAndPower[4];
+		float eyePositionAndTexture[4];
+		float lightDirection[3][4];
+		float lightDiffuseColor[3][4];
+		float lightSpecularColor[3][4];
+	};
+	static_assert(sizeof(Constants) % 16 == 0, "constant buffer size must be a multiple of 16");
+
+	// BasicEffect::EnableDefaultLighting と同じ光源
+	const float LIGHT_DIRECTIONS[3][3] =
+	{
+		{ -0.5265408f, -0.5735765f, -0.6275069f },
+		{ 0.7198464f, 0.3420201f, 0.6040227f },
+		{ 0.4545195f, -0.7660444f, 0.4545195f },
+	};
+	const float LIGHT_DIFFUSE_COLORS[3][3] =
+	{
+		{ 1.0000000f, 0.9607844f, 0.8078432f },
+		{ 0.9647059f, 0.7607844f, 0.4078432f },
+		{ 0.3231373f, 0.3607844f, 0.3937255f },
+	};
+	const float LIGHT_SPECULAR_COLORS[3][3] =
+	{
+		{ 1.0000000f, 0.9607844f, 0.8078432f },
+		{ 0.0000000f, 0.0000000f, 0.0000000f },
+		{ 0.3231373f, 0.3607844f, 0.3937255f },
+	};
+
+	// インスタンスごとのワールド行列（頂点宣言の後ろに足す）
+	const D3D11_INPUT_ELEMENT_DESC INSTANCE_ELEMENTS[] =
+	{
+		{ "WORLD", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 0, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+		{ "WORLD", 1, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 16, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+		{ "WORLD", 2, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 32, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+		{ "WORLD", 3, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 48, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+	};
+
+	// 失敗したら例外を投げる
+	void ThrowIfFailed(HRESULT hr, const char* message)
+	{
+		if (FAILED(hr))
+		{
+			throw std::runtime_error(message);
+		}
+	}
+
+	// シェーダーをコンパイル
+	ComPtr<ID3DBlob> CompileShader(const char* entryPoint, const char* target)
+	{
+		ComPtr<ID3DBlob> code;
+		ComPtr<ID3DBlob> errors;
+		HRESULT hr = D3DCompile(SHADER_SOURCE, sizeof(SHADER_SOURCE) - 1, "InstancedRenderer", nullptr, nullptr,
+			entryPoint, target, D3DCOMPILE_ENABLE_STRICTNESS | D3DCOMPILE_OPTIMIZATION_LEVEL3, 0,
+			code.GetAddressOf(), errors.GetAddressOf());
+		if (FAILED(hr))
+		{
+			std::string message = "shader compilation failed";
+			if (errors)
+			{
+				message += ": ";
+				message += static_cast<const char*>(errors->GetBufferPointer());
+			}
+			throw std::runtime_error(message);
+		}
+		return code;
+	}
+
+	// マテリアルの色を設定
+	void SetMaterialColors(InstancedRenderer::Material& material, const float diffuse[4], const float ambient[3],
+		const float specular[3], float specularPower, const float emissive[3])
+	{
+		material.diffuse = Vector4(diffuse[0], diffuse[1], diffuse[2], diffuse[3]);
+		material.ambient = Vector3(ambient);
+		material.specular = Vector3(specular);
+		material.specularPower = specularPower;
+		material.emissive = Vector3(emissive);
+	}
+
+	// テクスチャを読み込む（名前が空なら何もしない）
+	ComPtr<ID3D11ShaderResourceView> LoadTexture(IEffectFactory& factory, const std::wstring& name)
+	{
+		ComPtr<ID3D11ShaderResourceView> texture;
+		if (!name.empty())
+		{
+			factory.CreateTexture(name.c_str(), nullptr, texture.GetAddressOf());
+		}
+		return texture;
+	}
+
+	// CMO のパーツごとのマテリアル（Model::CreateFromCMO と同じ順）
+	void LoadCmoMaterials(const std::wstring& fileName, IEffectFactory& factory, std::vector<InstancedRenderer::Material>& materials)
+	{
+		CmoReader reader;
+		if (!reader.Open(fileName))
+		{
+			throw std::runtime_error(ToUtf8(fileName) + ": " + reader.GetError());
+		}
+
+		// マテリアルの無いメッシュの既定値
+		const float defaultDiffuse[4] = { 0.8f, 0.8f, 0.8f, 1.0f };
+		const float defaultAmbient[3] = { 0.2f, 0.2f, 0.2f };
+		const float zero[3] = { 0.0f, 0.0f, 0.0f };
+
+		for (const CmoMesh& mesh : reader.GetMeshes())
+		{
+			for (uint32_t i = 0; i < mesh.submeshes.count; i++)
+			{
+				InstancedRenderer::Material material;
+				const CmoSubMesh submesh = mesh.submeshes.Get(i);
+				if (mesh.materials.empty())
+				{
+					SetMaterialColors(material, defaultDiffuse, defaultAmbient, zero, 1.0f, zero);
+				}
+				else
+				{
+					const CmoMaterialInfo& info = mesh.materials[submesh.materialIndex];
+					SetMaterialColors(material, info.material.diffuse, info.material.ambient,
+						info.material.specular, info.material.specularPower, info.material.emissive);
+					material.texture = LoadTexture(factory, info.textures[0].ToWString());
+				}
+				materials.push_back(material);
+			}
+		}
+	}
+
+	// TKM のパーツごとのマテリアル
+	void LoadTkmMaterials(const std::wstring& fileName, IEffectFactory& factory, std::vector<InstancedRenderer::Material>& materials)
+	{
+		TkmReader reader;
+		if (!reader.Open(fileName))
+		{
+			throw std::runtime_error(ToUtf8(fileName) + ": " + reader.GetError());
+		}
+
+		const TkmHeader& header = reader.GetHeader();
+		for (uint32_t m = 0; m < header.meshCount; m++)
+		{
+			const TkmMesh& mesh = reader.GetMeshes()[m];
+			for (uint32_t p = 0; p < mesh.partCount; p++)
+			{
+				const TkmPart& part = reader.GetParts()[mesh.firstPart + p];
+				const TkmMaterial& info = reader.GetMaterials()[part.materialIndex];
+
+				InstancedRenderer::Material material;
+				SetMaterialColors(material, info.diffuse, info.ambient, info.specular, info.specularPower, info.emissive);
+				material.texture = LoadTexture(factory, reader.GetString(info.texture));
+				materials.push_back(material);
+			}
+		}
+	}
+
+	// 拡張子が .tkm か
+	bool IsTkmFile(const std::wstring& fileName)
+	{
+		if (fileName.size() < 4)
+		{
+			return false;
+		}
+		std::wstring extension = fileName.substr(fileName.size() - 4);
+		for (wchar_t& c : extension)
+		{
+			c = static_cast<wchar_t>(towlower(c));
+		}
+		return extension == L".tkm";
+	}
+
+	// ４成分に詰める
+	void Store(float destination[4], const Vector3& v, float w)
+	{
+		destination[0] = v.x;
+		destination[1] = v.y;
+		destination[2] = v.z;
+		destination[3] = w;
+	}
+}
+
+InstancedRenderer::InstancedRenderer(ID3D11Device* device)
+	: m_device(device)
+	, m_instanceCapacity(0)
+	, m_currentMaterial(nullptr)
+{
+	// シェーダーは実行時にコンパイルする
+	ComPtr<ID3DBlob> vertexShader = CompileShader("VSMain", "vs_4_0");
+	ComPtr<ID3DBlob> pixelShader = CompileShader("PSMain", "ps_4_0");
+	ThrowIfFailed(device->CreateVertexShader(vertexShader->GetBufferPointer(), vertexShader->GetBufferSize(),
+		nullptr, m_vertexShader.GetAddressOf()), "CreateVertexShader failed");
+	ThrowIfFailed(device->CreatePixelShader(pixelShader->GetBufferPointer(), pixelShader->GetBufferSize(),
+		nullptr, m_pixelShader.GetAddressOf()), "CreatePixelShader failed");
+	const uint8_t* code = static_cast<const uint8_t*>(vertexShader->GetBufferPointer());
+	m_vertexShaderCode.assign(code, code + vertexShader->GetBufferSize());
+
+	D3D11_BUFFER_DESC desc = {};
+	desc.ByteWidth = sizeof(Constants);
+	desc.Usage = D3D11_USAGE_DYNAMIC;
+	desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	ThrowIfFailed(device->CreateBuffer(&desc, nullptr, m_constantBuffer.GetAddressOf()), "CreateBuffer failed");
+
+	m_statistics = Statistics();
+}
+
+void InstancedRenderer::RegisterModel(const Model* model, const std::wstring& fileName, IEffectFactory& factory)
+{
+	std::vector<Material> materials;
+	if (IsTkmFile(fileName))
+	{
+		LoadTkmMaterials(fileName, factory, materials);
+	}
+	else
+	{
+		LoadCmoMaterials(fileName, factory, materials);
+	}
+
+	// ファイルとモデルのパーツ数が一致するか確かめる
+	size_t partCount = 0;
+	for (const auto& mesh : model->meshes)
+	{
+		partCount += mesh->meshParts.size();
+	}
+	if (partCount != materials.size())
+	{
+		throw std::runtime_error(ToUtf8(fileName) + ": part count does not match the model");
+	}
+
+	m_modelMaterials[model] = std::move(materials);
+}
+
+void InstancedRenderer::Draw(ID3D11DeviceContext* context, const CommonStates& states, const InstanceBatcher& batcher,
+	const Matrix& view, const Matrix& proj)
+{
+	PROFILE_SCOPE("InstancedRenderer::Draw");
+	m_statistics = Statistics();
+	const std::vector<InstanceBatcher::Batch>& batches = batcher.GetBatches();
+	if (batches.empty())
+	{
+		return;
+	}
+
+	// 全てのインスタンスのワールド行列を一度に書き込む
+	const size_t instanceCount = batcher.GetInstanceCount();
+	ReserveInstances(instanceCount);
+	D3D11_MAPPED_SUBRESOURCE mapped;
+	ThrowIfFailed(context->Map(m_instanceBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped), "Map failed");
+	std::memcpy(mapped.pData, batcher.GetInstances(), instanceCount * sizeof(Float4x4));
+	context->Unmap(m_instanceBuffer.Get(), 0);
+
+	m_viewProjection = view * proj;
+	m_eyePosition = view.Invert().Translation();
+	m_currentMaterial = nullptr;
+
+	// フレームで変わらない状態はまとめて設定する
+	context->VSSetShader(m_vertexShader.Get(), nullptr, 0);
+	context->PSSetShader(m_pixelShader.Get(), nullptr, 0);
+	context->VSSetConstantBuffers(0, 1, m_constantBuffer.GetAddressOf());
+	context->PSSetConstantBuffers(0, 1, m_constantBuffer.GetAddressOf());
+	ID3D11SamplerState* sampler = states.LinearWrap();
+	context->PSSetSamplers(0, 1, &sampler);
+	context->OMSetDepthStencilState(states.DepthDefault(), 0);
+	context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+
+	// 不透明なパーツを先に、半透明なパーツを後に描画
+	for (int pass = 0; pass < 2; pass++)
+	{
+		context->OMSetBlendState(pass == 0 ? states.Opaque() : states.AlphaBlend(), nullptr, 0xFFFFFFFF);
+		for (const InstanceBatcher::Batch& batch : batches)
+		{
+			DrawBatch(context, states, batch, pass == 1);
+		}
+	}
+	m_statistics.instances = static_cast<uint32_t>(instanceCount);
+}
+
+void InstancedRenderer::DrawBatch(ID3D11DeviceContext* context, const CommonStates& states,
+	const InstanceBatcher::Batch& batch, bool isAlpha)
+{
+	const Model* model = static_cast<const Model*>(batch.model);
+	const Material* overrideMaterial = static_cast<const Material*>(batch.material);
+	auto found = m_modelMaterials.find(model);
+	if (found == m_modelMaterials.end())
+	{
+		throw std::logic_error("InstancedRenderer: model is not registered");
+	}
+	const std::vector<Material>& materials = found->second;
+
+	ID3D11Buffer* instanceBuffer = m_instanceBuffer.Get();
+	const UINT instanceStride = sizeof(Float4x4);
+	const UINT instanceOffset = 0;
+	context->IASetVertexBuffers(1, 1, &instanceBuffer, &instanceStride, &instanceOffset);
+
+	size_t partIndex = 0;
+	for (const auto& mesh : model->meshes)
+	{
+		context->RSSetState(mesh->ccw ? states.CullCounterClockwise() : states.CullClockwise());
+		for (const auto& part : mesh->meshParts)
+		{
+			const Material& material = overrideMaterial ? *overrideMaterial : materials[partIndex];
+			partIndex++;
+			if (part->isAlpha != isAlpha)
+			{
+				continue;
+			}
+
+			ApplyMaterial(context, material);
+			context->IASetInputLayout(GetInputLayout(*part->vbDecl));
+			ID3D11Buffer* vertexBuffer = part->vertexBuffer.Get();
+			const UINT vertexOffset = 0;
+			context->IASetVertexBuffers(0, 1, &vertexBuffer, &part->vertexStride, &vertexOffset);
+			context->IASetIndexBuffer(part->indexBuffer.Get(), part->indexFormat, 0);
+
+			// インスタンスの範囲は StartInstanceLocation で指定する
+			context->DrawIndexedInstanced(part->indexCount, batch.instanceCount, part->startIndex,
+				part->vertexOffset, batch.firstInstance);
+
+			m_statistics.drawCalls++;
+			m_statistics.drawsSaved += batch.instanceCount - 1;
+		}
+	}
+}
+
+void InstancedRenderer::ApplyMaterial(ID3D11DeviceContext* context, const Material& material)
+{
+	if (m_currentMaterial == &material)
+	{
+		return;
+	}
+	m_currentMaterial = &material;
+
+	Constants constants;
+	const Matrix viewProjection = m_viewProjection.Transpose();
+	std::memcpy(constants.viewProjection, &viewProjection, sizeof(constants.viewProjection));
+	constants.diffuseColor[0] = material.diffuse.x;
+	constants.diffuseColor[1] = material.diffuse.y;
+	constants.diffuseColor[2] = material.diffuse.z;
+	constants.diffuseColor[3] = material.diffuse.w;
+	// BasicEffect と同じく、環境光はディフューズ色を掛けて自己発光に足す
+	Store(constants.emissiveColor, Vector3(
+		material.emissive.x + material.ambient.x * material.diffuse.x,
+		material.emissive.y + material.ambient.y * material.diffuse.y,
+		material.emissive.z + material.ambient.z * material.diffuse.z), 0.0f);
+	Store(constants.specularColorAndPower, material.specular, material.specularPower);
+	Store(constants.eyePositionAndTexture, m_eyePosition, material.texture ? 1.0f : 0.0f);
+	for (int i = 0; i < 3; i++)
+	{
+		Store(constants.lightDirection[i], Vector3(LIGHT_DIRECTIONS[i]), 0.0f);
+		Store(constants.lightDiffuseColor[i], Vector3(LIGHT_DIFFUSE_COLORS[i]), 0.0f);
+		Store(constants.lightSpecularColor[i], Vector3(LIGHT_SPECULAR_COLORS[i]), 0.0f);
+	}
+
+	D3D11_MAPPED_SUBRESOURCE mapped;
+	ThrowIfFailed(context->Map(m_constantBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped), "Map failed");
+	std::memcpy(mapped.pData, &constants, sizeof(constants));
+	context->Unmap(m_constantBuffer.Get(), 0);
+
+	ID3D11ShaderResourceView* texture = material.texture.Get();
+	context->PSSetShaderResources(0, 1, &texture);
+}
+
+ID3D11InputLayout* InstancedRenderer::GetInputLayout(const std::vector<D3D11_INPUT_ELEMENT_DESC>& vbDecl)
+{
+	auto found = m_inputLayouts.find(&vbDecl);
+	if (found != m_inputLayouts.end())
+	{
+		return found->second.Get();
+	}
+
+	// モデルの頂点宣言の後ろにワールド行列を足す
+	std::vector<D3D11_INPUT_ELEMENT_DESC> elements(vbDecl);
+	elements.insert(elements.end(), std::begin(INSTANCE_ELEMENTS), std::end(INSTANCE_ELEMENTS));
+
+	ComPtr<ID3D11InputLayout> inputLayout;
+	ThrowIfFailed(m_device->CreateInputLayout(elements.data(), static_cast<UINT>(elements.size()),
+		m_vertexShaderCode.data(), m_vertexShaderCode.size(), inputLayout.GetAddressOf()), "CreateInputLayout failed");
+	m_inputLayouts[&vbDecl] = inputLayout;
+	return inputLayout.Get();
+}
+
+void InstancedRenderer::ReserveInstances(size_t count)
+{
+	if (count <= m_instanceCapacity)
+	{
+		return;
+	}
+
+	// 作り直しを減らすため２倍ずつ増やす
+	size_t capacity = m_instanceCapacity > 0 ? m_instanceCapacity : 64;
+	while (capacity < count)
+	{
+		capacity *= 2;
+	}
+
+	D3D11_BUFFER_DESC desc = {};
+	desc.ByteWidth = static_cast<UINT>(capacity * sizeof(Float4x4));
+	desc.Usage = D3D11_USAGE_DYNAMIC;
+	desc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+	desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	m_instanceBuffer.Reset();
+	ThrowIfFailed(m_device->CreateBuffer(&desc, nullptr, m_instanceBuffer.GetAddressOf()), "CreateBuffer failed");
+	m_instanceCapacity = capacity;
+}
@@ -0,0 +1,102 @@
+﻿/// <summary>
+/// InstanceBatcher でまとめたモデルをインスタンス描画するクラス
+/// </summary>
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+#include <windows.h>
+#include <wrl/client.h>
+#include <d3d11.h>
+#include <CommonStates.h>
+#include <Effects.h>
+#include <Model.h>
+#include <SimpleMath.h>
+
+#include "InstanceBatcher.h"
+
+// バッチのモデルには登録した DirectX::Model を、マテリアルには
+// InstancedRenderer::Material（nullptr ならモデルのマテリアル）を指定する
+// 各バッチのメッシュパーツごとに DrawIndexedInstanced を１回だけ呼ぶ
+class InstancedRenderer
+{
+public:
+	// マテリアル（BasicEffect の既定のライティングと同じ計算で使う）
+	struct Material
+	{
+		// w はアルファ
+		DirectX::SimpleMath::Vector4 diffuse;
+		DirectX::SimpleMath::Vector3 ambient;
+		DirectX::SimpleMath::Vector3 specular;
+		float specularPower;
+		DirectX::SimpleMath::Vector3 emissive;
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> texture;
+	};
+
+	// 統計情報（直前の Draw の分）
+	struct Statistics
+	{
+		// 描画呼び出しの数
+		uint32_t drawCalls;
+		// 描画したインスタンスの数
+		uint32_t instances;
+		// １つずつ描画した場合と比べて減った描画呼び出しの数
+		uint32_t drawsSaved;
+	};
+
+	// シェーダーをコンパイルして作成
+	explicit InstancedRenderer(ID3D11Device* device);
+
+	// モデルを登録する（マテリアルは fileName の .cmo / .tkm から読み取る）
+	void RegisterModel(const DirectX::Model* model, const std::wstring& fileName, DirectX::IEffectFactory& factory);
+
+	// バッチを描画
+	void Draw(ID3D11DeviceContext* context, const DirectX::CommonStates& states, const InstanceBatcher& batcher,
+		const DirectX::SimpleMath::Matrix& view, const DirectX::SimpleMath::Matrix& proj);
+
+	// 統計情報を取得
+	const Statistics& GetStatistics() const { return m_statistics; }
+
+private:
+	InstancedRenderer(const InstancedRenderer&) = delete;
+	InstancedRenderer& operator=(const InstancedRenderer&) = delete;
+
+	// パーツを描画する（不透明と半透明の片方だけ）
+	void DrawBatch(ID3D11DeviceContext* context, const DirectX::CommonStates& states,
+		const InstanceBatcher::Batch& batch, bool isAlpha);
+	// マテリアルを定数バッファに書き込む（直前と同じなら何もしない）
+	void ApplyMaterial(ID3D11DeviceContext* context, const Material& material);
+	// 頂点宣言に対応する入力レイアウトを取得
+	ID3D11InputLayout* GetInputLayout(const std::vector<D3D11_INPUT_ELEMENT_DESC>& vbDecl);
+	// インスタンスバッファを必要な大きさにする
+	void ReserveInstances(size_t count);
+
+	// デバイス
+	Microsoft::WRL::ComPtr<ID3D11Device> m_device;
+	// シェーダー
+	Microsoft::WRL::ComPtr<ID3D11VertexShader> m_vertexShader;
+	Microsoft::WRL::ComPtr<ID3D11PixelShader> m_pixelShader;
+	// 入力レイアウトの作成に使う頂点シェーダーのバイトコード
+	std::vector<uint8_t> m_vertexShaderCode;
+	// 定数バッファ
+	Microsoft::WRL::ComPtr<ID3D11Buffer> m_constantBuffer;
+	// ワールド行列を入れるインスタンスバッファ
+	Microsoft::WRL::ComPtr<ID3D11Buffer> m_instanceBuffer;
+	size_t m_instanceCapacity;
+
+	// 頂点宣言ごとの入力レイアウト
+	std::map<const std::vector<D3D11_INPUT_ELEMENT_DESC>*, Microsoft::WRL::ComPtr<ID3D11InputLayout>> m_inputLayouts;
+	// 登録したモデルのパーツごとのマテリアル（メッシュ順・パーツ順）
+	std::map<const DirectX::Model*, std::vector<Material>> m_modelMaterials;
+
+	// 描画中の状態（同じものを設定し直さない）
+	const Material* m_currentMaterial;
+	// ビュー・射影行列と視点
+	DirectX::SimpleMath::Matrix m_viewProjection;
+	DirectX::SimpleMath::Vector3 m_eyePosition;
+
+	// 統計情報
+	Statistics m_statistics;
+};
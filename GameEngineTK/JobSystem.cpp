@@ -0,0 +1,402 @@
+﻿#include "JobSystem.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#include <emmintrin.h>
+#define JOB_SYSTEM_PAUSE() _mm_pause()
+#else
+#define JOB_SYSTEM_PAUSE() ((void)0)
+#endif
+
+#include "Profiler.h"
+
+namespace
+{
+	// ジョブが見つからないときに回って待つ回数
+	const int SPIN_COUNT = 256;
+	// 回り終えた後に譲る回数（ワーカーはその後で眠る）
+	const int YIELD_COUNT = 64;
+
+	// 呼び出し元のスレッドが属するジョブシステムとその中の番号
+	thread_local const JobSystem* t_jobSystem = nullptr;
+	thread_local int t_threadIndex = -1;
+
+	// 見つからなかった回数に応じて待つ
+	void Backoff(int idleCount)
+	{
+		if (idleCount < SPIN_COUNT)
+		{
+			JOB_SYSTEM_PAUSE();
+		}
+		else
+		{
+			std::this_thread::yield();
+		}
+	}
+}
+
+JobDeque::JobDeque()
+	: m_top(0)
+	, m_bottom(0)
+{
+	const Job empty = {};
+	for (int64_t i = 0; i < CAPACITY; i++)
+	{
+		Write(i, empty);
+	}
+}
+
+void JobDeque::Write(int64_t index, const Job& job)
+{
+	Slot& slot = m_slots[index & (CAPACITY - 1)];
+	slot.func.store(job.func, std::memory_order_relaxed);
+	slot.context.store(job.context, std::memory_order_relaxed);
+	slot.begin.store(job.begin, std::memory_order_relaxed);
+	slot.end.store(job.end, std::memory_order_relaxed);
+	slot.grain.store(job.grain, std::memory_order_relaxed);
+	slot.counter.store(job.counter, std::memory_order_relaxed);
+}
+
+void JobDeque::Read(int64_t index, Job& job) const
+{
+	const Slot& slot = m_slots[index & (CAPACITY - 1)];
+	job.func = slot.func.load(std::memory_order_relaxed);
+	job.context = slot.context.load(std::memory_order_relaxed);
+	job.begin = slot.begin.load(std::memory_order_relaxed);
+	job.end = slot.end.load(std::memory_order_relaxed);
+	job.grain = slot.grain.load(std::memory_order_relaxed);
+	job.counter = slot.counter.load(std::memory_order_relaxed);
+}
+
+bool JobDeque::Push(const Job& job)
+{
+	const int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+	const int64_t top = m_top.load(std::memory_order_acquire);
+	if (bottom - top >= CAPACITY)
+	{
+		return false;
+	}
+	Write(bottom, job);
+	// ジョブを書いてから底を進める
+	std::atomic_thread_fence(std::memory_order_release);
+	m_bottom.store(bottom + 1, std::memory_order_relaxed);
+	return true;
+}
+
+bool JobDeque::Pop(Job& job)
+{
+	const int64_t bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+	m_bottom.store(bottom, std::memory_order_relaxed);
+	// 底を下げたことを盗む側に見せてから天井を読む
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t top = m_top.load(std::memory_order_relaxed);
+	if (top > bottom)
+	{
+		// 空だった
+		m_bottom.store(bottom + 1, std::memory_order_relaxed);
+		return false;
+	}
+	Read(bottom, job);
+	if (top == bottom)
+	{
+		// 最後の１つは盗む側と取り合う
+		const bool isWon = m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+		m_bottom.store(bottom + 1, std::memory_order_relaxed);
+		return isWon;
+	}
+	return true;
+}
+
+bool JobDeque::Steal(Job& job)
+{
+	int64_t top = m_top.load(std::memory_order_acquire);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	const int64_t bottom = m_bottom.load(std::memory_order_acquire);
+	if (top >= bottom)
+	{
+		return false;
+	}
+	// 天井を進める前に読む（進めた後は持ち主が上書きしてよい）
+	Read(top, job);
+	// 他のスレッドか持ち主に取られていたら、読んだ値は捨てる
+	return m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+}
+
+bool JobDeque::IsEmpty() const
+{
+	return m_bottom.load(std::memory_order_acquire) <= m_top.load(std::memory_order_acquire);
+}
+
+JobSystem::JobSystem(unsigned workerCount, unsigned attachableCount)
+	: m_sleepingWorkers(0)
+	, m_wakeSignals(0)
+	, m_isQuit(false)
+	, m_startedWorkers(0)
+	, m_unattachedRunCount(0)
+{
+	for (unsigned i = 0; i <= workerCount + attachableCount; i++)
+	{
+		std::unique_ptr<ThreadState> state(new ThreadState);
+		state->random = 2463534242u + i * 0x9E3779B9u;
+		state->stealCount.store(0, std::memory_order_relaxed);
+		state->isAttached.store(false, std::memory_order_relaxed);
+		m_threads.push_back(std::move(state));
+	}
+
+	// 生成したスレッドは 0 番
+	t_jobSystem = this;
+	t_threadIndex = 0;
+
+	m_workers.reserve(workerCount);
+	for (unsigned i = 1; i <= workerCount; i++)
+	{
+		m_workers.emplace_back(&JobSystem::WorkerMain, this, static_cast<int>(i));
+	}
+	while (m_startedWorkers.load(std::memory_order_acquire) < workerCount)
+	{
+		std::this_thread::yield();
+	}
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_isQuit = true;
+	}
+	m_wakeUp.notify_all();
+	for (std::thread& worker : m_workers)
+	{
+		worker.join();
+	}
+	if (t_jobSystem == this)
+	{
+		t_jobSystem = nullptr;
+		t_threadIndex = -1;
+	}
+}
+
+uint64_t JobSystem::GetStealCount() const
+{
+	uint64_t count = 0;
+	for (const std::unique_ptr<ThreadState>& state : m_threads)
+	{
+		count += state->stealCount.load(std::memory_order_relaxed);
+	}
+	return count;
+}
+
+int JobSystem::GetThreadIndex() const
+{
+	return t_jobSystem == this ? t_threadIndex : -1;
+}
+
+bool JobSystem::AttachThread()
+{
+	if (t_jobSystem == this)
+	{
+		return true;
+	}
+	if (t_jobSystem)
+	{
+		return false;
+	}
+	for (size_t i = m_workers.size() + 1; i < m_threads.size(); i++)
+	{
+		// 前に使っていたスレッドが積んだ後始末を見てから、持ち主として積み始める
+		bool isAttached = false;
+		if (m_threads[i]->isAttached.compare_exchange_strong(isAttached, true, std::memory_order_acquire))
+		{
+			t_jobSystem = this;
+			t_threadIndex = static_cast<int>(i);
+			return true;
+		}
+	}
+	return false;
+}
+
+void JobSystem::DetachThread()
+{
+	const int threadIndex = GetThreadIndex();
+	// 生成したスレッドのキューは返さない
+	if (threadIndex <= static_cast<int>(m_workers.size()))
+	{
+		return;
+	}
+	t_jobSystem = nullptr;
+	t_threadIndex = -1;
+	m_threads[threadIndex]->isAttached.store(false, std::memory_order_release);
+}
+
+void JobSystem::Run(JobFunc func, const void* context, size_t count, size_t grain, JobCounter& counter)
+{
+	if (count == 0)
+	{
+		return;
+	}
+	Job job = { func, context, 0, count, grain > 0 ? grain : 1, &counter };
+	counter.m_count.fetch_add(1, std::memory_order_relaxed);
+	Submit(job);
+}
+
+void JobSystem::Submit(const Job& job)
+{
+	const int threadIndex = GetThreadIndex();
+	if (threadIndex < 0)
+	{
+		m_unattachedRunCount.fetch_add(1, std::memory_order_relaxed);
+		Execute(job);
+		return;
+	}
+	if (!m_threads[threadIndex]->deque.Push(job))
+	{
+		// キューが一杯ならその場で実行する
+		Execute(job);
+		return;
+	}
+	WakeWorker();
+}
+
+void JobSystem::Execute(Job job)
+{
+	// 大きい範囲は後ろ半分を積み直して、手元では前半分を続ける（空いたスレッドが盗んでいく）
+	while (job.end - job.begin > job.grain)
+	{
+		Job rest = job;
+		rest.begin = job.begin + (job.end - job.begin) / 2;
+		job.end = rest.begin;
+		job.counter->m_count.fetch_add(1, std::memory_order_relaxed);
+		Submit(rest);
+	}
+	job.func(job.context, job.begin, job.end);
+	// ジョブの結果を書いてから減らす（Wait の acquire と対になる）
+	job.counter->m_count.fetch_sub(1, std::memory_order_release);
+}
+
+bool JobSystem::FindJob(int threadIndex, Job& job)
+{
+	const size_t threadCount = m_threads.size();
+	size_t start = 0;
+	if (threadIndex >= 0)
+	{
+		ThreadState& state = *m_threads[threadIndex];
+		if (state.deque.Pop(job))
+		{
+			return true;
+		}
+		// xorshift で盗み始める相手を散らす
+		state.random ^= state.random << 13;
+		state.random ^= state.random >> 17;
+		state.random ^= state.random << 5;
+		start = state.random % threadCount;
+	}
+	for (size_t i = 0; i < threadCount; i++)
+	{
+		const size_t victim = (start + i) % threadCount;
+		if (static_cast<int>(victim) == threadIndex)
+		{
+			continue;
+		}
+		if (m_threads[victim]->deque.Steal(job))
+		{
+			if (threadIndex >= 0)
+			{
+				m_threads[threadIndex]->stealCount.fetch_add(1, std::memory_order_relaxed);
+			}
+			return true;
+		}
+	}
+	return false;
+}
+
+bool JobSystem::HasWork() const
+{
+	for (const std::unique_ptr<ThreadState>& state : m_threads)
+	{
+		if (!state->deque.IsEmpty())
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+void JobSystem::WakeWorker()
+{
+	// 積んだことと眠っているワーカーの数の読み取りの順番を守る（WorkerMain の眠る前の確認と対になる）
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (m_sleepingWorkers.load(std::memory_order_relaxed) == 0)
+	{
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_wakeSignals < m_workers.size())
+		{
+			m_wakeSignals++;
+		}
+	}
+	m_wakeUp.notify_one();
+}
+
+void JobSystem::Wait(const JobCounter& counter)
+{
+	const int threadIndex = GetThreadIndex();
+	int idleCount = 0;
+	Job job;
+	while (!counter.IsDone())
+	{
+		if (FindJob(threadIndex, job))
+		{
+			Execute(job);
+			idleCount = 0;
+		}
+		else
+		{
+			Backoff(idleCount++);
+		}
+	}
+}
+
+void JobSystem::WorkerMain(int threadIndex)
+{
+	t_jobSystem = this;
+	t_threadIndex = threadIndex;
+	Profiler::SetThreadName("Worker");
+	m_startedWorkers.fetch_add(1, std::memory_order_release);
+
+	int idleCount = 0;
+	Job job;
+	while (!m_isQuit.load(std::memory_order_relaxed))
+	{
+		if (FindJob(threadIndex, job))
+		{
+			Execute(job);
+			idleCount = 0;
+			continue;
+		}
+		if (idleCount < SPIN_COUNT + YIELD_COUNT)
+		{
+			Backoff(idleCount++);
+			continue;
+		}
+
+		// しばらく仕事が無ければ眠る
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_sleepingWorkers.fetch_add(1, std::memory_order_relaxed);
+		// 眠ることを見せてからキューを確かめる（WakeWorker と対になる）
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (!HasWork())
+		{
+			m_wakeUp.wait(lock, [this]()
+			{
+				return m_isQuit.load() || m_wakeSignals > 0;
+			});
+			if (m_wakeSignals > 0)
+			{
+				m_wakeSignals--;
+			}
+		}
+		m_sleepingWorkers.fetch_sub(1, std::memory_order_relaxed);
+		idleCount = 0;
+	}
+}
@@ -0,0 +1,208 @@
+﻿/// <summary>
+/// ワークスティーリングのジョブシステム（スレッドごとの Chase-Lev 両端キュー）
+/// </summary>
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class JobSystem;
+
+// ジョブの完了を数えるカウンター（ジョブを積むと増え、終わると減る）
+// 後に続く処理は Wait でカウンターが 0 になるのを待ってから積めば、依存関係を表せる
+class JobCounter
+{
+public:
+	JobCounter() : m_count(0) {}
+
+	// 積んだジョブが全て終わったか
+	bool IsDone() const { return m_count.load(std::memory_order_acquire) == 0; }
+
+private:
+	friend class JobSystem;
+
+	JobCounter(const JobCounter&) = delete;
+	JobCounter& operator=(const JobCounter&) = delete;
+
+	std::atomic<uint32_t> m_count;
+};
+
+// 範囲処理の関数
+typedef void(*JobFunc)(const void* context, size_t begin, size_t end);
+
+// ジョブ（[begin, end) が grain より大きければ、実行するスレッドが半分ずつに分けて積み直す）
+struct Job
+{
+	JobFunc func;
+	const void* context;
+	size_t begin;
+	size_t end;
+	size_t grain;
+	JobCounter* counter;
+};
+
+// Chase-Lev の両端キュー（固定容量）
+// 持ち主のスレッドは底に積んで底から取り出し、他のスレッドは天井から盗む
+// ジョブは値で持つので、取り出した後の領域の寿命を気にしなくてよい
+class JobDeque
+{
+public:
+	static const int64_t CAPACITY = 4096;
+
+	JobDeque();
+
+	// 積む（持ち主のスレッドだけ、一杯なら false）
+	bool Push(const Job& job);
+	// 最後に積んだものを取り出す（持ち主のスレッドだけ、空なら false）
+	bool Pop(Job& job);
+	// 最初に積まれたものを盗む（どのスレッドからでもよい、空か取り合いに負けたら false）
+	bool Steal(Job& job);
+	// 空か（他のスレッドが操作中なら目安）
+	bool IsEmpty() const;
+
+private:
+	JobDeque(const JobDeque&) = delete;
+	JobDeque& operator=(const JobDeque&) = delete;
+
+	// 盗む側が読んでいる間に持ち主が上書きすることがあるので（そのときは盗むのに失敗する）、各値をアトミックに持つ
+	struct Slot
+	{
+		std::atomic<JobFunc> func;
+		std::atomic<const void*> context;
+		std::atomic<size_t> begin;
+		std::atomic<size_t> end;
+		std::atomic<size_t> grain;
+		std::atomic<JobCounter*> counter;
+	};
+
+	void Write(int64_t index, const Job& job);
+	void Read(int64_t index, Job& job) const;
+
+	// 盗む側が進める
+	std::atomic<int64_t> m_top;
+	// 同じキャッシュラインに載せない
+	char m_padding[64];
+	// 持ち主が進める
+	std::atomic<int64_t> m_bottom;
+	Slot m_slots[CAPACITY];
+};
+
+// ワーカースレッドと、生成したスレッド（メインスレッド）でジョブを処理するジョブシステム
+// 空いたスレッドは他のスレッドのキューから盗むので、分割の仕方が偏っても全員が働く
+// ジョブを積めるのは生成したスレッドとワーカーと AttachThread したスレッドだけ
+// （他のスレッドから積んだときや、キューが一杯のときはその場で実行する）
+class JobSystem
+{
+public:
+	// workerCount 個のワーカースレッドを起動（生成したスレッドも Wait の間に処理に加わる）
+	// attachableCount 個のキューを、後から AttachThread するスレッド（パイプラインのスレッドなど）のために用意する
+	// ワーカーがプロファイラに登録し終えるまで待つので、その確保が最初のフレームに紛れ込まない
+	explicit JobSystem(unsigned workerCount, unsigned attachableCount = 0);
+	~JobSystem();
+
+	// 生成したスレッドを含めたスレッド数（AttachThread するスレッドは含まない）
+	unsigned GetThreadCount() const { return static_cast<unsigned>(m_workers.size()) + 1; }
+	// 他のスレッドから盗んだ回数の累計
+	uint64_t GetStealCount() const;
+	// 属していないスレッドから積まれ、並列にできずその場で実行したジョブの数の累計
+	uint64_t GetUnattachedRunCount() const { return m_unattachedRunCount.load(std::memory_order_relaxed); }
+
+	// 呼び出し元のスレッドに用意したキューを１つ割り当て、ジョブを積んで並列に処理できるようにする
+	// 既に属していれば何もしないで true、空いているキューが無いか別のジョブシステムに属していれば false
+	bool AttachThread();
+	// AttachThread で割り当てたキューを返す（スレッドが終わる前に、積んだジョブを待ち終えてから呼ぶ）
+	void DetachThread();
+
+	// [0, count) について grain 個以下ずつ func(context, begin, end) を呼ぶジョブを積み、counter を増やす
+	// context は counter を待ち終えるまで残しておくこと
+	void Run(JobFunc func, const void* context, size_t count, size_t grain, JobCounter& counter);
+
+	// func() を１回呼ぶジョブを積む（func は counter を待ち終えるまで残しておくこと）
+	template<typename Func>
+	void Run(const Func& func, JobCounter& counter)
+	{
+		Run(&InvokeOnce<Func>, &func, 1, 1, counter);
+	}
+
+	// [0, count) を grain 個以下ずつに分けて func(begin, end) を並列に呼ぶジョブを積む
+	template<typename Func>
+	void ParallelFor(size_t count, size_t grain, const Func& func, JobCounter& counter)
+	{
+		Run(&InvokeRange<Func>, &func, count, grain, counter);
+	}
+
+	// ParallelFor を積んで終わるまで待つ
+	template<typename Func>
+	void ParallelFor(size_t count, size_t grain, const Func& func)
+	{
+		JobCounter counter;
+		ParallelFor(count, grain, func, counter);
+		Wait(counter);
+	}
+
+	// counter が 0 になるまで待つ（待つ間も他のジョブを処理する）
+	void Wait(const JobCounter& counter);
+
+private:
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+	template<typename Func>
+	static void InvokeOnce(const void* context, size_t, size_t)
+	{
+		(*static_cast<const Func*>(context))();
+	}
+
+	template<typename Func>
+	static void InvokeRange(const void* context, size_t begin, size_t end)
+	{
+		(*static_cast<const Func*>(context))(begin, end);
+	}
+
+	// スレッドごとの状態
+	struct ThreadState
+	{
+		JobDeque deque;
+		// 盗む相手を選ぶ乱数
+		uint32_t random;
+		std::atomic<uint64_t> stealCount;
+		// AttachThread で使われているか（用意したキューだけ）
+		std::atomic<bool> isAttached;
+	};
+
+	// 呼び出し元のスレッドの番号（このジョブシステムのスレッドでなければ -1）
+	int GetThreadIndex() const;
+	// 呼び出し元のスレッドのキューに積む（積めなければその場で実行する）
+	void Submit(const Job& job);
+	// ジョブを実行する（大きければ分けて積みながら）
+	void Execute(Job job);
+	// 自分のキューか他のスレッドのキューからジョブを探す
+	bool FindJob(int threadIndex, Job& job);
+	// どこかのキューにジョブがあるか
+	bool HasWork() const;
+	// 眠っているワーカーを起こす
+	void WakeWorker();
+	// ワーカースレッドの処理
+	void WorkerMain(int threadIndex);
+
+	// 0 番が生成したスレッド、1 番からワーカー、その後ろが AttachThread するスレッド
+	std::vector<std::unique_ptr<ThreadState>> m_threads;
+	std::vector<std::thread> m_workers;
+
+	// 仕事が無い間だけワーカーを眠らせる
+	std::mutex m_mutex;
+	std::condition_variable m_wakeUp;
+	std::atomic<unsigned> m_sleepingWorkers;
+	unsigned m_wakeSignals;
+	std::atomic<bool> m_isQuit;
+	// 起動し終えたワーカーの数
+	std::atomic<unsigned> m_startedWorkers;
+	// 属していないスレッドから積まれてその場で実行した数
+	std::atomic<uint64_t> m_unattachedRunCount;
+};
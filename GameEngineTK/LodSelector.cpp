@@ -0,0 +1,73 @@
+﻿#include "LodSelector.h"
+
+#include <cmath>
+
+namespace
+{
+	// 距離の下限（視点が球の中にあるとき）
+	const float MIN_DISTANCE = 1e-3f;
+
+	// 使える詳細度か
+	bool IsAvailable(const bool* available, int level)
+	{
+		return level == 0 || !available || available[level];
+	}
+
+	// 画面上の誤差が limit 以下になる中で最も粗い使える詳細度（無ければ 0）
+	int FindCoarsest(const float* errors, const bool* available, int count, float pixelsPerUnit, float limit)
+	{
+		int result = 0;
+		for (int level = 1; level < count; level++)
+		{
+			if (errors[level] * pixelsPerUnit > limit)
+			{
+				break;
+			}
+			if (IsAvailable(available, level))
+			{
+				result = level;
+			}
+		}
+		return result;
+	}
+}
+
+float ComputePixelsPerUnit(const LodView& view, const Float3& center, float radius)
+{
+	const float dx = center.x - view.eyePosition.x;
+	const float dy = center.y - view.eyePosition.y;
+	const float dz = center.z - view.eyePosition.z;
+	float distance = std::sqrt(dx * dx + dy * dy + dz * dz) - radius;
+	distance = distance > MIN_DISTANCE ? distance : MIN_DISTANCE;
+
+	// 縦幅のピクセル数が視野角 fovY に広がる
+	const float screenHeight = view.aspect > 0.0f ? view.screenWidth / view.aspect : view.screenWidth;
+	return screenHeight / (2.0f * distance * std::tan(view.fovY * 0.5f));
+}
+
+int SelectLod(const float* errors, const bool* available, int count, float pixelsPerUnit,
+	int current, float threshold, float hysteresis)
+{
+	if (count <= 1)
+	{
+		return 0;
+	}
+	if (current < 0 || current >= count || !IsAvailable(available, current))
+	{
+		current = 0;
+	}
+
+	const int target = FindCoarsest(errors, available, count, pixelsPerUnit, threshold);
+	if (target < current)
+	{
+		// 今の詳細度では誤差が大きすぎるので、すぐに細かくする
+		return target;
+	}
+	if (target > current)
+	{
+		// 余裕を持って誤差が小さくなったときだけ粗くする
+		const int coarser = FindCoarsest(errors, available, count, pixelsPerUnit, threshold * (1.0f - hysteresis));
+		return coarser > current ? coarser : current;
+	}
+	return current;
+}
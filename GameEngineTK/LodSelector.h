@@ -0,0 +1,31 @@
+﻿/// <summary>
+/// 画面上の誤差から詳細度（LOD）を選ぶ関数群
+/// </summary>
+#pragma once
+
+#include "TransformMath.h"
+
+// 詳細度を選ぶための視点の情報
+struct LodView
+{
+	// 視点座標
+	Float3 eyePosition;
+	// 垂直方向視野角（ラジアン）
+	float fovY;
+	// アスペクト比（横幅 / 縦幅）
+	float aspect;
+	// 画面の横幅（ピクセル、縦幅はアスペクト比から求める）
+	float screenWidth;
+};
+
+// 球（center, radius）の位置で、ワールド空間の長さ１が画面上で何ピクセルになるか
+// 距離は球の手前の面までで測り、球の中に視点があれば十分に近いものとして扱う
+float ComputePixelsPerUnit(const LodView& view, const Float3& center, float radius);
+
+// 画面上の誤差が threshold ピクセル以下になる中で最も粗い詳細度を選ぶ
+// errors は詳細度ごとの幾何誤差（ワールド空間の長さ、0 番が最も細かく昇順に並ぶ）
+// available が nullptr でなければ、偽の詳細度は選ばない（0 番は常に使えるものとする）
+// 細かくするときはすぐに切り替え、粗くするときは threshold * (1 - hysteresis) 以下になるまで待つので
+// 境界付近で毎フレーム切り替わることがない
+int SelectLod(const float* errors, const bool* available, int count, float pixelsPerUnit,
+	int current, float threshold, float hysteresis);
@@ -1,4 +1,4 @@
-//
+﻿//
 // Main.cpp
 //
 
@@ -86,6 +86,27 @@ int WINAPI wWinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance,
         g_game->Initialize(hwnd, rc.right - rc.left, rc.bottom - rc.top);
     }
 
+	// -record ファイル でシミュレーションの入力を記録して終了時に書き出し、-replay ファイル で再生する
+	bool isRecording = false;
+	for (int i = 1; i + 1 < __argc; i++)
+	{
+		bool isStarted = true;
+		if (wcscmp(__wargv[i], L"-record") == 0)
+		{
+			isStarted = isRecording = g_game->StartInputRecording(__wargv[++i]);
+		}
+		else if (wcscmp(__wargv[i], L"-replay") == 0)
+		{
+			isStarted = g_game->StartInputReplay(__wargv[++i]);
+		}
+		if (!isStarted)
+		{
+			g_game.reset();
+			CoUninitialize();
+			return 1;
+		}
+	}
+
     // Main message loop
     MSG msg = { 0 };
     while (WM_QUIT != msg.message)
@@ -101,11 +122,17 @@ int WINAPI wWinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance,
         }
     }
 
+	int result = (int) msg.wParam;
+	if (isRecording && !g_game->StopInputRecording())
+	{
+		result = 1;
+	}
+
     g_game.reset();
 
     CoUninitialize();
 
-    return (int) msg.wParam;
+    return result;
 }
 
 // Windows procedure
@@ -177,9 +204,9 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
         break;
 
     case WM_ACTIVATEAPP:
-		Keyboard::ProcessMessage(message, wParam, lParam);
         if (game)
         {
+			game->OnInputMessage(message, wParam, lParam);
             if (wParam)
             {
                 game->OnActivated();
@@ -216,7 +243,10 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
         break;
 
     case WM_SYSKEYDOWN:
-		Keyboard::ProcessMessage(message, wParam, lParam);
+		if (game)
+		{
+			game->OnInputMessage(message, wParam, lParam);
+		}
         if (wParam == VK_RETURN && (lParam & 0x60000000) == 0x20000000)
         {
             // Implements the classic ALT+ENTER fullscreen toggle
@@ -252,7 +282,6 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
         // A menu is active and the user presses a key that does not correspond
         // to any mnemonic or accelerator key. Ignore so we don't produce an error beep.
         return MAKELRESULT(0, MNC_CLOSE);
-	case WM_INPUT:
 	case WM_MOUSEMOVE:
 	case WM_LBUTTONDOWN:
 	case WM_LBUTTONUP:
@@ -263,13 +292,14 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
 	case WM_MOUSEWHEEL:
 	case WM_XBUTTONDOWN:
 	case WM_XBUTTONUP:
-	case WM_MOUSEHOVER:
-		Mouse::ProcessMessage(message, wParam, lParam);
-		break;
 	case WM_KEYDOWN:
 	case WM_KEYUP:
 	case WM_SYSKEYUP:
-		Keyboard::ProcessMessage(message, wParam, lParam);
+		// 入力はイベントとしてゲームに渡し、フレームごとにまとめて読む
+		if (game)
+		{
+			game->OnInputMessage(message, wParam, lParam);
+		}
 		break;
     }
 
@@ -0,0 +1,193 @@
+﻿#include "ModelRenderBackend.h"
+
+#include <cmath>
+#include <stdexcept>
+
+using namespace DirectX;
+using namespace DirectX::SimpleMath;
+
+namespace
+{
+	// 射影行列からファークリップを取り出せないときに使う値
+	const float DEFAULT_FAR_CLIP = 1000.0f;
+}
+
+ModelRenderBackend::ModelRenderBackend(ID3D11Device* device, ID3D11DeviceContext* context)
+	: m_context(context)
+	, m_states(std::make_unique<CommonStates>(device))
+	, m_depthScale(1.0f / DEFAULT_FAR_CLIP)
+	, m_currentMaterial(nullptr)
+	, m_currentVertexBuffer(nullptr)
+	, m_currentIndexBuffer(nullptr)
+{
+}
+
+void ModelRenderBackend::BeginFrame(const Matrix& view, const Matrix& proj)
+{
+	m_view = view;
+	m_proj = proj;
+
+	// 右手系の透視射影では _33 = f / (n - f)、_43 = n * f / (n - f) なので f = _43 / (_33 + 1)
+	float farClip = DEFAULT_FAR_CLIP;
+	const float denominator = proj._33 + 1.0f;
+	if (std::fabs(denominator) > 1e-6f)
+	{
+		farClip = std::fabs(proj._43 / denominator);
+	}
+	m_depthScale = farClip > 0.0f ? 1.0f / farClip : 1.0f / DEFAULT_FAR_CLIP;
+
+	m_materials.clear();
+	FrameArena& arena = FrameArena::GetThreadArena();
+	m_materialIds = ArenaHashMap<MaterialKey, uint32_t, MaterialKeyHash>(arena);
+	m_parts.clear();
+	m_modelFirstParts = ArenaHashMap<const Model*, size_t, std::hash<const Model*>>(arena);
+	m_currentMaterial = nullptr;
+	m_currentVertexBuffer = nullptr;
+	m_currentIndexBuffer = nullptr;
+}
+
+void ModelRenderBackend::AddModel(RenderQueue& queue, const Model& model, const Matrix& world)
+{
+	const size_t firstPart = RegisterModel(model);
+	const uint32_t transform = queue.AddTransform(reinterpret_cast<const Float4x4&>(world));
+	const Matrix worldView = world * m_view;
+
+	size_t index = firstPart;
+	for (const auto& mesh : model.meshes)
+	{
+		for (size_t i = 0; i < mesh->meshParts.size(); i++, index++)
+		{
+			// 視点からの距離（ビュー空間では -z が奥）
+			const Part& part = m_parts[index];
+			const Vector3 center = Vector3::Transform(part.center, worldView);
+			const float depth = -center.z * m_depthScale;
+			queue.Add(RenderQueue::MakeKey(part.pass, part.state, part.material, static_cast<uint32_t>(index), depth), transform);
+		}
+	}
+}
+
+void ModelRenderBackend::SetState(RenderPass pass, uint32_t state)
+{
+	// Model::Draw（ModelMesh::PrepareForRendering）と同じ組み合わせ
+	ID3D11BlendState* blendState;
+	ID3D11DepthStencilState* depthStencilState;
+	if (pass == RENDER_PASS_ALPHA)
+	{
+		blendState = (state & STATE_PREMULTIPLIED_ALPHA) ? m_states->AlphaBlend() : m_states->NonPremultiplied();
+		depthStencilState = m_states->DepthRead();
+	}
+	else
+	{
+		blendState = m_states->Opaque();
+		depthStencilState = m_states->DepthDefault();
+	}
+	m_context->OMSetBlendState(blendState, nullptr, 0xFFFFFFFF);
+	m_context->OMSetDepthStencilState(depthStencilState, 0);
+	m_context->RSSetState((state & STATE_CCW) ? m_states->CullCounterClockwise() : m_states->CullClockwise());
+
+	ID3D11SamplerState* sampler = m_states->LinearWrap();
+	m_context->PSSetSamplers(0, 1, &sampler);
+}
+
+void ModelRenderBackend::SetMaterial(uint32_t material)
+{
+	m_currentMaterial = &m_materials[material];
+	m_context->IASetInputLayout(m_currentMaterial->inputLayout);
+}
+
+void ModelRenderBackend::SetMesh(uint32_t mesh)
+{
+	// 同じメッシュのパーツはバッファを共有しているので、変わったときだけ設定する
+	const ModelMeshPart& part = *m_parts[mesh].part;
+	if (part.vertexBuffer.Get() != m_currentVertexBuffer)
+	{
+		ID3D11Buffer* vertexBuffer = part.vertexBuffer.Get();
+		const UINT offset = 0;
+		m_context->IASetVertexBuffers(0, 1, &vertexBuffer, &part.vertexStride, &offset);
+		m_currentVertexBuffer = vertexBuffer;
+	}
+	if (part.indexBuffer.Get() != m_currentIndexBuffer)
+	{
+		m_context->IASetIndexBuffer(part.indexBuffer.Get(), part.indexFormat, 0);
+		m_currentIndexBuffer = part.indexBuffer.Get();
+	}
+	m_context->IASetPrimitiveTopology(part.primitiveType);
+}
+
+void ModelRenderBackend::Draw(uint32_t mesh, const Float4x4& world)
+{
+	// エフェクトの定数はワールド行列が変わるので描画ごとに更新する
+	if (m_currentMaterial->matrices)
+	{
+		m_currentMaterial->matrices->SetWorld(reinterpret_cast<const Matrix&>(world));
+	}
+	m_currentMaterial->effect->Apply(m_context.Get());
+
+	const ModelMeshPart& part = *m_parts[mesh].part;
+	m_context->DrawIndexed(part.indexCount, part.startIndex, part.vertexOffset);
+}
+
+size_t ModelRenderBackend::RegisterModel(const Model& model)
+{
+	const size_t* found = m_modelFirstParts.find(&model);
+	if (found)
+	{
+		return *found;
+	}
+
+	const size_t firstPart = m_parts.size();
+	for (const auto& mesh : model.meshes)
+	{
+		uint32_t state = 0;
+		state |= mesh->ccw ? STATE_CCW : 0;
+		state |= mesh->pmalpha ? STATE_PREMULTIPLIED_ALPHA : 0;
+
+		for (const auto& meshPart : mesh->meshParts)
+		{
+			if (m_parts.size() >= RenderQueue::MAX_MESHES)
+			{
+				throw std::length_error("too many mesh parts in a frame");
+			}
+
+			Part part;
+			part.part = meshPart.get();
+			part.pass = meshPart->isAlpha ? RENDER_PASS_ALPHA : RENDER_PASS_OPAQUE;
+			part.state = state;
+			part.material = GetMaterialId(*meshPart);
+			part.center = Vector3(mesh->boundingSphere.Center.x, mesh->boundingSphere.Center.y, mesh->boundingSphere.Center.z);
+			m_parts.push_back(part);
+		}
+	}
+	m_modelFirstParts.emplace(&model, firstPart);
+	return firstPart;
+}
+
+uint32_t ModelRenderBackend::GetMaterialId(const ModelMeshPart& part)
+{
+	const MaterialKey key = { part.effect.get(), part.inputLayout.Get() };
+	const uint32_t* found = m_materialIds.find(key);
+	if (found)
+	{
+		return *found;
+	}
+	if (m_materials.size() >= RenderQueue::MAX_MATERIALS)
+	{
+		throw std::length_error("too many materials in a frame");
+	}
+
+	// ビュー・射影行列は番号を振るときに一度だけ設定する
+	Material material;
+	material.effect = part.effect.get();
+	material.matrices = dynamic_cast<IEffectMatrices*>(part.effect.get());
+	material.inputLayout = part.inputLayout.Get();
+	if (material.matrices)
+	{
+		material.matrices->SetView(m_view);
+		material.matrices->SetProjection(m_proj);
+	}
+
+	const uint32_t id = static_cast<uint32_t>(m_materials.size());
+	m_materials.push_back(material);
+	m_materialIds.emplace(key, id);
+	return id;
+}
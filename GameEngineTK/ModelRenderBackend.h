@@ -0,0 +1,120 @@
+﻿/// <summary>
+/// DirectXTK のモデルを RenderQueue で描画するバックエンド
+/// </summary>
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+#include <windows.h>
+#include <wrl/client.h>
+#include <d3d11.h>
+#include <CommonStates.h>
+#include <Effects.h>
+#include <Model.h>
+#include <SimpleMath.h>
+
+#include "FrameArena.h"
+#include "RenderQueue.h"
+
+// モデルのメッシュパーツごとにコマンドを積み、Submit で受け取って描画する
+// ステートは Model::Draw と同じ組み合わせ（ブレンド・深度・カリング）を使う
+// マテリアルとメッシュの番号はフレームごとに振り直すので、モデルの破棄を気にしなくてよい
+class ModelRenderBackend : public RenderBackend
+{
+public:
+	ModelRenderBackend(ID3D11Device* device, ID3D11DeviceContext* context);
+
+	// フレームの始めに呼ぶ（番号を振り直し、ビュー・射影行列を覚える）
+	void BeginFrame(const DirectX::SimpleMath::Matrix& view, const DirectX::SimpleMath::Matrix& proj);
+	// モデルの全てのメッシュパーツをキューに積む
+	void AddModel(RenderQueue& queue, const DirectX::Model& model, const DirectX::SimpleMath::Matrix& world);
+
+	void SetState(RenderPass pass, uint32_t state) override;
+	void SetMaterial(uint32_t material) override;
+	void SetMesh(uint32_t mesh) override;
+	void Draw(uint32_t mesh, const Float4x4& world) override;
+
+private:
+	ModelRenderBackend(const ModelRenderBackend&) = delete;
+	ModelRenderBackend& operator=(const ModelRenderBackend&) = delete;
+
+	// ステート番号のビット
+	enum StateFlags
+	{
+		// 反時計回りが表
+		STATE_CCW = 0x1,
+		// 乗算済みアルファ
+		STATE_PREMULTIPLIED_ALPHA = 0x2,
+	};
+
+	// マテリアル
+	struct Material
+	{
+		DirectX::IEffect* effect;
+		DirectX::IEffectMatrices* matrices;
+		ID3D11InputLayout* inputLayout;
+	};
+
+	// メッシュパーツ（番号はメッシュ番号）
+	struct Part
+	{
+		const DirectX::ModelMeshPart* part;
+		RenderPass pass;
+		uint32_t state;
+		uint32_t material;
+		// モデル空間の境界球の中心
+		DirectX::SimpleMath::Vector3 center;
+	};
+
+	// マテリアルの検索表のキー
+	struct MaterialKey
+	{
+		const DirectX::IEffect* effect;
+		const ID3D11InputLayout* inputLayout;
+
+		bool operator==(const MaterialKey& other) const
+		{
+			return effect == other.effect && inputLayout == other.inputLayout;
+		}
+	};
+
+	struct MaterialKeyHash
+	{
+		size_t operator()(const MaterialKey& key) const
+		{
+			size_t a = reinterpret_cast<size_t>(key.effect);
+			size_t b = reinterpret_cast<size_t>(key.inputLayout);
+			return a ^ (b + 0x9E3779B9 + (a << 6) + (a >> 2));
+		}
+	};
+
+	// モデルのパーツに番号を振って、先頭のパーツの番号を返す
+	size_t RegisterModel(const DirectX::Model& model);
+	// エフェクトと入力レイアウトの組に番号を振る
+	uint32_t GetMaterialId(const DirectX::ModelMeshPart& part);
+
+	// コンテキスト
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> m_context;
+	// 汎用ステート
+	std::unique_ptr<DirectX::CommonStates> m_states;
+	// このフレームのビュー・射影行列
+	DirectX::SimpleMath::Matrix m_view;
+	DirectX::SimpleMath::Matrix m_proj;
+	// 深度を 0～1 にする係数（ファークリップの逆数）
+	float m_depthScale;
+
+	// このフレームのマテリアルとパーツ
+	// 検索表は BeginFrame を呼んだスレッドのフレーム用アリーナに置く
+	std::vector<Material> m_materials;
+	ArenaHashMap<MaterialKey, uint32_t, MaterialKeyHash> m_materialIds;
+	std::vector<Part> m_parts;
+	// モデルごとの先頭のパーツの番号
+	ArenaHashMap<const DirectX::Model*, size_t, std::hash<const DirectX::Model*>> m_modelFirstParts;
+
+	// 発行中の状態
+	const Material* m_currentMaterial;
+	ID3D11Buffer* m_currentVertexBuffer;
+	ID3D11Buffer* m_currentIndexBuffer;
+};
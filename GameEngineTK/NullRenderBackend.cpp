@@ -0,0 +1,50 @@
+﻿#include "NullRenderBackend.h"
+
+#include <cstring>
+
+namespace
+{
+	// チェックサムに値を混ぜる
+	uint64_t Mix(uint64_t checksum, uint64_t value)
+	{
+		return (checksum ^ value) * 0x100000001B3ull;
+	}
+}
+
+NullRenderBackend::NullRenderBackend()
+{
+	Reset();
+}
+
+void NullRenderBackend::SetState(RenderPass pass, uint32_t state)
+{
+	m_counters.stateChanges++;
+	m_checksum = Mix(m_checksum, (static_cast<uint64_t>(pass) << 32) | state);
+}
+
+void NullRenderBackend::SetMaterial(uint32_t material)
+{
+	m_counters.materialChanges++;
+	m_checksum = Mix(m_checksum, material);
+}
+
+void NullRenderBackend::SetMesh(uint32_t mesh)
+{
+	m_counters.meshChanges++;
+	m_checksum = Mix(m_checksum, mesh);
+}
+
+void NullRenderBackend::Draw(uint32_t mesh, const Float4x4& world)
+{
+	m_counters.draws++;
+	// 行列の平行移動成分を読んで、実際に描画するときと同じくメモリに触れる
+	uint32_t bits;
+	std::memcpy(&bits, &world.m[3][0], sizeof(bits));
+	m_checksum = Mix(m_checksum, (static_cast<uint64_t>(bits) << 32) | mesh);
+}
+
+void NullRenderBackend::Reset()
+{
+	m_counters = Counters();
+	m_checksum = 0xCBF29CE484222325ull;
+}
@@ -0,0 +1,41 @@
+﻿/// <summary>
+/// 何も描画しない描画バックエンド（ソートと発行の計測用）
+/// </summary>
+#pragma once
+
+#include <cstdint>
+
+#include "RenderQueue.h"
+
+// 受け取った呼び出しを数えるだけで、グラフィックス API を使わない
+// Windows 以外でもキューの並べ替えと発行の時間、ステートの切り替え回数を計測できる
+class NullRenderBackend : public RenderBackend
+{
+public:
+	// 呼び出された回数
+	struct Counters
+	{
+		uint32_t stateChanges;
+		uint32_t materialChanges;
+		uint32_t meshChanges;
+		uint32_t draws;
+	};
+
+	NullRenderBackend();
+
+	void SetState(RenderPass pass, uint32_t state) override;
+	void SetMaterial(uint32_t material) override;
+	void SetMesh(uint32_t mesh) override;
+	void Draw(uint32_t mesh, const Float4x4& world) override;
+
+	// 呼び出された回数
+	const Counters& GetCounters() const { return m_counters; }
+	// 受け取った値から作る値（計測で呼び出しが最適化で消えないように使う）
+	uint64_t GetChecksum() const { return m_checksum; }
+	// 数え直す
+	void Reset();
+
+private:
+	Counters m_counters;
+	uint64_t m_checksum;
+};
@@ -1,5 +1,18 @@
 #include "Obj3d.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cwctype>
+#include <iterator>
+#include <set>
+#include <stdexcept>
+#include <VertexTypes.h>
+
+#include "CmoReader.h"
+#include "FileSystem.h"
+#include "Profiler.h"
+#include "TkmReader.h"
+
 using namespace DirectX;
 using namespace DirectX::SimpleMath;
 
@@ -14,6 +27,404 @@ Microsoft::WRL::ComPtr<ID3D11Device>            Obj3d::m_d3dDevice;
 Microsoft::WRL::ComPtr<ID3D11DeviceContext>     Obj3d::m_d3dContext;
 // GtFNgt@Ng
 std::unique_ptr<DirectX::EffectFactory> Obj3d::m_factory;
+// SIuWFNg̕ϊ
+TransformHierarchy Obj3d::m_transforms;
+// ǂݍ񂾃f
+ResourceCache<DirectX::Model> Obj3d::m_models;
+// ǂݍݒ̃f
+std::unordered_map<std::wstring, std::weak_ptr<Obj3d::PendingModel>> Obj3d::m_pendingModels;
+// t@C̔񓯊ǂݍ
+std::unique_ptr<AsyncFileLoader> Obj3d::m_fileLoader;
+// ǂݍݒɑɕ`悷郂f
+std::shared_ptr<DirectX::Model> Obj3d::m_placeholderModel;
+// ڍדx̑Iѕ
+float Obj3d::m_lodScreenWidth = 1280.0f;
+float Obj3d::m_lodThreshold = 1.0f;
+float Obj3d::m_lodHysteresis = 0.25f;
+// ڍדx̓v
+Obj3d::LodStatistics Obj3d::m_lodStatistics;
+// TKM ̊ȗ̌덷
+std::unordered_map<std::wstring, float> Obj3d::m_geometricErrors;
+// `掞̕Ԃ̊
+float Obj3d::m_interpolationAlpha = 1.0f;
+// SIuWFNg̋E{bNX
+DynamicAabbTree Obj3d::m_spatialIndex;
+// `R}hςރL[ƃobNGh
+RenderQueue* Obj3d::m_renderQueue;
+ModelRenderBackend* Obj3d::m_renderBackend;
+
+namespace
+{
+	// SimpleMath ̌^ƕϊp̌^͓zu
+	static_assert(sizeof(Vector3) == sizeof(Float3), "Vector3 layout mismatch");
+	static_assert(sizeof(Matrix) == sizeof(Float4x4), "Matrix layout mismatch");
+
+	Float3 ToFloat3(const Vector3& v)
+	{
+		Float3 result = { v.x, v.y, v.z };
+		return result;
+	}
+
+	Vector3 ToVector3(const Float3& v)
+	{
+		return Vector3(v.x, v.y, v.z);
+	}
+
+	// f GPU ɊmۂĂobt@̃oCg
+	size_t GetModelBytes(const Model& model)
+	{
+		// p[cmŃobt@LĂ邱Ƃ̂ŏd
+		std::set<ID3D11Buffer*> buffers;
+		for (const auto& mesh : model.meshes)
+		{
+			for (const auto& part : mesh->meshParts)
+			{
+				buffers.insert(part->vertexBuffer.Get());
+				buffers.insert(part->indexBuffer.Get());
+			}
+		}
+
+		size_t bytes = 0;
+		for (ID3D11Buffer* buffer : buffers)
+		{
+			if (buffer)
+			{
+				D3D11_BUFFER_DESC desc;
+				buffer->GetDesc(&desc);
+				bytes += desc.ByteWidth;
+			}
+		}
+		return bytes;
+	}
+
+	// f̎Op`̐
+	uint32_t CountTriangles(const Model& model)
+	{
+		uint32_t triangles = 0;
+		for (const auto& mesh : model.meshes)
+		{
+			for (const auto& part : mesh->meshParts)
+			{
+				triangles += part->indexCount / 3;
+			}
+		}
+		return triangles;
+	}
+
+	// [hs̊e̊g嗦̍ő
+	float GetMaxScale(const Matrix& world)
+	{
+		const float x = world._11 * world._11 + world._12 * world._12 + world._13 * world._13;
+		const float y = world._21 * world._21 + world._22 * world._22 + world._23 * world._23;
+		const float z = world._31 * world._31 + world._32 * world._32 + world._33 * world._33;
+		const float scale = x > y ? x : y;
+		return std::sqrt(scale > z ? scale : z);
+	}
+
+	// gq .tkm 
+	bool IsTkmFile(const std::wstring& fileName)
+	{
+		if (fileName.size() < 4)
+		{
+			return false;
+		}
+		std::wstring extension = fileName.substr(fileName.size() - 4);
+		for (wchar_t& c : extension)
+		{
+			c = towlower(c);
+		}
+		return extension == L".tkm";
+	}
+
+	// t@C̒gfƂēǂ߂邩
+	bool IsValidModelData(const std::wstring& fileName, const std::vector<uint8_t>& data)
+	{
+		if (IsTkmFile(fileName))
+		{
+			TkmReader reader;
+			return reader.Parse(data.data(), data.size());
+		}
+		CmoReader reader;
+		return reader.Parse(data.data(), data.size());
+	}
+
+	// sO𓊂
+	void ThrowIfFailed(HRESULT hr, const char* message)
+	{
+		if (FAILED(hr))
+		{
+			throw std::runtime_error(message);
+		}
+	}
+
+	// TKM ̒_iTkmGpuVertexj̓̓CAEg
+	const D3D11_INPUT_ELEMENT_DESC TKM_INPUT_ELEMENTS[] =
+	{
+		{ "SV_Position", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "NORMAL", 0, DXGI_FORMAT_R8G8B8A8_SNORM, 0, 12, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "COLOR", 0, DXGI_FORMAT_R8G8B8A8_UNORM, 0, 16, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "TEXCOORD", 0, DXGI_FORMAT_R16G16_FLOAT, 0, 20, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+	};
+
+	// f[^w肵ĕύXȂobt@
+	Microsoft::WRL::ComPtr<ID3D11Buffer> CreateImmutableBuffer(ID3D11Device* device, UINT bindFlags, const void* data, size_t bytes)
+	{
+		D3D11_BUFFER_DESC desc = {};
+		desc.ByteWidth = static_cast<UINT>(bytes);
+		desc.Usage = D3D11_USAGE_IMMUTABLE;
+		desc.BindFlags = bindFlags;
+
+		D3D11_SUBRESOURCE_DATA initData = {};
+		initData.pSysMem = data;
+
+		Microsoft::WRL::ComPtr<ID3D11Buffer> buffer;
+		ThrowIfFailed(device->CreateBuffer(&desc, &initData, buffer.GetAddressOf()), "CreateBuffer failed");
+		return buffer;
+	}
+
+	// }eA BasicEffect Ɠ̓CAEgiEffectFactory ƓݒAF RGB ̔z diffuse  A ܂ށj
+	// texture łȂ factory œǂݍœ\
+	std::shared_ptr<BasicEffect> CreateMaterialEffect(ID3D11Device* device, IEffectFactory& factory,
+		const float* ambient, const float* diffuse, const float* specular, float specularPower, const float* emissive,
+		const std::wstring& texture, const D3D11_INPUT_ELEMENT_DESC* inputElements, UINT inputElementCount,
+		Microsoft::WRL::ComPtr<ID3D11InputLayout>& inputLayout)
+	{
+		auto effect = std::make_shared<BasicEffect>(device);
+		effect->EnableDefaultLighting();
+		effect->SetLightingEnabled(true);
+		effect->SetVertexColorEnabled(true);
+		effect->SetAlpha(diffuse[3]);
+		effect->SetAmbientLightColor(Vector3(ambient));
+		effect->SetDiffuseColor(Vector3(diffuse));
+		if (specular[0] != 0.0f || specular[1] != 0.0f || specular[2] != 0.0f)
+		{
+			effect->SetSpecularColor(Vector3(specular));
+			effect->SetSpecularPower(specularPower);
+		}
+		else
+		{
+			effect->DisableSpecular();
+		}
+		effect->SetEmissiveColor(Vector3(emissive));
+
+		if (!texture.empty())
+		{
+			Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> textureView;
+			factory.CreateTexture(texture.c_str(), nullptr, textureView.GetAddressOf());
+			effect->SetTexture(textureView.Get());
+			effect->SetTextureEnabled(true);
+		}
+
+		const void* shaderByteCode;
+		size_t byteCodeLength;
+		effect->GetVertexShaderBytecode(&shaderByteCode, &byteCodeLength);
+		ThrowIfFailed(device->CreateInputLayout(inputElements, inputElementCount,
+			shaderByteCode, byteCodeLength, inputLayout.ReleaseAndGetAddressOf()), "CreateInputLayout failed");
+		return effect;
+	}
+
+	// TKM 烂f
+	// _ƃCfbNX͂ꂼP̃obt@ɂ܂Ƃ߁A}eAƂ BasicEffect 
+	std::shared_ptr<Model> CreateModelFromTkm(ID3D11Device* device, IEffectFactory& factory, const TkmReader& reader)
+	{
+		const TkmHeader& header = reader.GetHeader();
+
+		// W𕜌Ē_obt@
+		std::vector<TkmGpuVertex> vertices(header.vertexCount);
+		reader.DecodeVertices(vertices.data());
+		Microsoft::WRL::ComPtr<ID3D11Buffer> vertexBuffer = CreateImmutableBuffer(device,
+			D3D11_BIND_VERTEX_BUFFER, vertices.data(), vertices.size() * sizeof(TkmGpuVertex));
+
+		// CfbNX͓ǂݍ񂾃f[^̂܂܎g
+		Microsoft::WRL::ComPtr<ID3D11Buffer> indexBuffer = CreateImmutableBuffer(device,
+			D3D11_BIND_INDEX_BUFFER, reader.GetIndices(), header.indexCount * reader.GetIndexSize());
+		const DXGI_FORMAT indexFormat = reader.GetIndexSize() == 4 ? DXGI_FORMAT_R32_UINT : DXGI_FORMAT_R16_UINT;
+
+		auto vbDecl = std::make_shared<std::vector<D3D11_INPUT_ELEMENT_DESC>>(
+			std::begin(TKM_INPUT_ELEMENTS), std::end(TKM_INPUT_ELEMENTS));
+
+		// }eAƂ̃GtFNgƓ̓CAEgiEffectFactory Ɠݒj
+		std::vector<std::shared_ptr<BasicEffect>> effects;
+		std::vector<Microsoft::WRL::ComPtr<ID3D11InputLayout>> inputLayouts;
+		for (uint32_t i = 0; i < header.materialCount; i++)
+		{
+			const TkmMaterial& material = reader.GetMaterials()[i];
+			Microsoft::WRL::ComPtr<ID3D11InputLayout> inputLayout;
+			effects.push_back(CreateMaterialEffect(device, factory, material.ambient, material.diffuse,
+				material.specular, material.specularPower, material.emissive,
+				material.texture.length > 0 ? reader.GetString(material.texture) : std::wstring(),
+				TKM_INPUT_ELEMENTS, _countof(TKM_INPUT_ELEMENTS), inputLayout));
+			inputLayouts.push_back(inputLayout);
+		}
+
+		auto model = std::make_shared<Model>();
+		for (uint32_t m = 0; m < header.meshCount; m++)
+		{
+			const TkmMesh& tkmMesh = reader.GetMeshes()[m];
+			auto mesh = std::make_shared<ModelMesh>();
+			mesh->name = reader.GetString(tkmMesh.name);
+			mesh->ccw = true;
+			mesh->pmalpha = false;
+
+			// E̓NbJ[ŌvZς
+			const TkmBounds& bounds = tkmMesh.bounds;
+			mesh->boundingSphere.Center = Vector3(bounds.center);
+			mesh->boundingSphere.Radius = bounds.radius;
+			mesh->boundingBox.Center = (Vector3(bounds.aabbMin) + Vector3(bounds.aabbMax)) * 0.5f;
+			mesh->boundingBox.Extents = (Vector3(bounds.aabbMax) - Vector3(bounds.aabbMin)) * 0.5f;
+
+			for (uint32_t p = 0; p < tkmMesh.partCount; p++)
+			{
+				const TkmPart& tkmPart = reader.GetParts()[tkmMesh.firstPart + p];
+				const TkmMaterial& material = reader.GetMaterials()[tkmPart.materialIndex];
+
+				auto part = std::make_unique<ModelMeshPart>();
+				part->indexCount = tkmPart.indexCount;
+				part->startIndex = tkmPart.startIndex;
+				part->vertexOffset = tkmPart.baseVertex;
+				part->vertexStride = sizeof(TkmGpuVertex);
+				part->primitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+				part->indexFormat = indexFormat;
+				part->inputLayout = inputLayouts[tkmPart.materialIndex];
+				part->indexBuffer = indexBuffer;
+				part->vertexBuffer = vertexBuffer;
+				part->effect = effects[tkmPart.materialIndex];
+				part->vbDecl = vbDecl;
+				part->isAlpha = material.diffuse[3] < 1.0f;
+				mesh->meshParts.push_back(std::move(part));
+			}
+			model->meshes.push_back(mesh);
+		}
+		return model;
+	}
+
+	// CMO ̒_ VertexPositionNormalTangentColorTexture Ɠzu
+	static_assert(sizeof(CmoVertex) == sizeof(VertexPositionNormalTangentColorTexture), "CMO vertex layout mismatch");
+
+	// }eA UV ϊPʍs񂩁iBasicEffect  UV ϊɑΉȂj
+	bool IsIdentityUvTransform(const CmoMaterial& material)
+	{
+		for (int i = 0; i < 16; i++)
+		{
+			if (material.uvTransform[i] != (i % 5 == 0 ? 1.0f : 0.0f))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// CmoReader ŉ͂ CMO 烂f
+	// _ƃCfbNX̓}bvt@C̃f[^炻̂܂܃obt@A}eAƂ BasicEffect 
+	// XLjO UV ϊ͒_̏KvȂ̂ŁȀꍇ Model::CreateFromCMO ɔC
+	std::shared_ptr<Model> CreateModelFromCmo(ID3D11Device* device, IEffectFactory& factory, const CmoReader& reader)
+	{
+		for (const CmoMesh& cmoMesh : reader.GetMeshes())
+		{
+			bool isDirect = !cmoMesh.hasSkeleton && cmoMesh.skinningVertexBuffers.empty();
+			for (const CmoMaterialInfo& info : cmoMesh.materials)
+			{
+				isDirect = isDirect && IsIdentityUvTransform(info.material);
+			}
+			if (!isDirect)
+			{
+				return Model::CreateFromCMO(device, reader.GetData(), reader.GetSize(), factory);
+			}
+		}
+
+		const D3D11_INPUT_ELEMENT_DESC* inputElements = VertexPositionNormalTangentColorTexture::InputElements;
+		const UINT inputElementCount = VertexPositionNormalTangentColorTexture::InputElementCount;
+		auto vbDecl = std::make_shared<std::vector<D3D11_INPUT_ELEMENT_DESC>>(
+			inputElements, inputElements + inputElementCount);
+
+		auto model = std::make_shared<Model>();
+		for (const CmoMesh& cmoMesh : reader.GetMeshes())
+		{
+			auto mesh = std::make_shared<ModelMesh>();
+			mesh->name = cmoMesh.name.ToWString();
+			mesh->ccw = true;
+			mesh->pmalpha = false;
+
+			const CmoMeshExtents& extents = cmoMesh.extents;
+			mesh->boundingSphere.Center = Vector3(extents.centerX, extents.centerY, extents.centerZ);
+			mesh->boundingSphere.Radius = extents.radius;
+			const Vector3 aabbMin(extents.minX, extents.minY, extents.minZ);
+			const Vector3 aabbMax(extents.maxX, extents.maxY, extents.maxZ);
+			mesh->boundingBox.Center = (aabbMin + aabbMax) * 0.5f;
+			mesh->boundingBox.Extents = (aabbMax - aabbMin) * 0.5f;
+
+			// t@C̔ẑ܂܏f[^ɂ
+			std::vector<Microsoft::WRL::ComPtr<ID3D11Buffer>> vertexBuffers;
+			for (const CmoArray<CmoVertex>& vertices : cmoMesh.vertexBuffers)
+			{
+				vertexBuffers.push_back(CreateImmutableBuffer(device, D3D11_BIND_VERTEX_BUFFER,
+					vertices.data, vertices.GetBytes()));
+			}
+			std::vector<Microsoft::WRL::ComPtr<ID3D11Buffer>> indexBuffers;
+			for (const CmoArray<uint16_t>& indices : cmoMesh.indexBuffers)
+			{
+				indexBuffers.push_back(CreateImmutableBuffer(device, D3D11_BIND_INDEX_BUFFER,
+					indices.data, indices.GetBytes()));
+			}
+
+			// }eA Model::CreateFromCMO Ɠ̃}eAg
+			std::vector<CmoMaterial> materials;
+			std::vector<std::wstring> textures;
+			for (const CmoMaterialInfo& info : cmoMesh.materials)
+			{
+				materials.push_back(info.material);
+				textures.push_back(info.textures[0].ToWString());
+			}
+			if (materials.empty())
+			{
+				const CmoMaterial defaultMaterial =
+				{
+					{ 0.2f, 0.2f, 0.2f, 1.0f },
+					{ 0.8f, 0.8f, 0.8f, 1.0f },
+					{ 0.0f, 0.0f, 0.0f, 1.0f },
+					1.0f,
+					{ 0.0f, 0.0f, 0.0f, 1.0f },
+					{ 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f },
+				};
+				materials.push_back(defaultMaterial);
+				textures.push_back(std::wstring());
+			}
+			std::vector<std::shared_ptr<BasicEffect>> effects;
+			std::vector<Microsoft::WRL::ComPtr<ID3D11InputLayout>> inputLayouts;
+			for (size_t i = 0; i < materials.size(); i++)
+			{
+				const CmoMaterial& material = materials[i];
+				Microsoft::WRL::ComPtr<ID3D11InputLayout> inputLayout;
+				effects.push_back(CreateMaterialEffect(device, factory, material.ambient, material.diffuse,
+					material.specular, material.specularPower, material.emissive, textures[i],
+					inputElements, inputElementCount, inputLayout));
+				inputLayouts.push_back(inputLayout);
+			}
+
+			// TubV̎QƐ CmoReader mFς
+			for (uint32_t i = 0; i < cmoMesh.submeshes.count; i++)
+			{
+				const CmoSubMesh submesh = cmoMesh.submeshes.Get(i);
+				auto part = std::make_unique<ModelMeshPart>();
+				part->indexCount = submesh.primCount * 3;
+				part->startIndex = submesh.startIndex;
+				part->vertexOffset = 0;
+				part->vertexStride = sizeof(CmoVertex);
+				part->primitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+				part->indexFormat = DXGI_FORMAT_R16_UINT;
+				part->inputLayout = inputLayouts[submesh.materialIndex];
+				part->indexBuffer = indexBuffers[submesh.indexBufferIndex];
+				part->vertexBuffer = vertexBuffers[submesh.vertexBufferIndex];
+				part->effect = effects[submesh.materialIndex];
+				part->vbDecl = vbDecl;
+				part->isAlpha = materials[submesh.materialIndex].diffuse[3] < 1.0f;
+				mesh->meshParts.push_back(std::move(part));
+			}
+			model->meshes.push_back(mesh);
+		}
+		return model;
+	}
+}
 
 
 void Obj3d::InitializeStatic(Camera * pCamera, Microsoft::WRL::ComPtr<ID3D11Device> d3dDevice, Microsoft::WRL::ComPtr<ID3D11DeviceContext> d3dContext)
@@ -29,54 +440,568 @@ void Obj3d::InitializeStatic(Camera * pCamera, Microsoft::WRL::ComPtr<ID3D11Devi
 	m_factory = std::make_unique<EffectFactory>(m_d3dDevice.Get());
 	// eNX`̓ǂݍ݃tH_w
 	m_factory->SetDirectory(L"Resources");
+
+	// t@Cǂݍݗp̃XbhN
+	m_fileLoader = std::make_unique<AsyncFileLoader>();
+}
+
+void Obj3d::ProcessLoadedModels()
+{
+	PROFILE_SCOPE("Obj3d::ProcessLoadedModels");
+	// ǂݍݏIt@C烂f𐶐ifoCXĝŃQ[Xbhōsj
+	m_fileLoader->DispatchCompletions();
+	// `撆ɃfςȂ悤ɁA󂯎̂͂ɂ
+	m_spatialIndex.ForEachProxy([](int32_t proxy)
+	{
+		static_cast<Obj3d*>(m_spatialIndex.GetUserData(proxy))->AdoptLoadedModels();
+	});
+}
+
+void Obj3d::WaitForLoadedModels()
+{
+	m_fileLoader->Flush();
+	m_spatialIndex.ForEachProxy([](int32_t proxy)
+	{
+		static_cast<Obj3d*>(m_spatialIndex.GetUserData(proxy))->AdoptLoadedModels();
+	});
+}
+
+size_t Obj3d::GetPendingModelCount()
+{
+	return m_fileLoader->GetPendingCount();
+}
+
+void Obj3d::SetPlaceholderModel(const wchar_t* fileName)
+{
+	if (!fileName)
+	{
+		m_placeholderModel.reset();
+		return;
+	}
+	Obj3d placeholder;
+	placeholder.LoadModel(fileName);
+	m_placeholderModel = placeholder.m_model;
+}
+
+void Obj3d::SetRenderQueue(RenderQueue* queue, ModelRenderBackend* backend)
+{
+	m_renderQueue = queue;
+	m_renderBackend = backend;
+}
+
+void Obj3d::ComputeBoundingSphere(const Model& model, const Matrix& world, Float3* center, float* radius)
+{
+	// SẴbV̋E܂Ƃ߂
+	BoundingSphere sphere = {};
+	bool isFirst = true;
+	for (const auto& mesh : model.meshes)
+	{
+		if (isFirst)
+		{
+			sphere = mesh->boundingSphere;
+			isFirst = false;
+		}
+		else
+		{
+			BoundingSphere::CreateMerged(sphere, sphere, mesh->boundingSphere);
+		}
+	}
+
+	const Float3 modelCenter = { sphere.Center.x, sphere.Center.y, sphere.Center.z };
+	TransformSphere(modelCenter, sphere.Radius, reinterpret_cast<const Float4x4&>(world), center, radius);
+}
+
+void Obj3d::UpdateAll(JobSystem* jobs)
+{
+	PROFILE_SCOPE("Obj3d::UpdateAll");
+	// e珇ɂP̑ŁAύXꂽIuWFNgƂ̎qvZ
+	m_transforms.Update(jobs);
+
+	// [hs񂩃fς̂E{bNXXV
+	// ivLV̔ԍ͖؂gݑւĂςȂ̂ŁAɓĂ悢j
+	m_spatialIndex.ForEachProxy([](int32_t proxy)
+	{
+		static_cast<Obj3d*>(m_spatialIndex.GetUserData(proxy))->UpdateBounds();
+	});
+}
+
+void Obj3d::SetLodParameters(float screenWidth, float threshold, float hysteresis)
+{
+	m_lodScreenWidth = screenWidth;
+	m_lodThreshold = threshold;
+	m_lodHysteresis = hysteresis;
+}
+
+void Obj3d::QueryAabb(const Aabb& aabb, std::vector<Obj3d*>& result)
+{
+	m_spatialIndex.QueryAabb(aabb, [&result](int32_t proxy)
+	{
+		result.push_back(static_cast<Obj3d*>(m_spatialIndex.GetUserData(proxy)));
+		return true;
+	});
+}
+
+void Obj3d::QuerySphere(const Float3& center, float radius, std::vector<Obj3d*>& result)
+{
+	m_spatialIndex.QuerySphere(center, radius, [&result](int32_t proxy)
+	{
+		result.push_back(static_cast<Obj3d*>(m_spatialIndex.GetUserData(proxy)));
+		return true;
+	});
+}
+
+void Obj3d::QueryFrustum(const Frustum& frustum, std::vector<Obj3d*>& result)
+{
+	m_spatialIndex.QueryFrustum(frustum, [&result](int32_t proxy)
+	{
+		result.push_back(static_cast<Obj3d*>(m_spatialIndex.GetUserData(proxy)));
+		return true;
+	});
+}
+
+void Obj3d::QueryNearest(const Float3& point, size_t k, std::vector<Obj3d*>& result)
+{
+	std::vector<int32_t> proxies(k);
+	const size_t count = m_spatialIndex.QueryNearest(point, k, proxies.data(), nullptr);
+	result.resize(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		result[i] = static_cast<Obj3d*>(m_spatialIndex.GetUserData(proxies[i]));
+	}
 }
 
 Obj3d::Obj3d()
+	: m_lodLevel(0)
+	, m_boundsModel(nullptr)
+{
+	// ϊKwɃm[hǉiXP[Pŏj
+	m_transform = m_transforms.Create();
+	// ԃCfbNXɒǉifԂ͌_̓_j
+	m_proxy = m_spatialIndex.CreateProxy(AabbFromSphere(Float3(), 0.0f), this);
+}
+
+Obj3d::Obj3d(Obj3d&& other)
+	: m_model(std::move(other.m_model))
+	, m_pendingModel(std::move(other.m_pendingModel))
+	, m_transform(other.m_transform)
+	, m_lodLevels(std::move(other.m_lodLevels))
+	, m_lodLevel(other.m_lodLevel)
+	, m_proxy(other.m_proxy)
+	, m_boundsModel(other.m_boundsModel)
+{
+	other.m_transform = TransformHierarchy::INVALID_HANDLE;
+	other.m_proxy = DynamicAabbTree::NULL_NODE;
+	if (m_proxy != DynamicAabbTree::NULL_NODE)
+	{
+		m_spatialIndex.SetUserData(m_proxy, this);
+	}
+}
+
+Obj3d::~Obj3d()
+{
+	if (m_transform != TransformHierarchy::INVALID_HANDLE)
+	{
+		m_transforms.Destroy(m_transform);
+	}
+	if (m_proxy != DynamicAabbTree::NULL_NODE)
+	{
+		m_spatialIndex.DestroyProxy(m_proxy);
+	}
+}
+
+Obj3d& Obj3d::operator=(Obj3d&& other)
+{
+	if (this != &other)
+	{
+		if (m_transform != TransformHierarchy::INVALID_HANDLE)
+		{
+			m_transforms.Destroy(m_transform);
+		}
+		if (m_proxy != DynamicAabbTree::NULL_NODE)
+		{
+			m_spatialIndex.DestroyProxy(m_proxy);
+		}
+		m_model = std::move(other.m_model);
+		m_pendingModel = std::move(other.m_pendingModel);
+		m_transform = other.m_transform;
+		m_lodLevels = std::move(other.m_lodLevels);
+		m_lodLevel = other.m_lodLevel;
+		m_proxy = other.m_proxy;
+		m_boundsModel = other.m_boundsModel;
+		other.m_transform = TransformHierarchy::INVALID_HANDLE;
+		other.m_proxy = DynamicAabbTree::NULL_NODE;
+		if (m_proxy != DynamicAabbTree::NULL_NODE)
+		{
+			m_spatialIndex.SetUserData(m_proxy, this);
+		}
+	}
+	return *this;
+}
+
+Matrix Obj3d::GetDrawWorld() const
+{
+	const Matrix& world = GetWorld();
+	if (m_interpolationAlpha >= 1.0f || !m_transforms.IsWorldChanged(m_transform))
+	{
+		return world;
+	}
+
+	// gkE]EsړɕĕԂi]͋ʐ`ԁj
+	Matrix previous = reinterpret_cast<const Matrix&>(m_transforms.GetPreviousWorld(m_transform));
+	Matrix current = world;
+	Vector3 previousScale, currentScale, previousTranslation, currentTranslation;
+	Quaternion previousRotation, currentRotation;
+	if (!previous.Decompose(previousScale, previousRotation, previousTranslation)
+		|| !current.Decompose(currentScale, currentRotation, currentTranslation))
+	{
+		return world;
+	}
+	const float alpha = m_interpolationAlpha;
+	return Matrix::CreateScale(Vector3::Lerp(previousScale, currentScale, alpha))
+		* Matrix::CreateFromQuaternion(Quaternion::Slerp(previousRotation, currentRotation, alpha))
+		* Matrix::CreateTranslation(Vector3::Lerp(previousTranslation, currentTranslation, alpha));
+}
+
+void Obj3d::AdoptLoadedModels()
+{
+	if (m_pendingModel && (m_pendingModel->model || m_pendingModel->isFailed))
+	{
+		m_model = m_pendingModel->model;
+		m_pendingModel.reset();
+	}
+	for (LodLevel& level : m_lodLevels)
+	{
+		if (level.pendingModel && (level.pendingModel->model || level.pendingModel->isFailed))
+		{
+			level.model = level.pendingModel->model;
+			level.pendingModel.reset();
+		}
+	}
+	ResolveLodErrors();
+}
+
+void Obj3d::ResolveLodErrors()
+{
+	for (LodLevel& level : m_lodLevels)
+	{
+		if (level.isErrorFromFile && level.model)
+		{
+			// CMO ȗĂȂ TKM ͌덷 0 Ƃ
+			auto it = m_geometricErrors.find(level.model->name);
+			level.geometricError = it != m_geometricErrors.end() ? it->second : 0.0f;
+			level.isErrorFromFile = false;
+		}
+	}
+}
+
+const Model* Obj3d::SelectLodModel(const Matrix& world)
 {
-	// ϐ̏
-	m_scale = Vector3(1, 1, 1);
+	const uint32_t fullDetailTriangles = CountTriangles(*m_model);
+	m_lodStatistics.fullDetailTriangles += fullDetailTriangles;
+	if (m_lodLevels.empty() || !m_pCamera)
+	{
+		m_lodStatistics.submittedTriangles += fullDetailTriangles;
+		return m_model.get();
+	}
+
+	// ڍדxƂ̌덷ifԂ̌덷[hԂɒjƁAǂݍݏIĂ邩
+	const float scale = GetMaxScale(world);
+	const int MAX_LEVELS = 16;
+	float errors[MAX_LEVELS] = { 0.0f };
+	bool available[MAX_LEVELS] = { true };
+	const int count = static_cast<int>(std::min<size_t>(m_lodLevels.size() + 1, MAX_LEVELS));
+	for (int i = 1; i < count; i++)
+	{
+		const LodLevel& level = m_lodLevels[i - 1];
+		errors[i] = level.geometricError * scale;
+		available[i] = level.model != nullptr;
+	}
 
-	m_pObjParent = nullptr;
+	// ̃f̋EŁA_̋Ɖʏ̑傫߂
+	Float3 center;
+	float radius;
+	ComputeBoundingSphere(*m_model, world, &center, &radius);
+	const Vector3& eyePosition = m_pCamera->GetEyePos();
+	LodView view;
+	view.eyePosition = Float3{ eyePosition.x, eyePosition.y, eyePosition.z };
+	view.fovY = m_pCamera->GetFovY();
+	view.aspect = m_pCamera->GetAspect();
+	view.screenWidth = m_lodScreenWidth;
+	const float pixelsPerUnit = ComputePixelsPerUnit(view, center, radius);
+
+	m_lodLevel = SelectLod(errors, available, count, pixelsPerUnit, m_lodLevel, m_lodThreshold, m_lodHysteresis);
+	const Model* model = m_lodLevel == 0 ? m_model.get() : m_lodLevels[m_lodLevel - 1].model.get();
+	m_lodStatistics.submittedTriangles += CountTriangles(*model);
+	return model;
+}
+
+void Obj3d::UpdateBounds()
+{
+	const Model* model = GetDrawModel();
+	if (model == m_boundsModel && !m_transforms.IsWorldChanged(m_transform))
+	{
+		return;
+	}
+	m_boundsModel = model;
+
+	// fΈʒu̓_ɂ
+	Float3 center;
+	float radius = 0.0f;
+	if (model)
+	{
+		ComputeBoundingSphere(*model, GetWorld(), &center, &radius);
+	}
+	else
+	{
+		const Matrix& world = GetWorld();
+		center = Float3{ world._41, world._42, world._43 };
+	}
+	m_spatialIndex.MoveProxy(m_proxy, AabbFromSphere(center, radius));
+}
+
+const Model* Obj3d::GetDrawModel() const
+{
+	if (m_model)
+	{
+		return m_model.get();
+	}
+	if (m_pendingModel && !m_pendingModel->isFailed)
+	{
+		return m_pendingModel->model ? m_pendingModel->model.get() : m_placeholderModel.get();
+	}
+	return nullptr;
+}
+
+std::shared_ptr<Model> Obj3d::CreateModel(const std::wstring& fileName, const uint8_t* data, size_t size)
+{
+	std::shared_ptr<Model> model;
+	if (IsTkmFile(fileName))
+	{
+		TkmReader reader;
+		if (!reader.Parse(data, size))
+		{
+			throw std::runtime_error(ToUtf8(fileName) + ": " + reader.GetError());
+		}
+		model = CreateModelFromTkm(m_d3dDevice.Get(), *m_factory, reader);
+		m_geometricErrors[fileName] = reader.GetHeader().geometricError;
+	}
+	else
+	{
+		// ͂̓t@C̈ʒu𒲂ׂ邾ŁA_CfbNX̓Rs[Ȃ
+		CmoReader reader;
+		if (!reader.Parse(data, size))
+		{
+			throw std::runtime_error(ToUtf8(fileName) + ": " + reader.GetError());
+		}
+		model = CreateModelFromCmo(m_d3dDevice.Get(), *m_factory, reader);
+	}
+	model->name = fileName;
+	return model;
 }
 
 void Obj3d::LoadModel(const wchar_t * fileName)
 {
-	m_model = Model::CreateFromCMO(
-		m_d3dDevice.Get(),
-		fileName,
-		*m_factory
-	);
+	m_pendingModel.reset();
+
+	// t@C͂P񂾂ǂݍŋL
+	m_model = m_models.Get(fileName, [fileName](size_t& bytes)
+	{
+		std::shared_ptr<Model> model;
+		if (IsTkmFile(fileName))
+		{
+			// TKM ͂PœǂݍŁÂ܂܃obt@
+			std::vector<uint8_t> data;
+			if (!ReadWholeFile(fileName, data))
+			{
+				throw std::runtime_error(ToUtf8(fileName) + ": cannot read file");
+			}
+			model = CreateModel(fileName, data.data(), data.size());
+		}
+		else
+		{
+			// CMO ̓t@C}bvČ؂A}bv璼ڃobt@
+			CmoReader reader;
+			if (!reader.Open(fileName))
+			{
+				throw std::runtime_error(ToUtf8(fileName) + ": " + reader.GetError());
+			}
+			model = CreateModelFromCmo(m_d3dDevice.Get(), *m_factory, reader);
+			model->name = fileName;
+		}
+		bytes = GetModelBytes(*model);
+		return model;
+	});
+}
+
+void Obj3d::LoadModelAsync(const wchar_t * fileName)
+{
+	m_model.reset();
+	m_pendingModel = RequestModel(fileName, &m_model);
 }
 
-void Obj3d::Update()
+void Obj3d::AddLodLevel(const wchar_t* fileName, float geometricError)
 {
-	// svZ
-	// XP[Os
-	Matrix scalemat = Matrix::CreateScale(m_scale);
-	// ]s
-	Matrix rotmatZ = Matrix::CreateRotationZ(m_rotation.z);
-	Matrix rotmatX = Matrix::CreateRotationX(m_rotation.x);
-	Matrix rotmatY = Matrix::CreateRotationY(m_rotation.y);
-	Matrix rotmat = rotmatZ * rotmatX * rotmatY;
-	// sړs
-	Matrix transmat = Matrix::CreateTranslation(m_translation);
-	// [hs
-	m_world = scalemat * rotmat * transmat;
-	// e̍s
-	if (m_pObjParent)
+	LodLevel level;
+	level.pendingModel = RequestModel(fileName, &level.model);
+	level.geometricError = geometricError;
+	level.isErrorFromFile = false;
+	m_lodLevels.push_back(level);
+}
+
+void Obj3d::AddLodLevel(const wchar_t* fileName)
+{
+	LodLevel level;
+	level.pendingModel = RequestModel(fileName, &level.model);
+	level.geometricError = 0.0f;
+	level.isErrorFromFile = true;
+	m_lodLevels.push_back(level);
+	// ǂݍݍς݂Ȃ炷Ɍ덷
+	ResolveLodErrors();
+}
+
+std::shared_ptr<Obj3d::PendingModel> Obj3d::RequestModel(const std::wstring& path, std::shared_ptr<Model>* model)
+{
+	// ǂݍݍς݂Ȃ炷Ɏg
+	*model = m_models.Find(path);
+	if (*model)
 	{
-		m_world *= m_pObjParent->GetWorld();
+		return nullptr;
 	}
+
+	// t@CǂݍݒȂ炻̌ʂ҂
+	auto it = m_pendingModels.find(path);
+	if (it != m_pendingModels.end())
+	{
+		std::shared_ptr<PendingModel> pending = it->second.lock();
+		if (pending)
+		{
+			return pending;
+		}
+	}
+
+	std::shared_ptr<PendingModel> pending = std::make_shared<PendingModel>();
+	pending->isFailed = false;
+	m_pendingModels[path] = pending;
+
+	// t@C̓ǂݍ݂ʃXbhōsAf̐̓Q[Xbhōs
+	m_fileLoader->Load(path, [path, pending](bool isSucceeded, std::vector<uint8_t>& data)
+	{
+		// ォ瓯t@C̓ǂݍ݂n܂Ă΁A̋L^͎c
+		auto it = m_pendingModels.find(path);
+		if (it != m_pendingModels.end() && it->second.lock() == pending)
+		{
+			m_pendingModels.erase(it);
+		}
+		if (!isSucceeded)
+		{
+			pending->isFailed = true;
+			return;
+		}
+		try
+		{
+			pending->model = m_models.Get(path, [&path, &data](size_t& bytes)
+			{
+				std::shared_ptr<Model> model = CreateModel(path, data.data(), data.size());
+				bytes = GetModelBytes(*model);
+				return model;
+			});
+		}
+		catch (...)
+		{
+			// ꂽt@CłQ[͎~߂Ãf̂܂܂ɂ
+			pending->isFailed = true;
+		}
+	},
+	[path](std::vector<uint8_t>& data)
+	{
+		// ꂽt@C͓ǂݍ݃Xbhł͂
+		return IsValidModelData(path, data);
+	});
+	return pending;
+}
+
+void Obj3d::SetScale(const Vector3& scale)
+{
+	m_transforms.SetScale(m_transform, ToFloat3(scale));
+}
+
+void Obj3d::SetRotation(const Vector3& rotation)
+{
+	m_transforms.SetRotation(m_transform, ToFloat3(rotation));
+}
+
+void Obj3d::SetTranslation(const Vector3& translation)
+{
+	m_transforms.SetTranslation(m_transform, ToFloat3(translation));
+}
+
+void Obj3d::SetObjParent(Obj3d* pObjParent)
+{
+	m_transforms.SetParent(m_transform,
+		pObjParent ? pObjParent->m_transform : TransformHierarchy::INVALID_HANDLE);
+}
+
+Vector3 Obj3d::GetScale() const
+{
+	return ToVector3(m_transforms.GetScale(m_transform));
+}
+
+Vector3 Obj3d::GetRotation() const
+{
+	return ToVector3(m_transforms.GetRotation(m_transform));
+}
+
+Vector3 Obj3d::GetTranslation() const
+{
+	return ToVector3(m_transforms.GetTranslation(m_transform));
+}
+
+const Matrix& Obj3d::GetWorld() const
+{
+	return reinterpret_cast<const Matrix&>(m_transforms.GetWorld(m_transform));
+}
+
+bool Obj3d::GetBoundingSphere(Float3* center, float* radius) const
+{
+	const Model* model = GetDrawModel();
+	if (!model)
+	{
+		return false;
+	}
+	ComputeBoundingSphere(*model, GetWorld(), center, radius);
+	return true;
 }
 
 void Obj3d::Draw()
 {
-	// f`
-	if (m_model)
+	Draw(GetDrawWorld());
+}
+
+void Obj3d::Draw(const Matrix& world)
+{
+	PROFILE_SCOPE("Obj3d::Draw");
+	// ǂݍݒ͑̃f`
+	const Model* model = GetDrawModel();
+	if (!model)
+	{
+		return;
+	}
+	// ǂݍݏIĂΉʏ̑傫ŏڍדxI
+	if (model == m_model.get())
+	{
+		model = SelectLodModel(world);
+	}
+
+	// L[΃R}hς݁A΂̏ŕ`
+	if (m_renderQueue && m_renderBackend)
+	{
+		m_renderBackend->AddModel(*m_renderQueue, *model, world);
+	}
+	else
 	{
-		m_model->Draw(m_d3dContext.Get(),
+		model->Draw(m_d3dContext.Get(),
 			*m_states,
-			m_world,
+			world,
 			m_pCamera->GetView(),
 			m_pCamera->GetProj());
 	}
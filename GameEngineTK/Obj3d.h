@@ -4,6 +4,9 @@
 #pragma once
 
 #include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
 #include <windows.h>
 #include <wrl/client.h>
 #include <Effects.h>
@@ -11,7 +14,16 @@
 #include <SimpleMath.h>
 #include <Model.h>
 
+#include "AsyncFileLoader.h"
 #include "Camera.h"
+#include "DynamicAabbTree.h"
+#include "LodSelector.h"
+#include "FrustumCulling.h"
+#include "ModelRenderBackend.h"
+#include "RenderQueue.h"
+#include "ResourceCache.h"
+#include "TransformHierarchy.h"
+#include "JobSystem.h"
 
 class Obj3d
 {
@@ -22,6 +34,15 @@ public:
 		Microsoft::WRL::ComPtr<ID3D11Device> d3dDevice,
 		Microsoft::WRL::ComPtr<ID3D11DeviceContext> d3dContext);
 
+	// ڍדx̓v
+	struct LodStatistics
+	{
+		// `ɉ񂵂Op`̐
+		uint32_t submittedTriangles;
+		// Sčłׂڍדxŕ`悵ꍇ̎Op`̐
+		uint32_t fullDetailTriangles;
+	};
+
 private:
 	// J
 	static Camera* m_pCamera;
@@ -33,53 +54,173 @@ private:
 	static std::unique_ptr<DirectX::CommonStates> m_states;
 	// GtFNgt@Ng
 	static std::unique_ptr<DirectX::EffectFactory> m_factory;
-
-	//static std::map<DirectX::Model, wstring> m_models;
+	// SIuWFNg̕ϊieqOɕԁj
+	static TransformHierarchy m_transforms;
+	// ǂݍ񂾃fit@CpXŋLj
+	static ResourceCache<DirectX::Model> m_models;
+	// 񓯊ǂݍݒ̃f
+	struct PendingModel
+	{
+		// ǂݍݏIf
+		std::shared_ptr<DirectX::Model> model;
+		// ǂݍ݂Ɏs
+		bool isFailed;
+	};
+	// ǂݍݒ̃fit@C̈˗͂Pɂ܂Ƃ߂j
+	static std::unordered_map<std::wstring, std::weak_ptr<PendingModel>> m_pendingModels;
+	// t@C̔񓯊ǂݍ
+	static std::unique_ptr<AsyncFileLoader> m_fileLoader;
+	// ǂݍݒɑɕ`悷郂f
+	static std::shared_ptr<DirectX::Model> m_placeholderModel;
+	// ڍדxIԉʂ̉isNZjAe덷isNZjA؂ւ̗]T
+	static float m_lodScreenWidth;
+	static float m_lodThreshold;
+	static float m_lodHysteresis;
+	// ڍדx̓v
+	static LodStatistics m_lodStatistics;
+	// TKM ̃wb_[ɂȗ̌덷it@CpXƁj
+	static std::unordered_map<std::wstring, float> m_geometricErrors;
+	// Oƌ݂̃V~[V̏Ԃ̊Ԃ̕Ԃ̊i`掞̃[hsɎgj
+	static float m_interpolationAlpha;
+	// SIuWFNg̋E{bNXivLṼ[U[f[^ Obj3d*j
+	static DynamicAabbTree m_spatialIndex;
+	// `R}hςރL[ƃobNGhi΂̏ŕ`j
+	static RenderQueue* m_renderQueue;
+	static ModelRenderBackend* m_renderBackend;
 
 public:
+	// ύX̂IuWFNg̃[hsvZijobs ΕɌvZj
+	static void UpdateAll(JobSystem* jobs = nullptr);
+	// `悷郏[hsAO UpdateAll ̑ȌԂ̊Ԃ alphai0`1j̊ŕԂ
+	static void SetInterpolationAlpha(float alpha) { m_interpolationAlpha = alpha; }
+	// ڍדx̑Iѕݒ
+	static void SetLodParameters(float screenWidth, float threshold = 1.0f, float hysteresis = 0.25f);
+	// ڍדx̓vOɖ߂it[̎n߂ɌĂԁj
+	static void ResetLodStatistics() { m_lodStatistics = LodStatistics(); }
+	// O ResetLodStatistics Ă`悵Op`̐
+	static const LodStatistics& GetLodStatistics() { return m_lodStatistics; }
+	// ԃCfbNXŋE{bNXdȂIuWFNgTiʂ result ̌ɑj
+	static void QueryAabb(const Aabb& aabb, std::vector<Obj3d*>& result);
+	static void QuerySphere(const Float3& center, float radius, std::vector<Obj3d*>& result);
+	static void QueryFrustum(const Frustum& frustum, std::vector<Obj3d*>& result);
+	// point ɋ߂ɍő k ̃IuWFNgTiresult ͋߂ɒuj
+	static void QueryNearest(const Float3& point, size_t k, std::vector<Obj3d*>& result);
+	// ԃCfbNX擾iv̊mFpj
+	static const DynamicAabbTree& GetSpatialIndex() { return m_spatialIndex; }
+	// O UpdateAll ōČvZ[hs̐
+	static size_t GetRebuiltWorldCount() { return m_transforms.GetRebuiltCount(); }
+	// SẴIuWFNg̕ϊ̊Kwi`ɈˑȂm[h𒼐ړj
+	static TransformHierarchy& GetTransforms() { return m_transforms; }
+	// fLbV擾iv̊mF\Z̐ݒpj
+	static ResourceCache<DirectX::Model>& GetModelCache() { return m_models; }
+	// ǂݍݏIf𐶐ăIuWFNgɓnit[A`OɌĂԁj
+	// ʂ̃Xbh UpdateAll ĂƂ́AꂪIĂĂ
+	static void ProcessLoadedModels();
+	// ǂݍݒ̃fSĐ܂ő҂
+	static void WaitForLoadedModels();
+	// ǂݍݒ̃t@C̐
+	static size_t GetPendingModelCount();
+	// ǂݍݒɑɕ`悷郂fݒinullptr Ȃ牽`悵Ȃj
+	static void SetPlaceholderModel(const wchar_t* fileName);
+	// Draw ŃR}hςރL[ݒinullptr Ȃ炻̏ŕ`j
+	static void SetRenderQueue(RenderQueue* queue, ModelRenderBackend* backend);
+	// f̋E[hsŕϊċ߂
+	static void ComputeBoundingSphere(const DirectX::Model& model, const DirectX::SimpleMath::Matrix& world,
+		Float3* center, float* radius);
+
 	// RXgN^
 	Obj3d();
+	// [uRXgN^
+	Obj3d(Obj3d&& other);
+	// fXgN^
+	~Obj3d();
+	// [u
+	Obj3d& operator=(Obj3d&& other);
 
-	// f̓ǂݍ
+	// f̓ǂݍ݁i.cmo ܂ .tkmj
 	void LoadModel(const wchar_t* fileName);
+	// f̔񓯊ǂݍ݁iǂݍݏI܂ł͕`悵Ȃ̃f`j
+	void LoadModelAsync(const wchar_t* fileName);
+	// ȗfڍדxƂĒǉieɒǉAgeometricError  TkmCooker \郂fԂ̌덷j
+	// ǂݍ݂͔񓯊ŁAǂݍ߂Ȃڍדx͎gȂ
+	void AddLodLevel(const wchar_t* fileName, float geometricError);
+	// TkmCooker -lod ŏo TKM ڍדxƂĒǉi덷̓t@C̃wb_[̒lgj
+	void AddLodLevel(const wchar_t* fileName);
+	// O̕`őI񂾏ڍדxi0 ̃fj
+	int GetLodLevel() const { return m_lodLevel; }
+	// fgԂ
+	bool IsModelReady() const { return m_model || (m_pendingModel && m_pendingModel->model); }
+	// `悷郂f̃[hԂ̋E擾i`悷郂f falsej
+	bool GetBoundingSphere(Float3* center, float* radius) const;
 
-	void Update();
-
+	// `iL[ݒ肳Ă΃R}hςނj
 	void Draw();
+	// [hsw肵ĕ`iV~[Vƕʂ̃XbhŁAʂsŕ`悷pj
+	void Draw(const DirectX::SimpleMath::Matrix& world);
+	// Ԃ`p̃[hsiSetInterpolationAlpha ̊j
+	DirectX::SimpleMath::Matrix GetDrawWorld() const;
 
 	// setter
 	// XP[Op
-	void SetScale(const DirectX::SimpleMath::Vector3& scale) { m_scale = scale; }
+	void SetScale(const DirectX::SimpleMath::Vector3& scale);
 	// ]pp
-	void SetRotation(const DirectX::SimpleMath::Vector3& rotation) { m_rotation = rotation; }
+	void SetRotation(const DirectX::SimpleMath::Vector3& rotation);
 	// sړp
-	void SetTranslation(const DirectX::SimpleMath::Vector3& translation) { m_translation = translation; }
+	void SetTranslation(const DirectX::SimpleMath::Vector3& translation);
 	// esp
-	void SetObjParent(Obj3d* pObjParent) { m_pObjParent = pObjParent; }
+	void SetObjParent(Obj3d* pObjParent);
 	// getter
 	// XP[Op
-	const DirectX::SimpleMath::Vector3& GetScale() { return m_scale; }
+	DirectX::SimpleMath::Vector3 GetScale() const;
 	// ]pp
-	const DirectX::SimpleMath::Vector3& GetRotation() { return m_rotation; }
+	DirectX::SimpleMath::Vector3 GetRotation() const;
 	// sړp
-	const DirectX::SimpleMath::Vector3& GetTranslation() { return m_translation; }
+	DirectX::SimpleMath::Vector3 GetTranslation() const;
 	// [hs擾
-	const DirectX::SimpleMath::Matrix& GetWorld() { return m_world; }
-	// esp
-	Obj3d* GetObjParent() { return m_pObjParent; }
+	const DirectX::SimpleMath::Matrix& GetWorld() const;
+	// ϊ̊Kw̃m[h擾
+	TransformHierarchy::Handle GetTransformHandle() const { return m_transform; }
 
 private:
-	// f̃j[N|C^
-	std::unique_ptr<DirectX::Model> m_model;
-	// XP[O
-	DirectX::SimpleMath::Vector3 m_scale;
-	// ]p
-	DirectX::SimpleMath::Vector3 m_rotation;
-	// sړ
-	DirectX::SimpleMath::Vector3 m_translation;
-	// [hs
-	DirectX::SimpleMath::Matrix m_world;
-	// eƂȂRcIuWFNg̃NX̃|C^
-	Obj3d* m_pObjParent;
+	Obj3d(const Obj3d&) = delete;
+	Obj3d& operator=(const Obj3d&) = delete;
+
+	// t@C̓ǂݍ݂˗iǂݍݍς݂Ȃ model ɓ nullptr Ԃj
+	static std::shared_ptr<PendingModel> RequestModel(const std::wstring& path, std::shared_ptr<DirectX::Model>* model);
+	// ǂݍݏIf󂯎
+	void AdoptLoadedModels();
+	// t@Č덷gڍדx̂Af󂯎̂̌덷߂
+	void ResolveLodErrors();
+	// world ɒuƂ̉ʏ̑傫ŏڍדxIсÃfԂ
+	const DirectX::Model* SelectLodModel(const DirectX::SimpleMath::Matrix& world);
+	// ԃCfbNX̋E{bNXXV
+	void UpdateBounds();
+	// `悷郂fiǂݍݒ͑̃fj
+	const DirectX::Model* GetDrawModel() const;
+	// ǂݍ񂾃f[^烂figq .tkm Ȃ TKMAȊO CMO ƂĈj
+	static std::shared_ptr<DirectX::Model> CreateModel(const std::wstring& fileName, const uint8_t* data, size_t size);
+
+	// fit@C̃IuWFNgŋLj
+	std::shared_ptr<DirectX::Model> m_model;
+	// ǂݍݒ̃f
+	std::shared_ptr<PendingModel> m_pendingModel;
+	// ϊKw̃nhieq֌WŊǗj
+	TransformHierarchy::Handle m_transform;
+	// ȗfi1 Ԉȍ~̏ڍדxj
+	struct LodLevel
+	{
+		std::shared_ptr<DirectX::Model> model;
+		std::shared_ptr<PendingModel> pendingModel;
+		float geometricError;
+		// 덷t@C̃wb_[if󂯎܂ł͕sj
+		bool isErrorFromFile;
+	};
+	std::vector<LodLevel> m_lodLevels;
+	// Iłڍדx
+	int m_lodLevel;
+	// ԃCfbNX̃vLV
+	int32_t m_proxy;
+	// E{bNX߂Ƃ̃fiς狁ߒj
+	const DirectX::Model* m_boundsModel;
 };
 
@@ -0,0 +1,344 @@
+﻿#include "Profiler.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#include "Clock.h"
+#include "FileSystem.h"
+#include "FrameArena.h"
+
+namespace
+{
+	// 呼び出し元のスレッドのバッファ
+	thread_local ProfileThreadBuffer* t_threadBuffer = nullptr;
+
+	// 集計するフレーム数の既定値
+	const uint32_t DEFAULT_SUMMARY_WINDOW = 60;
+
+	// JSON の文字列として書き出す
+	void AppendJsonString(std::string& output, const char* text)
+	{
+		output += '"';
+		for (const char* c = text; *c; c++)
+		{
+			switch (*c)
+			{
+			case '"': output += "\\\""; break;
+			case '\\': output += "\\\\"; break;
+			case '\n': output += "\\n"; break;
+			default:
+				if (static_cast<unsigned char>(*c) < 0x20)
+				{
+					char escaped[8];
+					std::snprintf(escaped, sizeof(escaped), "\\u%04x", *c);
+					output += escaped;
+				}
+				else
+				{
+					output += *c;
+				}
+				break;
+			}
+		}
+		output += '"';
+	}
+}
+
+std::atomic<bool> Profiler::m_enabled(false);
+std::mutex Profiler::m_threadMutex;
+std::vector<std::unique_ptr<ProfileThreadBuffer>> Profiler::m_threadBuffers;
+std::vector<std::string> Profiler::m_threadNames;
+std::vector<ProfileEvent> Profiler::m_frameEvents;
+std::vector<ProfileEvent> Profiler::m_capturedEvents;
+uint32_t Profiler::m_captureFramesLeft = 0;
+std::vector<Profiler::Statistic> Profiler::m_statistics;
+uint32_t Profiler::m_summaryWindow = DEFAULT_SUMMARY_WINDOW;
+uint32_t Profiler::m_summaryFrame = 0;
+uint32_t Profiler::m_summaryFrameCount = 0;
+uint64_t Profiler::m_droppedTotal = 0;
+
+ProfileThreadBuffer::ProfileThreadBuffer(uint32_t threadId)
+	: m_threadId(threadId)
+	, m_depth(0)
+	, m_events(CAPACITY)
+	, m_writeIndex(0)
+	, m_readIndex(0)
+	, m_droppedCount(0)
+{
+}
+
+void ProfileThreadBuffer::End(const char* name, uint64_t begin, uint64_t end, uint32_t depth)
+{
+	m_depth = depth;
+
+	const uint64_t write = m_writeIndex.load(std::memory_order_relaxed);
+	if (write - m_readIndex.load(std::memory_order_acquire) >= CAPACITY)
+	{
+		// 読み出しが追いつくまで捨てる
+		m_droppedCount.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+	ProfileEvent& event = m_events[write & (CAPACITY - 1)];
+	event.name = name;
+	event.begin = begin;
+	event.end = end;
+	event.depth = depth;
+	event.threadId = m_threadId;
+	m_writeIndex.store(write + 1, std::memory_order_release);
+}
+
+void ProfileThreadBuffer::Drain(std::vector<ProfileEvent>& output)
+{
+	const uint64_t read = m_readIndex.load(std::memory_order_relaxed);
+	const uint64_t write = m_writeIndex.load(std::memory_order_acquire);
+	for (uint64_t i = read; i < write; i++)
+	{
+		output.push_back(m_events[i & (CAPACITY - 1)]);
+	}
+	m_readIndex.store(write, std::memory_order_release);
+}
+
+ProfileThreadBuffer& Profiler::GetThreadBuffer()
+{
+	if (!t_threadBuffer)
+	{
+		std::lock_guard<std::mutex> lock(m_threadMutex);
+		m_threadBuffers.push_back(std::make_unique<ProfileThreadBuffer>(static_cast<uint32_t>(m_threadBuffers.size())));
+		m_threadNames.resize(m_threadBuffers.size());
+		t_threadBuffer = m_threadBuffers.back().get();
+	}
+	return *t_threadBuffer;
+}
+
+uint64_t Profiler::GetTime()
+{
+	static Clock& clock = GetDefaultClock();
+	return clock.GetCounter();
+}
+
+void Profiler::SetThreadName(const char* name)
+{
+	const uint32_t threadId = GetThreadBuffer().GetThreadId();
+	std::lock_guard<std::mutex> lock(m_threadMutex);
+	m_threadNames[threadId] = name;
+}
+
+void Profiler::EndFrame()
+{
+	// 全てのスレッドから今までに終わった区間を集める
+	m_frameEvents.clear();
+	{
+		std::lock_guard<std::mutex> lock(m_threadMutex);
+		for (const std::unique_ptr<ProfileThreadBuffer>& buffer : m_threadBuffers)
+		{
+			buffer->Drain(m_frameEvents);
+			m_droppedTotal += buffer->TakeDroppedCount();
+		}
+	}
+
+	// 集計のリングを１フレーム進めて、今のフレームの欄を空にする
+	m_summaryFrame = (m_summaryFrame + 1) % m_summaryWindow;
+	m_summaryFrameCount = std::min(m_summaryFrameCount + 1, m_summaryWindow);
+	for (Statistic& statistic : m_statistics)
+	{
+		statistic.totals[m_summaryFrame] = 0;
+		statistic.selfTotals[m_summaryFrame] = 0;
+		statistic.calls[m_summaryFrame] = 0;
+	}
+	// スレッドごとに続けて並んでいるので、スレッドの区切りごとに集計する
+	size_t begin = 0;
+	for (size_t i = 1; i <= m_frameEvents.size(); i++)
+	{
+		if (i == m_frameEvents.size() || m_frameEvents[i].threadId != m_frameEvents[begin].threadId)
+		{
+			Accumulate(m_frameEvents, begin, i);
+			begin = i;
+		}
+	}
+
+	if (m_captureFramesLeft > 0)
+	{
+		m_capturedEvents.insert(m_capturedEvents.end(), m_frameEvents.begin(), m_frameEvents.end());
+		m_captureFramesLeft--;
+	}
+}
+
+void Profiler::Accumulate(const std::vector<ProfileEvent>& events, size_t begin, size_t end)
+{
+	// 区間は終わった順に並ぶので、内側の区間は外側より先に来る
+	// 深さごとに、まだ外側の区間に引かれていない内側の時間を溜めておく
+	// 作業用の配列はアリーナから取り、抜けるときに戻す
+	FrameArena& arena = FrameArena::GetThreadArena();
+	FrameArenaScope scope(arena);
+	ArenaVector<uint64_t> childTimes(arena, 16);
+	for (size_t i = begin; i < end; i++)
+	{
+		const ProfileEvent& event = events[i];
+		const uint64_t duration = event.end - event.begin;
+		if (childTimes.size() < event.depth + 2)
+		{
+			childTimes.resize(event.depth + 2, 0);
+		}
+		const uint64_t childTime = std::min(childTimes[event.depth + 1], duration);
+		childTimes[event.depth + 1] = 0;
+		childTimes[event.depth] += duration;
+
+		Statistic& statistic = FindStatistic(event);
+		statistic.totals[m_summaryFrame] += duration;
+		statistic.selfTotals[m_summaryFrame] += duration - childTime;
+		statistic.calls[m_summaryFrame]++;
+	}
+}
+
+Profiler::Statistic& Profiler::FindStatistic(const ProfileEvent& event)
+{
+	const char* name = event.name;
+	// 同じ文字列が別のアドレスにあることもあるので、アドレスが違えば中身も比べる
+	for (Statistic& statistic : m_statistics)
+	{
+		if (statistic.name == name || std::strcmp(statistic.name, name) == 0)
+		{
+			return statistic;
+		}
+	}
+	Statistic statistic;
+	statistic.name = name;
+	statistic.depth = event.depth;
+	statistic.firstBegin = event.begin;
+	statistic.totals.assign(m_summaryWindow, 0);
+	statistic.selfTotals.assign(m_summaryWindow, 0);
+	statistic.calls.assign(m_summaryWindow, 0);
+	m_statistics.push_back(std::move(statistic));
+	return m_statistics.back();
+}
+
+void Profiler::StartCapture(uint32_t frameCount)
+{
+	m_capturedEvents.clear();
+	m_captureFramesLeft = frameCount;
+}
+
+void Profiler::StopCapture()
+{
+	m_captureFramesLeft = 0;
+}
+
+bool Profiler::WriteChromeTrace(const std::wstring& path)
+{
+	// 時刻は最初の区間からのマイクロ秒で書く
+	const double microsecondsPerCount = 1e6 / GetDefaultClock().GetFrequency();
+	uint64_t origin = UINT64_MAX;
+	for (const ProfileEvent& event : m_capturedEvents)
+	{
+		origin = std::min(origin, event.begin);
+	}
+
+	std::string json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	char number[128];
+	bool first = true;
+	{
+		std::lock_guard<std::mutex> lock(m_threadMutex);
+		for (size_t i = 0; i < m_threadNames.size(); i++)
+		{
+			if (m_threadNames[i].empty())
+			{
+				continue;
+			}
+			std::snprintf(number, sizeof(number), "%s{\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"name\":\"thread_name\",\"args\":{\"name\":",
+				first ? "" : ",\n", static_cast<unsigned>(i));
+			json += number;
+			AppendJsonString(json, m_threadNames[i].c_str());
+			json += "}}";
+			first = false;
+		}
+	}
+	for (const ProfileEvent& event : m_capturedEvents)
+	{
+		json += first ? "" : ",\n";
+		json += "{\"ph\":\"X\",\"cat\":\"cpu\",\"name\":";
+		AppendJsonString(json, event.name);
+		std::snprintf(number, sizeof(number), ",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+			event.threadId, (event.begin - origin) * microsecondsPerCount, (event.end - event.begin) * microsecondsPerCount);
+		json += number;
+		first = false;
+	}
+	json += "\n]}\n";
+	return WriteWholeFile(path, json.data(), json.size());
+}
+
+void Profiler::SetSummaryWindow(uint32_t frameCount)
+{
+	m_summaryWindow = std::max(frameCount, 1u);
+	m_summaryFrame = 0;
+	m_summaryFrameCount = 0;
+	m_statistics.clear();
+}
+
+void Profiler::GetSummary(std::vector<ProfileSummaryEntry>& summary)
+{
+	summary.clear();
+	if (m_summaryFrameCount == 0)
+	{
+		return;
+	}
+	const double millisecondsPerCount = 1e3 / GetDefaultClock().GetFrequency();
+	for (const Statistic& statistic : m_statistics)
+	{
+		uint64_t total = 0, selfTotal = 0, maxTotal = 0, calls = 0;
+		for (uint32_t i = 0; i < m_summaryWindow; i++)
+		{
+			total += statistic.totals[i];
+			selfTotal += statistic.selfTotals[i];
+			maxTotal = std::max(maxTotal, statistic.totals[i]);
+			calls += statistic.calls[i];
+		}
+		ProfileSummaryEntry entry;
+		entry.name = statistic.name;
+		entry.depth = statistic.depth;
+		entry.averageMs = total * millisecondsPerCount / m_summaryFrameCount;
+		entry.averageSelfMs = selfTotal * millisecondsPerCount / m_summaryFrameCount;
+		entry.maxMs = maxTotal * millisecondsPerCount;
+		entry.averageCalls = static_cast<double>(calls) / m_summaryFrameCount;
+		summary.push_back(entry);
+	}
+	// 区間は終わった順に記録されるので、開始順に並べ直して外側の区間を先にする
+	std::vector<size_t> order(m_statistics.size());
+	for (size_t i = 0; i < order.size(); i++)
+	{
+		order[i] = i;
+	}
+	std::stable_sort(order.begin(), order.end(), [](size_t a, size_t b)
+	{
+		return m_statistics[a].firstBegin < m_statistics[b].firstBegin;
+	});
+	std::vector<ProfileSummaryEntry> sorted;
+	sorted.reserve(summary.size());
+	for (size_t i : order)
+	{
+		sorted.push_back(summary[i]);
+	}
+	summary.swap(sorted);
+}
+
+std::string Profiler::FormatSummary(uint32_t maxDepth)
+{
+	std::vector<ProfileSummaryEntry> summary;
+	GetSummary(summary);
+
+	std::string text;
+	char line[256];
+	for (const ProfileSummaryEntry& entry : summary)
+	{
+		if (entry.depth > maxDepth)
+		{
+			continue;
+		}
+		const int indent = static_cast<int>(std::min(entry.depth * 2, 24u));
+		std::snprintf(line, sizeof(line), "%*s%-*s %9.4f ms (self %9.4f, max %9.4f) x%.1f\n",
+			indent, "", 32 - indent, entry.name,
+			entry.averageMs, entry.averageSelfMs, entry.maxMs, entry.averageCalls);
+		text += line;
+	}
+	return text;
+}
@@ -0,0 +1,203 @@
+﻿/// <summary>
+/// 区間ごとの CPU 時間を計測するプロファイラ（Chrome トレース形式で書き出せる）
+/// </summary>
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// 0 にすると PROFILE_SCOPE が何も生成しなくなる
+#ifndef PROFILER_ENABLED
+#define PROFILER_ENABLED 1
+#endif
+
+// 計測した１区間
+struct ProfileEvent
+{
+	// 区間の名前（文字列リテラルなど、プログラムの終了まで残る文字列）
+	const char* name;
+	// 開始と終了の時刻（Clock のカウント）
+	uint64_t begin;
+	uint64_t end;
+	// 入れ子の深さ（0 が一番外側）
+	uint32_t depth;
+	// 記録したスレッドの番号
+	uint32_t threadId;
+};
+
+// 直近のフレームでの区間ごとの集計
+struct ProfileSummaryEntry
+{
+	const char* name;
+	// 最初に記録された入れ子の深さ（表示の字下げに使う）
+	uint32_t depth;
+	// １フレームあたりの平均（ミリ秒、内側の区間を含む時間と含まない時間）
+	double averageMs;
+	double averageSelfMs;
+	// １フレームでの最大（ミリ秒）
+	double maxMs;
+	// １フレームあたりの平均の呼び出し回数
+	double averageCalls;
+};
+
+// スレッドごとの記録用のバッファ
+// 書き込むのは持ち主のスレッドだけで、EndFrame が別のスレッドからロック無しで読み出す
+class ProfileThreadBuffer
+{
+public:
+	// 1 フレームで溜められる区間の数（超えた分は捨てて数える）
+	static const size_t CAPACITY = 1 << 14;
+
+	explicit ProfileThreadBuffer(uint32_t threadId);
+
+	// 区間の開始（入れ子の深さを返す）
+	uint32_t Begin() { return m_depth++; }
+	// 区間の終了を記録
+	void End(const char* name, uint64_t begin, uint64_t end, uint32_t depth);
+	// 書き込まれた区間を取り出して output に追加する（読み出し側のスレッドから呼ぶ）
+	void Drain(std::vector<ProfileEvent>& output);
+	// 捨てた区間の数を取得して 0 に戻す
+	uint64_t TakeDroppedCount() { return m_droppedCount.exchange(0, std::memory_order_relaxed); }
+
+	uint32_t GetThreadId() const { return m_threadId; }
+
+private:
+	ProfileThreadBuffer(const ProfileThreadBuffer&) = delete;
+	ProfileThreadBuffer& operator=(const ProfileThreadBuffer&) = delete;
+
+	// 書き込み側だけが使う
+	uint32_t m_threadId;
+	uint32_t m_depth;
+	// 区間のリングバッファ（m_writeIndex を進める前に書き込む）
+	std::vector<ProfileEvent> m_events;
+	std::atomic<uint64_t> m_writeIndex;
+	std::atomic<uint64_t> m_readIndex;
+	std::atomic<uint64_t> m_droppedCount;
+};
+
+// プロファイラ（全て静的メンバで、どのスレッドからでも区間を記録できる）
+class Profiler
+{
+public:
+	// 記録するか（既定では記録しない、記録しない間の PROFILE_SCOPE の負荷は分岐１つ）
+	static void SetEnabled(bool enabled) { m_enabled.store(enabled, std::memory_order_relaxed); }
+	static bool IsEnabled() { return m_enabled.load(std::memory_order_relaxed); }
+
+	// 呼び出し元のスレッドに名前を付ける（トレースに表示する）
+	static void SetThreadName(const char* name);
+
+	// フレームの終わりにメインスレッドから呼ぶ
+	// 全てのスレッドのバッファを読み出して集計し、キャプチャ中なら保存する
+	static void EndFrame();
+
+	// frameCount フレーム分の区間を保存する（EndFrame のたびに溜まり、終わったら自動で止まる）
+	static void StartCapture(uint32_t frameCount);
+	// 保存を止める
+	static void StopCapture();
+	// 保存中か
+	static bool IsCapturing() { return m_captureFramesLeft > 0; }
+	// 保存した区間を Chrome トレース形式（chrome://tracing や Perfetto で開ける JSON）で書き出す（失敗したら false）
+	static bool WriteChromeTrace(const std::wstring& path);
+	// 保存した区間の数
+	static size_t GetCapturedEventCount() { return m_capturedEvents.size(); }
+
+	// 集計するフレーム数を設定（直近の frameCount フレームの平均と最大を求める）
+	static void SetSummaryWindow(uint32_t frameCount);
+	// 直近のフレームでの区間ごとの集計を、最初に記録された区間の開始順（外側の区間が先）に取得
+	static void GetSummary(std::vector<ProfileSummaryEntry>& summary);
+	// 集計を深さで字下げした複数行の文字列にする（maxDepth より深い区間は省く）
+	static std::string FormatSummary(uint32_t maxDepth = UINT32_MAX);
+	// 捨てた区間の累計
+	static uint64_t GetDroppedCount() { return m_droppedTotal; }
+
+	// 呼び出し元のスレッドのバッファ（初めて呼ばれたときに作る）
+	static ProfileThreadBuffer& GetThreadBuffer();
+	// 現在の時刻（Clock のカウント）
+	static uint64_t GetTime();
+
+private:
+	// 区間ごとの集計の途中経過
+	struct Statistic
+	{
+		const char* name;
+		uint32_t depth;
+		// 最初に記録された区間の開始時刻（表示の順番に使う）
+		uint64_t firstBegin;
+		// フレームごとの合計時間と呼び出し回数（集計するフレーム数の長さのリング）
+		std::vector<uint64_t> totals;
+		std::vector<uint64_t> selfTotals;
+		std::vector<uint32_t> calls;
+	};
+
+	// EndFrame で区間を集計に加える
+	static void Accumulate(const std::vector<ProfileEvent>& events, size_t begin, size_t end);
+	// 名前に対応する集計（無ければ作る）
+	static Statistic& FindStatistic(const ProfileEvent& event);
+
+	static std::atomic<bool> m_enabled;
+
+	// スレッドのバッファとスレッド名は m_threadMutex で守る
+	static std::mutex m_threadMutex;
+	static std::vector<std::unique_ptr<ProfileThreadBuffer>> m_threadBuffers;
+	static std::vector<std::string> m_threadNames;
+
+	// 以下は EndFrame を呼ぶスレッドだけが使う
+	static std::vector<ProfileEvent> m_frameEvents;
+	static std::vector<ProfileEvent> m_capturedEvents;
+	static uint32_t m_captureFramesLeft;
+	static std::vector<Statistic> m_statistics;
+	static uint32_t m_summaryWindow;
+	static uint32_t m_summaryFrame;
+	static uint32_t m_summaryFrameCount;
+	static uint64_t m_droppedTotal;
+};
+
+// コンストラクタからデストラクタまでを１つの区間として記録する
+class ProfileScope
+{
+public:
+	explicit ProfileScope(const char* name)
+		: m_buffer(nullptr)
+		, m_name(name)
+		, m_begin(0)
+		, m_depth(0)
+	{
+		if (Profiler::IsEnabled())
+		{
+			m_buffer = &Profiler::GetThreadBuffer();
+			m_depth = m_buffer->Begin();
+			m_begin = Profiler::GetTime();
+		}
+	}
+
+	~ProfileScope()
+	{
+		if (m_buffer)
+		{
+			m_buffer->End(m_name, m_begin, Profiler::GetTime(), m_depth);
+		}
+	}
+
+private:
+	ProfileScope(const ProfileScope&) = delete;
+	ProfileScope& operator=(const ProfileScope&) = delete;
+
+	ProfileThreadBuffer* m_buffer;
+	const char* m_name;
+	uint64_t m_begin;
+	uint32_t m_depth;
+};
+
+#if PROFILER_ENABLED
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+// この行からブロックの終わりまでを name の区間として記録する（name は文字列リテラル）
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+#else
+#define PROFILE_SCOPE(name) ((void)0)
+#endif
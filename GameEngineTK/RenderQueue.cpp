@@ -0,0 +1,209 @@
+﻿#include "RenderQueue.h"
+
+#include <cstring>
+
+#include "Profiler.h"
+
+namespace
+{
+	// 各フィールドの幅
+	const int PASS_SHIFT = 62;
+	const int STATE_BITS = 10;
+	const int MATERIAL_BITS = 16;
+	const int MESH_BITS = 16;
+	const uint64_t DEPTH_MASK = (1ull << RenderQueue::DEPTH_BITS) - 1;
+
+	// 不透明はステート・マテリアル・メッシュ・深度の順
+	const int OPAQUE_STATE_SHIFT = PASS_SHIFT - STATE_BITS;
+	const int OPAQUE_MATERIAL_SHIFT = OPAQUE_STATE_SHIFT - MATERIAL_BITS;
+	const int OPAQUE_MESH_SHIFT = OPAQUE_MATERIAL_SHIFT - MESH_BITS;
+	// 半透明は深度・ステート・マテリアル・メッシュの順
+	const int ALPHA_STATE_SHIFT = MATERIAL_BITS + MESH_BITS;
+	const int ALPHA_MATERIAL_SHIFT = MESH_BITS;
+
+	static_assert(OPAQUE_MESH_SHIFT == RenderQueue::DEPTH_BITS, "opaque key layout mismatch");
+	static_assert(ALPHA_STATE_SHIFT + STATE_BITS + RenderQueue::DEPTH_BITS == PASS_SHIFT, "alpha key layout mismatch");
+
+	// 基数ソートの１回で扱うビット数
+	const int RADIX_BITS = 8;
+	const int RADIX_SIZE = 1 << RADIX_BITS;
+	const int RADIX_PASSES = 64 / RADIX_BITS;
+
+	// 深度を量子化
+	uint64_t QuantizeDepth(float depth)
+	{
+		// NaN も 0 になるよう比較の向きに注意する
+		if (!(depth > 0.0f))
+		{
+			return 0;
+		}
+		if (depth >= 1.0f)
+		{
+			return DEPTH_MASK;
+		}
+		return static_cast<uint64_t>(depth * DEPTH_MASK);
+	}
+}
+
+RenderQueue::RenderQueue()
+	: m_statistics()
+{
+}
+
+uint64_t RenderQueue::MakeKey(RenderPass pass, uint32_t state, uint32_t material, uint32_t mesh, float depth)
+{
+	const uint64_t stateBits = state & (MAX_STATES - 1);
+	const uint64_t materialBits = material & (MAX_MATERIALS - 1);
+	const uint64_t meshBits = mesh & (MAX_MESHES - 1);
+	const uint64_t depthBits = QuantizeDepth(depth);
+
+	uint64_t key = static_cast<uint64_t>(pass) << PASS_SHIFT;
+	if (pass == RENDER_PASS_ALPHA)
+	{
+		// 奥のものが先に来るよう深度を反転する
+		key |= (DEPTH_MASK - depthBits) << (ALPHA_STATE_SHIFT + STATE_BITS);
+		key |= stateBits << ALPHA_STATE_SHIFT;
+		key |= materialBits << ALPHA_MATERIAL_SHIFT;
+		key |= meshBits;
+	}
+	else
+	{
+		key |= stateBits << OPAQUE_STATE_SHIFT;
+		key |= materialBits << OPAQUE_MATERIAL_SHIFT;
+		key |= meshBits << OPAQUE_MESH_SHIFT;
+		key |= depthBits;
+	}
+	return key;
+}
+
+uint32_t RenderQueue::GetState(uint64_t key)
+{
+	const int shift = GetPass(key) == RENDER_PASS_ALPHA ? ALPHA_STATE_SHIFT : OPAQUE_STATE_SHIFT;
+	return static_cast<uint32_t>(key >> shift) & (MAX_STATES - 1);
+}
+
+uint32_t RenderQueue::GetMaterial(uint64_t key)
+{
+	const int shift = GetPass(key) == RENDER_PASS_ALPHA ? ALPHA_MATERIAL_SHIFT : OPAQUE_MATERIAL_SHIFT;
+	return static_cast<uint32_t>(key >> shift) & (MAX_MATERIALS - 1);
+}
+
+uint32_t RenderQueue::GetMesh(uint64_t key)
+{
+	const int shift = GetPass(key) == RENDER_PASS_ALPHA ? 0 : OPAQUE_MESH_SHIFT;
+	return static_cast<uint32_t>(key >> shift) & (MAX_MESHES - 1);
+}
+
+void RenderQueue::Clear()
+{
+	m_commands.clear();
+	m_transforms.clear();
+}
+
+uint32_t RenderQueue::AddTransform(const Float4x4& world)
+{
+	m_transforms.push_back(world);
+	return static_cast<uint32_t>(m_transforms.size() - 1);
+}
+
+void RenderQueue::Add(uint64_t key, uint32_t transform)
+{
+	RenderCommand command;
+	command.key = key;
+	command.transform = transform;
+	m_commands.push_back(command);
+}
+
+void RenderQueue::Sort()
+{
+	PROFILE_SCOPE("RenderQueue::Sort");
+	const size_t count = m_commands.size();
+	if (count < 2)
+	{
+		return;
+	}
+	m_sortBuffer.resize(count);
+
+	// 全ての桁のヒストグラムを１回の走査で作る
+	uint32_t histograms[RADIX_PASSES][RADIX_SIZE];
+	std::memset(histograms, 0, sizeof(histograms));
+	for (const RenderCommand& command : m_commands)
+	{
+		uint64_t key = command.key;
+		for (int pass = 0; pass < RADIX_PASSES; pass++)
+		{
+			histograms[pass][key & (RADIX_SIZE - 1)]++;
+			key >>= RADIX_BITS;
+		}
+	}
+
+	// 下の桁から安定に振り分ける
+	for (int pass = 0; pass < RADIX_PASSES; pass++)
+	{
+		const int shift = pass * RADIX_BITS;
+		uint32_t* histogram = histograms[pass];
+
+		// 全てのキーでこの桁が同じなら並びは変わらない
+		if (histogram[(m_commands[0].key >> shift) & (RADIX_SIZE - 1)] == count)
+		{
+			continue;
+		}
+
+		// 各値の書き込み先
+		uint32_t offset = 0;
+		for (int i = 0; i < RADIX_SIZE; i++)
+		{
+			const uint32_t n = histogram[i];
+			histogram[i] = offset;
+			offset += n;
+		}
+
+		for (const RenderCommand& command : m_commands)
+		{
+			m_sortBuffer[histogram[(command.key >> shift) & (RADIX_SIZE - 1)]++] = command;
+		}
+		m_commands.swap(m_sortBuffer);
+	}
+}
+
+void RenderQueue::Submit(RenderBackend& backend)
+{
+	PROFILE_SCOPE("RenderQueue::Submit");
+	m_statistics = Statistics();
+
+	// 最初のコマンドで必ず設定されるよう、ありえない値にしておく
+	uint32_t currentPass = RENDER_PASS_COUNT;
+	uint32_t currentState = MAX_STATES;
+	uint32_t currentMaterial = MAX_MATERIALS;
+	uint32_t currentMesh = MAX_MESHES;
+
+	for (const RenderCommand& command : m_commands)
+	{
+		const RenderPass pass = GetPass(command.key);
+		const uint32_t state = GetState(command.key);
+		const uint32_t material = GetMaterial(command.key);
+		const uint32_t mesh = GetMesh(command.key);
+
+		if (pass != currentPass || state != currentState)
+		{
+			backend.SetState(pass, state);
+			currentPass = pass;
+			currentState = state;
+			m_statistics.stateChanges++;
+		}
+		if (material != currentMaterial)
+		{
+			backend.SetMaterial(material);
+			currentMaterial = material;
+			m_statistics.materialChanges++;
+		}
+		if (mesh != currentMesh)
+		{
+			backend.SetMesh(mesh);
+			currentMesh = mesh;
+			m_statistics.meshChanges++;
+		}
+		backend.Draw(mesh, m_transforms[command.transform]);
+		m_statistics.draws++;
+	}
+}
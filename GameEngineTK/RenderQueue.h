@@ -0,0 +1,113 @@
+﻿/// <summary>
+/// 描画コマンドを並べ替えてまとめて発行するキュー
+/// </summary>
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "TransformMath.h"
+
+// 描画パス（小さいものから描画する）
+enum RenderPass
+{
+	// 不透明（手前から奥へ）
+	RENDER_PASS_OPAQUE,
+	// 半透明（奥から手前へ）
+	RENDER_PASS_ALPHA,
+
+	RENDER_PASS_COUNT
+};
+
+// 描画コマンド（16 バイト）
+// ステート・マテリアル・メッシュは番号だけをソートキーに持ち、中身はバックエンドが管理する
+struct RenderCommand
+{
+	// ソートキー
+	uint64_t key;
+	// RenderQueue::GetTransforms() 内のワールド行列の番号
+	uint32_t transform;
+};
+
+// コマンドを受け取って実際に描画するもの
+// RenderQueue::Submit は前のコマンドと違うものだけを設定する
+class RenderBackend
+{
+public:
+	virtual ~RenderBackend() {}
+
+	// パスとステート（ブレンド・深度・ラスタライザー）を設定
+	virtual void SetState(RenderPass pass, uint32_t state) = 0;
+	// マテリアル（シェーダー・定数・テクスチャ）を設定
+	virtual void SetMaterial(uint32_t material) = 0;
+	// メッシュ（頂点・インデックスバッファ）を設定
+	virtual void SetMesh(uint32_t mesh) = 0;
+	// 設定済みの状態で描画
+	virtual void Draw(uint32_t mesh, const Float4x4& world) = 0;
+};
+
+// ソートキーの配置（上位から）
+//   不透明：パス 2bit、ステート 10bit、マテリアル 16bit、メッシュ 16bit、深度 20bit
+//   半透明：パス 2bit、反転した深度 20bit、ステート 10bit、マテリアル 16bit、メッシュ 16bit
+// 不透明はステートの切り替えが最少になる順に、半透明は奥から手前の順に並ぶ
+class RenderQueue
+{
+public:
+	// 番号の上限
+	static const uint32_t MAX_STATES = 1 << 10;
+	static const uint32_t MAX_MATERIALS = 1 << 16;
+	static const uint32_t MAX_MESHES = 1 << 16;
+	// 深度の分解能
+	static const uint32_t DEPTH_BITS = 20;
+
+	// 発行したときの統計
+	struct Statistics
+	{
+		// 描画したコマンドの数
+		uint32_t draws;
+		// 設定し直した回数
+		uint32_t stateChanges;
+		uint32_t materialChanges;
+		uint32_t meshChanges;
+	};
+
+	RenderQueue();
+
+	// ソートキーを作る（depth は 0 が手前、1 が奥で、範囲外は丸める）
+	static uint64_t MakeKey(RenderPass pass, uint32_t state, uint32_t material, uint32_t mesh, float depth);
+	// ソートキーから取り出す
+	static RenderPass GetPass(uint64_t key) { return static_cast<RenderPass>(key >> 62); }
+	static uint32_t GetState(uint64_t key);
+	static uint32_t GetMaterial(uint64_t key);
+	static uint32_t GetMesh(uint64_t key);
+
+	// 全てのコマンドを捨てる（確保したメモリは再利用する）
+	void Clear();
+	// ワールド行列を追加してその番号を返す（同じ行列を複数のコマンドで共有できる）
+	uint32_t AddTransform(const Float4x4& world);
+	// コマンドを追加
+	void Add(uint64_t key, uint32_t transform);
+	// キーの順に並べ替える（基数ソート、同じキーは追加順のまま）
+	void Sort();
+	// 並べ替えた順に発行する
+	void Submit(RenderBackend& backend);
+
+	// コマンド
+	size_t GetCommandCount() const { return m_commands.size(); }
+	const RenderCommand* GetCommands() const { return m_commands.data(); }
+	// ワールド行列
+	const Float4x4* GetTransforms() const { return m_transforms.data(); }
+	// 直前の Submit の統計
+	const Statistics& GetStatistics() const { return m_statistics; }
+
+private:
+	// コマンド
+	std::vector<RenderCommand> m_commands;
+	// 基数ソートの作業用
+	std::vector<RenderCommand> m_sortBuffer;
+	// ワールド行列
+	std::vector<Float4x4> m_transforms;
+	// 統計
+	Statistics m_statistics;
+};
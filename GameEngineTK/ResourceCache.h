@@ -0,0 +1,225 @@
+﻿/// <summary>
+/// ファイルパスをキーにして読み込んだリソースを共有するキャッシュ
+/// </summary>
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <future>
+#include <iterator>
+#include <limits>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// 同じファイルの読み込みは１回にまとめ、shared_ptr で共有する
+// 使用量が予算を超えたら、どこからも使われていないものを古い順に解放する
+template<typename T>
+class ResourceCache
+{
+public:
+	// 統計情報
+	struct Statistics
+	{
+		// キャッシュから返した回数（読み込み中のものを待った回数を含む）
+		uint64_t hits;
+		// 読み込んだ回数
+		uint64_t misses;
+		// 予算超過で解放した回数
+		uint64_t evictions;
+		// 保持しているリソースのバイト数
+		size_t residentBytes;
+		// 保持しているリソースの数
+		size_t entryCount;
+	};
+
+	// コンストラクタ（budgetBytes は保持するバイト数の上限）
+	explicit ResourceCache(size_t budgetBytes = (std::numeric_limits<size_t>::max)())
+		: m_budgetBytes(budgetBytes)
+		, m_residentBytes(0)
+		, m_hits(0)
+		, m_misses(0)
+		, m_evictions(0)
+	{
+	}
+
+	// リソースを取得する。無ければ loader(size_t& bytes) で読み込む
+	// 別のスレッドが同じキーを読み込み中なら、その完了を待って同じものを返す
+	template<typename Loader>
+	std::shared_ptr<T> Get(const std::wstring& key, Loader loader)
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+
+		auto it = m_entries.find(key);
+		if (it != m_entries.end())
+		{
+			m_hits++;
+			Entry& entry = it->second;
+			if (entry.resource)
+			{
+				// 最近使ったものとして先頭へ
+				m_lru.splice(m_lru.begin(), m_lru, entry.lru);
+				return entry.resource;
+			}
+			// 読み込み中なので完了を待つ
+			std::shared_future<std::shared_ptr<T>> future = entry.future;
+			lock.unlock();
+			return future.get();
+		}
+
+		// 読み込み中として登録してからロックを外して読み込む
+		m_misses++;
+		std::promise<std::shared_ptr<T>> promise;
+		Entry& entry = m_entries[key];
+		entry.future = promise.get_future().share();
+		entry.bytes = 0;
+		lock.unlock();
+
+		std::shared_ptr<T> resource;
+		size_t bytes = 0;
+		try
+		{
+			resource = loader(bytes);
+		}
+		catch (...)
+		{
+			lock.lock();
+			m_entries.erase(key);
+			promise.set_exception(std::current_exception());
+			throw;
+		}
+
+		lock.lock();
+		Entry& loaded = m_entries[key];
+		loaded.resource = resource;
+		loaded.bytes = bytes;
+		// 待っている側は自分の future を持っているので、こちらの参照は外す
+		loaded.future = std::shared_future<std::shared_ptr<T>>();
+		m_lru.push_front(key);
+		loaded.lru = m_lru.begin();
+		m_residentBytes += bytes;
+		promise.set_value(resource);
+
+		TrimLocked();
+		return resource;
+	}
+
+	// 読み込み済みのリソースを取得する。無ければ読み込まずに空を返す
+	std::shared_ptr<T> Find(const std::wstring& key)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		auto it = m_entries.find(key);
+		if (it == m_entries.end() || !it->second.resource)
+		{
+			return nullptr;
+		}
+		m_hits++;
+		m_lru.splice(m_lru.begin(), m_lru, it->second.lru);
+		return it->second.resource;
+	}
+
+	// 使用量の上限を設定
+	void SetBudget(size_t budgetBytes)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_budgetBytes = budgetBytes;
+		TrimLocked();
+	}
+
+	// 予算を超えていれば使われていないものを解放
+	void Trim()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		TrimLocked();
+	}
+
+	// 使われていないものを全て解放
+	void Clear()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		for (auto it = m_lru.begin(); it != m_lru.end();)
+		{
+			auto current = it++;
+			EvictIfUnused(*current);
+		}
+	}
+
+	// 統計情報を取得
+	Statistics GetStatistics() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		Statistics statistics;
+		statistics.hits = m_hits;
+		statistics.misses = m_misses;
+		statistics.evictions = m_evictions;
+		statistics.residentBytes = m_residentBytes;
+		statistics.entryCount = m_lru.size();
+		return statistics;
+	}
+
+private:
+	ResourceCache(const ResourceCache&) = delete;
+	ResourceCache& operator=(const ResourceCache&) = delete;
+
+	struct Entry
+	{
+		// 読み込み中の結果
+		std::shared_future<std::shared_ptr<T>> future;
+		// 読み込み済みのリソース
+		std::shared_ptr<T> resource;
+		// リソースのバイト数
+		size_t bytes;
+		// 使用順リスト内の位置
+		typename std::list<std::wstring>::iterator lru;
+	};
+
+	// 古いものから、使われていないものを予算内に収まるまで解放
+	void TrimLocked()
+	{
+		auto it = m_lru.end();
+		while (it != m_lru.begin() && m_residentBytes > m_budgetBytes)
+		{
+			--it;
+			// 解放すると it が無効になるので、一つ後ろから続ける
+			auto next = std::next(it);
+			if (EvictIfUnused(*it))
+			{
+				it = next;
+			}
+		}
+	}
+
+	// キャッシュ以外に持ち主がいなければ解放
+	bool EvictIfUnused(const std::wstring& key)
+	{
+		auto found = m_entries.find(key);
+		Entry& entry = found->second;
+		if (entry.resource.use_count() > 1)
+		{
+			return false;
+		}
+		m_residentBytes -= entry.bytes;
+		m_evictions++;
+		m_lru.erase(entry.lru);
+		m_entries.erase(found);
+		return true;
+	}
+
+	// 排他制御
+	mutable std::mutex m_mutex;
+	// キーごとのリソース
+	std::unordered_map<std::wstring, Entry> m_entries;
+	// 使用順（先頭が最近）
+	std::list<std::wstring> m_lru;
+	// 使用量の上限
+	size_t m_budgetBytes;
+	// 使用量
+	size_t m_residentBytes;
+	// 統計
+	uint64_t m_hits;
+	uint64_t m_misses;
+	uint64_t m_evictions;
+};
@@ -0,0 +1,40 @@
+﻿/// <summary>
+/// シミュレーションから描画に渡すシーンの状態
+/// </summary>
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "TransformMath.h"
+
+class Obj3d;
+
+// 描画するオブジェクト
+struct SceneDrawItem
+{
+	Obj3d* object;
+	// 補間した描画用のワールド行列
+	Float4x4 world;
+	// カリング用のワールド空間の境界球
+	Float3 center;
+	float radius;
+};
+
+// 描画に必要な値は全てここに写し、描画側はシミュレーションの状態に触れない
+// （オブジェクトからはモデルだけを読み、モデルの差し替えはシミュレーションが止まっている間に行う）
+struct SceneSnapshot
+{
+	// 何回シミュレーションを進めた後の状態か
+	uint32_t stepCount;
+	// 補間済みの視点と注視点
+	Float3 eyePosition;
+	Float3 refPosition;
+	// ビュー行列と射影行列
+	Float4x4 view;
+	Float4x4 projection;
+	// 空間インデックスで視錐台と重なったオブジェクト
+	std::vector<SceneDrawItem> items;
+	// 球のワールド行列
+	std::vector<Float4x4> ballWorlds;
+};
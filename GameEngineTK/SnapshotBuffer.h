@@ -0,0 +1,61 @@
+﻿/// <summary>
+/// １つのスレッドが書いて別の１つのスレッドが読む三重バッファ
+/// </summary>
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// 書く側と読む側がそれぞれ１つずつバッファを持ち、残りの１つを受け渡しに使う
+// 受け渡しはアトミックな交換だけで行うので、どちらも相手を待たない
+// 読む側は最後に公開された内容を受け取り、その間に公開されたものは読み飛ばす
+template<typename T>
+class SnapshotBuffer
+{
+public:
+	SnapshotBuffer()
+		: m_writeIndex(0)
+		, m_shared(1)
+		, m_readIndex(2)
+	{
+	}
+
+	// 書く側：次に公開するバッファ（以前に書いた内容が残っているので、全て書き直すこと）
+	T& GetWriteBuffer() { return m_buffers[m_writeIndex]; }
+	// 書く側：書き終えたバッファを公開し、受け渡し用だったバッファを次に書く
+	void Publish()
+	{
+		m_writeIndex = m_shared.exchange(m_writeIndex | NEW_FLAG, std::memory_order_acq_rel) & INDEX_MASK;
+	}
+
+	// 読む側：新しく公開されたものがあれば受け取って true（無ければ前に受け取ったものを使い続ける）
+	bool Acquire()
+	{
+		if ((m_shared.load(std::memory_order_relaxed) & NEW_FLAG) == 0)
+		{
+			return false;
+		}
+		m_readIndex = m_shared.exchange(m_readIndex, std::memory_order_acq_rel) & INDEX_MASK;
+		return true;
+	}
+	// 読む側：最後に受け取ったバッファ（一度も受け取っていなければ初期状態）
+	const T& GetReadBuffer() const { return m_buffers[m_readIndex]; }
+
+private:
+	SnapshotBuffer(const SnapshotBuffer&) = delete;
+	SnapshotBuffer& operator=(const SnapshotBuffer&) = delete;
+
+	// 受け渡し用の値の下位ビットがバッファの番号、NEW_FLAG は読む側がまだ受け取っていない印
+	static const uint32_t INDEX_MASK = 3;
+	static const uint32_t NEW_FLAG = 4;
+
+	T m_buffers[3];
+	// 書く側だけが使う
+	uint32_t m_writeIndex;
+	// 同じキャッシュラインに載せない
+	char m_writePadding[64];
+	std::atomic<uint32_t> m_shared;
+	char m_readPadding[64];
+	// 読む側だけが使う
+	uint32_t m_readIndex;
+};
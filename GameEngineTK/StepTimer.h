@@ -4,38 +4,46 @@
 
 #pragma once
 
-#include <exception>
+#include <cstdlib>
 #include <stdint.h>
 
+#include "Clock.h"
+#include "FrameStats.h"
+
 namespace DX
 {
     // Helper class for animation and simulation timing.
     class StepTimer
     {
     public:
-        StepTimer() : 
+        // The clock must outlive the timer. Pass a FakeClock to drive the timer by hand.
+        explicit StepTimer(Clock& clock = GetDefaultClock()) :
+            m_clock(&clock),
             m_elapsedTicks(0),
             m_totalTicks(0),
             m_leftOverTicks(0),
             m_frameCount(0),
             m_framesPerSecond(0),
             m_framesThisSecond(0),
-            m_qpcSecondCounter(0),
+            m_clockSecondCounter(0),
             m_isFixedTimeStep(false),
-            m_targetElapsedTicks(TicksPerSecond / 60)
+            m_targetElapsedTicks(TicksPerSecond / 60),
+            m_maxUpdatesPerTick(0),
+            m_droppedTicks(0),
+            m_lastTickDelta(0),
+            m_nextTickDelta(0),
+            m_hasNextTickDelta(false),
+            m_isFrameOpen(false),
+            m_clockUpdateTime(0),
+            m_clockPresentBegin(0),
+            m_clockPresentEnd(0),
+            m_isPresentTimed(false)
         {
-            if (!QueryPerformanceFrequency(&m_qpcFrequency))
-            {
-                throw std::exception( "QueryPerformanceFrequency" );
-            }
-
-            if (!QueryPerformanceCounter(&m_qpcLastTime))
-            {
-                throw std::exception( "QueryPerformanceCounter" );
-            }
+            m_clockFrequency = m_clock->GetFrequency();
+            m_clockLastTime = m_clock->GetCounter();
 
             // Initialize max delta to 1/10 of a second.
-            m_qpcMaxDelta = m_qpcFrequency.QuadPart / 10;
+            m_clockMaxDelta = m_clockFrequency / 10;
         }
 
         // Get elapsed time since the previous Update call.
@@ -59,27 +67,66 @@ namespace DX
         void SetTargetElapsedTicks(uint64_t targetElapsed)	{ m_targetElapsedTicks = targetElapsed; }
         void SetTargetElapsedSeconds(double targetElapsed)	{ m_targetElapsedTicks = SecondsToTicks(targetElapsed); }
 
+        // Limit how many Update calls a single Tick may make in fixed timestep mode (0 means no limit).
+        // Time beyond that budget is dropped, so a slow frame cannot snowball into ever more catch-up work.
+        void SetMaxUpdatesPerTick(uint32_t maxUpdates)		{ m_maxUpdatesPerTick = maxUpdates; }
+
+        // Get the total time dropped by the catch-up budget.
+        uint64_t GetDroppedTicks() const					{ return m_droppedTicks; }
+
+        // Get the current timestep configuration (to record it alongside a replay).
+        bool IsFixedTimeStep() const						{ return m_isFixedTimeStep; }
+        uint64_t GetTargetElapsedTicks() const				{ return m_targetElapsedTicks; }
+        uint32_t GetMaxUpdatesPerTick() const				{ return m_maxUpdatesPerTick; }
+
+        // Get how far the last Tick call advanced, in ticks (after clamping, before the fixed timestep rounding).
+        uint64_t GetLastTickDelta() const					{ return m_lastTickDelta; }
+
+        // Make the next Tick call advance by exactly this many ticks instead of the measured time, so that
+        // a recorded sequence of GetLastTickDelta values replays the same Update calls. Frames are still
+        // timed with the clock, so the frame statistics stay real.
+        void SetNextTickDelta(uint64_t ticks)				{ m_nextTickDelta = ticks; m_hasNextTickDelta = true; }
+
+        // Get how far the time not yet simulated has advanced towards the next fixed update (0 to 1).
+        // Render can use it to interpolate between the previous and the current simulation state.
+        double GetInterpolationAlpha() const
+        {
+            if (!m_isFixedTimeStep || m_targetElapsedTicks == 0)
+            {
+                return 1.0;
+            }
+            return static_cast<double>(m_leftOverTicks) / m_targetElapsedTicks;
+        }
+
         // Integer format represents time using 10,000,000 ticks per second.
         static const uint64_t TicksPerSecond = 10000000;
 
         static double TicksToSeconds(uint64_t ticks)		{ return static_cast<double>(ticks) / TicksPerSecond; }
         static uint64_t SecondsToTicks(double seconds)		{ return static_cast<uint64_t>(seconds * TicksPerSecond); }
 
+        // Per-frame timing histograms. A frame runs from one Tick call to the next and is recorded
+        // at the start of the following Tick, split into Update time, the rest of the CPU work up to
+        // BeginPresent, and the time spent between BeginPresent and EndPresent.
+        FrameStats& GetFrameStats()							{ return m_frameStats; }
+        const FrameStats& GetFrameStats() const				{ return m_frameStats; }
+
+        // Bracket the swap chain Present call so that waiting for vsync is not counted as CPU time.
+        void BeginPresent()									{ m_clockPresentBegin = m_clock->GetCounter(); }
+        void EndPresent()									{ m_clockPresentEnd = m_clock->GetCounter(); m_isPresentTimed = true; }
+
         // After an intentional timing discontinuity (for instance a blocking IO operation)
         // call this to avoid having the fixed timestep logic attempt a set of catch-up 
         // Update calls.
 
         void ResetElapsedTime()
         {
-            if (!QueryPerformanceCounter(&m_qpcLastTime))
-            {
-                throw std::exception("QueryPerformanceCounter");
-            }
+            m_clockLastTime = m_clock->GetCounter();
 
             m_leftOverTicks = 0;
+            m_isFrameOpen = false;
             m_framesPerSecond = 0;
             m_framesThisSecond = 0;
-            m_qpcSecondCounter = 0;
+            m_clockSecondCounter = 0;
         }
 
         // Update timer state, calling the specified Update function the appropriate number of times.
@@ -87,27 +134,39 @@ namespace DX
         void Tick(const TUpdate& update)
         {
             // Query the current time.
-            LARGE_INTEGER currentTime;
+            uint64_t currentTime = m_clock->GetCounter();
+
+            uint64_t timeDelta = currentTime - m_clockLastTime;
 
-            if (!QueryPerformanceCounter(&currentTime))
+            // Record the frame that ended here (before clamping, so stalls show up in full).
+            if (m_isFrameOpen)
             {
-                throw std::exception( "QueryPerformanceCounter" );
+                RecordFrame(timeDelta);
             }
+            m_isFrameOpen = true;
+            m_clockUpdateTime = 0;
+            m_isPresentTimed = false;
 
-            uint64_t timeDelta = currentTime.QuadPart - m_qpcLastTime.QuadPart;
-
-            m_qpcLastTime = currentTime;
-            m_qpcSecondCounter += timeDelta;
+            m_clockLastTime = currentTime;
+            m_clockSecondCounter += timeDelta;
 
             // Clamp excessively large time deltas (e.g. after paused in the debugger).
-            if (timeDelta > m_qpcMaxDelta)
+            if (timeDelta > m_clockMaxDelta)
             {
-                timeDelta = m_qpcMaxDelta;
+                timeDelta = m_clockMaxDelta;
             }
 
-            // Convert QPC units into a canonical tick format. This cannot overflow due to the previous clamp.
+            // Convert clock units into a canonical tick format. This cannot overflow due to the previous clamp.
             timeDelta *= TicksPerSecond;
-            timeDelta /= m_qpcFrequency.QuadPart;
+            timeDelta /= m_clockFrequency;
+
+            // Replace the measured time when replaying.
+            if (m_hasNextTickDelta)
+            {
+                timeDelta = m_nextTickDelta;
+                m_hasNextTickDelta = false;
+            }
+            m_lastTickDelta = timeDelta;
 
             uint32_t lastFrameCount = m_frameCount;
 
@@ -122,21 +181,32 @@ namespace DX
                 // accumulate enough tiny errors that it would drop a frame. It is better to just round 
                 // small deviations down to zero to leave things running smoothly.
 
-                if (abs(static_cast<int64_t>(timeDelta - m_targetElapsedTicks)) < TicksPerSecond / 4000)
+                if (std::abs(static_cast<int64_t>(timeDelta - m_targetElapsedTicks)) < static_cast<int64_t>(TicksPerSecond / 4000))
                 {
                     timeDelta = m_targetElapsedTicks;
                 }
 
                 m_leftOverTicks += timeDelta;
 
+                uint32_t updateCount = 0;
                 while (m_leftOverTicks >= m_targetElapsedTicks)
                 {
+                    // Out of catch-up budget: drop whole steps but keep the fraction for interpolation.
+                    if (m_maxUpdatesPerTick != 0 && updateCount == m_maxUpdatesPerTick)
+                    {
+                        uint64_t remainder = m_leftOverTicks % m_targetElapsedTicks;
+                        m_droppedTicks += m_leftOverTicks - remainder;
+                        m_leftOverTicks = remainder;
+                        break;
+                    }
+                    updateCount++;
+
                     m_elapsedTicks = m_targetElapsedTicks;
                     m_totalTicks += m_targetElapsedTicks;
                     m_leftOverTicks -= m_targetElapsedTicks;
                     m_frameCount++;
 
-                    update();
+                    TimedUpdate(update);
                 }
             }
             else
@@ -147,7 +217,7 @@ namespace DX
                 m_leftOverTicks = 0;
                 m_frameCount++;
 
-                update();
+                TimedUpdate(update);
             }
 
             // Track the current framerate.
@@ -156,19 +226,39 @@ namespace DX
                 m_framesThisSecond++;
             }
 
-            if (m_qpcSecondCounter >= static_cast<uint64_t>(m_qpcFrequency.QuadPart))
+            if (m_clockSecondCounter >= m_clockFrequency)
             {
                 m_framesPerSecond = m_framesThisSecond;
                 m_framesThisSecond = 0;
-                m_qpcSecondCounter %= m_qpcFrequency.QuadPart;
+                m_clockSecondCounter %= m_clockFrequency;
             }
         }
 
     private:
-        // Source timing data uses QPC units.
-        LARGE_INTEGER m_qpcFrequency;
-        LARGE_INTEGER m_qpcLastTime;
-        uint64_t m_qpcMaxDelta;
+        // Call update and add its duration to the current frame's Update time.
+        template<typename TUpdate>
+        void TimedUpdate(const TUpdate& update)
+        {
+            uint64_t begin = m_clock->GetCounter();
+            update();
+            m_clockUpdateTime += m_clock->GetCounter() - begin;
+        }
+
+        void RecordFrame(uint64_t frameTime)
+        {
+            double frequency = static_cast<double>(m_clockFrequency);
+            bool hasPresent = m_isPresentTimed && m_clockPresentBegin >= m_clockLastTime && m_clockPresentEnd >= m_clockPresentBegin;
+            uint64_t cpuTime = hasPresent ? m_clockPresentBegin - m_clockLastTime : frameTime;
+            uint64_t presentTime = hasPresent ? m_clockPresentEnd - m_clockPresentBegin : 0;
+            uint64_t renderTime = cpuTime > m_clockUpdateTime ? cpuTime - m_clockUpdateTime : 0;
+            m_frameStats.RecordFrame(frameTime / frequency, m_clockUpdateTime / frequency, renderTime / frequency, presentTime / frequency);
+        }
+
+        // Source timing data uses the clock's units.
+        Clock* m_clock;
+        uint64_t m_clockFrequency;
+        uint64_t m_clockLastTime;
+        uint64_t m_clockMaxDelta;
 
         // Derived timing data uses a canonical tick format.
         uint64_t m_elapsedTicks;
@@ -179,10 +269,25 @@ namespace DX
         uint32_t m_frameCount;
         uint32_t m_framesPerSecond;
         uint32_t m_framesThisSecond;
-        uint64_t m_qpcSecondCounter;
+        uint64_t m_clockSecondCounter;
 
         // Members for configuring fixed timestep mode.
         bool m_isFixedTimeStep;
         uint64_t m_targetElapsedTicks;
+        uint32_t m_maxUpdatesPerTick;
+        uint64_t m_droppedTicks;
+
+        // Members for recording and replaying the time each Tick advanced by.
+        uint64_t m_lastTickDelta;
+        uint64_t m_nextTickDelta;
+        bool m_hasNextTickDelta;
+
+        // Members for frame timing statistics (in the clock's units).
+        FrameStats m_frameStats;
+        bool m_isFrameOpen;
+        uint64_t m_clockUpdateTime;
+        uint64_t m_clockPresentBegin;
+        uint64_t m_clockPresentEnd;
+        bool m_isPresentTimed;
     };
 }
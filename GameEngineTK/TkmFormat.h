@@ -0,0 +1,252 @@
+﻿/// <summary>
+/// エンジン独自のメッシュ形式（TKM）のファイル構造
+/// </summary>
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+// ファイルの先頭から、ヘッダー、各セクションの順に並ぶ
+// セクションは TKM_ALIGNMENT バイト境界に揃えるので、読み込んだメモリ上でそのまま参照できる
+// 文字列は UTF-16 で、文字列セクションにまとめる
+
+// 識別子 "TKM\0"
+const uint32_t TKM_MAGIC = 0x004D4B54;
+// 形式のバージョン（構造を変えたら上げる）
+const uint16_t TKM_VERSION = 2;
+// セクションの境界
+const uint32_t TKM_ALIGNMENT = 16;
+
+// ヘッダーのフラグ
+enum TkmFlags
+{
+	// インデックスが 32bit
+	TKM_FLAG_INDEX32 = 0x0001,
+};
+
+// セクションの種類
+enum TkmSectionId
+{
+	TKM_SECTION_MESHES,
+	TKM_SECTION_PARTS,
+	TKM_SECTION_MATERIALS,
+	TKM_SECTION_VERTICES,
+	TKM_SECTION_INDICES,
+	TKM_SECTION_STRINGS,
+	TKM_SECTION_COUNT
+};
+
+// ファイル内の範囲
+struct TkmSection
+{
+	uint32_t offset;
+	uint32_t size;
+};
+
+// 文字列セクション内の文字列（offset はバイト単位、length は文字数）
+struct TkmString
+{
+	uint32_t offset;
+	uint32_t length;
+};
+
+// 境界球と AABB
+struct TkmBounds
+{
+	float center[3];
+	float radius;
+	float aabbMin[3];
+	float aabbMax[3];
+};
+
+// ファイルヘッダー
+struct TkmHeader
+{
+	uint32_t magic;
+	uint16_t version;
+	uint16_t flags;
+	// ファイル全体のバイト数
+	uint32_t fileSize;
+	uint32_t meshCount;
+	uint32_t partCount;
+	uint32_t materialCount;
+	uint32_t vertexCount;
+	uint32_t indexCount;
+	// 量子化した座標の復元用（position = center + q / 32767 * scale）
+	float positionCenter[3];
+	float positionScale;
+	// ファイル全体の境界
+	TkmBounds bounds;
+	// 簡略化で生じた誤差（モデル空間の長さ、簡略化していなければ 0）
+	float geometricError;
+	// 各セクションの位置
+	TkmSection sections[TKM_SECTION_COUNT];
+};
+
+// メッシュ（連続したパーツのまとまり）
+struct TkmMesh
+{
+	TkmString name;
+	uint32_t firstPart;
+	uint32_t partCount;
+	TkmBounds bounds;
+};
+
+// パーツ（１つのマテリアルで描画する範囲）
+struct TkmPart
+{
+	uint32_t materialIndex;
+	uint32_t startIndex;
+	uint32_t indexCount;
+	// インデックスに足す頂点番号
+	uint32_t baseVertex;
+	// baseVertex から参照される頂点の数
+	uint32_t vertexCount;
+};
+
+// マテリアル
+struct TkmMaterial
+{
+	TkmString name;
+	// ディフューズテクスチャ（無ければ長さ 0）
+	TkmString texture;
+	// w はアルファ
+	float diffuse[4];
+	float ambient[3];
+	float specular[3];
+	float specularPower;
+	float emissive[3];
+};
+
+// 頂点（20 バイト）
+struct TkmVertex
+{
+	// snorm16 に量子化した座標（w は未使用）
+	int16_t position[4];
+	// snorm8 に量子化した法線（w は未使用）
+	int8_t normal[4];
+	// R8G8B8A8 の頂点カラー
+	uint32_t color;
+	// 半精度浮動小数のテクスチャ座標
+	uint16_t texcoord[2];
+};
+
+static_assert(sizeof(TkmHeader) == 140, "TKM header size mismatch");
+static_assert(sizeof(TkmMesh) == 56, "TKM mesh size mismatch");
+static_assert(sizeof(TkmPart) == 20, "TKM part size mismatch");
+static_assert(sizeof(TkmMaterial) == 72, "TKM material size mismatch");
+static_assert(sizeof(TkmVertex) == 20, "TKM vertex size mismatch");
+
+// 量子化と復元
+
+inline int16_t QuantizeSnorm16(float value)
+{
+	value = value < -1.0f ? -1.0f : (value > 1.0f ? 1.0f : value);
+	return static_cast<int16_t>(std::lround(value * 32767.0f));
+}
+
+inline float DequantizeSnorm16(int16_t value)
+{
+	float result = value / 32767.0f;
+	return result < -1.0f ? -1.0f : result;
+}
+
+inline int8_t QuantizeSnorm8(float value)
+{
+	value = value < -1.0f ? -1.0f : (value > 1.0f ? 1.0f : value);
+	return static_cast<int8_t>(std::lround(value * 127.0f));
+}
+
+inline float DequantizeSnorm8(int8_t value)
+{
+	float result = value / 127.0f;
+	return result < -1.0f ? -1.0f : result;
+}
+
+// 半精度浮動小数へ変換（最近接丸め）
+inline uint16_t FloatToHalf(float value)
+{
+	uint32_t bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+	const uint32_t sign = (bits >> 16) & 0x8000;
+	const uint32_t absolute = bits & 0x7FFFFFFF;
+
+	// NaN と無限大
+	if (absolute >= 0x7F800000)
+	{
+		return static_cast<uint16_t>(sign | 0x7C00 | (absolute > 0x7F800000 ? 0x200 : 0));
+	}
+	// 半精度の最大値を超えるものは無限大
+	if (absolute >= 0x477FF000)
+	{
+		return static_cast<uint16_t>(sign | 0x7C00);
+	}
+	// 非正規化数
+	if (absolute < 0x38800000)
+	{
+		if (absolute < 0x33000000)
+		{
+			return static_cast<uint16_t>(sign);
+		}
+		const uint32_t exponent = absolute >> 23;
+		const uint32_t mantissa = (absolute & 0x7FFFFF) | 0x800000;
+		const uint32_t shift = 126 - exponent;
+		uint32_t half = mantissa >> shift;
+		const uint32_t rest = mantissa & ((1u << shift) - 1);
+		const uint32_t halfway = 1u << (shift - 1);
+		if (rest > halfway || (rest == halfway && (half & 1)))
+		{
+			half++;
+		}
+		return static_cast<uint16_t>(sign | half);
+	}
+	// 正規化数（仮数の下位 13bit を偶数丸め）
+	uint32_t half = (absolute - 0x38000000) >> 13;
+	const uint32_t rest = absolute & 0x1FFF;
+	if (rest > 0x1000 || (rest == 0x1000 && (half & 1)))
+	{
+		half++;
+	}
+	return static_cast<uint16_t>(sign | half);
+}
+
+// 半精度浮動小数から変換
+inline float HalfToFloat(uint16_t value)
+{
+	const uint32_t sign = static_cast<uint32_t>(value & 0x8000) << 16;
+	uint32_t exponent = (value >> 10) & 0x1F;
+	uint32_t mantissa = value & 0x3FF;
+	uint32_t bits;
+
+	if (exponent == 0x1F)
+	{
+		bits = sign | 0x7F800000 | (mantissa << 13);
+	}
+	else if (exponent == 0)
+	{
+		if (mantissa == 0)
+		{
+			bits = sign;
+		}
+		else
+		{
+			// 非正規化数を正規化する
+			exponent = 113;
+			while ((mantissa & 0x400) == 0)
+			{
+				mantissa <<= 1;
+				exponent--;
+			}
+			bits = sign | (exponent << 23) | ((mantissa & 0x3FF) << 13);
+		}
+	}
+	else
+	{
+		bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+	}
+
+	float result;
+	std::memcpy(&result, &bits, sizeof(result));
+	return result;
+}
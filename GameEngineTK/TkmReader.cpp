@@ -0,0 +1,245 @@
+﻿#include "TkmReader.h"
+
+#include "FileSystem.h"
+
+TkmReader::TkmReader()
+	: m_data(nullptr)
+	, m_size(0)
+	, m_header(nullptr)
+	, m_meshes(nullptr)
+	, m_parts(nullptr)
+	, m_materials(nullptr)
+	, m_vertices(nullptr)
+	, m_indices(nullptr)
+	, m_strings(nullptr)
+	, m_stringBytes(0)
+{
+}
+
+bool TkmReader::Open(const std::wstring& path)
+{
+	if (!ReadWholeFile(path, m_file))
+	{
+		return Fail("cannot read file");
+	}
+	return Parse(m_file.data(), m_file.size());
+}
+
+bool TkmReader::Parse(const uint8_t* data, size_t size)
+{
+	m_data = data;
+	m_size = size;
+	m_header = nullptr;
+	m_error.clear();
+
+	// セクションをその場で参照するので、先頭は４バイト境界に揃っている必要がある
+	if (reinterpret_cast<uintptr_t>(data) % 4 != 0)
+	{
+		return Fail("data is not aligned");
+	}
+	if (size < sizeof(TkmHeader))
+	{
+		return Fail("truncated header");
+	}
+
+	const TkmHeader* header = reinterpret_cast<const TkmHeader*>(data);
+	if (header->magic != TKM_MAGIC)
+	{
+		return Fail("not a TKM file");
+	}
+	if (header->version != TKM_VERSION)
+	{
+		return Fail("unsupported version");
+	}
+	if (header->fileSize != size)
+	{
+		return Fail("file size mismatch");
+	}
+	m_header = header;
+
+	// 各セクションの範囲と大きさ
+	m_meshes = reinterpret_cast<const TkmMesh*>(GetSection(TKM_SECTION_MESHES, header->meshCount, sizeof(TkmMesh)));
+	m_parts = reinterpret_cast<const TkmPart*>(GetSection(TKM_SECTION_PARTS, header->partCount, sizeof(TkmPart)));
+	m_materials = reinterpret_cast<const TkmMaterial*>(GetSection(TKM_SECTION_MATERIALS, header->materialCount, sizeof(TkmMaterial)));
+	m_vertices = reinterpret_cast<const TkmVertex*>(GetSection(TKM_SECTION_VERTICES, header->vertexCount, sizeof(TkmVertex)));
+	m_indices = GetSection(TKM_SECTION_INDICES, header->indexCount, GetIndexSize());
+	m_strings = GetSection(TKM_SECTION_STRINGS, header->sections[TKM_SECTION_STRINGS].size, 1);
+	m_stringBytes = header->sections[TKM_SECTION_STRINGS].size;
+	if (!m_meshes || !m_parts || !m_materials || !m_vertices || !m_indices || !m_strings)
+	{
+		return Fail("section out of range");
+	}
+	if (header->meshCount == 0)
+	{
+		return Fail("no meshes");
+	}
+
+	// メッシュ
+	for (uint32_t i = 0; i < header->meshCount; i++)
+	{
+		const TkmMesh& mesh = m_meshes[i];
+		if (mesh.firstPart > header->partCount || mesh.partCount > header->partCount - mesh.firstPart)
+		{
+			return Fail("mesh part range out of range");
+		}
+		if (!IsValidString(mesh.name))
+		{
+			return Fail("mesh name out of range");
+		}
+	}
+
+	// マテリアル
+	for (uint32_t i = 0; i < header->materialCount; i++)
+	{
+		if (!IsValidString(m_materials[i].name) || !IsValidString(m_materials[i].texture))
+		{
+			return Fail("material name out of range");
+		}
+	}
+
+	// パーツ
+	for (uint32_t i = 0; i < header->partCount; i++)
+	{
+		const TkmPart& part = m_parts[i];
+		if (part.materialIndex >= header->materialCount)
+		{
+			return Fail("material index out of range");
+		}
+		if (!ValidatePart(part))
+		{
+			return Fail("part index out of range");
+		}
+	}
+	return true;
+}
+
+std::wstring TkmReader::GetString(const TkmString& string) const
+{
+	std::wstring result;
+	result.reserve(string.length);
+	for (uint32_t i = 0; i < string.length; i++)
+	{
+		uint16_t code;
+		std::memcpy(&code, m_strings + string.offset + i * 2, sizeof(code));
+		result += static_cast<wchar_t>(code);
+	}
+	return result;
+}
+
+void TkmReader::DecodeVertices(TkmGpuVertex* vertices) const
+{
+	// 除算を掛け算にして、ループの外で係数を求めておく
+	const float scale = m_header->positionScale / 32767.0f;
+	const float* center = m_header->positionCenter;
+
+	const uint32_t count = m_header->vertexCount;
+	for (uint32_t i = 0; i < count; i++)
+	{
+		const TkmVertex& source = m_vertices[i];
+		TkmGpuVertex& vertex = vertices[i];
+		for (int k = 0; k < 3; k++)
+		{
+			// -32768 は -1 として扱う
+			int position = source.position[k] < -32767 ? -32767 : source.position[k];
+			vertex.position[k] = center[k] + position * scale;
+		}
+		// 法線以降はファイルと同じ配置なのでそのまま写す
+		static_assert(sizeof(TkmVertex) - offsetof(TkmVertex, normal) == sizeof(TkmGpuVertex) - offsetof(TkmGpuVertex, normal),
+			"TKM vertex tail layout mismatch");
+		std::memcpy(vertex.normal, source.normal, sizeof(TkmVertex) - offsetof(TkmVertex, normal));
+	}
+}
+
+void TkmReader::DecodePosition(const TkmVertex& vertex, float position[3]) const
+{
+	for (int i = 0; i < 3; i++)
+	{
+		position[i] = m_header->positionCenter[i] + DequantizeSnorm16(vertex.position[i]) * m_header->positionScale;
+	}
+}
+
+void TkmReader::DecodeNormal(const TkmVertex& vertex, float normal[3])
+{
+	float x = DequantizeSnorm8(vertex.normal[0]);
+	float y = DequantizeSnorm8(vertex.normal[1]);
+	float z = DequantizeSnorm8(vertex.normal[2]);
+	// 量子化で長さがずれるので正規化し直す
+	float length = std::sqrt(x * x + y * y + z * z);
+	float scale = length > 0.0f ? 1.0f / length : 0.0f;
+	normal[0] = x * scale;
+	normal[1] = y * scale;
+	normal[2] = z * scale;
+}
+
+void TkmReader::DecodeTexcoord(const TkmVertex& vertex, float texcoord[2])
+{
+	texcoord[0] = HalfToFloat(vertex.texcoord[0]);
+	texcoord[1] = HalfToFloat(vertex.texcoord[1]);
+}
+
+const uint8_t* TkmReader::GetSection(TkmSectionId id, uint32_t count, size_t stride)
+{
+	const TkmSection& section = m_header->sections[id];
+	if (section.offset % TKM_ALIGNMENT != 0)
+	{
+		return nullptr;
+	}
+	if (section.offset > m_size || section.size > m_size - section.offset)
+	{
+		return nullptr;
+	}
+	if (static_cast<uint64_t>(count) * stride != section.size)
+	{
+		return nullptr;
+	}
+	return m_data + section.offset;
+}
+
+bool TkmReader::IsValidString(const TkmString& string) const
+{
+	if (string.offset % 2 != 0 || string.offset > m_stringBytes)
+	{
+		return false;
+	}
+	return static_cast<uint64_t>(string.length) * 2 <= m_stringBytes - string.offset;
+}
+
+bool TkmReader::ValidatePart(const TkmPart& part) const
+{
+	const TkmHeader& header = *m_header;
+	if (part.startIndex > header.indexCount || part.indexCount > header.indexCount - part.startIndex)
+	{
+		return false;
+	}
+	if (part.baseVertex > header.vertexCount || part.vertexCount > header.vertexCount - part.baseVertex)
+	{
+		return false;
+	}
+
+	// インデックスの最大値が頂点数未満か
+	uint32_t maxIndex = 0;
+	if (GetIndexSize() == 4)
+	{
+		const uint32_t* indices = static_cast<const uint32_t*>(m_indices) + part.startIndex;
+		for (uint32_t i = 0; i < part.indexCount; i++)
+		{
+			maxIndex = indices[i] > maxIndex ? indices[i] : maxIndex;
+		}
+	}
+	else
+	{
+		const uint16_t* indices = static_cast<const uint16_t*>(m_indices) + part.startIndex;
+		for (uint32_t i = 0; i < part.indexCount; i++)
+		{
+			maxIndex = indices[i] > maxIndex ? indices[i] : maxIndex;
+		}
+	}
+	return part.indexCount == 0 || maxIndex < part.vertexCount;
+}
+
+bool TkmReader::Fail(const char* error)
+{
+	m_error = error;
+	m_header = nullptr;
+	return false;
+}
@@ -0,0 +1,92 @@
+﻿/// <summary>
+/// TKM（エンジン独自のメッシュ形式）を読み取るクラス
+/// </summary>
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "TkmFormat.h"
+
+// GPU に送る頂点（24 バイト）
+// 座標だけを浮動小数に戻し、法線・色・テクスチャ座標はファイルのまま入力レイアウトで変換させる
+struct TkmGpuVertex
+{
+	float position[3];
+	int8_t normal[4];
+	uint32_t color;
+	uint16_t texcoord[2];
+};
+static_assert(sizeof(TkmGpuVertex) == 24, "TKM GPU vertex size mismatch");
+
+// ファイルは１回の読み込みでメモリに置き、各セクションはその場で参照する
+// 全てのセクションとパーツの範囲、インデックスの値を確かめる
+class TkmReader
+{
+public:
+	TkmReader();
+
+	// ファイルを１回で読み込んで解析する（失敗したら false）
+	bool Open(const std::wstring& path);
+	// メモリ上のデータを解析する（data は４バイト境界に揃い、解析結果を使う間は有効でなければならない）
+	bool Parse(const uint8_t* data, size_t size);
+
+	// ヘッダー
+	const TkmHeader& GetHeader() const { return *m_header; }
+	// 各セクション
+	const TkmMesh* GetMeshes() const { return m_meshes; }
+	const TkmPart* GetParts() const { return m_parts; }
+	const TkmMaterial* GetMaterials() const { return m_materials; }
+	const TkmVertex* GetVertices() const { return m_vertices; }
+	// インデックス（GetIndexSize() が 2 なら uint16_t、4 なら uint32_t の配列）
+	const void* GetIndices() const { return m_indices; }
+	size_t GetIndexSize() const { return (m_header->flags & TKM_FLAG_INDEX32) ? 4 : 2; }
+	// 文字列を取り出す
+	std::wstring GetString(const TkmString& string) const;
+
+	// 全ての頂点を GPU に送る形にする（vertices は頂点数分の大きさが必要）
+	void DecodeVertices(TkmGpuVertex* vertices) const;
+	// 量子化された座標を復元
+	void DecodePosition(const TkmVertex& vertex, float position[3]) const;
+	// 量子化された法線を復元
+	static void DecodeNormal(const TkmVertex& vertex, float normal[3]);
+	// テクスチャ座標を復元
+	static void DecodeTexcoord(const TkmVertex& vertex, float texcoord[2]);
+
+	// 失敗した理由
+	const std::string& GetError() const { return m_error; }
+
+private:
+	TkmReader(const TkmReader&) = delete;
+	TkmReader& operator=(const TkmReader&) = delete;
+
+	// セクションを確認してその先頭を返す（失敗したら nullptr）
+	const uint8_t* GetSection(TkmSectionId id, uint32_t count, size_t stride);
+	// 文字列が文字列セクション内にあるか
+	bool IsValidString(const TkmString& string) const;
+	// パーツのインデックスが範囲内か
+	bool ValidatePart(const TkmPart& part) const;
+	// 失敗した理由を設定して false を返す
+	bool Fail(const char* error);
+
+	// Open で読み込んだデータ
+	std::vector<uint8_t> m_file;
+	// 解析したデータ
+	const uint8_t* m_data;
+	size_t m_size;
+
+	// 各セクションの先頭
+	const TkmHeader* m_header;
+	const TkmMesh* m_meshes;
+	const TkmPart* m_parts;
+	const TkmMaterial* m_materials;
+	const TkmVertex* m_vertices;
+	const void* m_indices;
+	const uint8_t* m_strings;
+	uint32_t m_stringBytes;
+
+	// 失敗した理由
+	std::string m_error;
+};
@@ -0,0 +1,383 @@
+﻿#include "TransformHierarchy.h"
+
+#include <cassert>
+
+#include "Profiler.h"
+#include "TransformKernel.h"
+#include "JobSystem.h"
+
+namespace
+{
+	// 並列計算で１スレッドが一度に受け持つノード数
+	const size_t PARALLEL_GRAIN = 1024;
+	// ローカル行列をまとめて合成する数
+	const size_t COMPOSE_BATCH = 64;
+
+	// 添字の並べ替えを配列に適用
+	template<typename T>
+	void ApplyOrder(std::vector<T>& values, const std::vector<uint32_t>& order)
+	{
+		std::vector<T> sorted;
+		sorted.reserve(order.size());
+		for (uint32_t index : order)
+		{
+			sorted.push_back(values[index]);
+		}
+		values.swap(sorted);
+	}
+}
+
+TransformHierarchy::TransformHierarchy()
+{
+	m_liveCount = 0;
+	m_rebuiltCount = 0;
+	m_isOrderDirty = false;
+	m_levelOffsets.push_back(0);
+}
+
+void TransformHierarchy::Reserve(size_t count)
+{
+	m_parents.reserve(count);
+	m_depths.reserve(count);
+	m_scales.reserve(count);
+	m_rotations.reserve(count);
+	m_translations.reserve(count);
+	m_locals.reserve(count);
+	m_worlds.reserve(count);
+	m_previousWorlds.reserve(count);
+	m_hasWorld.reserve(count);
+	m_localDirty.reserve(count);
+	m_worldChanged.reserve(count);
+	m_handles.reserve(count);
+	m_indices.reserve(count);
+}
+
+TransformHierarchy::Handle TransformHierarchy::Create(Handle parent)
+{
+	// ハンドルを割り当て
+	Handle handle;
+	if (m_freeHandles.empty())
+	{
+		handle = static_cast<Handle>(m_indices.size());
+		m_indices.push_back(0);
+	}
+	else
+	{
+		handle = m_freeHandles.back();
+		m_freeHandles.pop_back();
+	}
+
+	// 末尾に追加する（既存の親より必ず後ろになる）
+	uint32_t index = static_cast<uint32_t>(m_handles.size());
+	m_indices[handle] = index;
+
+	// 深さ順が崩れなければ末尾の深さの範囲を広げる
+	uint32_t depth = parent == INVALID_HANDLE ? 0 : m_depths[m_indices[parent]] + 1;
+	if (!m_isOrderDirty)
+	{
+		const uint32_t levelCount = static_cast<uint32_t>(m_levelOffsets.size()) - 1;
+		if (depth + 1 == levelCount)
+		{
+			m_levelOffsets.back()++;
+		}
+		else if (depth == levelCount)
+		{
+			m_levelOffsets.push_back(m_levelOffsets.back() + 1);
+		}
+		else
+		{
+			m_isOrderDirty = true;
+		}
+	}
+
+	const Float3 one = { 1.0f, 1.0f, 1.0f };
+	const Float3 zero = { 0.0f, 0.0f, 0.0f };
+	m_parents.push_back(parent == INVALID_HANDLE ? -1 : static_cast<int32_t>(m_indices[parent]));
+	m_depths.push_back(depth);
+	m_scales.push_back(one);
+	m_rotations.push_back(zero);
+	m_translations.push_back(zero);
+	m_locals.push_back(Float4x4Identity());
+	m_worlds.push_back(Float4x4Identity());
+	m_previousWorlds.push_back(Float4x4Identity());
+	m_hasWorld.push_back(0);
+	m_localDirty.push_back(1);
+	m_worldChanged.push_back(0);
+	m_handles.push_back(handle);
+
+	m_liveCount++;
+
+	return handle;
+}
+
+void TransformHierarchy::Destroy(Handle handle)
+{
+	uint32_t index = m_indices[handle];
+
+	// 子をルートにする
+	for (size_t i = 0; i < m_parents.size(); i++)
+	{
+		if (m_parents[i] == static_cast<int32_t>(index))
+		{
+			m_parents[i] = -1;
+			m_localDirty[i] = 1;
+		}
+	}
+
+	// 配列からの削除は次の並べ替えでまとめて行う
+	m_handles[index] = INVALID_HANDLE;
+	m_parents[index] = -1;
+	m_freeHandles.push_back(handle);
+	m_liveCount--;
+	m_isOrderDirty = true;
+}
+
+void TransformHierarchy::SetParent(Handle handle, Handle parent)
+{
+	uint32_t index = m_indices[handle];
+
+	// 親が変わるとワールド行列も変わり、子孫の深さも変わる
+	m_localDirty[index] = 1;
+	m_isOrderDirty = true;
+
+	if (parent == INVALID_HANDLE)
+	{
+		m_parents[index] = -1;
+		return;
+	}
+
+	uint32_t parentIndex = m_indices[parent];
+
+#ifndef NDEBUG
+	// 循環していないか確認
+	for (int32_t i = static_cast<int32_t>(parentIndex); i >= 0; i = m_parents[i])
+	{
+		assert(i != static_cast<int32_t>(index));
+	}
+#endif
+
+	m_parents[index] = static_cast<int32_t>(parentIndex);
+}
+
+TransformHierarchy::Handle TransformHierarchy::GetParent(Handle handle) const
+{
+	int32_t parentIndex = m_parents[m_indices[handle]];
+	return parentIndex < 0 ? INVALID_HANDLE : m_handles[parentIndex];
+}
+
+void TransformHierarchy::SetScale(Handle handle, const Float3& scale)
+{
+	uint32_t index = m_indices[handle];
+	m_scales[index] = scale;
+	m_localDirty[index] = 1;
+}
+
+void TransformHierarchy::SetRotation(Handle handle, const Float3& rotation)
+{
+	uint32_t index = m_indices[handle];
+	m_rotations[index] = rotation;
+	m_localDirty[index] = 1;
+}
+
+void TransformHierarchy::SetTranslation(Handle handle, const Float3& translation)
+{
+	uint32_t index = m_indices[handle];
+	m_translations[index] = translation;
+	m_localDirty[index] = 1;
+}
+
+void TransformHierarchy::Update(JobSystem* jobs)
+{
+	PROFILE_SCOPE("TransformHierarchy::Update");
+	if (m_isOrderDirty)
+	{
+		SortNodes();
+	}
+
+	const size_t count = m_worlds.size();
+
+	if (!jobs)
+	{
+		// 親が子より前にあるので、先頭から順に計算すれば親の変更は伝播済み
+		ComposeDirtyLocals(0, count);
+		m_rebuiltCount = PropagateWorlds(0, count);
+		return;
+	}
+
+	// ローカル行列はノードごとに独立
+	jobs->ParallelFor(count, PARALLEL_GRAIN, [this](size_t begin, size_t end)
+	{
+		PROFILE_SCOPE("ComposeDirtyLocals");
+		ComposeDirtyLocals(begin, end);
+	});
+
+	// 同じ深さのノードは互いに独立なので、浅い方から深さごとに並列に計算する
+	std::atomic<size_t> rebuilt(0);
+	for (size_t level = 0; level + 1 < m_levelOffsets.size(); level++)
+	{
+		const size_t levelBegin = m_levelOffsets[level];
+		const size_t levelEnd = m_levelOffsets[level + 1];
+		jobs->ParallelFor(levelEnd - levelBegin, PARALLEL_GRAIN, [&](size_t begin, size_t end)
+		{
+			PROFILE_SCOPE("PropagateWorlds");
+			rebuilt.fetch_add(PropagateWorlds(levelBegin + begin, levelBegin + end), std::memory_order_relaxed);
+		});
+	}
+	m_rebuiltCount = rebuilt.load();
+}
+
+void TransformHierarchy::ComposeDirtyLocals(size_t begin, size_t end)
+{
+	Float3 scales[COMPOSE_BATCH];
+	Float3 rotations[COMPOSE_BATCH];
+	Float3 translations[COMPOSE_BATCH];
+	Float4x4 locals[COMPOSE_BATCH];
+	uint32_t indices[COMPOSE_BATCH];
+	size_t batchCount = 0;
+
+	for (size_t i = begin; i < end; i++)
+	{
+		if (m_localDirty[i])
+		{
+			indices[batchCount] = static_cast<uint32_t>(i);
+			scales[batchCount] = m_scales[i];
+			rotations[batchCount] = m_rotations[i];
+			translations[batchCount] = m_translations[i];
+			batchCount++;
+		}
+
+		// 溜まったら、または最後にまとめて合成
+		if (batchCount == COMPOSE_BATCH || (i + 1 == end && batchCount > 0))
+		{
+			ComposeTransforms(scales, rotations, translations, nullptr, locals, batchCount);
+			for (size_t k = 0; k < batchCount; k++)
+			{
+				m_locals[indices[k]] = locals[k];
+			}
+			batchCount = 0;
+		}
+	}
+}
+
+size_t TransformHierarchy::PropagateWorlds(size_t begin, size_t end)
+{
+	size_t rebuilt = 0;
+	for (size_t i = begin; i < end; i++)
+	{
+		int32_t parent = m_parents[i];
+		bool isParentChanged = parent >= 0 && m_worldChanged[parent];
+
+		if (!m_localDirty[i] && !isParentChanged)
+		{
+			// 動かなかったので前の状態も今と同じにする
+			if (m_worldChanged[i])
+			{
+				m_previousWorlds[i] = m_worlds[i];
+			}
+			m_worldChanged[i] = 0;
+			continue;
+		}
+
+		m_localDirty[i] = 0;
+		const Float4x4 previous = m_worlds[i];
+		m_worlds[i] = parent < 0 ? m_locals[i] : Multiply(m_locals[i], m_worlds[parent]);
+		// 生成直後は補間元が無いので今の状態から始める
+		m_previousWorlds[i] = m_hasWorld[i] ? previous : m_worlds[i];
+		m_hasWorld[i] = 1;
+		m_worldChanged[i] = 1;
+		rebuilt++;
+	}
+	return rebuilt;
+}
+
+void TransformHierarchy::SortNodes()
+{
+	const uint32_t count = static_cast<uint32_t>(m_handles.size());
+
+	// 各ノードの深さを求める（破棄済みは -1）
+	std::vector<int32_t> depths(count, -2);
+	std::vector<uint32_t> chain;
+	int32_t maxDepth = -1;
+	for (uint32_t i = 0; i < count; i++)
+	{
+		if (m_handles[i] == INVALID_HANDLE)
+		{
+			depths[i] = -1;
+			continue;
+		}
+		// 深さが分かっているノードまで親をたどる
+		uint32_t node = i;
+		while (depths[node] == -2 && m_parents[node] >= 0)
+		{
+			chain.push_back(node);
+			node = static_cast<uint32_t>(m_parents[node]);
+		}
+		int32_t depth = depths[node] == -2 ? 0 : depths[node];
+		depths[node] = depth;
+		while (!chain.empty())
+		{
+			depths[chain.back()] = ++depth;
+			chain.pop_back();
+		}
+		if (depth > maxDepth)
+		{
+			maxDepth = depth;
+		}
+	}
+
+	// 深さ順に安定な計数ソート（親は必ず子より浅い）
+	std::vector<uint32_t> offsets(maxDepth + 2, 0);
+	for (uint32_t i = 0; i < count; i++)
+	{
+		if (depths[i] >= 0)
+		{
+			offsets[depths[i] + 1]++;
+		}
+	}
+	for (size_t d = 1; d < offsets.size(); d++)
+	{
+		offsets[d] += offsets[d - 1];
+	}
+	// 各深さの範囲を覚えておく
+	m_levelOffsets.assign(offsets.begin(), offsets.end());
+	std::vector<uint32_t> order(m_liveCount);
+	std::vector<int32_t> newIndices(count, -1);
+	for (uint32_t i = 0; i < count; i++)
+	{
+		if (depths[i] >= 0)
+		{
+			uint32_t newIndex = offsets[depths[i]]++;
+			order[newIndex] = i;
+			newIndices[i] = static_cast<int32_t>(newIndex);
+			m_depths[i] = static_cast<uint32_t>(depths[i]);
+		}
+	}
+
+	// 親の添字を付け替えてから各配列を並べ替える
+	for (uint32_t i = 0; i < count; i++)
+	{
+		if (m_parents[i] >= 0)
+		{
+			m_parents[i] = newIndices[m_parents[i]];
+		}
+	}
+	ApplyOrder(m_parents, order);
+	ApplyOrder(m_depths, order);
+	ApplyOrder(m_scales, order);
+	ApplyOrder(m_rotations, order);
+	ApplyOrder(m_translations, order);
+	ApplyOrder(m_locals, order);
+	ApplyOrder(m_worlds, order);
+	ApplyOrder(m_previousWorlds, order);
+	ApplyOrder(m_hasWorld, order);
+	ApplyOrder(m_localDirty, order);
+	ApplyOrder(m_worldChanged, order);
+	ApplyOrder(m_handles, order);
+
+	for (uint32_t i = 0; i < m_liveCount; i++)
+	{
+		m_indices[m_handles[i]] = i;
+	}
+
+	m_isOrderDirty = false;
+}
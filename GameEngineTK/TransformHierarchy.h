@@ -0,0 +1,111 @@
+﻿/// <summary>
+/// 親子関係を持つ変換を連続配列で管理するクラス
+/// </summary>
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "TransformMath.h"
+
+class JobSystem;
+
+// ノードは深さ順（親が子より前）に整列され、
+// ワールド行列は先頭から順に１回走査するだけで計算できる
+// 変更されたノードとその子孫だけを再計算する
+// 同じ深さのノードは互いに独立なので、深さごとに並列に計算できる
+class TransformHierarchy
+{
+public:
+	// ノードを識別するハンドル（並べ替えても変わらない）
+	typedef uint32_t Handle;
+	// 無効なハンドル
+	static const Handle INVALID_HANDLE = 0xffffffff;
+
+	// コンストラクタ
+	TransformHierarchy();
+
+	// 容量を予約
+	void Reserve(size_t count);
+
+	// ノードを生成
+	Handle Create(Handle parent = INVALID_HANDLE);
+	// ノードを破棄（子はルートになる）
+	void Destroy(Handle handle);
+
+	// 親を設定
+	void SetParent(Handle handle, Handle parent);
+	// 親を取得
+	Handle GetParent(Handle handle) const;
+
+	// setter（呼ぶとそのノードを再計算対象にする）
+	void SetScale(Handle handle, const Float3& scale);
+	void SetRotation(Handle handle, const Float3& rotation);
+	void SetTranslation(Handle handle, const Float3& translation);
+	// getter
+	const Float3& GetScale(Handle handle) const { return m_scales[m_indices[handle]]; }
+	const Float3& GetRotation(Handle handle) const { return m_rotations[m_indices[handle]]; }
+	const Float3& GetTranslation(Handle handle) const { return m_translations[m_indices[handle]]; }
+	// ワールド行列を取得
+	const Float4x4& GetWorld(Handle handle) const { return m_worlds[m_indices[handle]]; }
+	// 直前の Update の前のワールド行列を取得（描画で前後の状態を補間する用、生成直後は GetWorld と同じ）
+	const Float4x4& GetPreviousWorld(Handle handle) const { return m_previousWorlds[m_indices[handle]]; }
+
+	// 直前の Update でワールド行列が変わったか
+	bool IsWorldChanged(Handle handle) const { return m_worldChanged[m_indices[handle]] != 0; }
+	// 変更のあったノードのワールド行列を計算
+	// jobs を渡すと深さごとに複数スレッドで計算する（結果は逐次計算と同じ）
+	void Update(JobSystem* jobs = nullptr);
+
+	// 生存しているノード数
+	size_t GetCount() const { return m_liveCount; }
+	// 直前の Update で再計算したワールド行列の数
+	size_t GetRebuiltCount() const { return m_rebuiltCount; }
+
+private:
+	// 深さ順に並べ替え、破棄済みノードを詰める
+	void SortNodes();
+	// [begin, end) の変更されたノードのローカル行列を合成
+	void ComposeDirtyLocals(size_t begin, size_t end);
+	// [begin, end) のワールド行列を計算し、再計算した数を返す
+	size_t PropagateWorlds(size_t begin, size_t end);
+
+	// 以下の配列は同じ添字で１つのノードを表す
+	// 親の添字（ルートは -1）
+	std::vector<int32_t> m_parents;
+	// 深さ（ルートは 0）
+	std::vector<uint32_t> m_depths;
+	// スケーリング
+	std::vector<Float3> m_scales;
+	// 回転角
+	std::vector<Float3> m_rotations;
+	// 平行移動
+	std::vector<Float3> m_translations;
+	// ローカル行列
+	std::vector<Float4x4> m_locals;
+	// ワールド行列
+	std::vector<Float4x4> m_worlds;
+	// 直前の Update の前のワールド行列
+	std::vector<Float4x4> m_previousWorlds;
+	// ワールド行列を１回以上計算したか
+	std::vector<uint8_t> m_hasWorld;
+	// ローカル行列の再計算が必要か
+	std::vector<uint8_t> m_localDirty;
+	// 直前の Update でワールド行列が変わったか（子への伝播用）
+	std::vector<uint8_t> m_worldChanged;
+	// 添字からハンドルへの対応（破棄済みは INVALID_HANDLE）
+	std::vector<Handle> m_handles;
+	// 深さごとの先頭の添字（末尾に全体の数）
+	std::vector<uint32_t> m_levelOffsets;
+
+	// ハンドルから添字への対応
+	std::vector<uint32_t> m_indices;
+	// 再利用できるハンドル
+	std::vector<Handle> m_freeHandles;
+	// 生存しているノード数
+	size_t m_liveCount;
+	// 再計算したワールド行列の数
+	size_t m_rebuiltCount;
+	// 並べ替えが必要か
+	bool m_isOrderDirty;
+};
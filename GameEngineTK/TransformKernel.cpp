@@ -0,0 +1,408 @@
+﻿#include "TransformKernel.h"
+
+#if TRANSFORM_KERNEL_SSE2
+#include <emmintrin.h>
+#endif
+#if TRANSFORM_KERNEL_AVX2
+#include <immintrin.h>
+#endif
+
+namespace
+{
+	// sin/cos の多項式近似に使う定数（Cephes の sinf/cosf と同じ）
+	const float FOUR_OVER_PI = 1.27323954473516f;
+	// π/4 を３つに分けた値（引数の縮約で桁落ちを防ぐ）
+	const float MINUS_DP1 = -0.78515625f;
+	const float MINUS_DP2 = -2.4187564849853515625e-4f;
+	const float MINUS_DP3 = -3.77489497744594108e-8f;
+	const float SIN_P0 = -1.9515295891e-4f;
+	const float SIN_P1 = 8.3321608736e-3f;
+	const float SIN_P2 = -1.6666654611e-1f;
+	const float COS_P0 = 2.443315711809948e-5f;
+	const float COS_P1 = -1.388731625493765e-3f;
+	const float COS_P2 = 4.166664568298827e-2f;
+}
+
+void ComposeTransformsScalar(const Float3* scales, const Float3* rotations, const Float3* translations,
+	const Float4x4* parent, Float4x4* worlds, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		Float4x4 local = ComposeTRS(scales[i], rotations[i], translations[i]);
+		worlds[i] = parent ? Multiply(local, *parent) : local;
+	}
+}
+
+#if TRANSFORM_KERNEL_SSE2
+namespace
+{
+	// ４個の角度の sin と cos を同時に求める
+	inline void SinCos4(__m128 x, __m128* s, __m128* c)
+	{
+		const __m128 signMask = _mm_castsi128_ps(_mm_set1_epi32(0x80000000));
+
+		// 符号を取り除き、sin の符号を覚えておく
+		__m128 signSin = _mm_and_ps(x, signMask);
+		x = _mm_andnot_ps(signMask, x);
+
+		// π/4 単位の象限を求める（偶数に切り上げ）
+		__m128i quadrant = _mm_cvttps_epi32(_mm_mul_ps(x, _mm_set1_ps(FOUR_OVER_PI)));
+		quadrant = _mm_add_epi32(quadrant, _mm_set1_epi32(1));
+		quadrant = _mm_and_si128(quadrant, _mm_set1_epi32(~1));
+		__m128 y = _mm_cvtepi32_ps(quadrant);
+
+		// 象限から符号と使う多項式を決める
+		__m128 swapSignSin = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(quadrant, _mm_set1_epi32(4)), 29));
+		__m128 polyMask = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(quadrant, _mm_set1_epi32(2)), _mm_setzero_si128()));
+		__m128 signCos = _mm_castsi128_ps(_mm_slli_epi32(
+			_mm_andnot_si128(_mm_sub_epi32(quadrant, _mm_set1_epi32(2)), _mm_set1_epi32(4)), 29));
+		signSin = _mm_xor_ps(signSin, swapSignSin);
+
+		// [-π/4, π/4] に縮約
+		x = _mm_add_ps(x, _mm_mul_ps(y, _mm_set1_ps(MINUS_DP1)));
+		x = _mm_add_ps(x, _mm_mul_ps(y, _mm_set1_ps(MINUS_DP2)));
+		x = _mm_add_ps(x, _mm_mul_ps(y, _mm_set1_ps(MINUS_DP3)));
+		__m128 z = _mm_mul_ps(x, x);
+
+		// cos の多項式
+		__m128 polyCos = _mm_set1_ps(COS_P0);
+		polyCos = _mm_add_ps(_mm_mul_ps(polyCos, z), _mm_set1_ps(COS_P1));
+		polyCos = _mm_add_ps(_mm_mul_ps(polyCos, z), _mm_set1_ps(COS_P2));
+		polyCos = _mm_mul_ps(_mm_mul_ps(polyCos, z), z);
+		polyCos = _mm_sub_ps(polyCos, _mm_mul_ps(z, _mm_set1_ps(0.5f)));
+		polyCos = _mm_add_ps(polyCos, _mm_set1_ps(1.0f));
+
+		// sin の多項式
+		__m128 polySin = _mm_set1_ps(SIN_P0);
+		polySin = _mm_add_ps(_mm_mul_ps(polySin, z), _mm_set1_ps(SIN_P1));
+		polySin = _mm_add_ps(_mm_mul_ps(polySin, z), _mm_set1_ps(SIN_P2));
+		polySin = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(polySin, z), x), x);
+
+		// 象限に応じて入れ替える
+		__m128 sinValue = _mm_or_ps(_mm_and_ps(polyMask, polySin), _mm_andnot_ps(polyMask, polyCos));
+		__m128 cosValue = _mm_or_ps(_mm_and_ps(polyMask, polyCos), _mm_andnot_ps(polyMask, polySin));
+		*s = _mm_xor_ps(sinValue, signSin);
+		*c = _mm_xor_ps(cosValue, signCos);
+	}
+
+	// ４個分の行列を合成して書き出す
+	inline void Compose4(const Float3* scales, const Float3* rotations, const Float3* translations,
+		const Float4x4* parent, Float4x4* worlds)
+	{
+		__m128 sinX, cosX, sinY, cosY, sinZ, cosZ;
+		SinCos4(_mm_setr_ps(rotations[0].x, rotations[1].x, rotations[2].x, rotations[3].x), &sinX, &cosX);
+		SinCos4(_mm_setr_ps(rotations[0].y, rotations[1].y, rotations[2].y, rotations[3].y), &sinY, &cosY);
+		SinCos4(_mm_setr_ps(rotations[0].z, rotations[1].z, rotations[2].z, rotations[3].z), &sinZ, &cosZ);
+
+		const __m128 scaleX = _mm_setr_ps(scales[0].x, scales[1].x, scales[2].x, scales[3].x);
+		const __m128 scaleY = _mm_setr_ps(scales[0].y, scales[1].y, scales[2].y, scales[3].y);
+		const __m128 scaleZ = _mm_setr_ps(scales[0].z, scales[1].z, scales[2].z, scales[3].z);
+
+		// ローカル行列（ComposeTRS と同じ式）
+		__m128 m[4][4];
+		const __m128 sinZsinX = _mm_mul_ps(sinZ, sinX);
+		const __m128 cosZsinX = _mm_mul_ps(cosZ, sinX);
+		m[0][0] = _mm_mul_ps(scaleX, _mm_add_ps(_mm_mul_ps(cosZ, cosY), _mm_mul_ps(sinZsinX, sinY)));
+		m[0][1] = _mm_mul_ps(scaleX, _mm_mul_ps(sinZ, cosX));
+		m[0][2] = _mm_mul_ps(scaleX, _mm_sub_ps(_mm_mul_ps(sinZsinX, cosY), _mm_mul_ps(cosZ, sinY)));
+		m[1][0] = _mm_mul_ps(scaleY, _mm_sub_ps(_mm_mul_ps(cosZsinX, sinY), _mm_mul_ps(sinZ, cosY)));
+		m[1][1] = _mm_mul_ps(scaleY, _mm_mul_ps(cosZ, cosX));
+		m[1][2] = _mm_mul_ps(scaleY, _mm_add_ps(_mm_mul_ps(sinZ, sinY), _mm_mul_ps(cosZsinX, cosY)));
+		m[2][0] = _mm_mul_ps(scaleZ, _mm_mul_ps(cosX, sinY));
+		m[2][1] = _mm_mul_ps(scaleZ, _mm_sub_ps(_mm_setzero_ps(), sinX));
+		m[2][2] = _mm_mul_ps(scaleZ, _mm_mul_ps(cosX, cosY));
+		m[3][0] = _mm_setr_ps(translations[0].x, translations[1].x, translations[2].x, translations[3].x);
+		m[3][1] = _mm_setr_ps(translations[0].y, translations[1].y, translations[2].y, translations[3].y);
+		m[3][2] = _mm_setr_ps(translations[0].z, translations[1].z, translations[2].z, translations[3].z);
+		m[0][3] = m[1][3] = m[2][3] = _mm_setzero_ps();
+		m[3][3] = _mm_set1_ps(1.0f);
+
+		// 親行列を掛ける（ローカル行列の４列目は (0,0,0,1)）
+		if (parent)
+		{
+			__m128 w[4][4];
+			for (int i = 0; i < 4; i++)
+			{
+				for (int j = 0; j < 4; j++)
+				{
+					__m128 sum = _mm_add_ps(
+						_mm_mul_ps(m[i][0], _mm_set1_ps(parent->m[0][j])),
+						_mm_mul_ps(m[i][1], _mm_set1_ps(parent->m[1][j])));
+					sum = _mm_add_ps(sum, _mm_mul_ps(m[i][2], _mm_set1_ps(parent->m[2][j])));
+					w[i][j] = i == 3 ? _mm_add_ps(sum, _mm_set1_ps(parent->m[3][j])) : sum;
+				}
+			}
+			for (int i = 0; i < 4; i++)
+			{
+				for (int j = 0; j < 4; j++)
+				{
+					m[i][j] = w[i][j];
+				}
+			}
+		}
+
+		// 転置して行列ごとに書き出す
+		for (int i = 0; i < 4; i++)
+		{
+			__m128 row0 = m[i][0], row1 = m[i][1], row2 = m[i][2], row3 = m[i][3];
+			_MM_TRANSPOSE4_PS(row0, row1, row2, row3);
+			_mm_storeu_ps(worlds[0].m[i], row0);
+			_mm_storeu_ps(worlds[1].m[i], row1);
+			_mm_storeu_ps(worlds[2].m[i], row2);
+			_mm_storeu_ps(worlds[3].m[i], row3);
+		}
+	}
+}
+
+void ComposeTransformsSSE2(const Float3* scales, const Float3* rotations, const Float3* translations,
+	const Float4x4* parent, Float4x4* worlds, size_t count)
+{
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		Compose4(scales + i, rotations + i, translations + i, parent, worlds + i);
+	}
+
+	// 端数は一時配列に詰めて同じ計算をする（結果を SIMD 部分と揃えるため）
+	if (i < count)
+	{
+		const Float3 one = { 1.0f, 1.0f, 1.0f };
+		Float3 s[4] = { one, one, one, one };
+		Float3 r[4] = {};
+		Float3 t[4] = {};
+		Float4x4 w[4];
+		size_t rest = count - i;
+		for (size_t k = 0; k < rest; k++)
+		{
+			s[k] = scales[i + k];
+			r[k] = rotations[i + k];
+			t[k] = translations[i + k];
+		}
+		Compose4(s, r, t, parent, w);
+		for (size_t k = 0; k < rest; k++)
+		{
+			worlds[i + k] = w[k];
+		}
+	}
+}
+
+void SinCosSSE2(const float* angles, float* sines, float* cosines, size_t count)
+{
+	for (size_t i = 0; i < count; i += 4)
+	{
+		float a[4] = {}, s[4], c[4];
+		size_t n = count - i < 4 ? count - i : 4;
+		for (size_t k = 0; k < n; k++)
+		{
+			a[k] = angles[i + k];
+		}
+		__m128 vs, vc;
+		SinCos4(_mm_loadu_ps(a), &vs, &vc);
+		_mm_storeu_ps(s, vs);
+		_mm_storeu_ps(c, vc);
+		for (size_t k = 0; k < n; k++)
+		{
+			sines[i + k] = s[k];
+			cosines[i + k] = c[k];
+		}
+	}
+}
+#endif
+
+#if TRANSFORM_KERNEL_AVX2
+namespace
+{
+	// ８個の角度の sin と cos を同時に求める
+	inline void SinCos8(__m256 x, __m256* s, __m256* c)
+	{
+		const __m256 signMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x80000000));
+
+		__m256 signSin = _mm256_and_ps(x, signMask);
+		x = _mm256_andnot_ps(signMask, x);
+
+		__m256i quadrant = _mm256_cvttps_epi32(_mm256_mul_ps(x, _mm256_set1_ps(FOUR_OVER_PI)));
+		quadrant = _mm256_add_epi32(quadrant, _mm256_set1_epi32(1));
+		quadrant = _mm256_and_si256(quadrant, _mm256_set1_epi32(~1));
+		__m256 y = _mm256_cvtepi32_ps(quadrant);
+
+		__m256 swapSignSin = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(quadrant, _mm256_set1_epi32(4)), 29));
+		__m256 polyMask = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(quadrant, _mm256_set1_epi32(2)), _mm256_setzero_si256()));
+		__m256 signCos = _mm256_castsi256_ps(_mm256_slli_epi32(
+			_mm256_andnot_si256(_mm256_sub_epi32(quadrant, _mm256_set1_epi32(2)), _mm256_set1_epi32(4)), 29));
+		signSin = _mm256_xor_ps(signSin, swapSignSin);
+
+		x = _mm256_add_ps(x, _mm256_mul_ps(y, _mm256_set1_ps(MINUS_DP1)));
+		x = _mm256_add_ps(x, _mm256_mul_ps(y, _mm256_set1_ps(MINUS_DP2)));
+		x = _mm256_add_ps(x, _mm256_mul_ps(y, _mm256_set1_ps(MINUS_DP3)));
+		__m256 z = _mm256_mul_ps(x, x);
+
+		__m256 polyCos = _mm256_set1_ps(COS_P0);
+		polyCos = _mm256_add_ps(_mm256_mul_ps(polyCos, z), _mm256_set1_ps(COS_P1));
+		polyCos = _mm256_add_ps(_mm256_mul_ps(polyCos, z), _mm256_set1_ps(COS_P2));
+		polyCos = _mm256_mul_ps(_mm256_mul_ps(polyCos, z), z);
+		polyCos = _mm256_sub_ps(polyCos, _mm256_mul_ps(z, _mm256_set1_ps(0.5f)));
+		polyCos = _mm256_add_ps(polyCos, _mm256_set1_ps(1.0f));
+
+		__m256 polySin = _mm256_set1_ps(SIN_P0);
+		polySin = _mm256_add_ps(_mm256_mul_ps(polySin, z), _mm256_set1_ps(SIN_P1));
+		polySin = _mm256_add_ps(_mm256_mul_ps(polySin, z), _mm256_set1_ps(SIN_P2));
+		polySin = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(polySin, z), x), x);
+
+		__m256 sinValue = _mm256_blendv_ps(polyCos, polySin, polyMask);
+		__m256 cosValue = _mm256_blendv_ps(polySin, polyCos, polyMask);
+		*s = _mm256_xor_ps(sinValue, signSin);
+		*c = _mm256_xor_ps(cosValue, signCos);
+	}
+
+	// ８要素の成分を読み込む
+	inline __m256 Gather8(const float* base, size_t stride)
+	{
+		return _mm256_setr_ps(base[0], base[stride], base[stride * 2], base[stride * 3],
+			base[stride * 4], base[stride * 5], base[stride * 6], base[stride * 7]);
+	}
+
+	// ８個分の行列を合成して書き出す
+	inline void Compose8(const Float3* scales, const Float3* rotations, const Float3* translations,
+		const Float4x4* parent, Float4x4* worlds)
+	{
+		const size_t stride = sizeof(Float3) / sizeof(float);
+
+		__m256 sinX, cosX, sinY, cosY, sinZ, cosZ;
+		SinCos8(Gather8(&rotations[0].x, stride), &sinX, &cosX);
+		SinCos8(Gather8(&rotations[0].y, stride), &sinY, &cosY);
+		SinCos8(Gather8(&rotations[0].z, stride), &sinZ, &cosZ);
+
+		const __m256 scaleX = Gather8(&scales[0].x, stride);
+		const __m256 scaleY = Gather8(&scales[0].y, stride);
+		const __m256 scaleZ = Gather8(&scales[0].z, stride);
+
+		__m256 m[4][4];
+		const __m256 sinZsinX = _mm256_mul_ps(sinZ, sinX);
+		const __m256 cosZsinX = _mm256_mul_ps(cosZ, sinX);
+		m[0][0] = _mm256_mul_ps(scaleX, _mm256_add_ps(_mm256_mul_ps(cosZ, cosY), _mm256_mul_ps(sinZsinX, sinY)));
+		m[0][1] = _mm256_mul_ps(scaleX, _mm256_mul_ps(sinZ, cosX));
+		m[0][2] = _mm256_mul_ps(scaleX, _mm256_sub_ps(_mm256_mul_ps(sinZsinX, cosY), _mm256_mul_ps(cosZ, sinY)));
+		m[1][0] = _mm256_mul_ps(scaleY, _mm256_sub_ps(_mm256_mul_ps(cosZsinX, sinY), _mm256_mul_ps(sinZ, cosY)));
+		m[1][1] = _mm256_mul_ps(scaleY, _mm256_mul_ps(cosZ, cosX));
+		m[1][2] = _mm256_mul_ps(scaleY, _mm256_add_ps(_mm256_mul_ps(sinZ, sinY), _mm256_mul_ps(cosZsinX, cosY)));
+		m[2][0] = _mm256_mul_ps(scaleZ, _mm256_mul_ps(cosX, sinY));
+		m[2][1] = _mm256_mul_ps(scaleZ, _mm256_sub_ps(_mm256_setzero_ps(), sinX));
+		m[2][2] = _mm256_mul_ps(scaleZ, _mm256_mul_ps(cosX, cosY));
+		m[3][0] = Gather8(&translations[0].x, stride);
+		m[3][1] = Gather8(&translations[0].y, stride);
+		m[3][2] = Gather8(&translations[0].z, stride);
+		m[0][3] = m[1][3] = m[2][3] = _mm256_setzero_ps();
+		m[3][3] = _mm256_set1_ps(1.0f);
+
+		if (parent)
+		{
+			__m256 w[4][4];
+			for (int i = 0; i < 4; i++)
+			{
+				for (int j = 0; j < 4; j++)
+				{
+					__m256 sum = _mm256_add_ps(
+						_mm256_mul_ps(m[i][0], _mm256_set1_ps(parent->m[0][j])),
+						_mm256_mul_ps(m[i][1], _mm256_set1_ps(parent->m[1][j])));
+					sum = _mm256_add_ps(sum, _mm256_mul_ps(m[i][2], _mm256_set1_ps(parent->m[2][j])));
+					w[i][j] = i == 3 ? _mm256_add_ps(sum, _mm256_set1_ps(parent->m[3][j])) : sum;
+				}
+			}
+			for (int i = 0; i < 4; i++)
+			{
+				for (int j = 0; j < 4; j++)
+				{
+					m[i][j] = w[i][j];
+				}
+			}
+		}
+
+		// 各行を４×８から８×４に転置して書き出す
+		for (int i = 0; i < 4; i++)
+		{
+			__m256 t0 = _mm256_unpacklo_ps(m[i][0], m[i][1]);
+			__m256 t1 = _mm256_unpackhi_ps(m[i][0], m[i][1]);
+			__m256 t2 = _mm256_unpacklo_ps(m[i][2], m[i][3]);
+			__m256 t3 = _mm256_unpackhi_ps(m[i][2], m[i][3]);
+			__m256 r0 = _mm256_shuffle_ps(t0, t2, 0x44);
+			__m256 r1 = _mm256_shuffle_ps(t0, t2, 0xEE);
+			__m256 r2 = _mm256_shuffle_ps(t1, t3, 0x44);
+			__m256 r3 = _mm256_shuffle_ps(t1, t3, 0xEE);
+			_mm_storeu_ps(worlds[0].m[i], _mm256_castps256_ps128(r0));
+			_mm_storeu_ps(worlds[1].m[i], _mm256_castps256_ps128(r1));
+			_mm_storeu_ps(worlds[2].m[i], _mm256_castps256_ps128(r2));
+			_mm_storeu_ps(worlds[3].m[i], _mm256_castps256_ps128(r3));
+			_mm_storeu_ps(worlds[4].m[i], _mm256_extractf128_ps(r0, 1));
+			_mm_storeu_ps(worlds[5].m[i], _mm256_extractf128_ps(r1, 1));
+			_mm_storeu_ps(worlds[6].m[i], _mm256_extractf128_ps(r2, 1));
+			_mm_storeu_ps(worlds[7].m[i], _mm256_extractf128_ps(r3, 1));
+		}
+	}
+}
+
+void ComposeTransformsAVX2(const Float3* scales, const Float3* rotations, const Float3* translations,
+	const Float4x4* parent, Float4x4* worlds, size_t count)
+{
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		Compose8(scales + i, rotations + i, translations + i, parent, worlds + i);
+	}
+
+	// 端数は一時配列に詰めて同じ計算をする
+	if (i < count)
+	{
+		const Float3 one = { 1.0f, 1.0f, 1.0f };
+		Float3 s[8] = { one, one, one, one, one, one, one, one };
+		Float3 r[8] = {};
+		Float3 t[8] = {};
+		Float4x4 w[8];
+		size_t rest = count - i;
+		for (size_t k = 0; k < rest; k++)
+		{
+			s[k] = scales[i + k];
+			r[k] = rotations[i + k];
+			t[k] = translations[i + k];
+		}
+		Compose8(s, r, t, parent, w);
+		for (size_t k = 0; k < rest; k++)
+		{
+			worlds[i + k] = w[k];
+		}
+	}
+}
+
+void SinCosAVX2(const float* angles, float* sines, float* cosines, size_t count)
+{
+	for (size_t i = 0; i < count; i += 8)
+	{
+		float a[8] = {}, s[8], c[8];
+		size_t n = count - i < 8 ? count - i : 8;
+		for (size_t k = 0; k < n; k++)
+		{
+			a[k] = angles[i + k];
+		}
+		__m256 vs, vc;
+		SinCos8(_mm256_loadu_ps(a), &vs, &vc);
+		_mm256_storeu_ps(s, vs);
+		_mm256_storeu_ps(c, vc);
+		for (size_t k = 0; k < n; k++)
+		{
+			sines[i + k] = s[k];
+			cosines[i + k] = c[k];
+		}
+	}
+}
+#endif
+
+void ComposeTransforms(const Float3* scales, const Float3* rotations, const Float3* translations,
+	const Float4x4* parent, Float4x4* worlds, size_t count)
+{
+#if TRANSFORM_KERNEL_AVX2
+	ComposeTransformsAVX2(scales, rotations, translations, parent, worlds, count);
+#elif TRANSFORM_KERNEL_SSE2
+	ComposeTransformsSSE2(scales, rotations, translations, parent, worlds, count);
+#else
+	ComposeTransformsScalar(scales, rotations, translations, parent, worlds, count);
+#endif
+}
@@ -0,0 +1,42 @@
+﻿/// <summary>
+/// スケーリング・回転・平行移動からワールド行列をまとめて合成する関数群
+/// </summary>
+#pragma once
+
+#include <cstddef>
+
+#include "TransformMath.h"
+
+// 使用できる SIMD 命令セット
+#if defined(__AVX2__)
+#define TRANSFORM_KERNEL_AVX2 1
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TRANSFORM_KERNEL_SSE2 1
+#endif
+
+// world[i] = S(scales[i]) * Rz * Rx * Ry(rotations[i]) * T(translations[i]) * parent
+// parent が nullptr のときは親行列を掛けない
+// 使用できる中で最も速い実装を呼ぶ
+void ComposeTransforms(const Float3* scales, const Float3* rotations, const Float3* translations,
+	const Float4x4* parent, Float4x4* worlds, size_t count);
+
+// 基準となるスカラー実装（std::sin / std::cos を使用）
+void ComposeTransformsScalar(const Float3* scales, const Float3* rotations, const Float3* translations,
+	const Float4x4* parent, Float4x4* worlds, size_t count);
+
+#if TRANSFORM_KERNEL_SSE2
+// ４個ずつ処理する SSE2 実装
+void ComposeTransformsSSE2(const Float3* scales, const Float3* rotations, const Float3* translations,
+	const Float4x4* parent, Float4x4* worlds, size_t count);
+// ４個ずつ sin と cos を同時に求める（誤差の確認用）
+void SinCosSSE2(const float* angles, float* sines, float* cosines, size_t count);
+#endif
+
+#if TRANSFORM_KERNEL_AVX2
+// ８個ずつ処理する AVX2 実装
+void ComposeTransformsAVX2(const Float3* scales, const Float3* rotations, const Float3* translations,
+	const Float4x4* parent, Float4x4* worlds, size_t count);
+// ８個ずつ sin と cos を同時に求める（誤差の確認用）
+void SinCosAVX2(const float* angles, float* sines, float* cosines, size_t count);
+#endif
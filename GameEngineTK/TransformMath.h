@@ -0,0 +1,77 @@
+﻿/// <summary>
+/// プラットフォームに依存しない変換用の数学型
+/// </summary>
+#pragma once
+
+#include <cmath>
+
+// ３次元ベクトル（SimpleMath::Vector3 と同じメモリ配置）
+struct Float3
+{
+	float x, y, z;
+};
+
+// ４×４行列（SimpleMath::Matrix と同じ行優先・行ベクトル形式）
+struct Float4x4
+{
+	float m[4][4];
+};
+
+// 単位行列
+inline Float4x4 Float4x4Identity()
+{
+	Float4x4 result =
+	{ {
+		{ 1.0f, 0.0f, 0.0f, 0.0f },
+		{ 0.0f, 1.0f, 0.0f, 0.0f },
+		{ 0.0f, 0.0f, 1.0f, 0.0f },
+		{ 0.0f, 0.0f, 0.0f, 1.0f },
+	} };
+	return result;
+}
+
+// 行列の積（a * b）
+inline Float4x4 Multiply(const Float4x4& a, const Float4x4& b)
+{
+	Float4x4 result;
+	for (int i = 0; i < 4; i++)
+	{
+		for (int j = 0; j < 4; j++)
+		{
+			result.m[i][j] =
+				a.m[i][0] * b.m[0][j] +
+				a.m[i][1] * b.m[1][j] +
+				a.m[i][2] * b.m[2][j] +
+				a.m[i][3] * b.m[3][j];
+		}
+	}
+	return result;
+}
+
+// スケーリング・回転(Z→X→Y)・平行移動から行列を合成する
+// Matrix::CreateScale * CreateRotationZ * CreateRotationX * CreateRotationY * CreateTranslation と同じ結果
+inline Float4x4 ComposeTRS(const Float3& scale, const Float3& rotation, const Float3& translation)
+{
+	const float sinX = std::sin(rotation.x), cosX = std::cos(rotation.x);
+	const float sinY = std::sin(rotation.y), cosY = std::cos(rotation.y);
+	const float sinZ = std::sin(rotation.z), cosZ = std::cos(rotation.z);
+
+	Float4x4 result;
+	result.m[0][0] = scale.x * (cosZ * cosY + sinZ * sinX * sinY);
+	result.m[0][1] = scale.x * (sinZ * cosX);
+	result.m[0][2] = scale.x * (sinZ * sinX * cosY - cosZ * sinY);
+	result.m[0][3] = 0.0f;
+	result.m[1][0] = scale.y * (cosZ * sinX * sinY - sinZ * cosY);
+	result.m[1][1] = scale.y * (cosZ * cosX);
+	result.m[1][2] = scale.y * (sinZ * sinY + cosZ * sinX * cosY);
+	result.m[1][3] = 0.0f;
+	result.m[2][0] = scale.z * (cosX * sinY);
+	result.m[2][1] = scale.z * (-sinX);
+	result.m[2][2] = scale.z * (cosX * cosY);
+	result.m[2][3] = 0.0f;
+	result.m[3][0] = translation.x;
+	result.m[3][1] = translation.y;
+	result.m[3][2] = translation.z;
+	result.m[3][3] = 1.0f;
+	return result;
+}
@@ -0,0 +1,380 @@
+﻿/// <summary>
+/// 動的 AABB 木の検索結果を総当たりと比べ、構築・更新・検索の時間を測るコマンドラインツール
+///
+/// 使い方: AabbTreeBench [-n オブジェクト数] [-f 更新するフレーム数] [-q 検索の回数] [-k 近傍の数]
+/// -n を指定しなければ 10000、100000、1000000 個で順に測る
+/// オブジェクトを一定の密度でばらまいて木を作り、毎フレーム少しずつ（一部は大きく）動かして MoveProxy で更新し、
+/// 一部を削除して追加し直す。それぞれの後で Validate() が通ることを確かめ、
+/// ボックス・球・視錐台・k 近傍の検索結果が、全てのオブジェクトを総当たりで判定した結果と同じことを確かめる
+/// 構築・１フレームの更新・検索ごとの時間（総当たりの時間と比べて）を表示する
+/// 確かめた結果が合わなければ 1 を返す
+///
+/// Windows 以外では次のようにビルドする
+///   g++ -std=c++14 -O2 -pthread -I../../GameEngineTK Main.cpp ../../GameEngineTK/DynamicAabbTree.cpp
+///       ../../GameEngineTK/FrustumCulling.cpp ../../GameEngineTK/JobSystem.cpp ../../GameEngineTK/Profiler.cpp
+///       ../../GameEngineTK/Clock.cpp ../../GameEngineTK/FileSystem.cpp ../../GameEngineTK/FrameStats.cpp
+///       ../../GameEngineTK/FrameArena.cpp -o AabbTreeBench
+/// </summary>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "Clock.h"
+#include "DynamicAabbTree.h"
+#include "FrustumCulling.h"
+
+namespace
+{
+	// １オブジェクトあたりの空間の一辺（密度を一定にする）
+	const float CELL_SIZE = 8.0f;
+	// 大きく動かすオブジェクトの割合（%）
+	const float TELEPORT_PERCENT = 1.0f;
+	// 削除して追加し直すオブジェクトの割合（%）
+	const float RECREATE_PERCENT = 10.0f;
+	// 総当たりと比べる検索の回数（種類ごと）
+	const int COMPARE_QUERY_COUNT = 20;
+
+	// 確かめた結果を表示して数える
+	int Check(bool condition, const char* name, size_t objectCount)
+	{
+		if (!condition)
+		{
+			std::fprintf(stderr, "check failed: %s (%zu objects)\n", name, objectCount);
+			return 1;
+		}
+		return 0;
+	}
+
+	// 再現できる乱数（xorshift）
+	float Random(uint32_t& state, float low, float high)
+	{
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		return low + (high - low) * static_cast<float>(state & 0xffffff) / 16777216.0f;
+	}
+
+	Float3 RandomPoint(uint32_t& state, float extent)
+	{
+		return Float3{ Random(state, -extent, extent), Random(state, -extent * 0.1f, extent * 0.1f),
+			Random(state, -extent, extent) };
+	}
+
+	// オブジェクト（戦車のように地面の上を向いた方向へ進む）
+	struct Object
+	{
+		int32_t proxy;
+		Float3 center;
+		Float3 halfSize;
+		Float3 velocity;
+	};
+
+	Aabb GetAabb(const Object& object)
+	{
+		const Float3& c = object.center;
+		const Float3& h = object.halfSize;
+		Aabb aabb = { { c.x - h.x, c.y - h.y, c.z - h.z }, { c.x + h.x, c.y + h.y, c.z + h.z } };
+		return aabb;
+	}
+
+	Object MakeObject(uint32_t& random, float extent)
+	{
+		Object object;
+		object.proxy = DynamicAabbTree::NULL_NODE;
+		object.center = RandomPoint(random, extent);
+		object.halfSize = Float3{ Random(random, 0.25f, 2.0f), Random(random, 0.25f, 1.0f), Random(random, 0.25f, 2.0f) };
+		const float heading = Random(random, 0.0f, 6.2831853f);
+		const float speed = Random(random, 0.0f, 0.3f);
+		object.velocity = Float3{ std::cos(heading) * speed, 0.0f, std::sin(heading) * speed };
+		return object;
+	}
+
+	// position から yaw の向きを見る視点のビュー×射影行列（行ベクトル形式、深度 0～1）
+	Float4x4 MakeViewProjection(const Float3& position, float yaw, float farZ)
+	{
+		const float yScale = 1.0f / std::tan(0.5f);
+		const float nearZ = 0.1f;
+		Float4x4 projection = {};
+		projection.m[0][0] = yScale / (16.0f / 9.0f);
+		projection.m[1][1] = yScale;
+		projection.m[2][2] = farZ / (farZ - nearZ);
+		projection.m[2][3] = 1.0f;
+		projection.m[3][2] = -nearZ * farZ / (farZ - nearZ);
+
+		// 平行移動してからヨーの逆回転
+		Float4x4 view = Float4x4Identity();
+		view.m[0][0] = std::cos(yaw);
+		view.m[0][2] = std::sin(yaw);
+		view.m[2][0] = -std::sin(yaw);
+		view.m[2][2] = std::cos(yaw);
+		Float4x4 translation = Float4x4Identity();
+		translation.m[3][0] = -position.x;
+		translation.m[3][1] = -position.y;
+		translation.m[3][2] = -position.z;
+		return Multiply(Multiply(translation, view), projection);
+	}
+
+	// 経過時間（マイクロ秒）
+	double GetMicroseconds(Clock& clock, uint64_t begin)
+	{
+		return static_cast<double>(clock.GetCounter() - begin) * 1e6 / clock.GetFrequency();
+	}
+
+	// 検索の種類ごとの結果
+	struct QueryStats
+	{
+		const char* name;
+		double treeTime;
+		double bruteTime;
+		size_t hits;
+		int queryCount;
+		bool isSame;
+	};
+
+	// 木の検索と総当たりで同じプロキシが見つかるか比べる（test はボックスが当たるか）
+	template<typename TreeQuery, typename Test>
+	void CompareQuery(Clock& clock, const std::vector<Object>& objects, const TreeQuery& treeQuery, const Test& test,
+		QueryStats& stats)
+	{
+		std::vector<int32_t> found;
+		uint64_t begin = clock.GetCounter();
+		treeQuery([&found](int32_t proxy) { found.push_back(proxy); return true; });
+		stats.treeTime += GetMicroseconds(clock, begin);
+
+		std::vector<int32_t> expected;
+		begin = clock.GetCounter();
+		for (const Object& object : objects)
+		{
+			if (test(GetAabb(object)))
+			{
+				expected.push_back(object.proxy);
+			}
+		}
+		stats.bruteTime += GetMicroseconds(clock, begin);
+
+		std::sort(found.begin(), found.end());
+		std::sort(expected.begin(), expected.end());
+		stats.isSame = stats.isSame && found == expected;
+		stats.hits += found.size();
+		stats.queryCount++;
+	}
+
+	// １つの大きさで測る
+	int Run(size_t objectCount, int frameCount, int queryCount, size_t k)
+	{
+		int errors = 0;
+		Clock& clock = GetDefaultClock();
+		uint32_t random = 2463534242u ^ static_cast<uint32_t>(objectCount);
+		const float extent = CELL_SIZE * std::cbrt(static_cast<float>(objectCount)) * 0.5f;
+
+		std::vector<Object> objects;
+		objects.reserve(objectCount);
+		for (size_t i = 0; i < objectCount; i++)
+		{
+			objects.push_back(MakeObject(random, extent));
+		}
+
+		// 構築
+		DynamicAabbTree tree;
+		uint64_t begin = clock.GetCounter();
+		for (Object& object : objects)
+		{
+			object.proxy = tree.CreateProxy(GetAabb(object), &object);
+		}
+		const double buildTime = GetMicroseconds(clock, begin);
+		errors += Check(tree.Validate() && tree.GetProxyCount() == objectCount, "valid after build", objectCount);
+		const int32_t builtHeight = tree.GetHeight();
+
+		// 更新（ほとんどは少しずつ進み、一部は遠くへ移る）
+		double refitTime = 0.0;
+		size_t reinsertCount = 0;
+		for (int frame = 0; frame < frameCount; frame++)
+		{
+			for (Object& object : objects)
+			{
+				if (Random(random, 0.0f, 100.0f) < TELEPORT_PERCENT)
+				{
+					object.center = RandomPoint(random, extent);
+				}
+				else
+				{
+					object.center.x += object.velocity.x;
+					object.center.z += object.velocity.z;
+				}
+			}
+			begin = clock.GetCounter();
+			for (const Object& object : objects)
+			{
+				reinsertCount += tree.MoveProxy(object.proxy, GetAabb(object)) ? 1 : 0;
+			}
+			refitTime += GetMicroseconds(clock, begin);
+		}
+		errors += Check(tree.Validate(), "valid after moves", objectCount);
+
+		// 一部を削除して追加し直す（空いたノードが再利用される）
+		for (Object& object : objects)
+		{
+			if (Random(random, 0.0f, 100.0f) < RECREATE_PERCENT)
+			{
+				tree.DestroyProxy(object.proxy);
+				object = MakeObject(random, extent);
+				object.proxy = DynamicAabbTree::NULL_NODE;
+			}
+		}
+		errors += Check(tree.Validate(), "valid after removals", objectCount);
+		for (Object& object : objects)
+		{
+			if (object.proxy == DynamicAabbTree::NULL_NODE)
+			{
+				object.proxy = tree.CreateProxy(GetAabb(object), &object);
+			}
+		}
+		errors += Check(tree.Validate() && tree.GetProxyCount() == objectCount, "valid after reinsertion", objectCount);
+		bool isUserDataIntact = true;
+		for (const Object& object : objects)
+		{
+			isUserDataIntact = isUserDataIntact && tree.GetUserData(object.proxy) == &object;
+		}
+		errors += Check(isUserDataIntact, "user data follows the proxy", objectCount);
+
+		// 検索（最初の COMPARE_QUERY_COUNT 回は総当たりと比べる）
+		QueryStats aabbStats = { "AABB", 0.0, 0.0, 0, 0, true };
+		QueryStats sphereStats = { "sphere", 0.0, 0.0, 0, 0, true };
+		QueryStats frustumStats = { "frustum", 0.0, 0.0, 0, 0, true };
+		QueryStats nearestStats = { "nearest", 0.0, 0.0, 0, 0, true };
+		std::vector<int32_t> nearest(k);
+		std::vector<float> nearestDistances(k);
+		std::vector<float> bruteDistances(objectCount);
+		double queryTimes[4] = {};
+		for (int q = 0; q < queryCount; q++)
+		{
+			const bool isCompared = q < COMPARE_QUERY_COUNT;
+			const Float3 center = RandomPoint(random, extent);
+			const float size = Random(random, 5.0f, 40.0f);
+			const Aabb box = { { center.x - size, center.y - size, center.z - size }, { center.x + size, center.y + size, center.z + size } };
+			const float radius = Random(random, 5.0f, 40.0f);
+			const Frustum frustum = ExtractFrustum(MakeViewProjection(center, Random(random, 0.0f, 6.2831853f), 100.0f));
+
+			if (isCompared)
+			{
+				CompareQuery(clock, objects, [&](const auto& callback) { tree.QueryAabb(box, callback); },
+					[&](const Aabb& aabb) { return DynamicAabbTree::Overlaps(aabb, box); }, aabbStats);
+				CompareQuery(clock, objects, [&](const auto& callback) { tree.QuerySphere(center, radius, callback); },
+					[&](const Aabb& aabb) { return DynamicAabbTree::DistanceSquared(aabb, center) <= radius * radius; }, sphereStats);
+				CompareQuery(clock, objects, [&](const auto& callback) { tree.QueryFrustum(frustum, callback); },
+					[&](const Aabb& aabb) { return DynamicAabbTree::Overlaps(aabb, frustum); }, frustumStats);
+
+				// k 近傍は距離の並びが総当たりの小さい方から k 個と同じで、それぞれの距離が合っている
+				begin = clock.GetCounter();
+				const size_t foundCount = tree.QueryNearest(center, k, nearest.data(), nearestDistances.data());
+				nearestStats.treeTime += GetMicroseconds(clock, begin);
+				begin = clock.GetCounter();
+				for (size_t i = 0; i < objectCount; i++)
+				{
+					bruteDistances[i] = std::sqrt(DynamicAabbTree::DistanceSquared(GetAabb(objects[i]), center));
+				}
+				std::partial_sort(bruteDistances.begin(), bruteDistances.begin() + std::min(k, objectCount), bruteDistances.end());
+				nearestStats.bruteTime += GetMicroseconds(clock, begin);
+				bool isSame = foundCount == std::min(k, objectCount);
+				for (size_t i = 0; i < foundCount && isSame; i++)
+				{
+					isSame = nearestDistances[i] == bruteDistances[i] &&
+						nearestDistances[i] == std::sqrt(DynamicAabbTree::DistanceSquared(tree.GetAabb(nearest[i]), center)) &&
+						std::find(nearest.begin(), nearest.begin() + i, nearest[i]) == nearest.begin() + i;
+				}
+				nearestStats.isSame = nearestStats.isSame && isSame;
+				nearestStats.hits += foundCount;
+				nearestStats.queryCount++;
+				continue;
+			}
+
+			// 総当たりと比べない検索は木だけを測る
+			size_t hits = 0;
+			auto count = [&hits](int32_t) { hits++; return true; };
+			begin = clock.GetCounter();
+			tree.QueryAabb(box, count);
+			queryTimes[0] += GetMicroseconds(clock, begin);
+			begin = clock.GetCounter();
+			tree.QuerySphere(center, radius, count);
+			queryTimes[1] += GetMicroseconds(clock, begin);
+			begin = clock.GetCounter();
+			tree.QueryFrustum(frustum, count);
+			queryTimes[2] += GetMicroseconds(clock, begin);
+			begin = clock.GetCounter();
+			hits += tree.QueryNearest(center, k, nearest.data(), nullptr);
+			queryTimes[3] += GetMicroseconds(clock, begin);
+		}
+
+		std::printf("%zu objects: build %.1f ms, height %d -> %d\n", objectCount, buildTime / 1000.0, builtHeight,
+			tree.GetHeight());
+		std::printf("  refit %.2f ms/frame, %.2f%% reinserted\n", refitTime / 1000.0 / frameCount,
+			100.0 * reinsertCount / (static_cast<double>(objectCount) * frameCount));
+		QueryStats* allStats[] = { &aabbStats, &sphereStats, &frustumStats, &nearestStats };
+		for (int i = 0; i < 4; i++)
+		{
+			QueryStats& stats = *allStats[i];
+			// 比べた分と木だけの分を合わせた平均
+			const double treeTime = (stats.treeTime + queryTimes[i]) / std::max(queryCount, 1);
+			const double bruteTime = stats.bruteTime / std::max(stats.queryCount, 1);
+			std::printf("  %-8s query %9.2f us (brute force %9.2f us, %6.1fx), %.1f hits\n", stats.name, treeTime, bruteTime,
+				bruteTime / std::max(treeTime, 1e-3), static_cast<double>(stats.hits) / std::max(stats.queryCount, 1));
+			errors += Check(stats.isSame, stats.name, objectCount);
+		}
+		return errors;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	std::vector<size_t> objectCounts;
+	int frameCount = 10;
+	int queryCount = 100;
+	size_t k = 8;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "-n" && i + 1 < argc)
+		{
+			objectCounts.push_back(static_cast<size_t>(std::max(std::atoll(argv[++i]), 1ll)));
+		}
+		else if (arg == "-f" && i + 1 < argc)
+		{
+			frameCount = std::max(std::atoi(argv[++i]), 1);
+		}
+		else if (arg == "-q" && i + 1 < argc)
+		{
+			queryCount = std::max(std::atoi(argv[++i]), 1);
+		}
+		else if (arg == "-k" && i + 1 < argc)
+		{
+			k = static_cast<size_t>(std::max(std::atoi(argv[++i]), 1));
+		}
+		else
+		{
+			std::fprintf(stderr, "usage: AabbTreeBench [-n objects]... [-f frames] [-q queries] [-k nearest]\n");
+			return 2;
+		}
+	}
+	if (objectCounts.empty())
+	{
+		objectCounts = { 10000, 100000, 1000000 };
+	}
+
+	int errors = 0;
+	for (size_t objectCount : objectCounts)
+	{
+		errors += Run(objectCount, frameCount, queryCount, k);
+	}
+
+	if (errors > 0)
+	{
+		std::fprintf(stderr, "%d checks failed\n", errors);
+		return 1;
+	}
+	std::printf("checks: ok\n");
+	return 0;
+}
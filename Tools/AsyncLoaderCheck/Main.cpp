@@ -0,0 +1,224 @@
+﻿/// <summary>
+/// バックグラウンドでファイルを読み込むクラスを GPU を使わずに確かめるコマンドラインツール
+///
+/// 使い方: AsyncLoaderCheck [-dir 一時ファイルのフォルダ] [-n 読み込む数] [-j 読み込むスレッド数]
+/// 一時ファイルを書き出して AsyncFileLoader で読み込み、次のことを確かめる
+/// ・同じファイルを何度依頼しても、依頼ごとに同じ中身で１回ずつ通知される
+/// ・無いファイルや解析に失敗したファイルは失敗として通知される
+/// ・解析は読み込みスレッドで、通知は DispatchCompletions を呼んだスレッドで行われる
+/// ・通知の中から依頼した読み込みも Flush で全て終わり、通知されていない数が 0 に戻る
+/// ・読み込み中に破棄しても止まらない
+/// 確かめた結果が合わなければ 1 を返す
+///
+/// Windows 以外では次のようにビルドする
+///   g++ -std=c++14 -O2 -pthread -I../../GameEngineTK Main.cpp ../../GameEngineTK/AsyncFileLoader.cpp
+///       ../../GameEngineTK/FileSystem.cpp -o AsyncLoaderCheck
+/// </summary>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "AsyncFileLoader.h"
+#include "FileSystem.h"
+
+namespace
+{
+	// 書き出す一時ファイルの数
+	const int FILE_COUNT = 8;
+
+	// 確かめた結果を表示して数える
+	int Check(bool condition, const char* name)
+	{
+		if (!condition)
+		{
+			std::fprintf(stderr, "check failed: %s\n", name);
+			return 1;
+		}
+		return 0;
+	}
+
+	// index 番目の一時ファイルの中身（ファイルごとに大きさと値を変える）
+	std::vector<uint8_t> MakeContents(int index)
+	{
+		std::vector<uint8_t> data(1000 + index * 4096);
+		for (size_t i = 0; i < data.size(); i++)
+		{
+			data[i] = static_cast<uint8_t>(i * 31 + index);
+		}
+		return data;
+	}
+
+	// 読み込んだ中身が index 番目の一時ファイルと同じか
+	bool IsContents(const std::vector<uint8_t>& data, int index)
+	{
+		return data == MakeContents(index);
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	std::string directory = ".";
+	int loadCount = 1000;
+	unsigned threadCount = 2;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "-dir" && i + 1 < argc)
+		{
+			directory = argv[++i];
+		}
+		else if (arg == "-n" && i + 1 < argc)
+		{
+			loadCount = std::max(std::atoi(argv[++i]), 1);
+		}
+		else if (arg == "-j" && i + 1 < argc)
+		{
+			threadCount = static_cast<unsigned>(std::max(std::atoi(argv[++i]), 1));
+		}
+		else
+		{
+			std::fprintf(stderr, "usage: AsyncLoaderCheck [-dir temp_directory] [-n loads] [-j threads]\n");
+			return 2;
+		}
+	}
+
+	// 一時ファイルを書き出す
+	std::vector<std::wstring> paths;
+	for (int i = 0; i < FILE_COUNT; i++)
+	{
+		const std::wstring path = FromUtf8(directory + "/AsyncLoaderCheck_" + std::to_string(i) + ".bin");
+		const std::vector<uint8_t> data = MakeContents(i);
+		if (!WriteWholeFile(path, data.data(), data.size()))
+		{
+			std::fprintf(stderr, "%s: cannot write\n", ToUtf8(path).c_str());
+			return 1;
+		}
+		paths.push_back(path);
+	}
+	const std::wstring missingPath = FromUtf8(directory + "/AsyncLoaderCheck_missing.bin");
+
+	int errors = 0;
+	const std::thread::id mainThread = std::this_thread::get_id();
+	{
+		AsyncFileLoader loader(threadCount);
+
+		// 同じファイルを何度も依頼する（依頼ごとに１回ずつ、同じ中身で通知される）
+		int duplicateCount = 0;
+		bool isDuplicateIntact = true;
+		std::atomic<int> decodeCount(0);
+		bool isDecodedOnWorker = true;
+		bool isCompletedOnMain = true;
+		for (int i = 0; i < 4; i++)
+		{
+			loader.Load(paths[0], [&](bool isSucceeded, std::vector<uint8_t>& data)
+			{
+				duplicateCount++;
+				isDuplicateIntact = isDuplicateIntact && isSucceeded && IsContents(data, 0);
+				isCompletedOnMain = isCompletedOnMain && std::this_thread::get_id() == mainThread;
+			},
+			[&](std::vector<uint8_t>&)
+			{
+				decodeCount++;
+				if (std::this_thread::get_id() == mainThread)
+				{
+					isDecodedOnWorker = false;
+				}
+				return true;
+			});
+		}
+		errors += Check(loader.GetPendingCount() == 4, "pending count after duplicate requests");
+
+		// 無いファイルと、解析に失敗するファイル
+		int failedCount = 0;
+		bool isFailureEmpty = true;
+		loader.Load(missingPath, [&](bool isSucceeded, std::vector<uint8_t>& data)
+		{
+			failedCount += isSucceeded ? 0 : 1;
+			isFailureEmpty = isFailureEmpty && data.empty();
+		});
+		loader.Load(paths[1], [&](bool isSucceeded, std::vector<uint8_t>&)
+		{
+			failedCount += isSucceeded ? 0 : 1;
+		},
+		[](std::vector<uint8_t>&)
+		{
+			return false;
+		});
+
+		loader.Flush();
+		errors += Check(duplicateCount == 4 && isDuplicateIntact, "duplicate requests each complete once");
+		errors += Check(decodeCount.load() == 4 && isDecodedOnWorker, "decoder runs on the loader thread");
+		errors += Check(isCompletedOnMain, "completions run on the dispatching thread");
+		errors += Check(failedCount == 2 && isFailureEmpty, "missing file and decode failure are reported");
+		errors += Check(loader.GetPendingCount() == 0 && loader.DispatchCompletions() == 0, "nothing left after flush");
+
+		// 通知の中から次のファイルを依頼する（Flush は連鎖した依頼も全て終わらせる）
+		int chainIndex = 0;
+		bool isChainIntact = true;
+		std::function<void(bool, std::vector<uint8_t>&)> loadNext = [&](bool isSucceeded, std::vector<uint8_t>& data)
+		{
+			isChainIntact = isChainIntact && isSucceeded && IsContents(data, chainIndex);
+			if (++chainIndex < FILE_COUNT)
+			{
+				loader.Load(paths[chainIndex], loadNext);
+				// 自分の依頼を読み終える前に同じファイルをもう１回依頼しても、それぞれ通知される
+				loader.Load(paths[chainIndex], [&](bool isSucceeded, std::vector<uint8_t>&)
+				{
+					isChainIntact = isChainIntact && isSucceeded;
+				});
+			}
+		};
+		loader.Load(paths[0], loadNext);
+		loader.Flush();
+		errors += Check(chainIndex == FILE_COUNT && isChainIntact, "loads issued from completions finish in Flush");
+		errors += Check(loader.GetPendingCount() == 0, "pending count returns to zero");
+
+		// 多数の依頼を DispatchCompletions で少しずつ受け取る
+		int completedCount = 0;
+		bool isManyIntact = true;
+		for (int i = 0; i < loadCount; i++)
+		{
+			const int index = i % FILE_COUNT;
+			loader.Load(i % 10 == 9 ? missingPath : paths[index], [&, i, index](bool isSucceeded, std::vector<uint8_t>& data)
+			{
+				completedCount++;
+				isManyIntact = isManyIntact && (i % 10 == 9 ? !isSucceeded : isSucceeded && IsContents(data, index));
+			});
+		}
+		while (completedCount < loadCount)
+		{
+			if (loader.DispatchCompletions() == 0)
+			{
+				std::this_thread::yield();
+			}
+		}
+		errors += Check(isManyIntact && loader.GetPendingCount() == 0, "many loads complete once each");
+		std::printf("loads: %d completed on %u thread%s\n", completedCount, threadCount, threadCount == 1 ? "" : "s");
+
+		// 読み込み中の依頼を残したまま破棄する（通知は呼ばれない）
+		for (int i = 0; i < loadCount; i++)
+		{
+			loader.Load(paths[i % FILE_COUNT], [](bool, std::vector<uint8_t>&) {});
+		}
+	}
+	std::printf("destroyed with pending loads\n");
+
+	for (const std::wstring& path : paths)
+	{
+		std::remove(ToUtf8(path).c_str());
+	}
+
+	if (errors > 0)
+	{
+		std::fprintf(stderr, "%d checks failed\n", errors);
+		return 1;
+	}
+	std::printf("checks: ok\n");
+	return 0;
+}
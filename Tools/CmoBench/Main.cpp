@@ -0,0 +1,714 @@
+﻿/// <summary>
+/// CMO の読み取りを確かめ、速さを測るコマンドラインツール
+///
+/// 使い方: CmoBench [-assets フォルダ] [-dir 一時ファイルのフォルダ] [-scale 倍数] [-r 繰り返す回数] [入力.cmo または入力フォルダ...]
+/// 入力を指定しなければ、Assets の .WRL（VRML の IndexedFaceSet）を CMO に変換して一時ファイルに書き出し、
+/// 形状を -scale 倍に複製して大きなファイルも作る
+/// 書き出したファイルは次のことを確かめる
+/// ・書き出した数のマテリアル、サブメッシュ、バッファ、インデックスが読み取れる
+/// ・途中で切れたファイル、範囲外のインデックスやバッファを指すファイルは失敗する
+/// ・ランダムに壊したファイルでも止まらない
+/// 全てのファイルについて、メモリ上のデータの解析、マップして解析（Open）、全て読み込んで解析、
+/// 全てコピーするだけ（比較用）の時間と速さを表示する
+/// 確かめた結果が合わなければ 1 を返す
+///
+/// Windows 以外では次のようにビルドする
+///   g++ -std=c++14 -O2 -I../../GameEngineTK Main.cpp ../../GameEngineTK/CmoReader.cpp
+///       ../../GameEngineTK/FileSystem.cpp ../../GameEngineTK/Clock.cpp -o CmoBench
+/// </summary>
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cwctype>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "Clock.h"
+#include "CmoReader.h"
+#include "FileSystem.h"
+
+namespace
+{
+	// ランダムに壊すファイルの数
+	const int CORRUPT_COUNT = 2000;
+
+	// 確かめた結果を表示して数える
+	int Check(bool condition, const char* name, const std::string& file)
+	{
+		if (!condition)
+		{
+			std::fprintf(stderr, "check failed: %s (%s)\n", name, file.c_str());
+			return 1;
+		}
+		return 0;
+	}
+
+	// 再現できる乱数（xorshift）
+	uint32_t Random(uint32_t& state)
+	{
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		return state;
+	}
+
+	// 拡張子が一致するか（大文字小文字を区別しない）
+	bool HasExtension(const std::wstring& path, const wchar_t* extension)
+	{
+		const size_t length = std::wcslen(extension);
+		if (path.size() < length)
+		{
+			return false;
+		}
+		std::wstring tail = path.substr(path.size() - length);
+		std::transform(tail.begin(), tail.end(), tail.begin(), [](wchar_t c) { return static_cast<wchar_t>(std::towlower(c)); });
+		return tail == extension;
+	}
+
+	bool IsCmoFile(const std::wstring& path)
+	{
+		return HasExtension(path, L".cmo");
+	}
+
+	bool IsWrlFile(const std::wstring& path)
+	{
+		return HasExtension(path, L".wrl");
+	}
+
+	// VRML の形状（１つの Shape）
+	struct WrlShape
+	{
+		float diffuse[3];
+		float specular[3];
+		float shininess;
+		std::vector<float> points;
+		// 三角形に分割したインデックス
+		std::vector<uint32_t> indices;
+	};
+
+	// VRML のテキストを読む位置
+	class WrlCursor
+	{
+	public:
+		explicit WrlCursor(const std::string& text) : m_text(text), m_position(0) {}
+
+		// 次の key の直後に進む（見つからなければ false）
+		bool Find(const char* key, size_t limit = std::string::npos)
+		{
+			const size_t found = m_text.find(key, m_position);
+			if (found == std::string::npos || found >= limit)
+			{
+				return false;
+			}
+			m_position = found + std::strlen(key);
+			return true;
+		}
+		// 次の key の位置
+		size_t Peek(const char* key) const { return m_text.find(key, m_position); }
+		// 数値を読む（区切りのカンマと空白は飛ばす）
+		bool ReadNumber(double& value)
+		{
+			while (m_position < m_text.size() && (std::isspace(static_cast<unsigned char>(m_text[m_position])) || m_text[m_position] == ','))
+			{
+				m_position++;
+			}
+			if (m_position >= m_text.size() || m_text[m_position] == ']')
+			{
+				return false;
+			}
+			char* end;
+			value = std::strtod(m_text.c_str() + m_position, &end);
+			if (end == m_text.c_str() + m_position)
+			{
+				return false;
+			}
+			m_position = end - m_text.c_str();
+			return true;
+		}
+
+	private:
+		const std::string& m_text;
+		size_t m_position;
+	};
+
+	// key の後に続く count 個の数値を読む（key が limit までに無ければ values はそのまま）
+	void ReadValues(WrlCursor cursor, const char* key, size_t limit, float* values, int count)
+	{
+		if (!cursor.Find(key, limit))
+		{
+			return;
+		}
+		double value;
+		for (int i = 0; i < count && cursor.ReadNumber(value); i++)
+		{
+			values[i] = static_cast<float>(value);
+		}
+	}
+
+	// VRML の Shape を全て読む（変換は無視し、多角形は扇形に三角形へ分割する）
+	bool ReadWrl(const std::wstring& path, std::vector<WrlShape>& shapes)
+	{
+		std::vector<uint8_t> data;
+		if (!ReadWholeFile(path, data))
+		{
+			return false;
+		}
+		const std::string text(data.begin(), data.end());
+		WrlCursor cursor(text);
+		while (cursor.Find("Shape {"))
+		{
+			WrlShape shape = {};
+			shape.diffuse[0] = shape.diffuse[1] = shape.diffuse[2] = 0.8f;
+			shape.shininess = 0.2f;
+			const size_t next = cursor.Peek("Shape {");
+			ReadValues(cursor, "diffuseColor", next, shape.diffuse, 3);
+			ReadValues(cursor, "specularColor", next, shape.specular, 3);
+			ReadValues(cursor, "shininess", next, &shape.shininess, 1);
+
+			if (!cursor.Find("point [", next))
+			{
+				continue;
+			}
+			double value;
+			while (cursor.ReadNumber(value))
+			{
+				shape.points.push_back(static_cast<float>(value));
+			}
+			if (shape.points.size() % 3 != 0 || !cursor.Find("coordIndex [", next))
+			{
+				return false;
+			}
+			const uint32_t pointCount = static_cast<uint32_t>(shape.points.size() / 3);
+			std::vector<uint32_t> polygon;
+			bool isEnd = false;
+			while (!isEnd)
+			{
+				isEnd = !cursor.ReadNumber(value);
+				const int index = isEnd ? -1 : static_cast<int>(value);
+				if (index >= 0)
+				{
+					if (static_cast<uint32_t>(index) >= pointCount)
+					{
+						return false;
+					}
+					polygon.push_back(static_cast<uint32_t>(index));
+					continue;
+				}
+				for (size_t i = 2; i < polygon.size(); i++)
+				{
+					shape.indices.push_back(polygon[0]);
+					shape.indices.push_back(polygon[i - 1]);
+					shape.indices.push_back(polygon[i]);
+				}
+				polygon.clear();
+			}
+			if (!shape.indices.empty())
+			{
+				shapes.push_back(shape);
+			}
+		}
+		return !shapes.empty();
+	}
+
+	// CMO を書き出す
+	class CmoWriter
+	{
+	public:
+		void Write(const void* data, size_t size)
+		{
+			const uint8_t* bytes = static_cast<const uint8_t*>(data);
+			m_data.insert(m_data.end(), bytes, bytes + size);
+		}
+		void WriteUInt32(uint32_t value) { Write(&value, sizeof(value)); }
+		// 長さ（終端の 0 を含む）と UTF-16 の文字
+		void WriteString(const std::string& text)
+		{
+			WriteUInt32(static_cast<uint32_t>(text.size() + 1));
+			for (char c : text)
+			{
+				const uint16_t wide = static_cast<uint8_t>(c);
+				Write(&wide, sizeof(wide));
+			}
+			const uint16_t terminator = 0;
+			Write(&terminator, sizeof(terminator));
+		}
+		size_t GetSize() const { return m_data.size(); }
+		std::vector<uint8_t>& GetData() { return m_data; }
+
+	private:
+		std::vector<uint8_t> m_data;
+	};
+
+	// 書き出したファイルの内容（読み取った結果と比べる）
+	struct CmoLayout
+	{
+		uint32_t materialCount;
+		uint32_t submeshCount;
+		uint32_t bufferCount;
+		size_t indexCount;
+		size_t geometryBytes;
+		// 最初のサブメッシュの位置と、最初のインデックスバッファの中身の位置
+		size_t firstSubmeshOffset;
+		size_t firstIndexOffset;
+		// 最初の頂点バッファの頂点数
+		uint32_t firstVertexCount;
+	};
+
+	// 形状をそれぞれ scale 回複製して１つのメッシュの CMO にする
+	// 複製ごとに頂点バッファとインデックスバッファを分け、少しずつずらして置く
+	std::vector<uint8_t> MakeCmo(const std::vector<WrlShape>& shapes, int scale, CmoLayout& layout)
+	{
+		CmoWriter writer;
+		writer.WriteUInt32(1);
+		writer.WriteString("mesh");
+
+		layout = CmoLayout();
+		layout.materialCount = static_cast<uint32_t>(shapes.size());
+		writer.WriteUInt32(layout.materialCount);
+		for (size_t i = 0; i < shapes.size(); i++)
+		{
+			const WrlShape& shape = shapes[i];
+			CmoMaterial material = {};
+			for (int c = 0; c < 3; c++)
+			{
+				material.ambient[c] = shape.diffuse[c] * 0.2f;
+				material.diffuse[c] = shape.diffuse[c];
+				material.specular[c] = shape.specular[c];
+			}
+			material.ambient[3] = material.diffuse[3] = material.specular[3] = material.emissive[3] = 1.0f;
+			material.specularPower = shape.shininess * 128.0f;
+			for (int k = 0; k < 16; k += 5)
+			{
+				material.uvTransform[k] = 1.0f;
+			}
+			writer.WriteString("material" + std::to_string(i));
+			writer.Write(&material, sizeof(material));
+			writer.WriteString("Lambert.ps");
+			for (int t = 0; t < CmoMaterialInfo::MAX_TEXTURE; t++)
+			{
+				writer.WriteString("");
+			}
+		}
+
+		// スケルトンなし
+		const uint8_t hasSkeleton = 0;
+		writer.Write(&hasSkeleton, sizeof(hasSkeleton));
+
+		layout.bufferCount = static_cast<uint32_t>(shapes.size() * scale);
+		layout.submeshCount = layout.bufferCount;
+		writer.WriteUInt32(layout.submeshCount);
+		layout.firstSubmeshOffset = writer.GetSize();
+		for (uint32_t i = 0; i < layout.submeshCount; i++)
+		{
+			const WrlShape& shape = shapes[i % shapes.size()];
+			const CmoSubMesh submesh = { static_cast<uint32_t>(i % shapes.size()), i, i, 0,
+				static_cast<uint32_t>(shape.indices.size() / 3) };
+			writer.Write(&submesh, sizeof(submesh));
+		}
+
+		writer.WriteUInt32(layout.bufferCount);
+		for (uint32_t i = 0; i < layout.bufferCount; i++)
+		{
+			const WrlShape& shape = shapes[i % shapes.size()];
+			writer.WriteUInt32(static_cast<uint32_t>(shape.indices.size()));
+			if (i == 0)
+			{
+				layout.firstIndexOffset = writer.GetSize();
+			}
+			for (uint32_t index : shape.indices)
+			{
+				const uint16_t index16 = static_cast<uint16_t>(index);
+				writer.Write(&index16, sizeof(index16));
+			}
+			layout.indexCount += shape.indices.size();
+			layout.geometryBytes += shape.indices.size() * sizeof(uint16_t);
+		}
+
+		float boundsMin[3] = { 1e30f, 1e30f, 1e30f };
+		float boundsMax[3] = { -1e30f, -1e30f, -1e30f };
+		writer.WriteUInt32(layout.bufferCount);
+		for (uint32_t i = 0; i < layout.bufferCount; i++)
+		{
+			const WrlShape& shape = shapes[i % shapes.size()];
+			const uint32_t vertexCount = static_cast<uint32_t>(shape.points.size() / 3);
+			if (i == 0)
+			{
+				layout.firstVertexCount = vertexCount;
+			}
+			// 三角形の法線を頂点に足し合わせる
+			std::vector<float> normals(shape.points.size());
+			for (size_t t = 0; t < shape.indices.size(); t += 3)
+			{
+				const float* p0 = &shape.points[shape.indices[t] * 3];
+				const float* p1 = &shape.points[shape.indices[t + 1] * 3];
+				const float* p2 = &shape.points[shape.indices[t + 2] * 3];
+				const float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+				const float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+				const float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+				for (int k = 0; k < 3; k++)
+				{
+					for (int c = 0; c < 3; c++)
+					{
+						normals[shape.indices[t + k] * 3 + c] += n[c];
+					}
+				}
+			}
+			const float offset = static_cast<float>(i / shapes.size()) * 2.0f;
+			writer.WriteUInt32(vertexCount);
+			for (uint32_t v = 0; v < vertexCount; v++)
+			{
+				CmoVertex vertex = {};
+				const float* n = &normals[v * 3];
+				const float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+				for (int c = 0; c < 3; c++)
+				{
+					vertex.position[c] = shape.points[v * 3 + c] + (c == 0 ? offset : 0.0f);
+					vertex.normal[c] = length > 0.0f ? n[c] / length : (c == 1 ? 1.0f : 0.0f);
+					boundsMin[c] = std::min(boundsMin[c], vertex.position[c]);
+					boundsMax[c] = std::max(boundsMax[c], vertex.position[c]);
+				}
+				vertex.tangent[0] = vertex.tangent[3] = 1.0f;
+				vertex.color = 0xffffffffu;
+				writer.Write(&vertex, sizeof(vertex));
+			}
+			layout.geometryBytes += vertexCount * sizeof(CmoVertex);
+		}
+
+		// スキニングなし
+		writer.WriteUInt32(0);
+
+		CmoMeshExtents extents;
+		extents.minX = boundsMin[0];
+		extents.minY = boundsMin[1];
+		extents.minZ = boundsMin[2];
+		extents.maxX = boundsMax[0];
+		extents.maxY = boundsMax[1];
+		extents.maxZ = boundsMax[2];
+		extents.centerX = (boundsMin[0] + boundsMax[0]) * 0.5f;
+		extents.centerY = (boundsMin[1] + boundsMax[1]) * 0.5f;
+		extents.centerZ = (boundsMin[2] + boundsMax[2]) * 0.5f;
+		const float dx = boundsMax[0] - extents.centerX;
+		const float dy = boundsMax[1] - extents.centerY;
+		const float dz = boundsMax[2] - extents.centerZ;
+		extents.radius = std::sqrt(dx * dx + dy * dy + dz * dz);
+		writer.Write(&extents, sizeof(extents));
+		return std::move(writer.GetData());
+	}
+
+	// 書き出した CMO を読み取って内容を確かめ、壊したものが失敗することを確かめる
+	int CheckCmo(const std::vector<uint8_t>& data, const CmoLayout& layout, const std::string& name)
+	{
+		int errors = 0;
+		CmoReader reader;
+		const bool isParsed = reader.Parse(data.data(), data.size());
+		errors += Check(isParsed, "parse", name);
+		if (!isParsed)
+		{
+			std::fprintf(stderr, "  %s\n", reader.GetError().c_str());
+			return errors;
+		}
+		const std::vector<CmoMesh>& meshes = reader.GetMeshes();
+		errors += Check(meshes.size() == 1 && meshes[0].materials.size() == layout.materialCount,
+			"material count", name);
+		if (meshes.size() == 1)
+		{
+			const CmoMesh& mesh = meshes[0];
+			size_t indexCount = 0;
+			for (const CmoArray<uint16_t>& indices : mesh.indexBuffers)
+			{
+				indexCount += indices.count;
+			}
+			errors += Check(mesh.submeshes.count == layout.submeshCount, "submesh count", name);
+			errors += Check(mesh.indexBuffers.size() == layout.bufferCount && mesh.vertexBuffers.size() == layout.bufferCount,
+				"buffer count", name);
+			errors += Check(indexCount == layout.indexCount, "index count", name);
+			errors += Check(!mesh.hasSkeleton && mesh.skinningVertexBuffers.empty(), "no skeleton", name);
+			errors += Check(mesh.materials[0].name.ToWString() == L"material0", "material name", name);
+		}
+		errors += Check(reader.GetGeometryBytes() == layout.geometryBytes, "geometry bytes", name);
+		errors += Check(reader.GetData() == data.data() && reader.GetSize() == data.size(), "data is not copied", name);
+
+		// 途中で切れたファイル（先頭の 256 バイトは全て、後は間引いて）
+		bool isTruncationRejected = true;
+		for (size_t size = 0; size < data.size(); size += size < 256 ? 1 : std::max<size_t>(data.size() / 1000, 1))
+		{
+			isTruncationRejected = isTruncationRejected && !reader.Parse(data.data(), size);
+		}
+		errors += Check(isTruncationRejected, "truncated file is rejected", name);
+
+		// 頂点数を超えるインデックス
+		std::vector<uint8_t> broken = data;
+		const uint16_t badIndex = static_cast<uint16_t>(layout.firstVertexCount);
+		std::memcpy(&broken[layout.firstIndexOffset], &badIndex, sizeof(badIndex));
+		errors += Check(!reader.Parse(broken.data(), broken.size()), "index out of range is rejected", name);
+
+		// 存在しないマテリアル、インデックスバッファ、頂点バッファ、範囲外の開始位置を指すサブメッシュ
+		for (size_t field = 0; field < 4; field++)
+		{
+			broken = data;
+			const uint32_t badValue = field == 3 ? 0x7fffffffu : layout.bufferCount + layout.materialCount;
+			std::memcpy(&broken[layout.firstSubmeshOffset + field * sizeof(uint32_t)], &badValue, sizeof(badValue));
+			errors += Check(!reader.Parse(broken.data(), broken.size()), "submesh out of range is rejected", name);
+		}
+
+		// メッシュ数が大きすぎる
+		broken = data;
+		const uint32_t badMeshCount = 0xffffffffu;
+		std::memcpy(&broken[0], &badMeshCount, sizeof(badMeshCount));
+		errors += Check(!reader.Parse(broken.data(), broken.size()), "mesh count is rejected", name);
+		return errors;
+	}
+
+	// ランダムにバイトを書き換えても範囲外を読まずに終わる（失敗した数を返す）
+	int ParseCorrupted(const std::vector<uint8_t>& data, uint32_t seed)
+	{
+		uint32_t random = seed;
+		int rejectedCount = 0;
+		CmoReader reader;
+		std::vector<uint8_t> broken;
+		for (int i = 0; i < CORRUPT_COUNT; i++)
+		{
+			broken = data;
+			const int flipCount = 1 + Random(random) % 4;
+			for (int k = 0; k < flipCount; k++)
+			{
+				// 長さや数が並ぶ先頭付近を多めに壊す
+				const size_t range = Random(random) % 2 == 0 ? std::min<size_t>(broken.size(), 4096) : broken.size();
+				broken[Random(random) % range] ^= static_cast<uint8_t>(1u << (Random(random) % 8));
+			}
+			// 末尾を切り詰めて、範囲外の読み取りがメモリの確認ツールで見つかるようにする
+			broken.shrink_to_fit();
+			rejectedCount += reader.Parse(broken.data(), broken.size()) ? 0 : 1;
+		}
+		return rejectedCount;
+	}
+
+	// 計測する読み方
+	struct Method
+	{
+		const char* name;
+		// 全てのファイルを１回読み、読めた頂点とインデックスのバイト数を返す
+		size_t(*run)(const std::vector<std::wstring>& paths, const std::vector<std::vector<uint8_t>>& contents);
+	};
+
+	// メモリ上のデータを解析する
+	size_t RunParse(const std::vector<std::wstring>&, const std::vector<std::vector<uint8_t>>& contents)
+	{
+		size_t bytes = 0;
+		CmoReader reader;
+		for (const std::vector<uint8_t>& data : contents)
+		{
+			bytes += reader.Parse(data.data(), data.size()) ? reader.GetGeometryBytes() : 0;
+		}
+		return bytes;
+	}
+
+	// マップして解析する
+	size_t RunOpen(const std::vector<std::wstring>& paths, const std::vector<std::vector<uint8_t>>&)
+	{
+		size_t bytes = 0;
+		for (const std::wstring& path : paths)
+		{
+			CmoReader reader;
+			bytes += reader.Open(path) ? reader.GetGeometryBytes() : 0;
+		}
+		return bytes;
+	}
+
+	// 全て読み込んでから解析する
+	size_t RunReadAndParse(const std::vector<std::wstring>& paths, const std::vector<std::vector<uint8_t>>&)
+	{
+		size_t bytes = 0;
+		std::vector<uint8_t> data;
+		CmoReader reader;
+		for (const std::wstring& path : paths)
+		{
+			if (ReadWholeFile(path, data) && reader.Parse(data.data(), data.size()))
+			{
+				bytes += reader.GetGeometryBytes();
+			}
+		}
+		return bytes;
+	}
+
+	// 比較用に、メモリ上のデータを全てコピーするだけ
+	size_t RunCopy(const std::vector<std::wstring>&, const std::vector<std::vector<uint8_t>>& contents)
+	{
+		size_t bytes = 0;
+		for (const std::vector<uint8_t>& data : contents)
+		{
+			std::vector<uint8_t> copy(data);
+			bytes += copy.size() > 0 && copy.back() == data.back() ? copy.size() : 0;
+		}
+		return bytes;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	std::string assetDirectory = "../../GameEngineTK/Assets";
+	std::string directory = ".";
+	int scale = 100;
+	int repeatCount = 20;
+	std::vector<std::wstring> inputs;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "-assets" && i + 1 < argc)
+		{
+			assetDirectory = argv[++i];
+		}
+		else if (arg == "-dir" && i + 1 < argc)
+		{
+			directory = argv[++i];
+		}
+		else if (arg == "-scale" && i + 1 < argc)
+		{
+			scale = std::max(std::atoi(argv[++i]), 1);
+		}
+		else if (arg == "-r" && i + 1 < argc)
+		{
+			repeatCount = std::max(std::atoi(argv[++i]), 1);
+		}
+		else if (!arg.empty() && arg[0] == '-')
+		{
+			std::fprintf(stderr, "usage: CmoBench [-assets directory] [-dir temp_directory] [-scale copies] [-r repeats] [input.cmo|directory...]\n");
+			return 2;
+		}
+		else if (IsDirectory(FromUtf8(arg)))
+		{
+			std::vector<std::wstring> files;
+			if (!ListFiles(FromUtf8(arg), files))
+			{
+				std::fprintf(stderr, "%s: cannot list directory\n", arg.c_str());
+				return 1;
+			}
+			std::copy_if(files.begin(), files.end(), std::back_inserter(inputs), IsCmoFile);
+		}
+		else
+		{
+			inputs.push_back(FromUtf8(arg));
+		}
+	}
+
+	int errors = 0;
+	std::vector<std::wstring> temporaryPaths;
+	if (inputs.empty())
+	{
+		// Assets の .WRL を CMO に変換する（そのままの大きさと -scale 倍）
+		std::vector<std::wstring> files;
+		if (!ListFiles(FromUtf8(assetDirectory), files))
+		{
+			std::fprintf(stderr, "%s: cannot list directory\n", assetDirectory.c_str());
+			return 1;
+		}
+		std::sort(files.begin(), files.end());
+		uint32_t seed = 2463534242u;
+		for (const std::wstring& file : files)
+		{
+			std::vector<WrlShape> shapes;
+			if (!IsWrlFile(file))
+			{
+				continue;
+			}
+			if (!ReadWrl(file, shapes))
+			{
+				std::fprintf(stderr, "%s: cannot read shapes\n", ToUtf8(file).c_str());
+				errors++;
+				continue;
+			}
+			const size_t separator = file.find_last_of(L"/\\");
+			const std::string stem = ToUtf8(file.substr(separator + 1, file.size() - separator - 5));
+			for (int copies : { 1, scale })
+			{
+				CmoLayout layout;
+				const std::vector<uint8_t> data = MakeCmo(shapes, copies, layout);
+				const std::string name = stem + "_x" + std::to_string(copies) + ".cmo";
+				errors += CheckCmo(data, layout, name);
+				const int rejectedCount = ParseCorrupted(data, seed++);
+				std::printf("%-16s %9zu bytes, %4u submeshes, %7zu indices, %d of %d corrupted copies rejected\n",
+					name.c_str(), data.size(), layout.submeshCount, layout.indexCount, rejectedCount, CORRUPT_COUNT);
+
+				const std::wstring path = FromUtf8(directory + "/CmoBench_" + name);
+				if (!WriteWholeFile(path, data.data(), data.size()))
+				{
+					std::fprintf(stderr, "%s: cannot write\n", ToUtf8(path).c_str());
+					return 1;
+				}
+				temporaryPaths.push_back(path);
+				if (copies == scale)
+				{
+					break;
+				}
+			}
+		}
+		inputs = temporaryPaths;
+	}
+
+	// 全てのファイルを読み込んでおき、解析できることを確かめる
+	std::vector<std::vector<uint8_t>> contents(inputs.size());
+	size_t totalBytes = 0;
+	for (size_t i = 0; i < inputs.size(); i++)
+	{
+		CmoReader reader;
+		const bool isRead = ReadWholeFile(inputs[i], contents[i]);
+		errors += Check(isRead && reader.Parse(contents[i].data(), contents[i].size()), "parse input", ToUtf8(inputs[i]));
+		totalBytes += contents[i].size();
+	}
+	if (inputs.empty() || totalBytes == 0)
+	{
+		std::fprintf(stderr, "no input files\n");
+		return 1;
+	}
+
+	// 読み方ごとの時間（ファイルはキャッシュに乗っている）
+	const Method methods[] =
+	{
+		{ "parse", &RunParse },
+		{ "open", &RunOpen },
+		{ "read+parse", &RunReadAndParse },
+		{ "copy", &RunCopy },
+	};
+	std::printf("%zu files, %.2f MB\n", inputs.size(), totalBytes / (1024.0 * 1024.0));
+	Clock& clock = GetDefaultClock();
+	size_t expectedBytes = 0;
+	for (const Method& method : methods)
+	{
+		size_t bytes = 0;
+		const uint64_t begin = clock.GetCounter();
+		for (int r = 0; r < repeatCount; r++)
+		{
+			bytes = method.run(inputs, contents);
+		}
+		const double seconds = static_cast<double>(clock.GetCounter() - begin) / clock.GetFrequency() / repeatCount;
+		std::printf("%-10s %9.1f us %9.2f GB/s\n", method.name, seconds * 1e6, totalBytes / seconds / 1e9);
+		if (method.run == &RunCopy)
+		{
+			continue;
+		}
+		if (expectedBytes == 0)
+		{
+			expectedBytes = bytes;
+		}
+		errors += Check(bytes == expectedBytes, "same geometry bytes", method.name);
+	}
+	std::printf("geometry: %.2f MB referenced without copying\n", expectedBytes / (1024.0 * 1024.0));
+
+	for (const std::wstring& path : temporaryPaths)
+	{
+		std::remove(ToUtf8(path).c_str());
+	}
+
+	if (errors > 0)
+	{
+		std::fprintf(stderr, "%d checks failed\n", errors);
+		return 1;
+	}
+	std::printf("checks: ok\n");
+	return 0;
+}
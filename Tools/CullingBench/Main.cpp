@@ -0,0 +1,277 @@
+﻿/// <summary>
+/// 視錐台カリングの実装どうしの結果を比べ、性能を測るコマンドラインツール
+///
+/// 使い方: CullingBench [-n 球の数] [-v 視点の数] [-r 繰り返す回数] [-j 最大スレッド数]
+/// ランダムな球（一部は視錐台の平面にちょうど接するように置く）を視点ごとに判定し、
+/// CullSpheresScalar / SSE2 / AVX2、CullSpheres、FrustumCuller::Cull（JobSystem なしとあり）の
+/// 見える球の番号の並びが全て同じことを確かめる
+/// 実装ごとの１球あたりの時間と、FrustumCuller::Cull のスレッド数ごとの時間を表示する
+/// 確かめた結果が合わなければ 1 を返す
+///
+/// Windows 以外では次のようにビルドする（-mavx2 を付けると AVX2 の実装も確かめる）
+///   g++ -std=c++14 -O2 -pthread -I../../GameEngineTK Main.cpp ../../GameEngineTK/FrustumCulling.cpp
+///       ../../GameEngineTK/JobSystem.cpp ../../GameEngineTK/Profiler.cpp ../../GameEngineTK/Clock.cpp
+///       ../../GameEngineTK/FileSystem.cpp ../../GameEngineTK/FrameStats.cpp ../../GameEngineTK/FrameArena.cpp
+///       -o CullingBench
+/// </summary>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Clock.h"
+#include "FrustumCulling.h"
+#include "JobSystem.h"
+
+namespace
+{
+	// 球を置く範囲（原点を中心とする立方体の半分の幅）
+	const float WORLD_EXTENT = 500.0f;
+	// 平面に接するように置き直す球の割合（%）
+	const uint32_t TANGENT_PERCENT = 2;
+
+	// 判定する関数
+	typedef size_t(*CullFunc)(const Frustum& frustum, const float* x, const float* y, const float* z, const float* radius,
+		size_t count, uint32_t* visible);
+
+	// 確かめる実装
+	struct Kernel
+	{
+		const char* name;
+		CullFunc cull;
+	};
+
+	// 確かめた結果を表示して数える
+	int Check(bool condition, const char* name, const char* kernel)
+	{
+		if (!condition)
+		{
+			std::fprintf(stderr, "check failed: %s (%s)\n", name, kernel);
+			return 1;
+		}
+		return 0;
+	}
+
+	// 再現できる乱数（xorshift）
+	float Random(uint32_t& state, float low, float high)
+	{
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		return low + (high - low) * static_cast<float>(state & 0xffffff) / 16777216.0f;
+	}
+
+	// 成分ごとの配列に持った球
+	struct Spheres
+	{
+		std::vector<float> x, y, z, radius;
+	};
+
+	// 原点から yaw の向きを見る視点のビュー×射影行列（行ベクトル形式、深度 0～1）
+	Float4x4 MakeViewProjection(float yaw, float pitch)
+	{
+		const float fieldOfView = 1.0f;
+		const float aspect = 16.0f / 9.0f;
+		const float nearZ = 0.1f;
+		const float farZ = WORLD_EXTENT;
+		const float yScale = 1.0f / std::tan(fieldOfView * 0.5f);
+
+		Float4x4 projection = {};
+		projection.m[0][0] = yScale / aspect;
+		projection.m[1][1] = yScale;
+		projection.m[2][2] = farZ / (farZ - nearZ);
+		projection.m[2][3] = 1.0f;
+		projection.m[3][2] = -nearZ * farZ / (farZ - nearZ);
+
+		// 視点の回転の逆（ヨーの後にピッチ）
+		Float4x4 yawMatrix = Float4x4Identity();
+		yawMatrix.m[0][0] = std::cos(yaw);
+		yawMatrix.m[0][2] = std::sin(yaw);
+		yawMatrix.m[2][0] = -std::sin(yaw);
+		yawMatrix.m[2][2] = std::cos(yaw);
+		Float4x4 pitchMatrix = Float4x4Identity();
+		pitchMatrix.m[1][1] = std::cos(pitch);
+		pitchMatrix.m[1][2] = -std::sin(pitch);
+		pitchMatrix.m[2][1] = std::sin(pitch);
+		pitchMatrix.m[2][2] = std::cos(pitch);
+		return Multiply(Multiply(yawMatrix, pitchMatrix), projection);
+	}
+
+	// 一部の球を視錐台のどれかの平面にちょうど接するように置き直す（実装による境目の扱いの違いを見つける）
+	void PlaceTangentSpheres(const Frustum& frustum, Spheres& spheres, uint32_t& random)
+	{
+		for (size_t i = 0; i < spheres.x.size(); i++)
+		{
+			if (Random(random, 0.0f, 100.0f) >= TANGENT_PERCENT)
+			{
+				continue;
+			}
+			const FrustumPlane& plane = frustum.planes[static_cast<int>(Random(random, 0.0f, 6.0f)) % Frustum::PLANE_COUNT];
+			const float distance = plane.a * spheres.x[i] + plane.b * spheres.y[i] + plane.c * spheres.z[i] + plane.d;
+			const float move = distance + spheres.radius[i];
+			spheres.x[i] -= plane.a * move;
+			spheres.y[i] -= plane.b * move;
+			spheres.z[i] -= plane.c * move;
+		}
+	}
+
+	// 経過時間（ナノ秒）
+	double GetNanoseconds(Clock& clock, uint64_t begin)
+	{
+		return static_cast<double>(clock.GetCounter() - begin) * 1e9 / clock.GetFrequency();
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	size_t count = 100000;
+	int viewCount = 8;
+	int repeatCount = 20;
+	unsigned maxThreads = std::max(std::thread::hardware_concurrency(), 2u);
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "-n" && i + 1 < argc)
+		{
+			count = static_cast<size_t>(std::max(std::atoll(argv[++i]), 1ll));
+		}
+		else if (arg == "-v" && i + 1 < argc)
+		{
+			viewCount = std::max(std::atoi(argv[++i]), 1);
+		}
+		else if (arg == "-r" && i + 1 < argc)
+		{
+			repeatCount = std::max(std::atoi(argv[++i]), 1);
+		}
+		else if (arg == "-j" && i + 1 < argc)
+		{
+			maxThreads = static_cast<unsigned>(std::max(std::atoi(argv[++i]), 1));
+		}
+		else
+		{
+			std::fprintf(stderr, "usage: CullingBench [-n spheres] [-v views] [-r repeats] [-j max_threads]\n");
+			return 2;
+		}
+	}
+
+	std::vector<Kernel> kernels(1, Kernel{ "scalar", &CullSpheresScalar });
+#if FRUSTUM_CULLING_SSE2
+	kernels.push_back(Kernel{ "SSE2", &CullSpheresSSE2 });
+#endif
+#if FRUSTUM_CULLING_AVX2
+	kernels.push_back(Kernel{ "AVX2", &CullSpheresAVX2 });
+#endif
+	kernels.push_back(Kernel{ "default", &CullSpheres });
+
+	// 端数が出るように８の倍数から外す
+	count += 5;
+	uint32_t random = 2463534242u;
+	Spheres baseSpheres;
+	for (size_t i = 0; i < count; i++)
+	{
+		baseSpheres.x.push_back(Random(random, -WORLD_EXTENT, WORLD_EXTENT));
+		baseSpheres.y.push_back(Random(random, -WORLD_EXTENT, WORLD_EXTENT));
+		baseSpheres.z.push_back(Random(random, -WORLD_EXTENT, WORLD_EXTENT));
+		baseSpheres.radius.push_back(Random(random, 0.5f, 5.0f));
+	}
+
+	int errors = 0;
+	JobSystem jobs(maxThreads - 1);
+	FrustumCuller culler;
+	std::vector<uint32_t> expected(count), visible(count);
+	size_t totalVisible = 0;
+	for (int view = 0; view < viewCount; view++)
+	{
+		const Float4x4 viewProjection = MakeViewProjection(6.2831853f * view / viewCount, 0.3f * std::sin(static_cast<float>(view)));
+		const Frustum frustum = ExtractFrustum(viewProjection);
+		Spheres spheres = baseSpheres;
+		PlaceTangentSpheres(frustum, spheres, random);
+
+		// スカラー実装を基準にする
+		expected.resize(count);
+		expected.resize(CullSpheresScalar(frustum, spheres.x.data(), spheres.y.data(), spheres.z.data(),
+			spheres.radius.data(), count, expected.data()));
+		totalVisible += expected.size();
+		for (const Kernel& kernel : kernels)
+		{
+			visible.resize(count);
+			visible.resize(kernel.cull(frustum, spheres.x.data(), spheres.y.data(), spheres.z.data(),
+				spheres.radius.data(), count, visible.data()));
+			errors += Check(visible == expected, "same visible list as scalar", kernel.name);
+		}
+
+		culler.Clear();
+		for (size_t i = 0; i < count; i++)
+		{
+			culler.Add(Float3{ spheres.x[i], spheres.y[i], spheres.z[i] }, spheres.radius[i]);
+		}
+		culler.Cull(viewProjection);
+		errors += Check(culler.GetVisible() == expected, "same visible list as scalar", "Cull");
+		culler.Cull(viewProjection, &jobs);
+		errors += Check(culler.GetVisible() == expected, "same visible list as scalar", "Cull with jobs");
+		errors += Check(culler.GetStatistics().visible == expected.size() &&
+			culler.GetStatistics().culled == count - expected.size(), "statistics", "Cull with jobs");
+	}
+	std::printf("%zu spheres, %d views, %.1f%% visible on average\n", count, viewCount,
+		100.0 * totalVisible / (static_cast<double>(count) * viewCount));
+
+	// 実装ごとの時間（正面の視点、置き直す前の球）
+	Clock& clock = GetDefaultClock();
+	const Frustum frustum = ExtractFrustum(MakeViewProjection(0.0f, 0.0f));
+	double scalarTime = 0.0;
+	for (const Kernel& kernel : kernels)
+	{
+		const uint64_t begin = clock.GetCounter();
+		for (int r = 0; r < repeatCount; r++)
+		{
+			visible.resize(count);
+			kernel.cull(frustum, baseSpheres.x.data(), baseSpheres.y.data(), baseSpheres.z.data(),
+				baseSpheres.radius.data(), count, visible.data());
+		}
+		const double time = GetNanoseconds(clock, begin);
+		scalarTime = scalarTime > 0.0 ? scalarTime : time;
+		std::printf("%-8s %6.3f ns/sphere, %.2fx\n", kernel.name, time / (static_cast<double>(count) * repeatCount),
+			scalarTime / time);
+	}
+
+	// FrustumCuller::Cull のスレッド数ごとの時間（JobSystem なしを基準にする）
+	const Float4x4 viewProjection = MakeViewProjection(0.0f, 0.0f);
+	double serialTime = 0.0;
+	for (unsigned threads = 0; threads <= maxThreads; threads = threads == 0 ? 1 : threads * 2)
+	{
+		std::unique_ptr<JobSystem> threadJobs;
+		if (threads > 0)
+		{
+			threadJobs = std::make_unique<JobSystem>(threads - 1);
+		}
+		const uint64_t begin = clock.GetCounter();
+		for (int r = 0; r < repeatCount; r++)
+		{
+			culler.Cull(viewProjection, threadJobs.get());
+		}
+		const double time = GetNanoseconds(clock, begin) / repeatCount;
+		serialTime = serialTime > 0.0 ? serialTime : time;
+		if (threads == 0)
+		{
+			std::printf("Cull no jobs    %8.1f us\n", time / 1000.0);
+		}
+		else
+		{
+			std::printf("Cull %2u thread%s %8.1f us, %.2fx\n", threads, threads == 1 ? " " : "s", time / 1000.0,
+				serialTime / time);
+		}
+	}
+
+	if (errors > 0)
+	{
+		std::fprintf(stderr, "%d checks failed\n", errors);
+		return 1;
+	}
+	std::printf("checks: ok\n");
+	return 0;
+}
@@ -0,0 +1,159 @@
+﻿/// <summary>
+/// 追従カメラが更新の頻度によらず同じ速さで目標に追いつくことを確かめるコマンドラインツール
+///
+/// 使い方: FollowCameraCheck
+/// 自機を動かした後の TPS カメラの視点と参照点を、30 Hz と 60 Hz のシミュレーション
+/// （Game::SetSimulationRate と同じく StepTimer の目標の経過時間を変える）で同じ時刻ごとに比べ、
+/// 1/60 秒あたり 5% / 20% 近づく速さで目標に近づいていることを確かめる
+/// 確かめた結果が合わなければ 1 を返す
+///
+/// Windows 以外では次のようにビルドする
+///   g++ -std=c++14 -O2 -pthread -I../../GameEngineTK Main.cpp ../../GameEngineTK/GameSimulation.cpp
+///       ../../GameEngineTK/TransformHierarchy.cpp ../../GameEngineTK/TransformKernel.cpp
+///       ../../GameEngineTK/JobSystem.cpp ../../GameEngineTK/Clock.cpp ../../GameEngineTK/Profiler.cpp
+///       ../../GameEngineTK/FileSystem.cpp ../../GameEngineTK/FrameStats.cpp ../../GameEngineTK/FrameArena.cpp
+///       -o FollowCameraCheck
+/// </summary>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+
+#include "Clock.h"
+#include "GameSimulation.h"
+#include "StepTimer.h"
+#include "TransformHierarchy.h"
+
+namespace
+{
+	// 描画のフレームの間隔（30 Hz と 60 Hz のどちらでもステップの区切りになる）
+	const uint64_t FRAME_TICKS = DX::StepTimer::TicksPerSecond / 30;
+	// 比べるフレーム数（２秒）
+	const int FRAME_COUNT = 60;
+	// 自機を動かした先
+	const Float3 TARGET_POSITION = { 10.0f, 0.0f, -4.0f };
+	const float TARGET_ANGLE = 0.5f;
+	// 追従カメラが 1/60 秒で近づく割合（GameSimulation と同じ）
+	const float EYE_APPROACH_RATE = 0.05f;
+	const float REF_APPROACH_RATE = 0.20f;
+
+	// 確かめた結果を表示して数える
+	int Check(bool condition, const char* name)
+	{
+		if (!condition)
+		{
+			std::fprintf(stderr, "check failed: %s\n", name);
+			return 1;
+		}
+		return 0;
+	}
+
+	float Distance(const Float3& a, const Float3& b)
+	{
+		const float x = a.x - b.x, y = a.y - b.y, z = a.z - b.z;
+		return std::sqrt(x * x + y * y + z * z);
+	}
+
+	// updatesPerSecond 回/秒で進めるシミュレーション
+	class CameraRun
+	{
+	public:
+		explicit CameraRun(double updatesPerSecond)
+			: m_input()
+		{
+			TransformHierarchy::Handle parts[PLAYER_PARTS_NUM];
+			for (TransformHierarchy::Handle& part : parts)
+			{
+				part = m_transforms.Create();
+			}
+			m_simulation = std::make_unique<GameSimulation>(m_transforms, parts, 800, 600);
+			m_timer = std::make_unique<DX::StepTimer>(m_clock);
+			m_timer->SetFixedTimeStep(true);
+			m_timer->SetTargetElapsedSeconds(1.0 / updatesPerSecond);
+			// 原点から自機が動いた直後にする
+			m_simulation->SetCameraTarget(TARGET_POSITION, TARGET_ANGLE);
+		}
+
+		// 描画の１フレーム分進める
+		void Advance(uint64_t ticks)
+		{
+			m_clock.Advance(ticks);
+			m_timer->Tick([this]()
+			{
+				m_simulation->Step(static_cast<float>(m_timer->GetElapsedSeconds()), m_input);
+			});
+		}
+
+		const GameSimulation& GetSimulation() const { return *m_simulation; }
+
+	private:
+		FakeClock m_clock;
+		TransformHierarchy m_transforms;
+		std::unique_ptr<GameSimulation> m_simulation;
+		std::unique_ptr<DX::StepTimer> m_timer;
+		SimulationInput m_input;
+	};
+}
+
+int main(int argc, char*[])
+{
+	if (argc > 1)
+	{
+		std::fprintf(stderr, "usage: FollowCameraCheck\n");
+		return 2;
+	}
+
+	// 十分に進めた位置を目標とする
+	CameraRun settled(60.0);
+	const Float3 startEye = settled.GetSimulation().GetEyePos();
+	const Float3 startRef = settled.GetSimulation().GetRefPos();
+	for (int frame = 0; frame < 30 * 20; frame++)
+	{
+		settled.Advance(FRAME_TICKS);
+	}
+	const Float3 goalEye = settled.GetSimulation().GetEyePos();
+	const Float3 goalRef = settled.GetSimulation().GetRefPos();
+	const float eyeDistance = Distance(startEye, goalEye);
+	const float refDistance = Distance(startRef, goalRef);
+
+	int errors = 0;
+	errors += Check(eyeDistance > 1.0f && refDistance > 1.0f, "target moved away from the camera");
+
+	CameraRun run30(30.0);
+	CameraRun run60(60.0);
+	bool isSameEye = true, isSameRef = true;
+	bool isEyeRate = true, isRefRate = true;
+	for (int frame = 1; frame <= FRAME_COUNT; frame++)
+	{
+		run30.Advance(FRAME_TICKS);
+		run60.Advance(FRAME_TICKS);
+		const GameSimulation& sim30 = run30.GetSimulation();
+		const GameSimulation& sim60 = run60.GetSimulation();
+
+		// 同じ時刻では頻度によらず同じ位置にいる（最初の距離の 0.1% まで）
+		isSameEye = isSameEye && Distance(sim30.GetEyePos(), sim60.GetEyePos()) < eyeDistance * 1e-3f;
+		isSameRef = isSameRef && Distance(sim30.GetRefPos(), sim60.GetRefPos()) < refDistance * 1e-3f;
+
+		// 残りの距離は 1/60 秒ごとに (1 - 割合) 倍になる
+		const float steps = 2.0f * frame;
+		const float eyeExpected = eyeDistance * std::pow(1.0f - EYE_APPROACH_RATE, steps);
+		const float refExpected = refDistance * std::pow(1.0f - REF_APPROACH_RATE, steps);
+		isEyeRate = isEyeRate && std::fabs(Distance(sim30.GetEyePos(), goalEye) - eyeExpected) < eyeDistance * 1e-3f;
+		isRefRate = isRefRate && std::fabs(Distance(sim30.GetRefPos(), goalRef) - refExpected) < refDistance * 1e-3f;
+	}
+	errors += Check(isSameEye, "eye position matches at 30 Hz and 60 Hz");
+	errors += Check(isSameRef, "reference position matches at 30 Hz and 60 Hz");
+	errors += Check(isEyeRate, "eye approaches 5% per 1/60 s");
+	errors += Check(isRefRate, "reference approaches 20% per 1/60 s");
+	std::printf("eye %.4f -> %.4f, ref %.4f -> %.4f after %.1f s\n", eyeDistance,
+		Distance(run30.GetSimulation().GetEyePos(), goalEye), refDistance,
+		Distance(run30.GetSimulation().GetRefPos(), goalRef), FRAME_COUNT / 30.0);
+
+	if (errors > 0)
+	{
+		std::fprintf(stderr, "%d checks failed\n", errors);
+		return 1;
+	}
+	std::printf("checks: ok\n");
+	return 0;
+}
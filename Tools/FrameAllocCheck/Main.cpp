@@ -0,0 +1,383 @@
+﻿/// <summary>
+/// 毎フレームの処理が一般のヒープを使っていないかを、operator new を数えて確かめるコマンドラインツール
+///
+/// 使い方: FrameAllocCheck [-warmup フレーム数] [-f フレーム数] [-objects 球の数] [-j スレッド数]
+/// 描画以外の毎フレームの処理（入力・シミュレーション・変換の階層・スナップショット・カリング・
+/// インスタンスのまとめ・描画キュー・プロファイラ）を Game と同じ順に回し、
+/// 最初の数フレームで容量が決まった後のフレームで operator new が呼ばれた回数を表示する
+/// フレーム用アリーナの溢れたときの確保・広げ直し・最大使用量の記録も確かめる
+/// （-DFRAME_ARENA_POISON=1 でビルドすると、捨てた領域が埋められることも確かめる）
+/// 確かめた結果が合わないか、計測したフレームで確保があれば 1 を返す
+///
+/// Windows 以外では次のようにビルドする
+///   g++ -std=c++14 -O2 -pthread -I../../GameEngineTK Main.cpp ../../GameEngineTK/FrameArena.cpp
+///       ../../GameEngineTK/GameSimulation.cpp ../../GameEngineTK/TransformHierarchy.cpp
+///       ../../GameEngineTK/TransformKernel.cpp ../../GameEngineTK/JobSystem.cpp ../../GameEngineTK/Clock.cpp
+///       ../../GameEngineTK/Profiler.cpp ../../GameEngineTK/FileSystem.cpp ../../GameEngineTK/FrameStats.cpp
+///       ../../GameEngineTK/FrustumCulling.cpp ../../GameEngineTK/InstanceBatcher.cpp
+///       ../../GameEngineTK/RenderQueue.cpp ../../GameEngineTK/NullRenderBackend.cpp
+///       ../../GameEngineTK/InputEventQueue.cpp -o FrameAllocCheck
+/// </summary>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "Clock.h"
+#include "FrameArena.h"
+#include "FrameStats.h"
+#include "FrustumCulling.h"
+#include "GameSimulation.h"
+#include "InputEventQueue.h"
+#include "InstanceBatcher.h"
+#include "JobSystem.h"
+#include "NullRenderBackend.h"
+#include "Profiler.h"
+#include "RenderQueue.h"
+#include "SnapshotBuffer.h"
+#include "TransformHierarchy.h"
+
+namespace
+{
+	// 全てのスレッドで operator new が呼ばれた回数とバイト数
+	std::atomic<uint64_t> g_allocationCount(0);
+	std::atomic<uint64_t> g_allocationBytes(0);
+
+	void* CountedAllocate(size_t size)
+	{
+		g_allocationCount.fetch_add(1, std::memory_order_relaxed);
+		g_allocationBytes.fetch_add(size, std::memory_order_relaxed);
+		void* memory = std::malloc(size ? size : 1);
+		if (!memory)
+		{
+			throw std::bad_alloc();
+		}
+		return memory;
+	}
+}
+
+void* operator new(size_t size)
+{
+	return CountedAllocate(size);
+}
+
+void* operator new[](size_t size)
+{
+	return CountedAllocate(size);
+}
+
+void operator delete(void* memory) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete[](void* memory) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete[](void* memory, size_t) noexcept
+{
+	std::free(memory);
+}
+
+namespace
+{
+	const int SCREEN_WIDTH = 800;
+	const int SCREEN_HEIGHT = 600;
+	// シミュレーションの間隔（秒）
+	const float ELAPSED_TIME = 1.0f / 60.0f;
+
+	// 確かめた結果を表示して数える
+	int Check(bool condition, const char* name)
+	{
+		if (!condition)
+		{
+			std::fprintf(stderr, "check failed: %s\n", name);
+			return 1;
+		}
+		return 0;
+	}
+
+	// アリーナとコンテナを確かめる（失敗した数を返す）
+	int CheckArena()
+	{
+		int errors = 0;
+		FrameArena arena(1024);
+
+		// 境界に揃えて先頭から切り出す
+		void* first = arena.Allocate(3, 1);
+		void* aligned = arena.Allocate(16, 64);
+		errors += Check(first && reinterpret_cast<uintptr_t>(aligned) % 64 == 0, "alignment");
+
+		// 戻すとその位置から使い直す
+		const size_t marker = arena.GetMarker();
+		{
+			FrameArenaScope scope(arena);
+			arena.Allocate(100);
+		}
+		errors += Check(arena.GetMarker() == marker, "scope rewinds");
+
+		// 足りなければヒープから確保して数え、次の Reset で広げる
+		arena.Allocate(4096);
+		const FrameArenaStatistics& statistics = arena.GetStatistics();
+		errors += Check(statistics.overflowCount == 1 && statistics.overflowBytes == 4096, "overflow fallback");
+		errors += Check(statistics.highWaterMark >= 4096 && statistics.used == statistics.highWaterMark, "high-water mark");
+		const uint32_t generation = arena.GetGeneration();
+		arena.Reset();
+		errors += Check(arena.GetGeneration() == generation + 1 && statistics.used == 0 && statistics.resetCount == 1,
+			"reset");
+		errors += Check(statistics.capacity >= statistics.highWaterMark, "grow after overflow");
+		arena.Allocate(4096);
+		errors += Check(statistics.overflowCount == 1, "no overflow after growing");
+		arena.Reset();
+
+		// 広げながら追加しても中身が残る
+		ArenaVector<uint32_t> values(arena);
+		for (uint32_t i = 0; i < 1000; i++)
+		{
+			values.push_back(i);
+		}
+		bool isIntact = values.size() == 1000;
+		for (uint32_t i = 0; isIntact && i < values.size(); i++)
+		{
+			isIntact = values[i] == i;
+		}
+		const ArenaSpan<const uint32_t> span = static_cast<const ArenaVector<uint32_t>&>(values).GetSpan();
+		errors += Check(isIntact && span.size() == 1000 && span[999] == 999, "vector growth");
+
+		// ハッシュ表は同じキーを２回追加しない
+		ArenaHashMap<uint32_t, uint32_t, std::hash<uint32_t>> map(arena);
+		for (uint32_t i = 0; i < 500; i++)
+		{
+			map.emplace(i * 7, i);
+		}
+		const std::pair<uint32_t*, bool> again = map.emplace(7, 100);
+		const uint32_t* found = map.find(700);
+		errors += Check(map.size() == 500 && !again.second && *again.first == 1 && found && *found == 100
+			&& !map.find(701), "hash map");
+
+		// 上で溢れた分はここで広げる
+		arena.Reset();
+
+#if FRAME_ARENA_POISON
+		// 捨てた領域は埋めてあるので、Reset の後に読むと分かる（広げ直さない Reset では同じ領域が残る）
+		uint8_t* bytes = arena.AllocateArray<uint8_t>(32);
+		std::fill(bytes, bytes + 32, 0);
+		arena.Reset();
+		errors += Check(bytes[0] == FrameArena::POISON_BYTE && bytes[31] == FrameArena::POISON_BYTE, "poison after reset");
+		std::printf("poisoning: on\n");
+#else
+		std::printf("poisoning: off (build with -DFRAME_ARENA_POISON=1 to check it)\n");
+#endif
+		return errors;
+	}
+
+	// 描画の代わりに受け取る状態
+	struct FrameSnapshot
+	{
+		std::vector<Float4x4> ballWorlds;
+		std::vector<Float4x4> partWorlds;
+	};
+}
+
+int main(int argc, char* argv[])
+{
+	int warmupCount = 10;
+	int frameCount = 1000;
+	int objectCount = 4000;
+	unsigned threadCount = 4;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "-warmup" && i + 1 < argc)
+		{
+			warmupCount = std::max(std::atoi(argv[++i]), 1);
+		}
+		else if (arg == "-f" && i + 1 < argc)
+		{
+			frameCount = std::max(std::atoi(argv[++i]), 1);
+		}
+		else if (arg == "-objects" && i + 1 < argc)
+		{
+			objectCount = std::max(std::atoi(argv[++i]), 0);
+		}
+		else if (arg == "-j" && i + 1 < argc)
+		{
+			threadCount = static_cast<unsigned>(std::max(std::atoi(argv[++i]), 1));
+		}
+		else
+		{
+			std::fprintf(stderr, "usage: FrameAllocCheck [-warmup frames] [-f frames] [-objects count] [-j threads]\n");
+			return 2;
+		}
+	}
+
+	int errors = CheckArena();
+	std::printf("arena checks: %s\n", errors == 0 ? "ok" : "FAILED");
+
+	// Game::Initialize と同じく自機のパーツのノードを作る
+	TransformHierarchy transforms;
+	transforms.Create();
+	TransformHierarchy::Handle parts[PLAYER_PARTS_NUM];
+	for (TransformHierarchy::Handle& part : parts)
+	{
+		part = transforms.Create();
+	}
+	GameSimulation simulation(transforms, parts, SCREEN_WIDTH, SCREEN_HEIGHT);
+	std::unique_ptr<JobSystem> jobs;
+	if (threadCount > 1)
+	{
+		jobs = std::make_unique<JobSystem>(threadCount - 1);
+	}
+
+	InputEventQueue inputQueue;
+	InputState inputState;
+	SnapshotBuffer<FrameSnapshot> snapshots;
+	FrustumCuller culler;
+	InstanceBatcher batcher;
+	RenderQueue renderQueue;
+	NullRenderBackend backend;
+	FrameStats frameStats;
+	Float4x4 ballWorlds[GameSimulation::BALL_COUNT];
+	// カリングの対象を増やす球（格子状に並べる）
+	std::vector<Float3> objects(objectCount);
+	for (int i = 0; i < objectCount; i++)
+	{
+		const Float3 object = { (i % 64) * 2.0f - 64.0f, 0.0f, (i / 64) * 2.0f - 64.0f };
+		objects[i] = object;
+	}
+	// 真上から見下ろす平行投影（X と Z が ±50 の範囲が見える）
+	Float4x4 viewProjection = {};
+	viewProjection.m[0][0] = 1.0f / 50.0f;
+	viewProjection.m[2][1] = 1.0f / 50.0f;
+	viewProjection.m[1][2] = 1.0f / 1000.0f;
+	viewProjection.m[3][2] = 0.5f;
+	viewProjection.m[3][3] = 1.0f;
+	Profiler::SetThreadName("Main");
+	Profiler::SetEnabled(true);
+
+	Clock& clock = GetDefaultClock();
+	const double frequency = static_cast<double>(clock.GetFrequency());
+	FrameArena& arena = FrameArena::GetThreadArena();
+	uint64_t measuredCount = 0;
+	uint64_t measuredBytes = 0;
+	uint64_t worstFrameCount = 0;
+	uint64_t checksum = 0;
+	for (int frame = 0; frame < warmupCount + frameCount; frame++)
+	{
+		const uint64_t countBegin = g_allocationCount.load();
+		const uint64_t bytesBegin = g_allocationBytes.load();
+		const uint64_t frameBegin = clock.GetCounter();
+		{
+			PROFILE_SCOPE("Frame");
+
+			// 入力（ウィンドウプロシージャの代わりに積む）
+			InputEvent event = {};
+			event.timestamp = frameBegin;
+			event.type = (frame & 1) ? INPUT_EVENT_KEY_UP : INPUT_EVENT_KEY_DOWN;
+			event.code = 'W';
+			inputQueue.Push(event);
+			const InputSnapshot& input = inputState.Update(inputQueue);
+			SimulationInput step = {};
+			step.moveForward = input.IsKeyActive('W');
+			step.turnLeft = (frame / 60) % 2 == 0;
+
+			// シミュレーションと変換の階層
+			simulation.Step(ELAPSED_TIME, step);
+			transforms.Update(jobs.get());
+			GameSimulation::ComputeBallWorlds(simulation.GetBallAngle(), ballWorlds);
+
+			// スナップショットを公開して受け取る（書く側は前の内容を全て書き直す）
+			FrameSnapshot& write = snapshots.GetWriteBuffer();
+			write.ballWorlds.assign(ballWorlds, ballWorlds + GameSimulation::BALL_COUNT);
+			write.partWorlds.clear();
+			for (TransformHierarchy::Handle part : parts)
+			{
+				write.partWorlds.push_back(transforms.GetWorld(part));
+			}
+			snapshots.Publish();
+			snapshots.Acquire();
+			const FrameSnapshot& scene = snapshots.GetReadBuffer();
+
+			// カリング
+			culler.Clear();
+			for (const Float4x4& world : scene.ballWorlds)
+			{
+				const Float3 center = { world.m[3][0], world.m[3][1], world.m[3][2] };
+				culler.Add(center, 1.0f);
+			}
+			for (const Float3& object : objects)
+			{
+				culler.Add(object, 1.0f);
+			}
+			culler.Cull(viewProjection, jobs.get());
+
+			// 見える球はインスタンス描画にまとめ、残りは描画キューに積む
+			batcher.Clear();
+			renderQueue.Clear();
+			for (uint32_t index : culler.GetVisible())
+			{
+				if (index < scene.ballWorlds.size())
+				{
+					batcher.Add(&ballWorlds, nullptr, scene.ballWorlds[index]);
+				}
+				else
+				{
+					const uint32_t transform = renderQueue.AddTransform(Float4x4Identity());
+					renderQueue.Add(RenderQueue::MakeKey(RENDER_PASS_OPAQUE, index % 4, index % 16, index % 64,
+						(index % 100) * 0.01f), transform);
+				}
+			}
+			for (const Float4x4& world : scene.partWorlds)
+			{
+				renderQueue.Add(RenderQueue::MakeKey(RENDER_PASS_OPAQUE, 0, 0, 0, 0.5f), renderQueue.AddTransform(world));
+			}
+			batcher.Build();
+			renderQueue.Sort();
+			renderQueue.Submit(backend);
+		}
+		Profiler::EndFrame();
+		const double frameSeconds = (clock.GetCounter() - frameBegin) / frequency;
+		frameStats.RecordFrame(frameSeconds, frameSeconds, 0.0, 0.0);
+		arena.Reset();
+
+		const uint64_t count = g_allocationCount.load() - countBegin;
+		if (frame >= warmupCount)
+		{
+			measuredCount += count;
+			measuredBytes += g_allocationBytes.load() - bytesBegin;
+			worstFrameCount = std::max(worstFrameCount, count);
+		}
+		checksum += backend.GetChecksum() + batcher.GetInstanceCount();
+	}
+
+	const FrameArenaStatistics& statistics = arena.GetStatistics();
+	std::printf("steady state: %llu allocations (%llu bytes) in %d frames, worst frame %llu\n",
+		static_cast<unsigned long long>(measuredCount), static_cast<unsigned long long>(measuredBytes), frameCount,
+		static_cast<unsigned long long>(worstFrameCount));
+	std::printf("last frame: %u visible, %zu instances in %zu batches, %zu commands (checksum %016llx)\n",
+		culler.GetStatistics().visible, batcher.GetInstanceCount(), batcher.GetBatches().size(),
+		renderQueue.GetCommandCount(), static_cast<unsigned long long>(checksum));
+	std::printf("main thread arena: %llu bytes capacity, %llu bytes peak, %llu overflows\n",
+		static_cast<unsigned long long>(statistics.capacity), static_cast<unsigned long long>(statistics.highWaterMark),
+		static_cast<unsigned long long>(statistics.overflowCount));
+	errors += Check(measuredCount == 0, "no general-heap allocations in steady-state frames");
+
+	if (errors > 0)
+	{
+		std::fprintf(stderr, "%d checks failed\n", errors);
+		return 1;
+	}
+	return 0;
+}
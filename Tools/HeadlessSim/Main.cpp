@@ -0,0 +1,590 @@
+﻿/// <summary>
+/// 描画やウィンドウを使わずに Game::Update と同じシミュレーションを回すコマンドラインツール
+///
+/// 使い方: HeadlessSim [-n ティック数] [-rate 回/秒] [-players 自機の数] [-j スレッド数] [-script 入力の台本]
+///                     [-profile トレース.json] [-csv 記録.csv] [-pipeline capped|free]
+///                     [-record 入力.rec] [-replay 入力.rec]
+/// できるだけ速くティックを進め、１秒あたりのティック数と最終状態のチェックサムを表示する
+/// 同じ台本と同じビルドならチェックサムは一致するので、計算の変化の確認にも使える
+/// -profile を指定すると、区間ごとの集計を表示し、最初のティックを Chrome トレース形式で書き出す
+/// ティックごとの時間の分布（p50 / p95 / p99 / 最大）も表示し、-csv を指定するとファイルに１行追加する
+/// -pipeline capped|free を指定すると、Game と同じくシミュレーションを専用のスレッドで進め、
+/// メインスレッドは描画の代わりに受け取ったスナップショットが書いたときのまま揃っているかを確かめる
+/// （capped は毎フレーム前のフレームを待ち、遅れが１フレームを超えないことも確かめる。食い違いがあれば終了コード 1）
+/// -j と一緒に指定すると、専用のスレッドから積んだジョブがその場で実行されず並列に配られることも確かめる
+/// -record を指定すると、進めたティックの入力を Game -record と同じ形式で書き出す
+/// -replay を指定すると、台本と -n の代わりに Game や HeadlessSim で記録した入力を再生する
+/// 記録したフレームの時間でタイマーを進めてフレームごとのティック数が合うことも確かめる（合わなければ終了コード 1）
+/// １ティックの時間は Game と同じく StepTimer の単位に丸めるので、記録した Game と同じチェックサムになる
+///
+/// 台本は１行に「ティック数 キー [マウスX マウスY [ホイール]]」を書き、最後の行まで進んだら先頭に戻る
+/// キーは W A S D C の組み合わせ（何も押さないときは -）、C はその行の最初のティックだけ押す
+/// マウスの座標を書くと、その間は左ボタンでドラッグしている扱いになる。# 以降は読み飛ばす
+///
+/// Windows 以外では次のようにビルドする
+///   g++ -std=c++14 -O2 -pthread -I../../GameEngineTK Main.cpp ../../GameEngineTK/GameSimulation.cpp
+///       ../../GameEngineTK/TransformHierarchy.cpp ../../GameEngineTK/TransformKernel.cpp
+///       ../../GameEngineTK/JobSystem.cpp ../../GameEngineTK/Clock.cpp ../../GameEngineTK/Profiler.cpp
+///       ../../GameEngineTK/FileSystem.cpp ../../GameEngineTK/FrameStats.cpp ../../GameEngineTK/FramePipeline.cpp
+///       ../../GameEngineTK/InputRecording.cpp ../../GameEngineTK/FrameArena.cpp -o HeadlessSim
+/// </summary>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Clock.h"
+#include "FileSystem.h"
+#include "FramePipeline.h"
+#include "FrameStats.h"
+#include "GameSimulation.h"
+#include "InputRecording.h"
+#include "JobSystem.h"
+#include "Profiler.h"
+#include "SnapshotBuffer.h"
+#include "StepTimer.h"
+#include "TransformHierarchy.h"
+
+namespace
+{
+	// 画面の大きさ（デバッグカメラのドラッグの基準）
+	const int SCREEN_WIDTH = 800;
+	const int SCREEN_HEIGHT = 600;
+	// -profile で書き出すティック数
+	const uint32_t PROFILE_CAPTURE_TICKS = 300;
+
+	// 台本の１行
+	struct ScriptLine
+	{
+		int ticks;
+		SimulationInput input;
+	};
+
+	// 台本を指定しないときの入力（前進・旋回・カメラの切り替え・ドラッグを一通り含む）
+	const char* DEFAULT_SCRIPT =
+		"60 W\n"
+		"30 WA\n"
+		"60 W\n"
+		"30 WD\n"
+		"20 -\n"
+		"1 C\n"
+		"60 S\n"
+		"1 C\n"
+		"30 - 400 300\n"
+		"30 - 480 340 -240\n"
+		"30 AD\n";
+
+	// 台本を読む（形式が違う行があれば、その行番号を line に入れて false）
+	bool ParseScript(std::istream& stream, std::vector<ScriptLine>& script, int& line)
+	{
+		std::string text;
+		for (line = 1; std::getline(stream, text); line++)
+		{
+			text = text.substr(0, text.find('#'));
+			std::istringstream fields(text);
+			ScriptLine item = {};
+			std::string keys;
+			if (!(fields >> item.ticks))
+			{
+				// 空行
+				if (fields.eof())
+				{
+					continue;
+				}
+				return false;
+			}
+			if (item.ticks <= 0 || !(fields >> keys))
+			{
+				return false;
+			}
+			for (char key : keys)
+			{
+				switch (key)
+				{
+				case 'W': case 'w': item.input.moveForward = true; break;
+				case 'A': case 'a': item.input.turnLeft = true; break;
+				case 'S': case 's': item.input.moveBackward = true; break;
+				case 'D': case 'd': item.input.turnRight = true; break;
+				case 'C': case 'c': item.input.toggleCamera = true; break;
+				case '-': break;
+				default: return false;
+				}
+			}
+			if (fields >> item.input.mouseX)
+			{
+				if (!(fields >> item.input.mouseY))
+				{
+					return false;
+				}
+				item.input.isDragging = true;
+				fields >> item.input.scrollWheelValue;
+			}
+			script.push_back(item);
+		}
+		line = 0;
+		return !script.empty();
+	}
+
+	// FNV-1a で値のバイト列を混ぜる
+	void HashBytes(uint64_t& hash, const void* data, size_t size)
+	{
+		const uint8_t* bytes = static_cast<const uint8_t*>(data);
+		for (size_t i = 0; i < size; i++)
+		{
+			hash = (hash ^ bytes[i]) * 1099511628211ull;
+		}
+	}
+
+	// -pipeline でシミュレーションのスレッドから受け取る状態
+	struct TickSnapshot
+	{
+		// 何ティック進めた後の状態か
+		long long tick;
+		// 自機のパーツのワールド行列
+		std::vector<Float4x4> worlds;
+		// 追従カメラの視点と注視点
+		std::vector<Float3> cameras;
+		// 書いたときの内容のチェックサム
+		uint64_t checksum;
+	};
+
+	uint64_t HashSnapshot(const TickSnapshot& snapshot)
+	{
+		uint64_t hash = 14695981039346656037ull;
+		HashBytes(hash, &snapshot.tick, sizeof(snapshot.tick));
+		HashBytes(hash, snapshot.worlds.data(), snapshot.worlds.size() * sizeof(Float4x4));
+		HashBytes(hash, snapshot.cameras.data(), snapshot.cameras.size() * sizeof(Float3));
+		return hash;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	long long tickCount = 100000;
+	double rate = 60.0;
+	int playerCount = 1;
+	unsigned threadCount = 1;
+	std::string scriptPath;
+	std::string profilePath;
+	std::string csvPath;
+	std::string pipelineMode;
+	std::string recordPath;
+	std::string replayPath;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "-n" && i + 1 < argc)
+		{
+			tickCount = std::max(std::atoll(argv[++i]), 1ll);
+		}
+		else if (arg == "-rate" && i + 1 < argc)
+		{
+			rate = std::atof(argv[++i]);
+			if (!(rate > 0.0))
+			{
+				std::fprintf(stderr, "-rate: expected a positive number of ticks per second\n");
+				return 2;
+			}
+		}
+		else if (arg == "-players" && i + 1 < argc)
+		{
+			playerCount = std::max(std::atoi(argv[++i]), 1);
+		}
+		else if (arg == "-j" && i + 1 < argc)
+		{
+			threadCount = static_cast<unsigned>(std::max(std::atoi(argv[++i]), 1));
+		}
+		else if (arg == "-script" && i + 1 < argc)
+		{
+			scriptPath = argv[++i];
+		}
+		else if (arg == "-profile" && i + 1 < argc)
+		{
+			profilePath = argv[++i];
+		}
+		else if (arg == "-csv" && i + 1 < argc)
+		{
+			csvPath = argv[++i];
+		}
+		else if (arg == "-pipeline" && i + 1 < argc && (std::strcmp(argv[i + 1], "capped") == 0 || std::strcmp(argv[i + 1], "free") == 0))
+		{
+			pipelineMode = argv[++i];
+		}
+		else if (arg == "-record" && i + 1 < argc)
+		{
+			recordPath = argv[++i];
+		}
+		else if (arg == "-replay" && i + 1 < argc)
+		{
+			replayPath = argv[++i];
+		}
+		else
+		{
+			std::fprintf(stderr, "usage: HeadlessSim [-n ticks] [-rate hz] [-players count] [-j threads] [-script file] [-profile trace.json] [-csv stats.csv] [-pipeline capped|free] [-record file.rec] [-replay file.rec]\n");
+			return 2;
+		}
+	}
+
+	// 入力の台本
+	std::vector<ScriptLine> script;
+	int line = 0;
+	bool parsed;
+	if (scriptPath.empty())
+	{
+		std::istringstream stream(DEFAULT_SCRIPT);
+		parsed = ParseScript(stream, script, line);
+	}
+	else
+	{
+		std::ifstream stream(scriptPath);
+		if (!stream)
+		{
+			std::fprintf(stderr, "%s: cannot open\n", scriptPath.c_str());
+			return 1;
+		}
+		parsed = ParseScript(stream, script, line);
+	}
+	if (!parsed)
+	{
+		std::fprintf(stderr, "%s:%d: expected '<ticks> <WASDC or -> [mouseX mouseY [wheel]]'\n",
+			scriptPath.empty() ? "(default script)" : scriptPath.c_str(), line);
+		return 1;
+	}
+
+	// 記録した入力を読み、Game と同じくタイマーを記録した時間で進めてフレームごとのティック数を確かめる
+	InputRecording replay;
+	uint64_t targetElapsedTicks = DX::StepTimer::SecondsToTicks(1.0 / rate);
+	int screenWidth = SCREEN_WIDTH;
+	int screenHeight = SCREEN_HEIGHT;
+	long long replayMismatchCount = 0;
+	if (!replayPath.empty())
+	{
+		if (!replay.Load(FromUtf8(replayPath)))
+		{
+			std::fprintf(stderr, "%s: cannot read input recording\n", replayPath.c_str());
+			return 1;
+		}
+		const InputRecordingSettings& settings = replay.GetSettings();
+		if (!settings.isFixedTimeStep || settings.targetElapsedTicks == 0 || replay.GetSteps().empty())
+		{
+			std::fprintf(stderr, "%s: expected a fixed time step recording with at least one tick\n", replayPath.c_str());
+			return 1;
+		}
+		FakeClock replayClock;
+		DX::StepTimer timer(replayClock);
+		timer.SetFixedTimeStep(true);
+		timer.SetTargetElapsedTicks(settings.targetElapsedTicks);
+		timer.SetMaxUpdatesPerTick(settings.maxUpdatesPerTick);
+		for (const InputRecordingFrame& frame : replay.GetFrames())
+		{
+			uint32_t ticks = 0;
+			timer.SetNextTickDelta(frame.tickDelta);
+			timer.Tick([&ticks]()
+			{
+				ticks++;
+			});
+			if (ticks != frame.stepCount)
+			{
+				replayMismatchCount++;
+			}
+		}
+		tickCount = static_cast<long long>(replay.GetSteps().size());
+		targetElapsedTicks = settings.targetElapsedTicks;
+		rate = static_cast<double>(DX::StepTimer::TicksPerSecond) / targetElapsedTicks;
+		screenWidth = settings.screenWidth;
+		screenHeight = settings.screenHeight;
+	}
+
+	// Game::Initialize と同じく、天球と自機のパーツのノードを作る
+	TransformHierarchy transforms;
+	std::vector<std::unique_ptr<GameSimulation>> simulations;
+	for (int i = 0; i < playerCount; i++)
+	{
+		transforms.Create();
+		TransformHierarchy::Handle parts[PLAYER_PARTS_NUM];
+		for (TransformHierarchy::Handle& part : parts)
+		{
+			part = transforms.Create();
+		}
+		simulations.push_back(std::make_unique<GameSimulation>(transforms, parts, screenWidth, screenHeight));
+	}
+	// 区間ごとの計測（集計は全てのティックの平均）
+	if (!profilePath.empty())
+	{
+		Profiler::SetThreadName("Main");
+		Profiler::SetSummaryWindow(static_cast<uint32_t>(std::min(tickCount, 1000000ll)));
+		Profiler::StartCapture(PROFILE_CAPTURE_TICKS);
+		Profiler::SetEnabled(true);
+	}
+
+	// メインスレッドも計算に加わる（-pipeline のスレッドのキューも用意する）
+	std::unique_ptr<JobSystem> jobs;
+	if (threadCount > 1)
+	{
+		jobs = std::make_unique<JobSystem>(threadCount - 1, 1);
+	}
+
+	// Game と同じく StepTimer の単位に丸めた間隔で進める
+	const float elapsedTime = static_cast<float>(DX::StepTimer::TicksToSeconds(targetElapsedTicks));
+	Float4x4 ballWorlds[GameSimulation::BALL_COUNT];
+	size_t scriptIndex = 0;
+	int scriptTick = 0;
+	Clock& clock = GetDefaultClock();
+	const double frequency = static_cast<double>(clock.GetFrequency());
+	// ティックごとの時間（予算はシミュレーションの間隔）
+	FrameStats tickStats;
+	tickStats.SetBudget(1.0 / rate);
+	// -record で書き出す入力（１フレームに１ティックずつ進めたことにする）
+	InputRecording recording;
+	if (!recordPath.empty())
+	{
+		InputRecordingSettings settings;
+		settings.isFixedTimeStep = true;
+		settings.targetElapsedTicks = targetElapsedTicks;
+		settings.maxUpdatesPerTick = 0;
+		settings.screenWidth = screenWidth;
+		settings.screenHeight = screenHeight;
+		recording.Reset(settings);
+	}
+	size_t replayIndex = 0;
+	// 台本か記録の次の入力で１ティック進める
+	auto step = [&]()
+	{
+		SimulationInput input;
+		if (!replayPath.empty())
+		{
+			input = replay.GetSteps()[replayIndex++];
+		}
+		else
+		{
+			input = script[scriptIndex].input;
+			input.toggleCamera = input.toggleCamera && scriptTick == 0;
+			if (++scriptTick >= script[scriptIndex].ticks)
+			{
+				scriptTick = 0;
+				scriptIndex = (scriptIndex + 1) % script.size();
+			}
+		}
+		if (!recordPath.empty())
+		{
+			recording.AddStep(input);
+			recording.AddFrame(targetElapsedTicks, 1);
+		}
+
+		// Game::Update と同じ順に進める（球は描画のたびに計算するので、ここでは１ティックに１回）
+		PROFILE_SCOPE("Tick");
+		for (std::unique_ptr<GameSimulation>& simulation : simulations)
+		{
+			simulation->Step(elapsedTime, input);
+			PROFILE_SCOPE("ComputeBallWorlds");
+			GameSimulation::ComputeBallWorlds(simulation->GetBallAngle(), ballWorlds);
+		}
+		transforms.Update(jobs.get());
+	};
+
+	const uint64_t start = clock.GetCounter();
+	uint64_t tickBegin = start;
+	long long errorCount = 0;
+	if (pipelineMode.empty())
+	{
+		for (long long tick = 0; tick < tickCount; tick++)
+		{
+			step();
+			if (!profilePath.empty())
+			{
+				Profiler::EndFrame();
+			}
+
+			const uint64_t tickEnd = clock.GetCounter();
+			const double tickSeconds = (tickEnd - tickBegin) / frequency;
+			tickStats.RecordFrame(tickSeconds, tickSeconds, 0.0, 0.0);
+			tickBegin = tickEnd;
+		}
+	}
+	else
+	{
+		// １フレームに１ティックずつ専用のスレッドに渡し、描画の代わりに受け取った状態を確かめる
+		const bool isLatencyCapped = pipelineMode == "capped";
+		SnapshotBuffer<TickSnapshot> snapshots;
+		// 実行中のパイプラインに渡したティック数と、パイプラインのスレッドが進めたティック数
+		long long kickTicks = 0;
+		long long simulatedTicks = 0;
+		FramePipeline pipeline([&]()
+		{
+			for (long long i = 0; i < kickTicks; i++)
+			{
+				step();
+			}
+			simulatedTicks += kickTicks;
+
+			TickSnapshot& snapshot = snapshots.GetWriteBuffer();
+			snapshot.tick = simulatedTicks;
+			snapshot.worlds.clear();
+			snapshot.cameras.clear();
+			for (const std::unique_ptr<GameSimulation>& simulation : simulations)
+			{
+				for (int part = 0; part < PLAYER_PARTS_NUM; part++)
+				{
+					snapshot.worlds.push_back(transforms.GetWorld(simulation->GetPart(static_cast<PLAYER_PARTS>(part))));
+				}
+				snapshot.cameras.push_back(simulation->GetEyePos());
+				snapshot.cameras.push_back(simulation->GetRefPos());
+			}
+			snapshot.checksum = HashSnapshot(snapshot);
+			snapshots.Publish();
+		}, "Simulation", jobs.get());
+
+		long long frameCount = 0;
+		long long pendingTicks = 0;
+		long long kickedTicks = 0;
+		long long renderedTick = 0;
+		long long receivedCount = 0;
+		long long maxLag = 0;
+		while (renderedTick < tickCount)
+		{
+			if (isLatencyCapped)
+			{
+				pipeline.Wait();
+			}
+			if (kickedTicks + pendingTicks < tickCount)
+			{
+				pendingTicks++;
+			}
+			if (pendingTicks > 0 && !pipeline.IsBusy())
+			{
+				kickTicks = pendingTicks;
+				kickedTicks += pendingTicks;
+				pendingTicks = 0;
+				pipeline.Kick();
+			}
+
+			if (snapshots.Acquire())
+			{
+				// 書いたときのまま揃っていて、前に受け取ったものより新しいこと
+				const TickSnapshot& snapshot = snapshots.GetReadBuffer();
+				if (snapshot.checksum != HashSnapshot(snapshot) || snapshot.tick <= renderedTick)
+				{
+					errorCount++;
+				}
+				renderedTick = snapshot.tick;
+				receivedCount++;
+			}
+			else
+			{
+				std::this_thread::yield();
+			}
+			// 進めるべきティックから、描画した状態がどれだけ遅れているか
+			maxLag = std::max(maxLag, kickedTicks + pendingTicks - renderedTick);
+			frameCount++;
+			if (!profilePath.empty())
+			{
+				Profiler::EndFrame();
+			}
+
+			const uint64_t frameEnd = clock.GetCounter();
+			const double frameSeconds = (frameEnd - tickBegin) / frequency;
+			tickStats.RecordFrame(frameSeconds, frameSeconds, 0.0, 0.0);
+			tickBegin = frameEnd;
+		}
+		pipeline.Wait();
+		if (isLatencyCapped && maxLag > 1)
+		{
+			errorCount++;
+		}
+		// パイプラインのスレッドから積んだジョブも並列に配られたこと
+		const uint64_t inlineJobs = jobs ? jobs->GetUnattachedRunCount() : 0;
+		if (inlineJobs > 0)
+		{
+			errorCount++;
+		}
+		std::printf("pipeline: %s, %lld frames, %lld snapshots checked, max lag %lld frame%s, %llu jobs run inline, %lld error%s\n",
+			pipelineMode.c_str(), frameCount, receivedCount, maxLag, maxLag == 1 ? "" : "s",
+			static_cast<unsigned long long>(inlineJobs), errorCount, errorCount == 1 ? "" : "s");
+		if (jobs)
+		{
+			std::printf("jobs: %llu steals\n", static_cast<unsigned long long>(jobs->GetStealCount()));
+		}
+	}
+	const uint64_t end = tickBegin;
+	const double seconds = (end - start) / frequency;
+
+	// 最終状態のチェックサム（自機のワールド行列・カメラ・球）
+	uint64_t hash = 14695981039346656037ull;
+	for (const std::unique_ptr<GameSimulation>& simulation : simulations)
+	{
+		for (int part = 0; part < PLAYER_PARTS_NUM; part++)
+		{
+			HashBytes(hash, &transforms.GetWorld(simulation->GetPart(static_cast<PLAYER_PARTS>(part))), sizeof(Float4x4));
+		}
+		HashBytes(hash, &simulation->GetEyePos(), sizeof(Float3));
+		HashBytes(hash, &simulation->GetRefPos(), sizeof(Float3));
+		HashBytes(hash, &simulation->GetDebugEyePos(), sizeof(Float3));
+		const float angle = simulation->GetBallAngle();
+		HashBytes(hash, &angle, sizeof(angle));
+	}
+	HashBytes(hash, ballWorlds, sizeof(ballWorlds));
+
+	const Float4x4& tower = transforms.GetWorld(simulations[0]->GetPart(PLAYER_PARTS_TOWER));
+	std::printf("ticks: %lld (%.1f simulated seconds, %d player%s, %u thread%s)\n",
+		tickCount, tickCount / rate, playerCount, playerCount == 1 ? "" : "s", threadCount, threadCount == 1 ? "" : "s");
+	std::printf("time: %.3f s, %.0f ticks/s, %.3f us/tick\n",
+		seconds, seconds > 0.0 ? tickCount / seconds : 0.0, seconds * 1e6 / tickCount);
+	std::printf("player: (%.3f, %.3f, %.3f)\n", tower.m[3][0], tower.m[3][1], tower.m[3][2]);
+	std::printf("checksum: %016llx\n", static_cast<unsigned long long>(hash));
+	if (!replayPath.empty())
+	{
+		std::printf("replay: %s, %zu frames, %lld mismatched frame%s\n", replayPath.c_str(), replay.GetFrames().size(),
+			replayMismatchCount, replayMismatchCount == 1 ? "" : "s");
+		errorCount += replayMismatchCount;
+	}
+	if (!recordPath.empty())
+	{
+		std::vector<uint8_t> encoded;
+		recording.Encode(encoded);
+		if (!WriteWholeFile(FromUtf8(recordPath), encoded.data(), encoded.size()))
+		{
+			std::fprintf(stderr, "%s: cannot write\n", recordPath.c_str());
+			return 1;
+		}
+		std::printf("recorded: %s (%zu ticks, %zu bytes)\n", recordPath.c_str(), recording.GetSteps().size(), encoded.size());
+	}
+	const FrameStatsReport report = tickStats.GetReport();
+	std::printf("tick: p50 %.4f ms, p95 %.4f ms, p99 %.4f ms, max %.4f ms\n",
+		report.update.p50, report.update.p95, report.update.p99, report.update.max);
+	if (!csvPath.empty())
+	{
+		char label[256];
+		std::snprintf(label, sizeof(label), "%s players=%d threads=%u rate=%g",
+			!replayPath.empty() ? replayPath.c_str() : scriptPath.empty() ? "default" : scriptPath.c_str(),
+			playerCount, threadCount, rate);
+		if (!tickStats.AppendCsv(FromUtf8(csvPath), label))
+		{
+			std::fprintf(stderr, "%s: cannot write\n", csvPath.c_str());
+			return 1;
+		}
+	}
+
+	if (!profilePath.empty())
+	{
+		std::printf("\nper tick:\n%s", Profiler::FormatSummary().c_str());
+		if (Profiler::GetDroppedCount() > 0)
+		{
+			std::printf("dropped events: %llu\n", static_cast<unsigned long long>(Profiler::GetDroppedCount()));
+		}
+		if (!Profiler::WriteChromeTrace(FromUtf8(profilePath)))
+		{
+			std::fprintf(stderr, "%s: cannot write\n", profilePath.c_str());
+			return 1;
+		}
+		std::printf("trace: %s (%zu events)\n", profilePath.c_str(), Profiler::GetCapturedEventCount());
+	}
+	// -pipeline や -replay で食い違いがあれば失敗にする
+	return errorCount > 0 ? 1 : 0;
+}
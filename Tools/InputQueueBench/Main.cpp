@@ -0,0 +1,241 @@
+﻿/// <summary>
+/// 入力イベントのキューを合成したイベントで確かめ、性能を測るコマンドラインツール
+///
+/// 使い方: InputQueueBench [-n イベント数] [-f フレーム数] [-hz フレームの頻度] [-rate １秒あたりのイベント数]
+/// １フレームの中で押して離したキーなどの組み立てを確かめ、別のスレッドから積んだイベントが
+/// 欠けず順番通りに届くことと、フレームごとに読み出すまでの遅れの分布を表示する
+/// 確かめた結果が合わなければ 1 を返す
+///
+/// Windows 以外では次のようにビルドする
+///   g++ -std=c++14 -O2 -pthread -I../../GameEngineTK Main.cpp ../../GameEngineTK/InputEventQueue.cpp
+///       ../../GameEngineTK/Clock.cpp ../../GameEngineTK/FrameStats.cpp ../../GameEngineTK/FileSystem.cpp
+///       -o InputQueueBench
+/// </summary>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+
+#include "Clock.h"
+#include "FrameStats.h"
+#include "InputEventQueue.h"
+
+namespace
+{
+	// 合成するイベント
+	InputEvent MakeEvent(uint8_t type, uint8_t code, uint64_t timestamp)
+	{
+		InputEvent event = {};
+		event.timestamp = timestamp;
+		event.type = type;
+		event.code = code;
+		return event;
+	}
+
+	// 確かめた結果を表示して数える
+	int Check(bool condition, const char* name)
+	{
+		if (!condition)
+		{
+			std::fprintf(stderr, "check failed: %s\n", name);
+			return 1;
+		}
+		return 0;
+	}
+
+	// １フレームの組み立てを確かめる（失敗した数を返す）
+	int CheckSnapshot()
+	{
+		int errors = 0;
+		InputEventQueue queue(4);
+		InputState state;
+
+		// 容量は２の累乗で、満杯なら捨てて数える
+		for (uint64_t i = 0; i < 5; i++)
+		{
+			queue.Push(MakeEvent(INPUT_EVENT_MOUSE_MOVE, 0, i + 1));
+		}
+		errors += Check(queue.GetCapacity() == 4 && queue.TakeDroppedCount() == 1, "drop when full");
+		state.Update(queue);
+		errors += Check(state.GetSnapshot().eventCount == 4 && state.GetSnapshot().oldestTimestamp == 1, "drain");
+
+		// 同じフレームで押して離したキーは、押した瞬間も離した瞬間も残る
+		queue.Push(MakeEvent(INPUT_EVENT_KEY_DOWN, 'C', 10));
+		queue.Push(MakeEvent(INPUT_EVENT_KEY_UP, 'C', 11));
+		const InputSnapshot& tap = state.Update(queue);
+		errors += Check(tap.IsKeyPressed('C') && tap.IsKeyReleased('C') && !tap.IsKeyDown('C') && tap.IsKeyActive('C'),
+			"tap within a frame");
+
+		// 押し続けて繰り返し届いたものは押した瞬間に数えない
+		queue.Push(MakeEvent(INPUT_EVENT_KEY_DOWN, 'W', 20));
+		state.Update(queue);
+		queue.Push(MakeEvent(INPUT_EVENT_KEY_DOWN, 'W', 21));
+		const InputSnapshot& repeat = state.Update(queue);
+		errors += Check(repeat.IsKeyDown('W') && !repeat.IsKeyPressed('W') && !repeat.IsKeyPressed('C'), "key repeat");
+
+		// イベントが無いフレームは押したままで、時刻は 0
+		const InputSnapshot& idle = state.Update(queue);
+		errors += Check(idle.IsKeyDown('W') && idle.eventCount == 0 && idle.oldestTimestamp == 0, "idle frame");
+
+		// ボタンと座標とホイール
+		InputEvent button = MakeEvent(INPUT_EVENT_BUTTON_DOWN, INPUT_MOUSE_LEFT, 30);
+		button.x = 12;
+		button.y = 34;
+		queue.Push(button);
+		InputEvent wheel = MakeEvent(INPUT_EVENT_WHEEL, 0, 31);
+		wheel.wheelDelta = -120;
+		queue.Push(wheel);
+		queue.Push(wheel);
+		const InputSnapshot& mouse = state.Update(queue);
+		errors += Check(mouse.IsButtonDown(INPUT_MOUSE_LEFT) && mouse.IsButtonPressed(INPUT_MOUSE_LEFT)
+			&& mouse.mouseX == 12 && mouse.mouseY == 34 && mouse.wheelDelta == -240, "mouse");
+
+		// フォーカスを失ったら全て離す
+		queue.Push(MakeEvent(INPUT_EVENT_RELEASE_ALL, 0, 40));
+		const InputSnapshot& released = state.Update(queue);
+		errors += Check(!released.IsKeyDown('W') && released.IsKeyReleased('W')
+			&& !released.IsButtonDown(INPUT_MOUSE_LEFT) && released.wheelDelta == 0, "release all");
+		return errors;
+	}
+
+	// 経過時間（秒）
+	double ToSeconds(Clock& clock, uint64_t begin, uint64_t end)
+	{
+		return static_cast<double>(end - begin) / clock.GetFrequency();
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	uint64_t eventCount = 10000000;
+	int frameCount = 300;
+	double frameRate = 60.0;
+	double eventRate = 2000.0;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "-n" && i + 1 < argc)
+		{
+			eventCount = static_cast<uint64_t>(std::max(std::atoll(argv[++i]), 1ll));
+		}
+		else if (arg == "-f" && i + 1 < argc)
+		{
+			frameCount = std::max(std::atoi(argv[++i]), 1);
+		}
+		else if (arg == "-hz" && i + 1 < argc)
+		{
+			frameRate = std::max(std::atof(argv[++i]), 1.0);
+		}
+		else if (arg == "-rate" && i + 1 < argc)
+		{
+			eventRate = std::max(std::atof(argv[++i]), 1.0);
+		}
+		else
+		{
+			std::fprintf(stderr, "usage: InputQueueBench [-n events] [-f frames] [-hz frame_rate] [-rate events_per_second]\n");
+			return 2;
+		}
+	}
+
+	int errors = CheckSnapshot();
+	std::printf("snapshot checks: %s\n", errors == 0 ? "ok" : "FAILED");
+
+	Clock& clock = GetDefaultClock();
+
+	// 別のスレッドからできるだけ速く積み、欠けと順番を確かめる（満杯なら空くまで積み直す）
+	{
+		InputEventQueue queue;
+		const uint64_t begin = clock.GetCounter();
+		std::thread producer([&queue, eventCount]()
+		{
+			for (uint64_t i = 0; i < eventCount; i++)
+			{
+				const InputEvent event = MakeEvent(INPUT_EVENT_KEY_DOWN, static_cast<uint8_t>(i), i);
+				while (!queue.Push(event))
+				{
+					std::this_thread::yield();
+				}
+			}
+		});
+
+		uint64_t received = 0;
+		bool isOrdered = true;
+		InputEvent event;
+		while (received < eventCount)
+		{
+			if (!queue.Pop(event))
+			{
+				std::this_thread::yield();
+				continue;
+			}
+			isOrdered = isOrdered && event.timestamp == received && event.code == static_cast<uint8_t>(received);
+			received++;
+		}
+		producer.join();
+		const double seconds = ToSeconds(clock, begin, clock.GetCounter());
+		errors += Check(isOrdered, "events arrive in order without loss");
+		std::printf("throughput: %.0f events/s, %.1f ns/event (%llu retries when full)\n",
+			eventCount / seconds, seconds * 1e9 / eventCount,
+			static_cast<unsigned long long>(queue.TakeDroppedCount()));
+	}
+
+	// 一定の頻度で届くイベントを、フレームごとに１回読み出したときの遅れ
+	{
+		InputEventQueue queue;
+		std::atomic<bool> isQuit(false);
+		std::atomic<uint64_t> pushed(0);
+		std::thread producer([&]()
+		{
+			const auto interval = std::chrono::duration<double>(1.0 / eventRate);
+			auto next = std::chrono::steady_clock::now();
+			for (uint64_t i = 0; !isQuit.load(std::memory_order_relaxed); i++)
+			{
+				// 押して離すを繰り返す
+				const uint8_t type = (i & 1) ? INPUT_EVENT_KEY_UP : INPUT_EVENT_KEY_DOWN;
+				queue.Push(MakeEvent(type, static_cast<uint8_t>('A' + (i >> 1) % 26), clock.GetCounter()));
+				pushed.fetch_add(1, std::memory_order_relaxed);
+				next += std::chrono::duration_cast<std::chrono::steady_clock::duration>(interval);
+				std::this_thread::sleep_until(next);
+			}
+		});
+
+		InputState state;
+		FrameTimeHistogram latency;
+		uint64_t applied = 0;
+		const auto frameInterval = std::chrono::duration<double>(1.0 / frameRate);
+		auto nextFrame = std::chrono::steady_clock::now();
+		for (int frame = 0; frame < frameCount; frame++)
+		{
+			nextFrame += std::chrono::duration_cast<std::chrono::steady_clock::duration>(frameInterval);
+			std::this_thread::sleep_until(nextFrame);
+			const InputSnapshot& snapshot = state.Update(queue);
+			const uint64_t now = clock.GetCounter();
+			applied += snapshot.eventCount;
+			if (snapshot.eventCount > 0)
+			{
+				// マイクロ秒で記録する
+				latency.Record(static_cast<uint64_t>(ToSeconds(clock, snapshot.oldestTimestamp, now) * 1e6));
+			}
+		}
+		isQuit.store(true, std::memory_order_relaxed);
+		producer.join();
+		applied += state.Update(queue).eventCount;
+		const uint64_t dropped = queue.TakeDroppedCount();
+		errors += Check(applied + dropped == pushed.load(), "every pushed event is applied or counted as dropped");
+		std::printf("frame drain at %.0f Hz, %.0f events/s: oldest event waited p50 %.2f ms, p99 %.2f ms, max %.2f ms"
+			" (%llu events, %llu dropped)\n",
+			frameRate, eventRate, latency.GetPercentile(50.0) * 1e-3, latency.GetPercentile(99.0) * 1e-3,
+			latency.GetMax() * 1e-3, static_cast<unsigned long long>(applied), static_cast<unsigned long long>(dropped));
+	}
+
+	if (errors > 0)
+	{
+		std::fprintf(stderr, "%d checks failed\n", errors);
+		return 1;
+	}
+	return 0;
+}
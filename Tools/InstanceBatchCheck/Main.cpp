@@ -0,0 +1,246 @@
+﻿/// <summary>
+/// インスタンスをまとめるクラスを GPU を使わずに確かめるコマンドラインツール
+///
+/// 使い方: InstanceBatchCheck [-n インスタンス数] [-models モデル数] [-materials マテリアル数] [-f フレーム数]
+/// 毎フレーム、ランダムなモデルとマテリアルの組でワールド行列を InstanceBatcher に追加し、
+/// 素直に組み分けした結果と比べて次のことを確かめる
+/// ・組は最初に追加された順に並び、モデルかマテリアルが違えば別の組になる
+/// ・各組の firstInstance は前の組までの個数の合計で、instanceCount は追加した数
+/// ・組の中のワールド行列は追加した順
+/// ・GetInstanceCount と GetDrawsSaved が追加した数と組の数に合う
+/// ・Build を繰り返しても、Clear の後に前のフレームの組が残らない
+/// １インスタンスあたりの Add と Build の時間も表示する
+/// 確かめた結果が合わなければ 1 を返す
+///
+/// Windows 以外では次のようにビルドする
+///   g++ -std=c++14 -O2 -I../../GameEngineTK Main.cpp ../../GameEngineTK/InstanceBatcher.cpp
+///       ../../GameEngineTK/FrameArena.cpp ../../GameEngineTK/Clock.cpp -o InstanceBatchCheck
+/// </summary>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "Clock.h"
+#include "FrameArena.h"
+#include "InstanceBatcher.h"
+
+namespace
+{
+	// 確かめた結果を表示して数える
+	int Check(bool condition, const char* name, int frame)
+	{
+		if (!condition)
+		{
+			std::fprintf(stderr, "check failed: %s (frame %d)\n", name, frame);
+			return 1;
+		}
+		return 0;
+	}
+
+	// 再現できる乱数（xorshift）
+	uint32_t Random(uint32_t& state)
+	{
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		return state;
+	}
+
+	// 追加するインスタンス
+	struct Instance
+	{
+		const void* model;
+		const void* material;
+	};
+
+	// 追加した順番を行列に埋め込む
+	Float4x4 MakeWorld(size_t order)
+	{
+		Float4x4 world = Float4x4Identity();
+		world.m[3][0] = static_cast<float>(order);
+		world.m[3][1] = static_cast<float>(order % 7);
+		return world;
+	}
+
+	// 素直に組み分けした結果（組は最初に現れた順、組の中は追加した順）
+	struct ExpectedBatch
+	{
+		Instance key;
+		std::vector<size_t> orders;
+	};
+
+	std::vector<ExpectedBatch> GroupNaive(const std::vector<Instance>& instances)
+	{
+		std::vector<ExpectedBatch> batches;
+		for (size_t i = 0; i < instances.size(); i++)
+		{
+			auto it = std::find_if(batches.begin(), batches.end(), [&](const ExpectedBatch& batch)
+			{
+				return batch.key.model == instances[i].model && batch.key.material == instances[i].material;
+			});
+			if (it == batches.end())
+			{
+				batches.push_back(ExpectedBatch{ instances[i], std::vector<size_t>() });
+				it = batches.end() - 1;
+			}
+			it->orders.push_back(i);
+		}
+		return batches;
+	}
+
+	// Build した結果を素直な組み分けと比べる
+	int CheckBatches(const InstanceBatcher& batcher, const std::vector<Instance>& instances, int frame)
+	{
+		int errors = 0;
+		const std::vector<ExpectedBatch> expected = GroupNaive(instances);
+		const std::vector<InstanceBatcher::Batch>& batches = batcher.GetBatches();
+		errors += Check(batches.size() == expected.size(), "batch count", frame);
+		errors += Check(batcher.GetInstanceCount() == instances.size(), "instance count", frame);
+		errors += Check(batcher.GetDrawsSaved() == instances.size() - expected.size(), "draws saved", frame);
+		if (batches.size() != expected.size())
+		{
+			return errors;
+		}
+
+		bool isOrdered = true;
+		bool isRangeRight = true;
+		bool isInstanceOrdered = true;
+		uint32_t offset = 0;
+		for (size_t b = 0; b < batches.size(); b++)
+		{
+			const InstanceBatcher::Batch& batch = batches[b];
+			isOrdered = isOrdered && batch.model == expected[b].key.model && batch.material == expected[b].key.material;
+			isRangeRight = isRangeRight && batch.firstInstance == offset && batch.instanceCount == expected[b].orders.size();
+			for (uint32_t i = 0; i < batch.instanceCount && isRangeRight; i++)
+			{
+				const Float4x4& world = batcher.GetInstances()[batch.firstInstance + i];
+				isInstanceOrdered = isInstanceOrdered && world.m[3][0] == static_cast<float>(expected[b].orders[i]) &&
+					world.m[3][1] == static_cast<float>(expected[b].orders[i] % 7);
+			}
+			offset += batch.instanceCount;
+		}
+		errors += Check(isOrdered, "batches in first-added order", frame);
+		errors += Check(isRangeRight && offset == instances.size(), "firstInstance and instanceCount", frame);
+		errors += Check(isInstanceOrdered, "instances in added order within a batch", frame);
+		return errors;
+	}
+
+	// フレームのアリーナを戻し、インスタンスを追加して Build する
+	void RunFrame(InstanceBatcher& batcher, const std::vector<Instance>& instances)
+	{
+		FrameArena::GetThreadArena().Reset();
+		batcher.Clear();
+		for (size_t i = 0; i < instances.size(); i++)
+		{
+			batcher.Add(instances[i].model, instances[i].material, MakeWorld(i));
+		}
+		batcher.Build();
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	int instanceCount = 100000;
+	int modelCount = 16;
+	int materialCount = 4;
+	int frameCount = 20;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "-n" && i + 1 < argc)
+		{
+			instanceCount = std::max(std::atoi(argv[++i]), 1);
+		}
+		else if (arg == "-models" && i + 1 < argc)
+		{
+			modelCount = std::max(std::atoi(argv[++i]), 1);
+		}
+		else if (arg == "-materials" && i + 1 < argc)
+		{
+			materialCount = std::max(std::atoi(argv[++i]), 1);
+		}
+		else if (arg == "-f" && i + 1 < argc)
+		{
+			frameCount = std::max(std::atoi(argv[++i]), 1);
+		}
+		else
+		{
+			std::fprintf(stderr, "usage: InstanceBatchCheck [-n instances] [-models models] [-materials materials] [-f frames]\n");
+			return 2;
+		}
+	}
+
+	// キーにするだけなので、中身の無い配列の要素を指す
+	std::vector<char> models(modelCount);
+	std::vector<char> materials(materialCount);
+	int errors = 0;
+	InstanceBatcher batcher;
+
+	// 何も追加しないフレーム
+	RunFrame(batcher, std::vector<Instance>());
+	errors += Check(batcher.GetBatches().empty() && batcher.GetDrawsSaved() == 0, "empty frame", 0);
+
+	// 同じモデルでマテリアルが違う、同じマテリアルでモデルが違う、間に挟まった同じ組
+	const std::vector<Instance> mixed =
+	{
+		{ &models[0], &materials[0] },
+		{ &models[0], &materials[materialCount - 1] },
+		{ &models[modelCount - 1], &materials[0] },
+		{ &models[0], &materials[0] },
+		{ &models[0], nullptr },
+		{ &models[0], &materials[0] },
+	};
+	RunFrame(batcher, mixed);
+	errors += CheckBatches(batcher, mixed, 0);
+
+	// ランダムな組み合わせと数で、フレームごとに Clear して繰り返す
+	uint32_t random = 2463534242u;
+	std::vector<Instance> instances;
+	for (int frame = 1; frame <= frameCount; frame++)
+	{
+		// 最後のフレームだけ最大数（時間を測る）
+		const size_t count = frame == frameCount ? instanceCount : Random(random) % (instanceCount + 1);
+		// フレームごとに使う組の数も変える
+		const uint32_t usedModels = 1 + Random(random) % modelCount;
+		instances.resize(count);
+		for (Instance& instance : instances)
+		{
+			instance.model = &models[Random(random) % usedModels];
+			instance.material = &materials[Random(random) % materialCount];
+		}
+		RunFrame(batcher, instances);
+		errors += CheckBatches(batcher, instances, frame);
+
+		// Build をもう１回呼んでも同じ
+		batcher.Build();
+		errors += CheckBatches(batcher, instances, frame);
+	}
+
+	// Add と Build の時間（アリーナを温めた後）
+	Clock& clock = GetDefaultClock();
+	FrameArena::GetThreadArena().Reset();
+	batcher.Clear();
+	const uint64_t begin = clock.GetCounter();
+	for (size_t i = 0; i < instances.size(); i++)
+	{
+		batcher.Add(instances[i].model, instances[i].material, MakeWorld(i));
+	}
+	const uint64_t added = clock.GetCounter();
+	batcher.Build();
+	const uint64_t built = clock.GetCounter();
+	const double perInstance = 1e9 / clock.GetFrequency() / static_cast<double>(instances.size());
+	std::printf("%zu instances in %zu batches (%zu draws saved): Add %.2f ns, Build %.2f ns per instance\n",
+		instances.size(), batcher.GetBatches().size(), batcher.GetDrawsSaved(),
+		(added - begin) * perInstance, (built - added) * perInstance);
+
+	if (errors > 0)
+	{
+		std::fprintf(stderr, "%d checks failed\n", errors);
+		return 1;
+	}
+	std::printf("checks: ok\n");
+	return 0;
+}
@@ -0,0 +1,129 @@
+﻿/// <summary>
+/// ジョブシステムの性能を測るコマンドラインツール
+///
+/// 使い方: JobBenchmark [-j スレッド数] [-n ジョブ数] [-r フォーク・ジョインの回数]
+/// 空のジョブを流したときの１秒あたりのジョブ数と、小さなフォーク・ジョインの所要時間の分布を表示する
+///
+/// Windows 以外では次のようにビルドする
+///   g++ -std=c++14 -O2 -pthread -I../../GameEngineTK Main.cpp ../../GameEngineTK/JobSystem.cpp
+///       ../../GameEngineTK/Profiler.cpp ../../GameEngineTK/Clock.cpp ../../GameEngineTK/FileSystem.cpp
+///       ../../GameEngineTK/FrameStats.cpp ../../GameEngineTK/FrameArena.cpp -o JobBenchmark
+/// </summary>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+
+#include "Clock.h"
+#include "FrameStats.h"
+#include "JobSystem.h"
+
+namespace
+{
+	// まとめて積んでから待つジョブの数（１スレッドが同時に持てる数より少なくする）
+	const size_t BATCH_SIZE = 1024;
+
+	// 何もしないジョブ
+	void EmptyJob(const void*, size_t, size_t)
+	{
+	}
+
+	// 経過時間（秒）
+	double ToSeconds(Clock& clock, uint64_t begin, uint64_t end)
+	{
+		return static_cast<double>(end - begin) / clock.GetFrequency();
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	unsigned threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+	size_t jobCount = 1000000;
+	int forkJoinCount = 10000;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "-j" && i + 1 < argc)
+		{
+			threadCount = static_cast<unsigned>(std::max(std::atoi(argv[++i]), 1));
+		}
+		else if (arg == "-n" && i + 1 < argc)
+		{
+			jobCount = static_cast<size_t>(std::max(std::atoll(argv[++i]), 1ll));
+		}
+		else if (arg == "-r" && i + 1 < argc)
+		{
+			forkJoinCount = std::max(std::atoi(argv[++i]), 1);
+		}
+		else
+		{
+			std::fprintf(stderr, "usage: JobBenchmark [-j threads] [-n jobs] [-r fork_joins]\n");
+			return 2;
+		}
+	}
+
+	JobSystem jobs(threadCount - 1);
+	Clock& clock = GetDefaultClock();
+	std::printf("threads: %u\n", jobs.GetThreadCount());
+
+	// 空のジョブをメインスレッドから１個ずつ積む（積む・盗む・数えるの負荷）
+	{
+		const uint64_t stealsBefore = jobs.GetStealCount();
+		const uint64_t begin = clock.GetCounter();
+		for (size_t done = 0; done < jobCount; )
+		{
+			JobCounter counter;
+			const size_t batch = std::min(BATCH_SIZE, jobCount - done);
+			for (size_t i = 0; i < batch; i++)
+			{
+				jobs.Run(&EmptyJob, nullptr, 1, 1, counter);
+			}
+			jobs.Wait(counter);
+			done += batch;
+		}
+		const double seconds = ToSeconds(clock, begin, clock.GetCounter());
+		std::printf("empty jobs (submitted one by one): %.0f jobs/s, %.1f ns/job, %llu steals\n",
+			jobCount / seconds, seconds * 1e9 / jobCount,
+			static_cast<unsigned long long>(jobs.GetStealCount() - stealsBefore));
+	}
+
+	// 空のジョブを１回の ParallelFor で分割しながら配る
+	{
+		const uint64_t stealsBefore = jobs.GetStealCount();
+		const uint64_t begin = clock.GetCounter();
+		jobs.ParallelFor(jobCount, 1, [](size_t, size_t) {});
+		const double seconds = ToSeconds(clock, begin, clock.GetCounter());
+		std::printf("empty jobs (split by ParallelFor):  %.0f jobs/s, %.1f ns/job, %llu steals\n",
+			jobCount / seconds, seconds * 1e9 / jobCount,
+			static_cast<unsigned long long>(jobs.GetStealCount() - stealsBefore));
+	}
+
+	// スレッド数の４倍の小さなジョブを配って全て終わるまでの時間
+	{
+		FrameTimeHistogram latency;
+		const size_t forkCount = jobs.GetThreadCount() * 4;
+		std::atomic<size_t> sum(0);
+		for (int i = 0; i < forkJoinCount; i++)
+		{
+			const uint64_t begin = clock.GetCounter();
+			jobs.ParallelFor(forkCount, 1, [&sum](size_t b, size_t e)
+			{
+				sum.fetch_add(e - b, std::memory_order_relaxed);
+			});
+			// ナノ秒で記録する
+			latency.Record(static_cast<uint64_t>(ToSeconds(clock, begin, clock.GetCounter()) * 1e9));
+		}
+		if (sum.load() != forkCount * forkJoinCount)
+		{
+			std::fprintf(stderr, "fork-join: lost jobs (%zu of %zu)\n", sum.load(), forkCount * forkJoinCount);
+			return 1;
+		}
+		std::printf("fork-join of %zu jobs: p50 %.2f us, p95 %.2f us, p99 %.2f us, max %.2f us, mean %.2f us\n",
+			forkCount, latency.GetPercentile(50.0) * 1e-3, latency.GetPercentile(95.0) * 1e-3,
+			latency.GetPercentile(99.0) * 1e-3, latency.GetMax() * 1e-3, latency.GetMean() * 1e-3);
+	}
+	return 0;
+}
@@ -0,0 +1,118 @@
+﻿/// <summary>
+/// 詳細度の選び方（SelectLod / ComputePixelsPerUnit）を確かめるコマンドラインツール
+///
+/// 使い方: LodSelectorCheck
+/// 画面上の誤差のしきい値で選ぶ詳細度、細かくするときはすぐ・粗くするときは余裕を持って切り替えること、
+/// 使えない詳細度を飛ばすこと、境界をまたいで行き来しても毎フレーム切り替わらないことを確かめる
+/// 確かめた結果が合わなければ 1 を返す
+///
+/// Windows 以外では次のようにビルドする
+///   g++ -std=c++14 -O2 -I../../GameEngineTK Main.cpp ../../GameEngineTK/LodSelector.cpp -o LodSelectorCheck
+/// </summary>
+#include <cmath>
+#include <cstdio>
+
+#include "LodSelector.h"
+
+namespace
+{
+	// 詳細度ごとの幾何誤差（0 番が元のモデル）
+	const float ERRORS[] = { 0.0f, 0.01f, 0.04f, 0.16f };
+	const int LEVEL_COUNT = sizeof(ERRORS) / sizeof(ERRORS[0]);
+	// 許容する画面上の誤差（ピクセル）と切り替えの余裕
+	const float THRESHOLD = 1.0f;
+	const float HYSTERESIS = 0.25f;
+
+	// 確かめた結果を表示して数える
+	int Check(bool condition, const char* name)
+	{
+		if (!condition)
+		{
+			std::fprintf(stderr, "check failed: %s\n", name);
+			return 1;
+		}
+		return 0;
+	}
+
+	// level の誤差が画面上で pixels ピクセルになる pixelsPerUnit
+	float PixelsFor(int level, float pixels)
+	{
+		return pixels / ERRORS[level];
+	}
+
+	int Select(float pixelsPerUnit, int current, const bool* available = nullptr, float hysteresis = HYSTERESIS)
+	{
+		return SelectLod(ERRORS, available, LEVEL_COUNT, pixelsPerUnit, current, THRESHOLD, hysteresis);
+	}
+
+	// 2 番の誤差が境界の前後 (1 ± 0.05 ピクセル) を行き来するときに詳細度が変わった回数
+	int CountSwitches(float hysteresis)
+	{
+		int level = 2;
+		int switches = 0;
+		for (int frame = 0; frame < 100; frame++)
+		{
+			const int next = Select(PixelsFor(2, frame % 2 == 0 ? 1.05f : 0.95f), level, nullptr, hysteresis);
+			switches += next != level ? 1 : 0;
+			level = next;
+		}
+		return switches;
+	}
+}
+
+int main(int argc, char*[])
+{
+	if (argc > 1)
+	{
+		std::fprintf(stderr, "usage: LodSelectorCheck\n");
+		return 2;
+	}
+
+	int errors = 0;
+
+	// しきい値: 誤差が 1 ピクセル以下で最も粗い詳細度（十分に余裕があれば元のモデルからでも粗くする）
+	errors += Check(Select(PixelsFor(3, 0.5f), 0) == 3, "threshold: coarsest level far away");
+	errors += Check(Select(PixelsFor(2, 0.5f), 0) == 2, "threshold: level 2 within half a pixel");
+	errors += Check(Select(PixelsFor(1, 1.5f), 3) == 0, "threshold: full detail up close");
+	errors += Check(SelectLod(ERRORS, nullptr, 1, 0.0f, 0, THRESHOLD, HYSTERESIS) == 0, "threshold: single level");
+
+	// 細かくするときはしきい値を超えたらすぐ
+	errors += Check(Select(PixelsFor(2, 1.01f), 2) == 1, "hysteresis: refine as soon as the error exceeds the threshold");
+	errors += Check(Select(PixelsFor(2, 0.99f), 2) == 2, "hysteresis: keep the level below the threshold");
+
+	// 粗くするときは threshold * (1 - hysteresis) 以下になるまで待つ（待つ間は粗くできる所まで）
+	errors += Check(Select(PixelsFor(2, 0.9f), 1) == 1, "hysteresis: wait before coarsening");
+	errors += Check(Select(PixelsFor(2, 0.9f), 0) == 1, "hysteresis: coarsen only as far as the margin allows");
+	errors += Check(Select(PixelsFor(2, 0.7f), 1) == 2, "hysteresis: coarsen with enough margin");
+
+	// 境界を行き来しても切り替わるのは最初の１回だけ（余裕が無ければ毎フレーム切り替わる）
+	errors += Check(CountSwitches(HYSTERESIS) == 1, "hysteresis: no flicker at the boundary");
+	errors += Check(CountSwitches(0.0f) == 100, "hysteresis: flickers without a margin");
+
+	// 読み込み終わっていない詳細度は飛ばす
+	const bool without3[LEVEL_COUNT] = { true, true, true, false };
+	const bool without2[LEVEL_COUNT] = { true, true, false, true };
+	errors += Check(Select(PixelsFor(3, 0.5f), 0, without3) == 2, "available: skip a missing coarse level");
+	errors += Check(Select(PixelsFor(3, 0.5f), 0, without2) == 3, "available: skip a missing middle level");
+	errors += Check(Select(PixelsFor(2, 0.5f), 0, without2) == 1, "available: use a finer level instead");
+	errors += Check(Select(PixelsFor(2, 0.99f), 2, without2) == 1, "available: current level that went missing");
+	errors += Check(Select(PixelsFor(3, 0.5f), 7) == 3, "available: current level out of range");
+
+	// 画面上の大きさ: 縦 1000 ピクセルに 90 度の視野なら、手前の面まで 10 の距離で 50 ピクセル/単位
+	LodView view;
+	view.eyePosition = Float3{ 0.0f, 0.0f, 0.0f };
+	view.fovY = 3.14159265f * 0.5f;
+	view.aspect = 1.6f;
+	view.screenWidth = 1600.0f;
+	errors += Check(std::fabs(ComputePixelsPerUnit(view, Float3{ 0.0f, 0.0f, 11.0f }, 1.0f) - 50.0f) < 1e-3f,
+		"pixels per unit at distance 10");
+	errors += Check(ComputePixelsPerUnit(view, Float3{ 0.0f, 0.0f, 1.0f }, 2.0f) > 1e5f, "pixels per unit inside the sphere");
+
+	if (errors > 0)
+	{
+		std::fprintf(stderr, "%d checks failed\n", errors);
+		return 1;
+	}
+	std::printf("checks: ok\n");
+	return 0;
+}
@@ -0,0 +1,312 @@
+﻿/// <summary>
+/// 描画キューの並べ替えと発行を確かめ、性能を測るコマンドラインツール
+///
+/// 使い方: RenderQueueBench [-n コマンド数] [-r 繰り返す回数] [-states ステート数] [-materials マテリアル数] [-meshes メッシュ数]
+/// ランダムなコマンドを RenderQueue で並べ替えて NullRenderBackend に発行し、次のことを確かめる
+/// ・並べ替えた順が std::stable_sort と同じ（同じキーは追加した順のまま）
+/// ・不透明が半透明より先で、半透明は奥から手前の順
+/// ・GetCounters() と GetStatistics() が、並べ替えた順で前と違うものを数えた回数と同じ
+/// ・キーから取り出したステート・マテリアル・メッシュが作ったときの値と同じ
+/// 並べ替え（std::stable_sort との比較）と発行の１コマンドあたりの時間、
+/// 並べ替える前と後の切り替え回数を表示する
+/// 確かめた結果が合わなければ 1 を返す
+///
+/// Windows 以外では次のようにビルドする
+///   g++ -std=c++14 -O2 -pthread -I../../GameEngineTK Main.cpp ../../GameEngineTK/RenderQueue.cpp
+///       ../../GameEngineTK/NullRenderBackend.cpp ../../GameEngineTK/Profiler.cpp ../../GameEngineTK/Clock.cpp
+///       ../../GameEngineTK/FileSystem.cpp ../../GameEngineTK/FrameStats.cpp ../../GameEngineTK/FrameArena.cpp
+///       -o RenderQueueBench
+/// </summary>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "Clock.h"
+#include "NullRenderBackend.h"
+#include "RenderQueue.h"
+
+namespace
+{
+	// 半透明にする割合（%）
+	const uint32_t ALPHA_PERCENT = 20;
+
+	// 確かめた結果を表示して数える
+	int Check(bool condition, const char* name)
+	{
+		if (!condition)
+		{
+			std::fprintf(stderr, "check failed: %s\n", name);
+			return 1;
+		}
+		return 0;
+	}
+
+	// 再現できる乱数（xorshift）
+	uint32_t Random(uint32_t& state)
+	{
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		return state;
+	}
+
+	// 追加するコマンド
+	struct Source
+	{
+		RenderPass pass;
+		uint32_t state;
+		uint32_t material;
+		uint32_t mesh;
+		float depth;
+		uint64_t key;
+	};
+
+	// 種類の数
+	struct Options
+	{
+		uint32_t states;
+		uint32_t materials;
+		uint32_t meshes;
+	};
+
+	std::vector<Source> MakeSources(size_t count, const Options& options, uint32_t& random)
+	{
+		std::vector<Source> sources(count);
+		for (Source& source : sources)
+		{
+			source.pass = Random(random) % 100 < ALPHA_PERCENT ? RENDER_PASS_ALPHA : RENDER_PASS_OPAQUE;
+			source.state = Random(random) % options.states;
+			source.material = Random(random) % options.materials;
+			source.mesh = Random(random) % options.meshes;
+			source.depth = static_cast<float>(Random(random) % 1000) / 1000.0f;
+			source.key = RenderQueue::MakeKey(source.pass, source.state, source.material, source.mesh, source.depth);
+		}
+		return sources;
+	}
+
+	// キューに追加する（ワールド行列の平行移動に追加した順を入れる）
+	void Fill(RenderQueue& queue, const std::vector<Source>& sources)
+	{
+		queue.Clear();
+		for (size_t i = 0; i < sources.size(); i++)
+		{
+			Float4x4 world = Float4x4Identity();
+			world.m[3][0] = static_cast<float>(i);
+			queue.Add(sources[i].key, queue.AddTransform(world));
+		}
+	}
+
+	// 並べ替えた順で前と違うものを数える（Submit と同じ数え方）
+	NullRenderBackend::Counters CountChanges(const RenderCommand* commands, size_t count)
+	{
+		NullRenderBackend::Counters counters = {};
+		for (size_t i = 0; i < count; i++)
+		{
+			const uint64_t key = commands[i].key;
+			const uint64_t previous = i > 0 ? commands[i - 1].key : 0;
+			if (i == 0 || RenderQueue::GetPass(key) != RenderQueue::GetPass(previous) ||
+				RenderQueue::GetState(key) != RenderQueue::GetState(previous))
+			{
+				counters.stateChanges++;
+			}
+			if (i == 0 || RenderQueue::GetMaterial(key) != RenderQueue::GetMaterial(previous))
+			{
+				counters.materialChanges++;
+			}
+			if (i == 0 || RenderQueue::GetMesh(key) != RenderQueue::GetMesh(previous))
+			{
+				counters.meshChanges++;
+			}
+			counters.draws++;
+		}
+		return counters;
+	}
+
+	bool IsSameCounters(const NullRenderBackend::Counters& a, const NullRenderBackend::Counters& b)
+	{
+		return a.stateChanges == b.stateChanges && a.materialChanges == b.materialChanges &&
+			a.meshChanges == b.meshChanges && a.draws == b.draws;
+	}
+
+	// キューを並べ替えて std::stable_sort の結果と比べる
+	int CheckSort(RenderQueue& queue, const std::vector<Source>& sources, const char* name)
+	{
+		Fill(queue, sources);
+		std::vector<RenderCommand> expected(queue.GetCommands(), queue.GetCommands() + queue.GetCommandCount());
+		std::stable_sort(expected.begin(), expected.end(), [](const RenderCommand& a, const RenderCommand& b)
+		{
+			return a.key < b.key;
+		});
+		queue.Sort();
+		bool isSame = queue.GetCommandCount() == expected.size();
+		for (size_t i = 0; i < expected.size() && isSame; i++)
+		{
+			isSame = queue.GetCommands()[i].key == expected[i].key && queue.GetCommands()[i].transform == expected[i].transform;
+		}
+		if (!isSame)
+		{
+			std::fprintf(stderr, "check failed: same order as std::stable_sort (%s)\n", name);
+			return 1;
+		}
+		return 0;
+	}
+
+	// 経過時間（ナノ秒）
+	double GetNanoseconds(Clock& clock, uint64_t begin)
+	{
+		return static_cast<double>(clock.GetCounter() - begin) * 1e9 / clock.GetFrequency();
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	size_t count = 100000;
+	int repeatCount = 20;
+	Options options = { 16, 256, 1024 };
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "-n" && i + 1 < argc)
+		{
+			count = static_cast<size_t>(std::max(std::atoll(argv[++i]), 1ll));
+		}
+		else if (arg == "-r" && i + 1 < argc)
+		{
+			repeatCount = std::max(std::atoi(argv[++i]), 1);
+		}
+		else if (arg == "-states" && i + 1 < argc)
+		{
+			options.states = static_cast<uint32_t>(std::min(std::max(std::atoi(argv[++i]), 1), static_cast<int>(RenderQueue::MAX_STATES)));
+		}
+		else if (arg == "-materials" && i + 1 < argc)
+		{
+			options.materials = static_cast<uint32_t>(std::min(std::max(std::atoi(argv[++i]), 1), static_cast<int>(RenderQueue::MAX_MATERIALS)));
+		}
+		else if (arg == "-meshes" && i + 1 < argc)
+		{
+			options.meshes = static_cast<uint32_t>(std::min(std::max(std::atoi(argv[++i]), 1), static_cast<int>(RenderQueue::MAX_MESHES)));
+		}
+		else
+		{
+			std::fprintf(stderr, "usage: RenderQueueBench [-n commands] [-r repeats] [-states n] [-materials n] [-meshes n]\n");
+			return 2;
+		}
+	}
+
+	int errors = 0;
+	uint32_t random = 2463534242u;
+	const std::vector<Source> sources = MakeSources(count, options, random);
+	RenderQueue queue;
+
+	// キーから取り出した値
+	bool isKeyIntact = true;
+	for (const Source& source : sources)
+	{
+		isKeyIntact = isKeyIntact && RenderQueue::GetPass(source.key) == source.pass &&
+			RenderQueue::GetState(source.key) == source.state && RenderQueue::GetMaterial(source.key) == source.material &&
+			RenderQueue::GetMesh(source.key) == source.mesh;
+	}
+	errors += Check(isKeyIntact, "key fields round-trip");
+
+	// 並べ替えの順（ランダム、全て同じキー、並べ替え済み、0 個と 1 個）
+	errors += CheckSort(queue, sources, "random");
+	errors += CheckSort(queue, std::vector<Source>(1000, sources[0]), "identical keys");
+	std::vector<Source> sorted = sources;
+	std::stable_sort(sorted.begin(), sorted.end(), [](const Source& a, const Source& b) { return a.key < b.key; });
+	errors += CheckSort(queue, sorted, "already sorted");
+	errors += CheckSort(queue, std::vector<Source>(), "empty");
+	errors += CheckSort(queue, std::vector<Source>(1, sources[0]), "single");
+
+	// 並べ替えた順の性質
+	Fill(queue, sources);
+	queue.Sort();
+	const RenderCommand* commands = queue.GetCommands();
+	bool isPassOrdered = true;
+	bool isAlphaBackToFront = true;
+	for (size_t i = 1; i < queue.GetCommandCount(); i++)
+	{
+		const RenderPass pass = RenderQueue::GetPass(commands[i].key);
+		const RenderPass previousPass = RenderQueue::GetPass(commands[i - 1].key);
+		isPassOrdered = isPassOrdered && previousPass <= pass;
+		if (pass == RENDER_PASS_ALPHA && previousPass == RENDER_PASS_ALPHA)
+		{
+			// ワールド行列は追加した順なので、番号がそのまま sources の番号
+			isAlphaBackToFront = isAlphaBackToFront &&
+				sources[commands[i - 1].transform].depth >= sources[commands[i].transform].depth;
+		}
+	}
+	errors += Check(isPassOrdered, "opaque before alpha");
+	errors += Check(isAlphaBackToFront, "alpha sorted back to front");
+
+	// 発行した回数（並べ替える前と後）
+	NullRenderBackend backend;
+	Fill(queue, sources);
+	queue.Submit(backend);
+	const NullRenderBackend::Counters unsorted = backend.GetCounters();
+	errors += Check(IsSameCounters(unsorted, CountChanges(queue.GetCommands(), queue.GetCommandCount())),
+		"unsorted counters match the command order");
+	queue.Sort();
+	backend.Reset();
+	queue.Submit(backend);
+	const NullRenderBackend::Counters& counters = backend.GetCounters();
+	const RenderQueue::Statistics& statistics = queue.GetStatistics();
+	errors += Check(IsSameCounters(counters, CountChanges(queue.GetCommands(), queue.GetCommandCount())),
+		"sorted counters match the command order");
+	errors += Check(statistics.draws == counters.draws && statistics.stateChanges == counters.stateChanges &&
+		statistics.materialChanges == counters.materialChanges && statistics.meshChanges == counters.meshChanges,
+		"statistics match backend counters");
+	std::printf("%zu commands, %u states, %u materials, %u meshes\n", count, options.states, options.materials, options.meshes);
+	std::printf("unsorted: %u state, %u material, %u mesh changes, %u draws\n",
+		unsorted.stateChanges, unsorted.materialChanges, unsorted.meshChanges, unsorted.draws);
+	std::printf("sorted:   %u state, %u material, %u mesh changes, %u draws\n",
+		counters.stateChanges, counters.materialChanges, counters.meshChanges, counters.draws);
+
+	// 時間（追加、基数ソート、std::stable_sort、発行）
+	Clock& clock = GetDefaultClock();
+	double fillTime = 0.0;
+	double sortTime = 0.0;
+	double stableSortTime = 0.0;
+	double submitTime = 0.0;
+	const uint64_t checksum = backend.GetChecksum();
+	bool isChecksumSame = true;
+	std::vector<RenderCommand> copy;
+	for (int r = 0; r < repeatCount; r++)
+	{
+		uint64_t begin = clock.GetCounter();
+		Fill(queue, sources);
+		fillTime += GetNanoseconds(clock, begin);
+
+		copy.assign(queue.GetCommands(), queue.GetCommands() + queue.GetCommandCount());
+		begin = clock.GetCounter();
+		std::stable_sort(copy.begin(), copy.end(), [](const RenderCommand& a, const RenderCommand& b) { return a.key < b.key; });
+		stableSortTime += GetNanoseconds(clock, begin);
+
+		begin = clock.GetCounter();
+		queue.Sort();
+		sortTime += GetNanoseconds(clock, begin);
+
+		backend.Reset();
+		begin = clock.GetCounter();
+		queue.Submit(backend);
+		submitTime += GetNanoseconds(clock, begin);
+		isChecksumSame = isChecksumSame && backend.GetChecksum() == checksum;
+	}
+	const double perCommand = 1.0 / (static_cast<double>(count) * repeatCount);
+	std::printf("add         %6.2f ns/command\n", fillTime * perCommand);
+	std::printf("sort        %6.2f ns/command (std::stable_sort %.2f ns, %.2fx)\n", sortTime * perCommand,
+		stableSortTime * perCommand, stableSortTime / sortTime);
+	std::printf("submit      %6.2f ns/command (checksum %016llx)\n", submitTime * perCommand,
+		static_cast<unsigned long long>(checksum));
+	errors += Check(isChecksumSame, "every submit issues the same calls");
+
+	if (errors > 0)
+	{
+		std::fprintf(stderr, "%d checks failed\n", errors);
+		return 1;
+	}
+	std::printf("checks: ok\n");
+	return 0;
+}
@@ -0,0 +1,177 @@
+﻿/// <summary>
+/// DX::StepTimer の Tick を FakeClock で進めて確かめるコマンドラインツール
+///
+/// 使い方: StepTimerCheck
+/// 手で進める時計で次の場合の Update の回数・捨てた時間・補間の割合を確かめる
+/// ・通常のフレーム（固定ステップと可変ステップ）
+/// ・最大の経過時間を超える停止（0.1 秒に丸められる）
+/// ・１回の Tick で追いつける回数を超えた遅れ（まとめて捨て、端数は補間に残す）
+/// ・30 Hz の更新を 60 Hz の描画で回す
+/// 確かめた結果が合わなければ 1 を返す
+///
+/// Windows 以外では次のようにビルドする
+///   g++ -std=c++14 -O2 -I../../GameEngineTK Main.cpp ../../GameEngineTK/Clock.cpp
+///       ../../GameEngineTK/FrameStats.cpp ../../GameEngineTK/FileSystem.cpp -o StepTimerCheck
+/// </summary>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+
+#include "Clock.h"
+#include "StepTimer.h"
+
+namespace
+{
+	// 60 Hz の１ステップ（StepTimer と同じく切り捨て）
+	const uint64_t STEP_60HZ = DX::StepTimer::TicksPerSecond / 60;
+	// 30 Hz の１ステップ
+	const uint64_t STEP_30HZ = DX::StepTimer::TicksPerSecond / 30;
+	// StepTimer が丸める最大の経過時間（0.1 秒）
+	const uint64_t MAX_DELTA = DX::StepTimer::TicksPerSecond / 10;
+
+	// 確かめた結果を表示して数える
+	int Check(bool condition, const char* name)
+	{
+		if (!condition)
+		{
+			std::fprintf(stderr, "check failed: %s\n", name);
+			return 1;
+		}
+		return 0;
+	}
+
+	// 時計を進めて Tick し、Update が呼ばれた回数を返す
+	int Tick(DX::StepTimer& timer, FakeClock& clock, uint64_t ticks)
+	{
+		clock.Advance(ticks);
+		int updateCount = 0;
+		timer.Tick([&updateCount]() { updateCount++; });
+		return updateCount;
+	}
+
+	bool IsNear(double value, double expected)
+	{
+		return std::fabs(value - expected) < 1e-9;
+	}
+}
+
+int main(int argc, char*[])
+{
+	if (argc > 1)
+	{
+		std::fprintf(stderr, "usage: StepTimerCheck\n");
+		return 2;
+	}
+
+	// FakeClock の既定の周波数は StepTimer の刻みと同じなので、時計の値がそのまま刻みになる
+	int errors = 0;
+
+	// 通常のフレーム（固定ステップ）: ちょうど１ステップ進めれば１回、端数なし
+	{
+		FakeClock clock;
+		DX::StepTimer timer(clock);
+		timer.SetFixedTimeStep(true);
+		timer.SetTargetElapsedTicks(STEP_60HZ);
+		bool isOnePerFrame = true;
+		for (int frame = 0; frame < 120; frame++)
+		{
+			isOnePerFrame = isOnePerFrame && Tick(timer, clock, STEP_60HZ) == 1;
+		}
+		errors += Check(isOnePerFrame, "fixed step: one update per frame");
+		errors += Check(timer.GetFrameCount() == 120 && timer.GetTotalTicks() == 120 * STEP_60HZ, "fixed step: total time");
+		errors += Check(IsNear(timer.GetInterpolationAlpha(), 0.0) && timer.GetDroppedTicks() == 0, "fixed step: no leftover");
+
+		// 1/4 ミリ秒未満のずれはステップに丸められる（端数が溜まらない）
+		const int updateCount = Tick(timer, clock, STEP_60HZ + 2000);
+		errors += Check(updateCount == 1 && IsNear(timer.GetInterpolationAlpha(), 0.0), "fixed step: small jitter is snapped");
+	}
+
+	// 通常のフレーム（可変ステップ）: 進めた分だけ経過する
+	{
+		FakeClock clock;
+		DX::StepTimer timer(clock);
+		const int updateCount = Tick(timer, clock, 123456);
+		errors += Check(updateCount == 1 && timer.GetElapsedTicks() == 123456, "variable step: elapsed time");
+		errors += Check(IsNear(timer.GetInterpolationAlpha(), 1.0), "variable step: alpha is 1");
+	}
+
+	// 最大の経過時間を超える停止: 0.1 秒に丸め、その分だけ追いつく
+	{
+		FakeClock clock;
+		DX::StepTimer timer(clock);
+		timer.SetFixedTimeStep(true);
+		timer.SetTargetElapsedTicks(STEP_60HZ);
+		const int updateCount = Tick(timer, clock, 2 * DX::StepTimer::TicksPerSecond);
+		errors += Check(timer.GetLastTickDelta() == MAX_DELTA, "hitch: delta clamped to max");
+		errors += Check(updateCount == static_cast<int>(MAX_DELTA / STEP_60HZ), "hitch: catch-up update count");
+		errors += Check(timer.GetTotalTicks() == (MAX_DELTA / STEP_60HZ) * STEP_60HZ, "hitch: total time");
+		errors += Check(timer.GetDroppedTicks() == 0, "hitch: nothing dropped without a budget");
+		errors += Check(IsNear(timer.GetInterpolationAlpha(), static_cast<double>(MAX_DELTA % STEP_60HZ) / STEP_60HZ),
+			"hitch: leftover kept for interpolation");
+
+		// 可変ステップでも丸められる
+		FakeClock variableClock;
+		DX::StepTimer variableTimer(variableClock);
+		Tick(variableTimer, variableClock, 2 * DX::StepTimer::TicksPerSecond);
+		errors += Check(variableTimer.GetElapsedTicks() == MAX_DELTA, "hitch: variable step clamped");
+	}
+
+	// 追いつける回数を超えた遅れ: 上限まで更新し、残りの整数ステップを捨てて端数を残す
+	{
+		FakeClock clock;
+		DX::StepTimer timer(clock);
+		timer.SetFixedTimeStep(true);
+		timer.SetTargetElapsedTicks(STEP_60HZ);
+		timer.SetMaxUpdatesPerTick(2);
+		const uint64_t delay = 90 * DX::StepTimer::TicksPerSecond / 1000;
+		const int updateCount = Tick(timer, clock, delay);
+		const uint64_t remainder = delay % STEP_60HZ;
+		errors += Check(updateCount == 2, "budget: updates limited");
+		errors += Check(timer.GetDroppedTicks() == delay - remainder - 2 * STEP_60HZ, "budget: whole steps dropped");
+		errors += Check(timer.GetTotalTicks() == 2 * STEP_60HZ, "budget: dropped time is not simulated");
+		const double alpha = static_cast<double>(remainder) / STEP_60HZ;
+		errors += Check(IsNear(timer.GetInterpolationAlpha(), alpha), "budget: fraction kept for interpolation");
+
+		// 次の通常のフレームは１回だけ更新し、補間の割合は変わらない
+		const uint64_t dropped = timer.GetDroppedTicks();
+		errors += Check(Tick(timer, clock, STEP_60HZ) == 1, "budget: next frame updates once");
+		errors += Check(IsNear(timer.GetInterpolationAlpha(), alpha) && timer.GetDroppedTicks() == dropped,
+			"budget: alpha after drop");
+	}
+
+	// 30 Hz の更新を 60 Hz の描画で回す: ２フレームに１回更新し、間のフレームは半分まで補間する
+	{
+		FakeClock clock;
+		DX::StepTimer timer(clock);
+		timer.SetFixedTimeStep(true);
+		timer.SetTargetElapsedTicks(STEP_30HZ);
+		int totalUpdates = 0;
+		bool isAlternating = true;
+		bool isAlphaHalfway = true;
+		uint64_t now = 0;
+		for (int frame = 1; frame <= 600; frame++)
+		{
+			// 60 Hz の時刻を丸めて進める（1/60 秒は刻みで割り切れない）
+			const uint64_t next = frame * DX::StepTimer::TicksPerSecond / 60;
+			const int updateCount = Tick(timer, clock, next - now);
+			now = next;
+			totalUpdates += updateCount;
+			isAlternating = isAlternating && updateCount == (frame % 2 == 0 ? 1 : 0);
+			const double alpha = timer.GetInterpolationAlpha();
+			isAlphaHalfway = isAlphaHalfway && alpha >= 0.0 && alpha < 1.0 &&
+				std::fabs(alpha - (frame % 2 == 0 ? 0.0 : 0.5)) < 1e-3;
+		}
+		errors += Check(totalUpdates == 300, "30 Hz step: update count over 10 seconds");
+		errors += Check(isAlternating, "30 Hz step: one update every other frame");
+		errors += Check(isAlphaHalfway, "30 Hz step: alpha 0.5 on the frames between updates");
+		errors += Check(timer.GetElapsedTicks() == STEP_30HZ && timer.GetDroppedTicks() == 0, "30 Hz step: step length");
+	}
+
+	if (errors > 0)
+	{
+		std::fprintf(stderr, "%d checks failed\n", errors);
+		return 1;
+	}
+	std::printf("checks: ok\n");
+	return 0;
+}
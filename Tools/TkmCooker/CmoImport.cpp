@@ -0,0 +1,96 @@
+﻿#include "CmoImport.h"
+
+namespace
+{
+	// マテリアルの無いメッシュに使う既定のマテリアル
+	CookMaterial GetDefaultMaterial()
+	{
+		CookMaterial material;
+		material.name = L"Default";
+		for (int i = 0; i < 3; i++)
+		{
+			material.diffuse[i] = 0.8f;
+			material.ambient[i] = 0.2f;
+			material.specular[i] = 0.0f;
+			material.emissive[i] = 0.0f;
+		}
+		material.diffuse[3] = 1.0f;
+		material.specularPower = 1.0f;
+		return material;
+	}
+
+	CookMaterial ImportMaterial(const CmoMaterialInfo& info)
+	{
+		CookMaterial material;
+		material.name = info.name.ToWString();
+		material.texture = info.textures[0].ToWString();
+		for (int i = 0; i < 3; i++)
+		{
+			material.diffuse[i] = info.material.diffuse[i];
+			material.ambient[i] = info.material.ambient[i];
+			material.specular[i] = info.material.specular[i];
+			material.emissive[i] = info.material.emissive[i];
+		}
+		material.diffuse[3] = info.material.diffuse[3];
+		material.specularPower = info.material.specularPower;
+		return material;
+	}
+}
+
+void ImportCmo(const CmoReader& reader, CookModel& model)
+{
+	for (const CmoMesh& cmoMesh : reader.GetMeshes())
+	{
+		// マテリアルはファイル全体で１つの配列にまとめる
+		const uint32_t materialBase = static_cast<uint32_t>(model.materials.size());
+		if (cmoMesh.materials.empty())
+		{
+			model.materials.push_back(GetDefaultMaterial());
+		}
+		for (const CmoMaterialInfo& info : cmoMesh.materials)
+		{
+			model.materials.push_back(ImportMaterial(info));
+		}
+
+		CookMesh mesh;
+		mesh.name = cmoMesh.name.ToWString();
+
+		for (uint32_t s = 0; s < cmoMesh.submeshes.count; s++)
+		{
+			const CmoSubMesh submesh = cmoMesh.submeshes.Get(s);
+			const CmoArray<uint16_t>& ib = cmoMesh.indexBuffers[submesh.indexBufferIndex];
+			const CmoArray<CmoVertex>& vb = cmoMesh.vertexBuffers[submesh.vertexBufferIndex];
+
+			CookPart part;
+			part.materialIndex = materialBase + submesh.materialIndex;
+
+			// 元の頂点番号からパーツ内の頂点番号へ
+			std::vector<int32_t> remap(vb.count, -1);
+			const uint32_t end = submesh.startIndex + submesh.primCount * 3;
+			part.indices.reserve(submesh.primCount * 3);
+			for (uint32_t i = submesh.startIndex; i < end; i++)
+			{
+				const uint16_t index = ib.Get(i);
+				if (remap[index] < 0)
+				{
+					remap[index] = static_cast<int32_t>(part.vertices.size());
+
+					const CmoVertex source = vb.Get(index);
+					CookVertex vertex;
+					for (int k = 0; k < 3; k++)
+					{
+						vertex.position[k] = source.position[k];
+						vertex.normal[k] = source.normal[k];
+					}
+					vertex.color = source.color;
+					vertex.texcoord[0] = source.textureCoordinate[0];
+					vertex.texcoord[1] = source.textureCoordinate[1];
+					part.vertices.push_back(vertex);
+				}
+				part.indices.push_back(static_cast<uint32_t>(remap[index]));
+			}
+			mesh.parts.push_back(std::move(part));
+		}
+		model.meshes.push_back(std::move(mesh));
+	}
+}
@@ -0,0 +1,10 @@
+﻿/// <summary>
+/// CMO からクッカー内部の表現への変換
+/// </summary>
+#pragma once
+
+#include "CmoReader.h"
+#include "CookModel.h"
+
+// サブメッシュごとに参照される頂点だけを取り出してパーツにする
+void ImportCmo(const CmoReader& reader, CookModel& model);
@@ -0,0 +1,53 @@
+﻿/// <summary>
+/// クッカー内部でのモデルの表現
+/// </summary>
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// 頂点（量子化前）
+struct CookVertex
+{
+	float position[3];
+	float normal[3];
+	uint32_t color;
+	float texcoord[2];
+};
+
+// パーツ（参照する頂点だけを持つ）
+struct CookPart
+{
+	uint32_t materialIndex;
+	std::vector<CookVertex> vertices;
+	std::vector<uint32_t> indices;
+};
+
+// マテリアル
+struct CookMaterial
+{
+	std::wstring name;
+	std::wstring texture;
+	float diffuse[4];
+	float ambient[3];
+	float specular[3];
+	float specularPower;
+	float emissive[3];
+};
+
+// メッシュ
+struct CookMesh
+{
+	std::wstring name;
+	std::vector<CookPart> parts;
+};
+
+// モデル
+struct CookModel
+{
+	std::vector<CookMesh> meshes;
+	std::vector<CookMaterial> materials;
+	// 簡略化で生じた誤差（モデル空間の長さ）
+	float geometricError = 0.0f;
+};
@@ -0,0 +1,278 @@
+﻿/// <summary>
+/// CMO を TKM に変換するコマンドラインツール
+///
+/// 使い方: TkmCooker [-o 出力フォルダ] [-j スレッド数] [-lod 割合,...] 入力.cmo または入力フォルダ...
+/// 出力ファイル名は入力の拡張子を .tkm に変えたもの
+/// フォルダを指定するとその中（サブフォルダを含む）の .cmo を全て変換する
+/// -lod を指定すると、三角形数をそれぞれの割合に減らした詳細度を 名前_lod1.tkm から順に書き出し
+/// 詳細度ごとの誤差（ヘッダーにも書き、Obj3d::AddLodLevel(ファイル名) はその値を使う）を表示する
+/// 三角形と頂点は頂点キャッシュとオーバードローに合わせて並べ替え、前後の ACMR / ATVR を表示する
+///
+/// Windows 以外では次のようにビルドする
+///   g++ -std=c++14 -O2 -pthread -I../../GameEngineTK *.cpp ../../GameEngineTK/CmoReader.cpp
+///       ../../GameEngineTK/FileSystem.cpp ../../GameEngineTK/TkmReader.cpp -o TkmCooker
+/// </summary>
+#include <algorithm>
+#include <atomic>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cwctype>
+#include <iterator>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "CmoImport.h"
+#include "CmoReader.h"
+#include "FileSystem.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "TkmReader.h"
+#include "TkmWriter.h"
+
+namespace
+{
+	// 効率を表示するときの FIFO の頂点キャッシュの大きさ
+	const size_t ANALYZE_CACHE_SIZE = 16;
+
+	// 複数のスレッドから表示しても行が混ざらないようにする
+	std::mutex g_printMutex;
+
+	void Print(FILE* stream, const char* format, ...)
+	{
+		std::lock_guard<std::mutex> lock(g_printMutex);
+		va_list args;
+		va_start(args, format);
+		std::vfprintf(stream, format, args);
+		va_end(args);
+	}
+
+	// 拡張子が .cmo か
+	bool IsCmoFile(const std::wstring& path)
+	{
+		if (path.size() < 4)
+		{
+			return false;
+		}
+		std::wstring extension = path.substr(path.size() - 4);
+		std::transform(extension.begin(), extension.end(), extension.begin(), [](wchar_t c) { return static_cast<wchar_t>(std::towlower(c)); });
+		return extension == L".cmo";
+	}
+
+	// 詳細度の割合をカンマ区切りで読む（0 より大きく 1 未満で、大きい順）
+	bool ParseRatios(const std::string& text, std::vector<float>& ratios)
+	{
+		size_t begin = 0;
+		while (begin <= text.size())
+		{
+			size_t end = text.find(',', begin);
+			end = end == std::string::npos ? text.size() : end;
+			const std::string item = text.substr(begin, end - begin);
+			char* last = nullptr;
+			const float ratio = std::strtof(item.c_str(), &last);
+			if (item.empty() || *last != '\0' || !(ratio > 0.0f && ratio < 1.0f) || (!ratios.empty() && ratio >= ratios.back()))
+			{
+				return false;
+			}
+			ratios.push_back(ratio);
+			begin = end + 1;
+		}
+		return !ratios.empty();
+	}
+
+	// 出力ファイル名を作る（suffix は拡張子の前に付ける）
+	std::wstring GetOutputPath(const std::wstring& input, const std::wstring& outputDirectory, const std::wstring& suffix)
+	{
+		std::wstring path = input;
+		size_t separator = path.find_last_of(L"/\\");
+		size_t dot = path.find_last_of(L'.');
+		if (dot != std::wstring::npos && (separator == std::wstring::npos || dot > separator))
+		{
+			path.erase(dot);
+		}
+		path += suffix + L".tkm";
+
+		if (!outputDirectory.empty())
+		{
+			std::wstring name = separator == std::wstring::npos ? path : path.substr(separator + 1);
+			path = outputDirectory + L"/" + name;
+		}
+		return path;
+	}
+
+	// モデル全体の頂点キャッシュの効率
+	VertexCacheStatistics AnalyzeModel(const CookModel& model)
+	{
+		VertexCacheStatistics statistics = {};
+		for (const CookMesh& mesh : model.meshes)
+		{
+			for (const CookPart& part : mesh.parts)
+			{
+				AnalyzeVertexCache(part.indices, part.vertices.size(), ANALYZE_CACHE_SIZE, statistics);
+			}
+		}
+		return statistics;
+	}
+
+	// 書き出して、読めることを確かめる
+	bool Write(const CookModel& model, const std::wstring& output, std::vector<uint8_t>& file, TkmReader& check)
+	{
+		WriteTkm(model, file);
+		if (!check.Parse(file.data(), file.size()))
+		{
+			Print(stderr, "%s: internal error: %s\n", ToUtf8(output).c_str(), check.GetError().c_str());
+			return false;
+		}
+		if (!WriteWholeFile(output, file.data(), file.size()))
+		{
+			Print(stderr, "%s: cannot write\n", ToUtf8(output).c_str());
+			return false;
+		}
+		return true;
+	}
+
+	// １つのファイルを変換する
+	bool Cook(const std::wstring& input, const std::wstring& outputDirectory, const std::vector<float>& lodRatios)
+	{
+		CmoReader reader;
+		if (!reader.Open(input))
+		{
+			Print(stderr, "%s: %s\n", ToUtf8(input).c_str(), reader.GetError().c_str());
+			return false;
+		}
+
+		// TKM は静的なメッシュだけを扱う
+		for (const CmoMesh& mesh : reader.GetMeshes())
+		{
+			if (mesh.hasSkeleton || !mesh.skinningVertexBuffers.empty())
+			{
+				Print(stderr, "%s: warning: skinning data is not supported and was dropped\n", ToUtf8(input).c_str());
+				break;
+			}
+		}
+
+		CookModel model;
+		ImportCmo(reader, model);
+
+		// 実行時の負担なしに GPU の仕事を減らせるように並べ替える
+		const VertexCacheStatistics before = AnalyzeModel(model);
+		OptimizeModel(model);
+		const VertexCacheStatistics after = AnalyzeModel(model);
+
+		const std::wstring output = GetOutputPath(input, outputDirectory, L"");
+		std::vector<uint8_t> file;
+		TkmReader check;
+		if (!Write(model, output, file, check))
+		{
+			return false;
+		}
+
+		const TkmHeader header = check.GetHeader();
+		Print(stdout, "%s -> %s: %zu -> %zu bytes (%.1f%%), %u meshes, %u parts, %u vertices, %u indices (%s)\n",
+			ToUtf8(input).c_str(), ToUtf8(output).c_str(),
+			reader.GetSize(), file.size(), 100.0 * file.size() / reader.GetSize(),
+			header.meshCount, header.partCount, header.vertexCount, header.indexCount,
+			(header.flags & TKM_FLAG_INDEX32) ? "32bit" : "16bit");
+		Print(stdout, "%s: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", ToUtf8(output).c_str(),
+			before.GetAcmr(), after.GetAcmr(), before.GetAtvr(), after.GetAtvr());
+
+		// 詳細度
+		if (lodRatios.empty())
+		{
+			return true;
+		}
+		std::vector<CookModel> levels;
+		std::vector<float> errors;
+		SimplifyModel(model, lodRatios, levels, errors);
+		for (size_t i = 0; i < levels.size(); i++)
+		{
+			OptimizeModel(levels[i]);
+			const std::wstring lodOutput = GetOutputPath(input, outputDirectory, L"_lod" + std::to_wstring(i + 1));
+			if (!Write(levels[i], lodOutput, file, check))
+			{
+				return false;
+			}
+			Print(stdout, "%s: ratio %.3f, %u -> %u triangles, %u vertices, error %g, ACMR %.3f\n",
+				ToUtf8(lodOutput).c_str(), lodRatios[i], header.indexCount / 3, check.GetHeader().indexCount / 3,
+				check.GetHeader().vertexCount, errors[i], AnalyzeModel(levels[i]).GetAcmr());
+		}
+		return true;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	std::wstring outputDirectory;
+	std::vector<float> lodRatios;
+	unsigned threadCount = std::thread::hardware_concurrency();
+	std::vector<std::wstring> inputs;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "-o" && i + 1 < argc)
+		{
+			outputDirectory = FromUtf8(argv[++i]);
+		}
+		else if (arg == "-j" && i + 1 < argc)
+		{
+			threadCount = static_cast<unsigned>(std::max(std::atoi(argv[++i]), 1));
+		}
+		else if (arg == "-lod" && i + 1 < argc)
+		{
+			if (!ParseRatios(argv[++i], lodRatios))
+			{
+				std::fprintf(stderr, "-lod: expected decreasing ratios between 0 and 1, e.g. 0.5,0.25\n");
+				return 2;
+			}
+		}
+		else if (IsDirectory(FromUtf8(arg)))
+		{
+			// フォルダは中の .cmo を全て変換する
+			std::vector<std::wstring> files;
+			if (!ListFiles(FromUtf8(arg), files))
+			{
+				std::fprintf(stderr, "%s: cannot list directory\n", arg.c_str());
+				return 1;
+			}
+			std::copy_if(files.begin(), files.end(), std::back_inserter(inputs), IsCmoFile);
+		}
+		else
+		{
+			inputs.push_back(FromUtf8(arg));
+		}
+	}
+
+	if (inputs.empty())
+	{
+		std::fprintf(stderr, "usage: TkmCooker [-o output_directory] [-j threads] [-lod ratio,...] input.cmo|directory...\n");
+		return 2;
+	}
+
+	// ファイルごとに空いているスレッドで変換する
+	std::atomic<size_t> nextInput(0);
+	std::atomic<int> failedCount(0);
+	auto work = [&]()
+	{
+		for (size_t i = nextInput++; i < inputs.size(); i = nextInput++)
+		{
+			if (!Cook(inputs[i], outputDirectory, lodRatios))
+			{
+				failedCount++;
+			}
+		}
+	};
+	threadCount = std::max(1u, std::min(threadCount, static_cast<unsigned>(inputs.size())));
+	std::vector<std::thread> threads;
+	for (unsigned i = 1; i < threadCount; i++)
+	{
+		threads.emplace_back(work);
+	}
+	work();
+	for (std::thread& thread : threads)
+	{
+		thread.join();
+	}
+	return failedCount == 0 ? 0 : 1;
+}
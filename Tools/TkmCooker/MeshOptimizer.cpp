@@ -0,0 +1,363 @@
+﻿#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	// 並べ替えで想定する頂点キャッシュの大きさ
+	const int CACHE_SIZE = 32;
+	// 効率を測る FIFO キャッシュの大きさ（多くの GPU に近い）
+	const size_t FIFO_CACHE_SIZE = 16;
+	// Forsyth の方法の重み
+	const float CACHE_DECAY_POWER = 1.5f;
+	const float LAST_TRIANGLE_SCORE = 0.75f;
+	const float VALENCE_BOOST_SCALE = 2.0f;
+	const float VALENCE_BOOST_POWER = 0.5f;
+	// 無効な番号
+	const uint32_t INVALID_INDEX = 0xFFFFFFFF;
+
+	// 頂点のスコア（キャッシュ内の位置 cachePosition と、まだ描画していない三角形の数 remaining から求める）
+	float GetVertexScore(int cachePosition, uint32_t remaining)
+	{
+		if (remaining == 0)
+		{
+			return -1.0f;
+		}
+		float score = 0.0f;
+		if (cachePosition >= 0)
+		{
+			if (cachePosition < 3)
+			{
+				// 直前の三角形の頂点は、同じ三角形を続けて選ばないように少し下げる
+				score = LAST_TRIANGLE_SCORE;
+			}
+			else
+			{
+				const float scale = 1.0f / (CACHE_SIZE - 3);
+				score = std::pow(1.0f - (cachePosition - 3) * scale, CACHE_DECAY_POWER);
+			}
+		}
+		// 残りの三角形が少ない頂点を先に片付ける
+		score += VALENCE_BOOST_SCALE * std::pow(static_cast<float>(remaining), -VALENCE_BOOST_POWER);
+		return score;
+	}
+
+	// FIFO キャッシュで三角形ごとのキャッシュミスの数を求める
+	void SimulateFifo(const std::vector<uint32_t>& indices, size_t vertexCount, size_t cacheSize, std::vector<uint8_t>& misses)
+	{
+		// 頂点がキャッシュに入った時刻で、残っているかを判定する
+		std::vector<size_t> timestamps(vertexCount, 0);
+		size_t time = cacheSize + 1;
+		const size_t triangleCount = indices.size() / 3;
+		misses.assign(triangleCount, 0);
+		for (size_t t = 0; t < triangleCount; t++)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				const uint32_t index = indices[t * 3 + k];
+				if (time - timestamps[index] > cacheSize)
+				{
+					timestamps[index] = time++;
+					misses[t]++;
+				}
+			}
+		}
+	}
+}
+
+void AnalyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount, size_t cacheSize,
+	VertexCacheStatistics& statistics)
+{
+	std::vector<uint8_t> misses;
+	SimulateFifo(indices, vertexCount, cacheSize, misses);
+	std::vector<uint8_t> isUsed(vertexCount, 0);
+	for (uint32_t index : indices)
+	{
+		statistics.vertexCount += isUsed[index] ? 0 : 1;
+		isUsed[index] = 1;
+	}
+	for (uint8_t miss : misses)
+	{
+		statistics.transformedCount += miss;
+	}
+	statistics.triangleCount += misses.size();
+}
+
+void OptimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount)
+{
+	const size_t triangleCount = indices.size() / 3;
+	if (triangleCount == 0)
+	{
+		return;
+	}
+
+	// 頂点ごとの三角形の一覧（先頭 remaining[v] 個がまだ描画していないもの）
+	std::vector<uint32_t> remaining(vertexCount, 0);
+	for (size_t i = 0; i < triangleCount * 3; i++)
+	{
+		remaining[indices[i]]++;
+	}
+	std::vector<uint32_t> offsets(vertexCount + 1, 0);
+	for (size_t v = 0; v < vertexCount; v++)
+	{
+		offsets[v + 1] = offsets[v] + remaining[v];
+	}
+	std::vector<uint32_t> adjacency(triangleCount * 3);
+	{
+		std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+		for (size_t i = 0; i < triangleCount * 3; i++)
+		{
+			adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+		}
+	}
+
+	std::vector<float> vertexScores(vertexCount);
+	for (size_t v = 0; v < vertexCount; v++)
+	{
+		vertexScores[v] = GetVertexScore(-1, remaining[v]);
+	}
+	std::vector<float> triangleScores(triangleCount);
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		triangleScores[t] = vertexScores[indices[t * 3]] + vertexScores[indices[t * 3 + 1]] + vertexScores[indices[t * 3 + 2]];
+	}
+
+	std::vector<uint8_t> isEmitted(triangleCount, 0);
+	std::vector<uint32_t> result;
+	result.reserve(triangleCount * 3);
+	// キャッシュ（LRU、新しい順）。追加した直後は最大 3 つはみ出す
+	std::vector<uint32_t> cache;
+	std::vector<uint32_t> newCache;
+	cache.reserve(CACHE_SIZE + 3);
+	newCache.reserve(CACHE_SIZE + 3);
+
+	size_t nextInputTriangle = 0;
+	uint32_t best = 0;
+	while (true)
+	{
+		isEmitted[best] = 1;
+		const uint32_t* triangle = &indices[best * 3];
+		result.insert(result.end(), triangle, triangle + 3);
+
+		// 描画した三角形の頂点をキャッシュの先頭に入れ、残りを後ろにずらす
+		newCache.assign(triangle, triangle + 3);
+		for (uint32_t vertex : cache)
+		{
+			if (vertex != triangle[0] && vertex != triangle[1] && vertex != triangle[2])
+			{
+				newCache.push_back(vertex);
+			}
+		}
+		cache.swap(newCache);
+
+		// 頂点の一覧から描画した三角形を外す
+		for (int k = 0; k < 3; k++)
+		{
+			const uint32_t vertex = triangle[k];
+			uint32_t* list = &adjacency[offsets[vertex]];
+			for (uint32_t i = 0; i < remaining[vertex]; i++)
+			{
+				if (list[i] == best)
+				{
+					std::swap(list[i], list[remaining[vertex] - 1]);
+					remaining[vertex]--;
+					break;
+				}
+			}
+		}
+
+		// キャッシュ内の頂点のスコアを更新し、それらを使う三角形から次を選ぶ
+		for (size_t i = 0; i < cache.size(); i++)
+		{
+			const uint32_t vertex = cache[i];
+			const int position = i < CACHE_SIZE ? static_cast<int>(i) : -1;
+			const float score = GetVertexScore(position, remaining[vertex]);
+			const float delta = score - vertexScores[vertex];
+			vertexScores[vertex] = score;
+			for (uint32_t j = 0; j < remaining[vertex]; j++)
+			{
+				triangleScores[adjacency[offsets[vertex] + j]] += delta;
+			}
+		}
+		if (cache.size() > CACHE_SIZE)
+		{
+			cache.resize(CACHE_SIZE);
+		}
+
+		float bestScore = -1.0f;
+		best = INVALID_INDEX;
+		for (uint32_t vertex : cache)
+		{
+			for (uint32_t j = 0; j < remaining[vertex]; j++)
+			{
+				const uint32_t t = adjacency[offsets[vertex] + j];
+				if (triangleScores[t] > bestScore)
+				{
+					bestScore = triangleScores[t];
+					best = t;
+				}
+			}
+		}
+
+		// キャッシュから続けられなければ、入力順で次のまだ描画していない三角形から始める
+		if (best == INVALID_INDEX)
+		{
+			while (nextInputTriangle < triangleCount && isEmitted[nextInputTriangle])
+			{
+				nextInputTriangle++;
+			}
+			if (nextInputTriangle == triangleCount)
+			{
+				break;
+			}
+			best = static_cast<uint32_t>(nextInputTriangle);
+		}
+	}
+	indices.swap(result);
+}
+
+void OptimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<CookVertex>& vertices, float threshold)
+{
+	const size_t triangleCount = indices.size() / 3;
+	if (triangleCount == 0)
+	{
+		return;
+	}
+
+	// 全ての頂点がキャッシュミスになる三角形で区切ってまとまりにする
+	std::vector<uint8_t> misses;
+	SimulateFifo(indices, vertices.size(), FIFO_CACHE_SIZE, misses);
+	size_t totalMisses = 0;
+	for (uint8_t miss : misses)
+	{
+		totalMisses += miss;
+	}
+	const float acmr = static_cast<float>(totalMisses) / triangleCount;
+
+	// まとまりの途中でも、そこまでの ACMR が全体の threshold 倍以下ならミスの多い三角形で区切る
+	std::vector<uint32_t> clusters;
+	size_t clusterMisses = 0;
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		const size_t clusterSize = clusters.empty() ? 0 : t - clusters.back();
+		const bool isHardBoundary = misses[t] == 3;
+		const bool isSoftBoundary = misses[t] >= 2 && clusterSize > 0
+			&& static_cast<float>(clusterMisses) / clusterSize <= acmr * threshold;
+		if (clusters.empty() || isHardBoundary || isSoftBoundary)
+		{
+			clusters.push_back(static_cast<uint32_t>(t));
+			clusterMisses = 0;
+		}
+		clusterMisses += misses[t];
+	}
+	const size_t clusterCount = clusters.size();
+	clusters.push_back(static_cast<uint32_t>(triangleCount));
+
+	// モデルの中心（面積で重み付け）
+	double meshCenter[3] = { 0.0, 0.0, 0.0 };
+	double meshArea = 0.0;
+	std::vector<double> centers(clusterCount * 3, 0.0);
+	std::vector<double> normals(clusterCount * 3, 0.0);
+	std::vector<double> areas(clusterCount, 0.0);
+	for (size_t c = 0; c < clusterCount; c++)
+	{
+		for (uint32_t t = clusters[c]; t < clusters[c + 1]; t++)
+		{
+			const float* p0 = vertices[indices[t * 3]].position;
+			const float* p1 = vertices[indices[t * 3 + 1]].position;
+			const float* p2 = vertices[indices[t * 3 + 2]].position;
+			double e1[3];
+			double e2[3];
+			for (int i = 0; i < 3; i++)
+			{
+				e1[i] = p1[i] - p0[i];
+				e2[i] = p2[i] - p0[i];
+			}
+			const double normal[3] =
+			{
+				e1[1] * e2[2] - e1[2] * e2[1],
+				e1[2] * e2[0] - e1[0] * e2[2],
+				e1[0] * e2[1] - e1[1] * e2[0],
+			};
+			const double area = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+			for (int i = 0; i < 3; i++)
+			{
+				const double center = (p0[i] + p1[i] + p2[i]) / 3.0;
+				centers[c * 3 + i] += center * area;
+				meshCenter[i] += center * area;
+				normals[c * 3 + i] += normal[i];
+			}
+			areas[c] += area;
+			meshArea += area;
+		}
+	}
+	for (int i = 0; i < 3; i++)
+	{
+		meshCenter[i] = meshArea > 0.0 ? meshCenter[i] / meshArea : 0.0;
+	}
+
+	// 中心から外を向いているまとまりほど他を隠しやすいので先に描画する
+	std::vector<float> sortKeys(clusterCount);
+	for (size_t c = 0; c < clusterCount; c++)
+	{
+		const double* normal = &normals[c * 3];
+		const double length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+		double key = 0.0;
+		if (areas[c] > 0.0 && length > 0.0)
+		{
+			for (int i = 0; i < 3; i++)
+			{
+				key += (centers[c * 3 + i] / areas[c] - meshCenter[i]) * normal[i] / length;
+			}
+		}
+		sortKeys[c] = static_cast<float>(key);
+	}
+	std::vector<uint32_t> order(clusterCount);
+	for (size_t c = 0; c < clusterCount; c++)
+	{
+		order[c] = static_cast<uint32_t>(c);
+	}
+	std::stable_sort(order.begin(), order.end(), [&sortKeys](uint32_t a, uint32_t b)
+	{
+		return sortKeys[a] > sortKeys[b];
+	});
+
+	std::vector<uint32_t> result;
+	result.reserve(indices.size());
+	for (uint32_t c : order)
+	{
+		result.insert(result.end(), indices.begin() + clusters[c] * 3, indices.begin() + clusters[c + 1] * 3);
+	}
+	indices.swap(result);
+}
+
+void OptimizeVertexFetch(CookPart& part)
+{
+	std::vector<uint32_t> remap(part.vertices.size(), INVALID_INDEX);
+	std::vector<CookVertex> vertices;
+	vertices.reserve(part.vertices.size());
+	for (uint32_t& index : part.indices)
+	{
+		if (remap[index] == INVALID_INDEX)
+		{
+			remap[index] = static_cast<uint32_t>(vertices.size());
+			vertices.push_back(part.vertices[index]);
+		}
+		index = remap[index];
+	}
+	part.vertices.swap(vertices);
+}
+
+void OptimizeModel(CookModel& model)
+{
+	for (CookMesh& mesh : model.meshes)
+	{
+		for (CookPart& part : mesh.parts)
+		{
+			OptimizeVertexCache(part.indices, part.vertices.size());
+			OptimizeOverdraw(part.indices, part.vertices, 1.05f);
+			OptimizeVertexFetch(part);
+		}
+	}
+}
@@ -0,0 +1,44 @@
+﻿/// <summary>
+/// GPU の頂点キャッシュとオーバードローに合わせてパーツの三角形と頂点を並べ替える
+/// </summary>
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "CookModel.h"
+
+// 頂点キャッシュの効率
+struct VertexCacheStatistics
+{
+	// 頂点シェーダーを実行した回数
+	size_t transformedCount;
+	// 三角形の数
+	size_t triangleCount;
+	// 使われている頂点の数
+	size_t vertexCount;
+
+	// 三角形あたりの実行回数（0.5 に近いほど良く、3 が最悪）
+	float GetAcmr() const { return triangleCount ? static_cast<float>(transformedCount) / triangleCount : 0.0f; }
+	// 頂点あたりの実行回数（1 が最良）
+	float GetAtvr() const { return vertexCount ? static_cast<float>(transformedCount) / vertexCount : 0.0f; }
+};
+
+// 大きさ cacheSize の FIFO の頂点キャッシュで描画した場合の効率を求めて statistics に加える
+void AnalyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount, size_t cacheSize,
+	VertexCacheStatistics& statistics);
+
+// 頂点キャッシュに残っている頂点を使う三角形が続くように並べ替える（Forsyth の方法）
+void OptimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount);
+
+// 頂点キャッシュの効率を大きく落とさない範囲で、外側を向いた三角形のまとまりが先に描画されるように並べ替える
+// threshold は許容する ACMR の悪化の割合（1.05 なら 5% まで）
+// OptimizeVertexCache の後に使う
+void OptimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<CookVertex>& vertices, float threshold);
+
+// 頂点を最初に使われる順に並べ替え、インデックスを付け替える（使われない頂点は捨てる）
+void OptimizeVertexFetch(CookPart& part);
+
+// モデルの全てのパーツに上の３つを順に行う
+void OptimizeModel(CookModel& model);
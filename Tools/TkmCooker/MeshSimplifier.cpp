@@ -0,0 +1,542 @@
+﻿#include "MeshSimplifier.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	// 境界の平面の重み（大きいほど境界が動かない）
+	const double BORDER_WEIGHT = 10.0;
+	// 無効な頂点番号
+	const uint32_t INVALID_INDEX = 0xFFFFFFFF;
+
+	void Subtract(const double* a, const double* b, double result[3])
+	{
+		for (int i = 0; i < 3; i++)
+		{
+			result[i] = a[i] - b[i];
+		}
+	}
+
+	void Cross(const double a[3], const double b[3], double result[3])
+	{
+		result[0] = a[1] * b[2] - a[2] * b[1];
+		result[1] = a[2] * b[0] - a[0] * b[2];
+		result[2] = a[0] * b[1] - a[1] * b[0];
+	}
+
+	double Dot(const double a[3], const double b[3])
+	{
+		return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+	}
+
+	// グループの組を１つの値にする（小さい方を上位に）
+	uint64_t MakeEdgeKey(uint32_t a, uint32_t b)
+	{
+		return a < b ? (static_cast<uint64_t>(a) << 32) | b : (static_cast<uint64_t>(b) << 32) | a;
+	}
+}
+
+MeshSimplifier::MeshSimplifier(const CookPart& part)
+	: m_vertices(part.vertices)
+	, m_materialIndex(part.materialIndex)
+	, m_indices(part.indices)
+	, m_triangleCount(0)
+	, m_error(0.0f)
+{
+	const uint32_t vertexCount = static_cast<uint32_t>(m_vertices.size());
+	const uint32_t triangleCount = static_cast<uint32_t>(m_indices.size() / 3);
+	m_indices.resize(triangleCount * 3);
+
+	// 同じ座標の頂点をグループにまとめる
+	std::vector<uint32_t> order(vertexCount);
+	for (uint32_t i = 0; i < vertexCount; i++)
+	{
+		order[i] = i;
+	}
+	auto lessPosition = [this](uint32_t a, uint32_t b)
+	{
+		const float* p = m_vertices[a].position;
+		const float* q = m_vertices[b].position;
+		return std::lexicographical_compare(p, p + 3, q, q + 3);
+	};
+	std::sort(order.begin(), order.end(), lessPosition);
+
+	m_vertexGroups.resize(vertexCount);
+	m_groupVertices.reserve(vertexCount);
+	for (uint32_t i = 0; i < vertexCount; i++)
+	{
+		if (i == 0 || lessPosition(order[i - 1], order[i]))
+		{
+			m_firstGroupVertex.push_back(i);
+			for (int k = 0; k < 3; k++)
+			{
+				m_groupPositions.push_back(m_vertices[order[i]].position[k]);
+			}
+		}
+		m_vertexGroups[order[i]] = static_cast<uint32_t>(m_firstGroupVertex.size() - 1);
+		m_groupVertices.push_back(order[i]);
+	}
+	const uint32_t groupCount = static_cast<uint32_t>(m_firstGroupVertex.size());
+	m_firstGroupVertex.push_back(vertexCount);
+
+	// 範囲外の頂点を使う三角形と、同じ座標の頂点を２つ使う三角形は捨てる
+	m_isTriangleAlive.assign(triangleCount, 0);
+	m_vertexTriangles.resize(vertexCount);
+	m_isVertexAlive.assign(vertexCount, 1);
+	for (uint32_t t = 0; t < triangleCount; t++)
+	{
+		const uint32_t* index = &m_indices[t * 3];
+		if (index[0] >= vertexCount || index[1] >= vertexCount || index[2] >= vertexCount)
+		{
+			continue;
+		}
+		const uint32_t g0 = m_vertexGroups[index[0]];
+		const uint32_t g1 = m_vertexGroups[index[1]];
+		const uint32_t g2 = m_vertexGroups[index[2]];
+		if (g0 == g1 || g1 == g2 || g2 == g0)
+		{
+			continue;
+		}
+		m_isTriangleAlive[t] = 1;
+		m_triangleCount++;
+		for (int k = 0; k < 3; k++)
+		{
+			m_vertexTriangles[index[k]].push_back(t);
+		}
+	}
+
+	// 面の平面の二次誤差を面積で重み付けして頂点に集める
+	const Quadric zero = {};
+	m_groupQuadrics.assign(groupCount, zero);
+	std::vector<uint64_t> edges;
+	edges.reserve(m_triangleCount * 3);
+	for (uint32_t t = 0; t < triangleCount; t++)
+	{
+		if (!m_isTriangleAlive[t])
+		{
+			continue;
+		}
+		double normal[3];
+		GetNormal(t, INVALID_INDEX, nullptr, normal);
+		const double length = std::sqrt(Dot(normal, normal));
+		for (int k = 0; k < 3; k++)
+		{
+			edges.push_back(MakeEdgeKey(m_vertexGroups[m_indices[t * 3 + k]], m_vertexGroups[m_indices[t * 3 + (k + 1) % 3]]));
+		}
+		if (length <= 0.0)
+		{
+			continue;
+		}
+		for (int i = 0; i < 3; i++)
+		{
+			normal[i] /= length;
+		}
+		const uint32_t g0 = m_vertexGroups[m_indices[t * 3]];
+		const double d = -Dot(normal, &m_groupPositions[g0 * 3]);
+		for (int k = 0; k < 3; k++)
+		{
+			AddPlane(m_groupQuadrics[m_vertexGroups[m_indices[t * 3 + k]]], normal, d, length * 0.5);
+		}
+	}
+
+	// 開いた境界（１つの三角形だけが使う辺）には、面に垂直な平面を加えて境界を動きにくくする
+	std::sort(edges.begin(), edges.end());
+	for (uint32_t t = 0; t < triangleCount; t++)
+	{
+		if (!m_isTriangleAlive[t])
+		{
+			continue;
+		}
+		double normal[3];
+		GetNormal(t, INVALID_INDEX, nullptr, normal);
+		for (int k = 0; k < 3; k++)
+		{
+			const uint32_t g0 = m_vertexGroups[m_indices[t * 3 + k]];
+			const uint32_t g1 = m_vertexGroups[m_indices[t * 3 + (k + 1) % 3]];
+			const uint64_t key = MakeEdgeKey(g0, g1);
+			auto range = std::equal_range(edges.begin(), edges.end(), key);
+			if (range.second - range.first != 1)
+			{
+				continue;
+			}
+			double edge[3];
+			Subtract(&m_groupPositions[g1 * 3], &m_groupPositions[g0 * 3], edge);
+			double plane[3];
+			Cross(edge, normal, plane);
+			const double length = std::sqrt(Dot(plane, plane));
+			if (length <= 0.0)
+			{
+				continue;
+			}
+			for (int i = 0; i < 3; i++)
+			{
+				plane[i] /= length;
+			}
+			const double d = -Dot(plane, &m_groupPositions[g0 * 3]);
+			const double weight = Dot(edge, edge) * BORDER_WEIGHT;
+			AddPlane(m_groupQuadrics[g0], plane, d, weight);
+			AddPlane(m_groupQuadrics[g1], plane, d, weight);
+		}
+	}
+}
+
+void MeshSimplifier::Simplify(size_t targetTriangles)
+{
+	while (m_triangleCount > targetTriangles)
+	{
+		if (RunPass(targetTriangles) == 0)
+		{
+			break;
+		}
+	}
+}
+
+void MeshSimplifier::Extract(CookPart& part) const
+{
+	part.materialIndex = m_materialIndex;
+	part.vertices.clear();
+	part.indices.clear();
+
+	std::vector<uint32_t> remap(m_vertices.size(), INVALID_INDEX);
+	for (size_t t = 0; t < m_isTriangleAlive.size(); t++)
+	{
+		if (!m_isTriangleAlive[t])
+		{
+			continue;
+		}
+		for (int k = 0; k < 3; k++)
+		{
+			const uint32_t index = m_indices[t * 3 + k];
+			if (remap[index] == INVALID_INDEX)
+			{
+				remap[index] = 0;
+			}
+		}
+	}
+
+	// 頂点は元の順に並べる
+	for (size_t i = 0; i < m_vertices.size(); i++)
+	{
+		if (remap[i] != INVALID_INDEX)
+		{
+			remap[i] = static_cast<uint32_t>(part.vertices.size());
+			part.vertices.push_back(m_vertices[i]);
+		}
+	}
+	part.indices.reserve(m_triangleCount * 3);
+	for (size_t t = 0; t < m_isTriangleAlive.size(); t++)
+	{
+		if (m_isTriangleAlive[t])
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				part.indices.push_back(remap[m_indices[t * 3 + k]]);
+			}
+		}
+	}
+}
+
+void MeshSimplifier::AddPlane(Quadric& quadric, const double normal[3], double d, double weight)
+{
+	quadric.a00 += weight * normal[0] * normal[0];
+	quadric.a01 += weight * normal[0] * normal[1];
+	quadric.a02 += weight * normal[0] * normal[2];
+	quadric.a11 += weight * normal[1] * normal[1];
+	quadric.a12 += weight * normal[1] * normal[2];
+	quadric.a22 += weight * normal[2] * normal[2];
+	quadric.b0 += weight * normal[0] * d;
+	quadric.b1 += weight * normal[1] * d;
+	quadric.b2 += weight * normal[2] * d;
+	quadric.c += weight * d * d;
+	quadric.weight += weight;
+}
+
+void MeshSimplifier::AddQuadric(Quadric& quadric, const Quadric& other)
+{
+	quadric.a00 += other.a00;
+	quadric.a01 += other.a01;
+	quadric.a02 += other.a02;
+	quadric.a11 += other.a11;
+	quadric.a12 += other.a12;
+	quadric.a22 += other.a22;
+	quadric.b0 += other.b0;
+	quadric.b1 += other.b1;
+	quadric.b2 += other.b2;
+	quadric.c += other.c;
+	quadric.weight += other.weight;
+}
+
+double MeshSimplifier::Evaluate(const Quadric& quadric, const double position[3])
+{
+	if (quadric.weight <= 0.0)
+	{
+		return 0.0;
+	}
+	const double x = position[0];
+	const double y = position[1];
+	const double z = position[2];
+	const double error =
+		quadric.a00 * x * x + quadric.a11 * y * y + quadric.a22 * z * z
+		+ 2.0 * (quadric.a01 * x * y + quadric.a02 * x * z + quadric.a12 * y * z)
+		+ 2.0 * (quadric.b0 * x + quadric.b1 * y + quadric.b2 * z)
+		+ quadric.c;
+	// 丸め誤差で負になることがある
+	return std::max(error, 0.0) / quadric.weight;
+}
+
+void MeshSimplifier::GetNormal(uint32_t triangle, uint32_t movedGroup, const double* position, double normal[3]) const
+{
+	const double* p[3];
+	for (int k = 0; k < 3; k++)
+	{
+		const uint32_t group = m_vertexGroups[m_indices[triangle * 3 + k]];
+		p[k] = group == movedGroup ? position : &m_groupPositions[group * 3];
+	}
+	double e1[3];
+	double e2[3];
+	Subtract(p[1], p[0], e1);
+	Subtract(p[2], p[0], e2);
+	Cross(e1, e2, normal);
+}
+
+size_t MeshSimplifier::RunPass(size_t targetTriangles)
+{
+	const uint32_t groupCount = static_cast<uint32_t>(m_groupQuadrics.size());
+
+	// 今の三角形の辺を集め、１つの三角形だけが使う辺を境界とする
+	std::vector<uint64_t> edges;
+	edges.reserve(m_triangleCount * 3);
+	for (size_t t = 0; t < m_isTriangleAlive.size(); t++)
+	{
+		if (m_isTriangleAlive[t])
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				edges.push_back(MakeEdgeKey(m_vertexGroups[m_indices[t * 3 + k]], m_vertexGroups[m_indices[t * 3 + (k + 1) % 3]]));
+			}
+		}
+	}
+	std::sort(edges.begin(), edges.end());
+
+	std::vector<uint8_t> isBorder(groupCount, 0);
+	for (size_t i = 0; i < edges.size(); )
+	{
+		size_t end = i + 1;
+		while (end < edges.size() && edges[end] == edges[i])
+		{
+			end++;
+		}
+		if (end - i == 1)
+		{
+			isBorder[edges[i] >> 32] = 1;
+			isBorder[edges[i] & 0xFFFFFFFF] = 1;
+		}
+		i = end;
+	}
+
+	// 辺ごとに誤差の小さい向きを候補にする（境界の頂点は境界の辺に沿ってだけ動かす）
+	std::vector<Collapse> collapses;
+	collapses.reserve(edges.size() / 2);
+	for (size_t i = 0; i < edges.size(); )
+	{
+		size_t end = i + 1;
+		while (end < edges.size() && edges[end] == edges[i])
+		{
+			end++;
+		}
+		const bool isBorderEdge = end - i == 1;
+		const uint32_t groups[2] = { static_cast<uint32_t>(edges[i] >> 32), static_cast<uint32_t>(edges[i] & 0xFFFFFFFF) };
+		i = end;
+
+		Quadric quadric = m_groupQuadrics[groups[0]];
+		AddQuadric(quadric, m_groupQuadrics[groups[1]]);
+		Collapse best = { INVALID_INDEX, INVALID_INDEX, 0.0 };
+		for (int k = 0; k < 2; k++)
+		{
+			const uint32_t from = groups[k];
+			const uint32_t to = groups[1 - k];
+			if (isBorder[from] && !isBorderEdge)
+			{
+				continue;
+			}
+			const double cost = Evaluate(quadric, &m_groupPositions[to * 3]);
+			if (best.from == INVALID_INDEX || cost < best.cost)
+			{
+				best.from = from;
+				best.to = to;
+				best.cost = cost;
+			}
+		}
+		if (best.from != INVALID_INDEX)
+		{
+			collapses.push_back(best);
+		}
+	}
+	std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b)
+	{
+		return a.cost < b.cost;
+	});
+
+	// 誤差の小さい順に縮約する（１回の走査では同じグループを２回動かさない）
+	std::vector<uint8_t> isLocked(groupCount, 0);
+	size_t collapsedCount = 0;
+	for (const Collapse& collapse : collapses)
+	{
+		if (m_triangleCount <= targetTriangles)
+		{
+			break;
+		}
+		if (isLocked[collapse.from] || isLocked[collapse.to])
+		{
+			continue;
+		}
+		if (TryCollapse(collapse.from, collapse.to, isLocked))
+		{
+			collapsedCount++;
+		}
+	}
+	return collapsedCount;
+}
+
+bool MeshSimplifier::TryCollapse(uint32_t from, uint32_t to, std::vector<uint8_t>& isLocked)
+{
+	// グループ内の各頂点の縮約先は、辺でつながった to の頂点（継ぎ目の片側ごとに１つに決まらなければ縮約しない）
+	std::vector<std::pair<uint32_t, uint32_t>> targets;
+	for (uint32_t i = m_firstGroupVertex[from]; i < m_firstGroupVertex[from + 1]; i++)
+	{
+		const uint32_t vertex = m_groupVertices[i];
+		if (!m_isVertexAlive[vertex])
+		{
+			continue;
+		}
+		uint32_t target = INVALID_INDEX;
+		bool isUsed = false;
+		for (uint32_t t : m_vertexTriangles[vertex])
+		{
+			if (!m_isTriangleAlive[t])
+			{
+				continue;
+			}
+			isUsed = true;
+			for (int k = 0; k < 3; k++)
+			{
+				const uint32_t corner = m_indices[t * 3 + k];
+				if (corner != vertex && m_vertexGroups[corner] == to)
+				{
+					if (target != INVALID_INDEX && target != corner)
+					{
+						return false;
+					}
+					target = corner;
+				}
+			}
+		}
+		if (isUsed && target == INVALID_INDEX)
+		{
+			return false;
+		}
+		targets.push_back(std::make_pair(vertex, target));
+	}
+
+	// 残る三角形が裏返るなら縮約しない
+	const double* position = &m_groupPositions[to * 3];
+	for (const auto& pair : targets)
+	{
+		for (uint32_t t : m_vertexTriangles[pair.first])
+		{
+			const uint32_t* index = &m_indices[t * 3];
+			if (!m_isTriangleAlive[t] || index[0] == pair.second || index[1] == pair.second || index[2] == pair.second)
+			{
+				continue;
+			}
+			double before[3];
+			double after[3];
+			GetNormal(t, INVALID_INDEX, nullptr, before);
+			GetNormal(t, from, position, after);
+			if (Dot(before, after) <= 0.0 && Dot(before, before) > 0.0)
+			{
+				return false;
+			}
+		}
+	}
+
+	// 縮約先を共有する三角形は消え、それ以外は縮約先を使う
+	for (const auto& pair : targets)
+	{
+		const uint32_t vertex = pair.first;
+		const uint32_t target = pair.second;
+		for (uint32_t t : m_vertexTriangles[vertex])
+		{
+			if (!m_isTriangleAlive[t])
+			{
+				continue;
+			}
+			uint32_t* index = &m_indices[t * 3];
+			if (index[0] == target || index[1] == target || index[2] == target)
+			{
+				m_isTriangleAlive[t] = 0;
+				m_triangleCount--;
+				continue;
+			}
+			for (int k = 0; k < 3; k++)
+			{
+				if (index[k] == vertex)
+				{
+					index[k] = target;
+				}
+			}
+			m_vertexTriangles[target].push_back(t);
+		}
+		m_vertexTriangles[vertex].clear();
+		m_vertexTriangles[vertex].shrink_to_fit();
+		m_isVertexAlive[vertex] = 0;
+	}
+
+	AddQuadric(m_groupQuadrics[to], m_groupQuadrics[from]);
+	m_error = std::max(m_error, static_cast<float>(std::sqrt(Evaluate(m_groupQuadrics[to], position))));
+	isLocked[from] = 1;
+	isLocked[to] = 1;
+	return true;
+}
+
+void SimplifyModel(const CookModel& model, const std::vector<float>& ratios,
+	std::vector<CookModel>& levels, std::vector<float>& errors)
+{
+	levels.assign(ratios.size(), CookModel());
+	errors.assign(ratios.size(), 0.0f);
+	for (CookModel& level : levels)
+	{
+		level.materials = model.materials;
+		level.meshes.resize(model.meshes.size());
+	}
+
+	for (size_t m = 0; m < model.meshes.size(); m++)
+	{
+		const CookMesh& mesh = model.meshes[m];
+		for (CookModel& level : levels)
+		{
+			level.meshes[m].name = mesh.name;
+			level.meshes[m].parts.resize(mesh.parts.size());
+		}
+
+		for (size_t p = 0; p < mesh.parts.size(); p++)
+		{
+			// 前の詳細度の結果から続けて簡略化する
+			MeshSimplifier simplifier(mesh.parts[p]);
+			const size_t triangleCount = mesh.parts[p].indices.size() / 3;
+			for (size_t i = 0; i < ratios.size(); i++)
+			{
+				const size_t target = static_cast<size_t>(std::ceil(triangleCount * static_cast<double>(ratios[i])));
+				simplifier.Simplify(target);
+				simplifier.Extract(levels[i].meshes[m].parts[p]);
+				errors[i] = std::max(errors[i], simplifier.GetError());
+			}
+		}
+	}
+
+	for (size_t i = 0; i < levels.size(); i++)
+	{
+		levels[i].geometricError = errors[i];
+	}
+}
@@ -0,0 +1,92 @@
+﻿/// <summary>
+/// 二次誤差（QEM）による辺の縮約でパーツを簡略化するクラス
+/// </summary>
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "CookModel.h"
+
+// 縮約は同じ座標の頂点をまとめた単位で行い、縮約先の頂点をそのまま使う（半辺縮約）
+// 法線やテクスチャ座標の継ぎ目にある頂点は、継ぎ目の両側が揃って縮約できるときだけ縮約するので継ぎ目は崩れない
+// 開いた境界の頂点は境界に沿ってだけ縮約する
+// Simplify を繰り返し呼ぶと、前回の結果からさらに簡略化する（詳細度の列を作るのに使う）
+class MeshSimplifier
+{
+public:
+	explicit MeshSimplifier(const CookPart& part);
+
+	// 三角形数が targetTriangles 以下になるまで縮約する（縮約できる辺が無くなればそこで止まる）
+	void Simplify(size_t targetTriangles);
+
+	// 残っている三角形の数
+	size_t GetTriangleCount() const { return m_triangleCount; }
+	// これまでの縮約で生じた最大の誤差（元の面からの距離の目安、モデル空間の長さ）
+	float GetError() const { return m_error; }
+	// 現在の形をパーツとして取り出す（使われている頂点だけを元の順で残す）
+	void Extract(CookPart& part) const;
+
+private:
+	// 二次誤差（対称行列の上三角と、重みの合計）
+	struct Quadric
+	{
+		double a00, a01, a02, a11, a12, a22;
+		double b0, b1, b2;
+		double c;
+		double weight;
+	};
+
+	// 縮約の候補
+	struct Collapse
+	{
+		uint32_t from;
+		uint32_t to;
+		double cost;
+	};
+
+	// 平面 n・p + d = 0 の二次誤差を weight 倍して加える
+	static void AddPlane(Quadric& quadric, const double normal[3], double d, double weight);
+	// 二つの二次誤差を足す
+	static void AddQuadric(Quadric& quadric, const Quadric& other);
+	// 点での誤差（重みで割った平均の二乗距離）
+	static double Evaluate(const Quadric& quadric, const double position[3]);
+
+	// 三角形の法線（正規化していない）
+	void GetNormal(uint32_t triangle, uint32_t movedGroup, const double* position, double normal[3]) const;
+	// 縮約を１回の走査で可能な限り行い、行った数を返す
+	size_t RunPass(size_t targetTriangles);
+	// グループ from を to に縮約する（できなければ false）
+	bool TryCollapse(uint32_t from, uint32_t to, std::vector<uint8_t>& isLocked);
+
+	// 頂点の属性
+	std::vector<CookVertex> m_vertices;
+	uint32_t m_materialIndex;
+	// 三角形の頂点番号（縮約すると書き換える）
+	std::vector<uint32_t> m_indices;
+	// 三角形が残っているか
+	std::vector<uint8_t> m_isTriangleAlive;
+	size_t m_triangleCount;
+	// 頂点ごとの、その頂点を使う三角形（消えた三角形も含む）
+	std::vector<std::vector<uint32_t>> m_vertexTriangles;
+	// 頂点が残っているか
+	std::vector<uint8_t> m_isVertexAlive;
+
+	// 頂点が属するグループ（同じ座標の頂点のまとまり）
+	std::vector<uint32_t> m_vertexGroups;
+	// グループに属する頂点（firstGroupVertex[g] から firstGroupVertex[g + 1] まで）
+	std::vector<uint32_t> m_groupVertices;
+	std::vector<uint32_t> m_firstGroupVertex;
+	// グループの座標と二次誤差
+	std::vector<double> m_groupPositions;
+	std::vector<Quadric> m_groupQuadrics;
+
+	// 最大の誤差
+	float m_error;
+};
+
+// パーツごとに、元の三角形数に ratios の割合を掛けた数まで簡略化した詳細度の列を作る
+// ratios は大きい順に並べる。errors には詳細度ごとの誤差（全パーツの最大）を入れる
+void SimplifyModel(const CookModel& model, const std::vector<float>& ratios,
+	std::vector<CookModel>& levels, std::vector<float>& errors);
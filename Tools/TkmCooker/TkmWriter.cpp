@@ -0,0 +1,261 @@
+﻿#include "TkmWriter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "TkmFormat.h"
+
+namespace
+{
+	// 境界の計算
+	class BoundsBuilder
+	{
+	public:
+		BoundsBuilder()
+			: m_isEmpty(true)
+		{
+			for (int i = 0; i < 3; i++)
+			{
+				m_min[i] = 0.0f;
+				m_max[i] = 0.0f;
+			}
+		}
+
+		// 点を AABB に加える
+		void Add(const float position[3])
+		{
+			for (int i = 0; i < 3; i++)
+			{
+				m_min[i] = m_isEmpty ? position[i] : std::min(m_min[i], position[i]);
+				m_max[i] = m_isEmpty ? position[i] : std::max(m_max[i], position[i]);
+			}
+			m_isEmpty = false;
+		}
+
+		// AABB の中心
+		void GetCenter(float center[3]) const
+		{
+			for (int i = 0; i < 3; i++)
+			{
+				center[i] = (m_min[i] + m_max[i]) * 0.5f;
+			}
+		}
+
+		// 境界球は AABB の中心から最も遠い点までを半径にする
+		TkmBounds GetBounds(const std::vector<const CookPart*>& parts) const
+		{
+			TkmBounds bounds;
+			GetCenter(bounds.center);
+			float radiusSq = 0.0f;
+			for (const CookPart* part : parts)
+			{
+				for (const CookVertex& vertex : part->vertices)
+				{
+					float dx = vertex.position[0] - bounds.center[0];
+					float dy = vertex.position[1] - bounds.center[1];
+					float dz = vertex.position[2] - bounds.center[2];
+					radiusSq = std::max(radiusSq, dx * dx + dy * dy + dz * dz);
+				}
+			}
+			bounds.radius = std::sqrt(radiusSq);
+			for (int i = 0; i < 3; i++)
+			{
+				bounds.aabbMin[i] = m_min[i];
+				bounds.aabbMax[i] = m_max[i];
+			}
+			return bounds;
+		}
+
+		// 各軸の半分の大きさの最大
+		float GetMaxHalfExtent() const
+		{
+			float extent = 0.0f;
+			for (int i = 0; i < 3; i++)
+			{
+				extent = std::max(extent, (m_max[i] - m_min[i]) * 0.5f);
+			}
+			return extent;
+		}
+
+	private:
+		bool m_isEmpty;
+		float m_min[3];
+		float m_max[3];
+	};
+
+	// 文字列セクションを作る
+	class StringTable
+	{
+	public:
+		TkmString Add(const std::wstring& text)
+		{
+			TkmString string;
+			string.offset = static_cast<uint32_t>(m_data.size() * 2);
+			string.length = static_cast<uint32_t>(text.size());
+			for (wchar_t c : text)
+			{
+				m_data.push_back(static_cast<uint16_t>(c));
+			}
+			return string;
+		}
+
+		const std::vector<uint16_t>& GetData() const { return m_data; }
+
+	private:
+		std::vector<uint16_t> m_data;
+	};
+
+	uint32_t AlignUp(uint32_t value)
+	{
+		return (value + TKM_ALIGNMENT - 1) / TKM_ALIGNMENT * TKM_ALIGNMENT;
+	}
+
+	// セクションを追加
+	template<typename T>
+	void AppendSection(std::vector<uint8_t>& file, TkmSection& section, const std::vector<T>& data)
+	{
+		file.resize(AlignUp(static_cast<uint32_t>(file.size())), 0);
+		section.offset = static_cast<uint32_t>(file.size());
+		section.size = static_cast<uint32_t>(data.size() * sizeof(T));
+		if (!data.empty())
+		{
+			const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data.data());
+			file.insert(file.end(), bytes, bytes + section.size);
+		}
+	}
+}
+
+void WriteTkm(const CookModel& model, std::vector<uint8_t>& file)
+{
+	TkmHeader header;
+	std::memset(&header, 0, sizeof(header));
+	header.magic = TKM_MAGIC;
+	header.version = TKM_VERSION;
+
+	// ファイル全体の境界（量子化の範囲にもなる）
+	BoundsBuilder modelBounds;
+	std::vector<const CookPart*> allParts;
+	bool isIndex32 = false;
+	for (const CookMesh& mesh : model.meshes)
+	{
+		for (const CookPart& part : mesh.parts)
+		{
+			for (const CookVertex& vertex : part.vertices)
+			{
+				modelBounds.Add(vertex.position);
+			}
+			allParts.push_back(&part);
+			isIndex32 = isIndex32 || part.vertices.size() > 65536;
+		}
+	}
+	header.bounds = modelBounds.GetBounds(allParts);
+	modelBounds.GetCenter(header.positionCenter);
+	header.positionScale = modelBounds.GetMaxHalfExtent();
+	if (header.positionScale <= 0.0f)
+	{
+		header.positionScale = 1.0f;
+	}
+	header.flags = isIndex32 ? TKM_FLAG_INDEX32 : 0;
+	header.geometricError = model.geometricError;
+	const float inverseScale = 1.0f / header.positionScale;
+
+	StringTable strings;
+	std::vector<TkmMesh> meshes;
+	std::vector<TkmPart> parts;
+	std::vector<TkmVertex> vertices;
+	std::vector<uint16_t> indices16;
+	std::vector<uint32_t> indices32;
+
+	for (const CookMesh& mesh : model.meshes)
+	{
+		TkmMesh tkmMesh;
+		tkmMesh.name = strings.Add(mesh.name);
+		tkmMesh.firstPart = static_cast<uint32_t>(parts.size());
+		tkmMesh.partCount = static_cast<uint32_t>(mesh.parts.size());
+
+		BoundsBuilder meshBounds;
+		std::vector<const CookPart*> meshParts;
+		for (const CookPart& part : mesh.parts)
+		{
+			TkmPart tkmPart;
+			tkmPart.materialIndex = part.materialIndex;
+			tkmPart.startIndex = static_cast<uint32_t>(isIndex32 ? indices32.size() : indices16.size());
+			tkmPart.indexCount = static_cast<uint32_t>(part.indices.size());
+			tkmPart.baseVertex = static_cast<uint32_t>(vertices.size());
+			tkmPart.vertexCount = static_cast<uint32_t>(part.vertices.size());
+			parts.push_back(tkmPart);
+
+			for (const CookVertex& vertex : part.vertices)
+			{
+				meshBounds.Add(vertex.position);
+
+				TkmVertex tkmVertex;
+				for (int i = 0; i < 3; i++)
+				{
+					tkmVertex.position[i] = QuantizeSnorm16((vertex.position[i] - header.positionCenter[i]) * inverseScale);
+					tkmVertex.normal[i] = QuantizeSnorm8(vertex.normal[i]);
+				}
+				tkmVertex.position[3] = 0;
+				tkmVertex.normal[3] = 0;
+				tkmVertex.color = vertex.color;
+				tkmVertex.texcoord[0] = FloatToHalf(vertex.texcoord[0]);
+				tkmVertex.texcoord[1] = FloatToHalf(vertex.texcoord[1]);
+				vertices.push_back(tkmVertex);
+			}
+
+			for (uint32_t index : part.indices)
+			{
+				if (isIndex32)
+				{
+					indices32.push_back(index);
+				}
+				else
+				{
+					indices16.push_back(static_cast<uint16_t>(index));
+				}
+			}
+			meshParts.push_back(&part);
+		}
+		tkmMesh.bounds = meshBounds.GetBounds(meshParts);
+		meshes.push_back(tkmMesh);
+	}
+
+	std::vector<TkmMaterial> materials;
+	for (const CookMaterial& material : model.materials)
+	{
+		TkmMaterial tkmMaterial;
+		tkmMaterial.name = strings.Add(material.name);
+		tkmMaterial.texture = strings.Add(material.texture);
+		std::memcpy(tkmMaterial.diffuse, material.diffuse, sizeof(tkmMaterial.diffuse));
+		std::memcpy(tkmMaterial.ambient, material.ambient, sizeof(tkmMaterial.ambient));
+		std::memcpy(tkmMaterial.specular, material.specular, sizeof(tkmMaterial.specular));
+		tkmMaterial.specularPower = material.specularPower;
+		std::memcpy(tkmMaterial.emissive, material.emissive, sizeof(tkmMaterial.emissive));
+		materials.push_back(tkmMaterial);
+	}
+
+	header.meshCount = static_cast<uint32_t>(meshes.size());
+	header.partCount = static_cast<uint32_t>(parts.size());
+	header.materialCount = static_cast<uint32_t>(materials.size());
+	header.vertexCount = static_cast<uint32_t>(vertices.size());
+	header.indexCount = static_cast<uint32_t>(isIndex32 ? indices32.size() : indices16.size());
+
+	// ヘッダーは最後に書き直す
+	file.assign(sizeof(TkmHeader), 0);
+	AppendSection(file, header.sections[TKM_SECTION_MESHES], meshes);
+	AppendSection(file, header.sections[TKM_SECTION_PARTS], parts);
+	AppendSection(file, header.sections[TKM_SECTION_MATERIALS], materials);
+	AppendSection(file, header.sections[TKM_SECTION_VERTICES], vertices);
+	if (isIndex32)
+	{
+		AppendSection(file, header.sections[TKM_SECTION_INDICES], indices32);
+	}
+	else
+	{
+		AppendSection(file, header.sections[TKM_SECTION_INDICES], indices16);
+	}
+	AppendSection(file, header.sections[TKM_SECTION_STRINGS], strings.GetData());
+	header.fileSize = static_cast<uint32_t>(file.size());
+	std::memcpy(file.data(), &header, sizeof(header));
+}
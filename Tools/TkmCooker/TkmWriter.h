@@ -0,0 +1,13 @@
+﻿/// <summary>
+/// クッカー内部の表現を TKM 形式に書き出す
+/// </summary>
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "CookModel.h"
+
+// 座標と法線を量子化し、境界を計算して TKM のバイト列を作る
+// 全てのパーツの頂点数が 65536 以下なら 16bit インデックスにする
+void WriteTkm(const CookModel& model, std::vector<uint8_t>& file);
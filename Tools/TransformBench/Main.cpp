@@ -0,0 +1,446 @@
+﻿/// <summary>
+/// 変換の階層を確かめ、性能を測るコマンドラインツール
+///
+/// 使い方: TransformBench [-n 自機の数] [-f フレーム数] [-j 最大のスレッド数] [-objects 並列化を測るノード数]
+/// Game と同じ形の自機（塔の下に基地・エンジン・換気扇、基地の下に音符）を並べ、
+/// ワールド行列を親をたどって１個ずつ合成した値と比べる（変更したノードだけ再計算した後と、
+/// 親の付け替え・破棄・追加の後も確かめる）
+/// 全ての自機が動くとき・換気扇だけが回るとき・何も動かないときの Update の時間を表示する
+/// ジョブシステムを渡して深さごとに並列に計算した結果が、逐次計算とビット単位で一致することも確かめ、
+/// -objects 個のノードを全て動かしたときの Update の時間を 1 から -j 個のスレッドまで表示する
+/// 確かめた結果が合わなければ 1 を返す
+///
+/// Windows 以外では次のようにビルドする
+///   g++ -std=c++14 -O2 -pthread -I../../GameEngineTK Main.cpp ../../GameEngineTK/TransformHierarchy.cpp
+///       ../../GameEngineTK/TransformKernel.cpp ../../GameEngineTK/JobSystem.cpp ../../GameEngineTK/Profiler.cpp
+///       ../../GameEngineTK/Clock.cpp ../../GameEngineTK/FileSystem.cpp ../../GameEngineTK/FrameStats.cpp
+///       ../../GameEngineTK/FrameArena.cpp -o TransformBench
+/// </summary>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Clock.h"
+#include "JobSystem.h"
+#include "TransformHierarchy.h"
+
+namespace
+{
+	// 自機のパーツ（GameSimulation と同じ親子関係）
+	enum TANK_PARTS
+	{
+		TANK_TOWER,
+		TANK_BASE,
+		TANK_ENGINE_R,
+		TANK_ENGINE_L,
+		TANK_FAN,
+		TANK_SCORE,
+
+		TANK_PARTS_NUM
+	};
+
+	// 各パーツの親（塔はルート）
+	const int TANK_PARENTS[TANK_PARTS_NUM] = { -1, TANK_TOWER, TANK_TOWER, TANK_TOWER, TANK_TOWER, TANK_BASE };
+
+	// 親をたどって合成した値との誤差の許容値（SIMD の sin / cos の近似を含む）
+	const double TOLERANCE = 1e-4;
+
+	typedef TransformHierarchy::Handle Handle;
+
+	struct Tank
+	{
+		Handle parts[TANK_PARTS_NUM];
+	};
+
+	// 再現できる乱数（xorshift）
+	float Random(uint32_t& state, float low, float high)
+	{
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		return low + (high - low) * static_cast<float>(state & 0xffffff) / 16777216.0f;
+	}
+
+	// 自機を並べる（パーツのオフセットは GameSimulation と同じ、塔の位置と向きは散らす）
+	void CreateTanks(TransformHierarchy& transforms, std::vector<Tank>& tanks, size_t count)
+	{
+		uint32_t random = 2463534242u;
+		const float PI = 3.14159265f;
+		tanks.resize(count);
+		transforms.Reserve(count * TANK_PARTS_NUM);
+		for (Tank& tank : tanks)
+		{
+			for (int part = 0; part < TANK_PARTS_NUM; part++)
+			{
+				const int parent = TANK_PARENTS[part];
+				tank.parts[part] = transforms.Create(parent < 0 ? TransformHierarchy::INVALID_HANDLE : tank.parts[parent]);
+			}
+			transforms.SetScale(tank.parts[TANK_TOWER], Float3{ 2.0f, 2.0f, 2.0f });
+			transforms.SetRotation(tank.parts[TANK_TOWER], Float3{ 0.0f, Random(random, -PI, PI), 0.0f });
+			transforms.SetTranslation(tank.parts[TANK_TOWER],
+				Float3{ Random(random, -100.0f, 100.0f), 0.0f, Random(random, -100.0f, 100.0f) });
+			transforms.SetTranslation(tank.parts[TANK_BASE], Float3{ 0.0f, 0.7f, 0.0f });
+			transforms.SetTranslation(tank.parts[TANK_SCORE], Float3{ 0.0f, 1.0f, 0.0f });
+			transforms.SetScale(tank.parts[TANK_SCORE], Float3{ 2.0f, 2.0f, 2.0f });
+			transforms.SetTranslation(tank.parts[TANK_ENGINE_R], Float3{ 0.22f, 0.3f, 0.22f });
+			transforms.SetRotation(tank.parts[TANK_ENGINE_R], Float3{ 0.0f, PI / 4.0f, 0.0f });
+			transforms.SetTranslation(tank.parts[TANK_ENGINE_L], Float3{ -0.22f, 0.3f, 0.22f });
+			transforms.SetRotation(tank.parts[TANK_ENGINE_L], Float3{ 0.0f, -PI / 4.0f, 0.0f });
+			transforms.SetTranslation(tank.parts[TANK_FAN], Float3{ 0.0f, 0.3f, 1.0f });
+		}
+	}
+
+	// 全ての自機を前に進めて旋回させる（全てのノードが再計算の対象になる）
+	void MoveTanks(TransformHierarchy& transforms, const std::vector<Tank>& tanks, int frame)
+	{
+		for (const Tank& tank : tanks)
+		{
+			const Handle tower = tank.parts[TANK_TOWER];
+			Float3 rotation = transforms.GetRotation(tower);
+			rotation.y += 0.01f;
+			Float3 translation = transforms.GetTranslation(tower);
+			translation.x += 0.1f * std::sin(rotation.y);
+			translation.z += 0.1f * std::cos(rotation.y);
+			translation.y = 0.5f * std::sin(frame * 0.1f);
+			transforms.SetRotation(tower, rotation);
+			transforms.SetTranslation(tower, translation);
+		}
+	}
+
+	// 換気扇だけを回す（子を持たないノードだけが再計算の対象になる）
+	void SpinFans(TransformHierarchy& transforms, const std::vector<Tank>& tanks, int frame)
+	{
+		for (const Tank& tank : tanks)
+		{
+			transforms.SetRotation(tank.parts[TANK_FAN], Float3{ 0.0f, 0.0f, frame * 0.2f });
+		}
+	}
+
+	// 親をたどって１個ずつ合成したワールド行列
+	Float4x4 ComposeNaive(const TransformHierarchy& transforms, Handle handle)
+	{
+		const Float4x4 local = ComposeTRS(transforms.GetScale(handle), transforms.GetRotation(handle),
+			transforms.GetTranslation(handle));
+		const Handle parent = transforms.GetParent(handle);
+		return parent == TransformHierarchy::INVALID_HANDLE ? local : Multiply(local, ComposeNaive(transforms, parent));
+	}
+
+	// 親をたどって合成した値との最大の誤差（大きい値は相対誤差で比べる）
+	double GetMaxError(const TransformHierarchy& transforms, const std::vector<Handle>& handles)
+	{
+		double maxError = 0.0;
+		for (Handle handle : handles)
+		{
+			const Float4x4 expected = ComposeNaive(transforms, handle);
+			const Float4x4& world = transforms.GetWorld(handle);
+			for (int i = 0; i < 4; i++)
+			{
+				for (int j = 0; j < 4; j++)
+				{
+					const double error = std::fabs(static_cast<double>(world.m[i][j]) - expected.m[i][j])
+						/ std::max(1.0, std::fabs(static_cast<double>(expected.m[i][j])));
+					maxError = std::max(maxError, error);
+				}
+			}
+		}
+		return maxError;
+	}
+
+	// 全ての自機のパーツのハンドル
+	std::vector<Handle> GetHandles(const std::vector<Tank>& tanks)
+	{
+		std::vector<Handle> handles;
+		handles.reserve(tanks.size() * TANK_PARTS_NUM);
+		for (const Tank& tank : tanks)
+		{
+			handles.insert(handles.end(), tank.parts, tank.parts + TANK_PARTS_NUM);
+		}
+		return handles;
+	}
+
+	// 確かめた結果を表示して数える
+	int Check(bool condition, const char* name)
+	{
+		if (!condition)
+		{
+			std::fprintf(stderr, "check failed: %s\n", name);
+			return 1;
+		}
+		return 0;
+	}
+
+	// 経過時間（秒）
+	double ToSeconds(Clock& clock, uint64_t begin, uint64_t end)
+	{
+		return static_cast<double>(end - begin) / clock.GetFrequency();
+	}
+
+	// 親の付け替え・破棄・追加をして、生存しているノードを alive に入れ、再計算が必要になった数を返す
+	size_t EditTanks(TransformHierarchy& transforms, std::vector<Tank>& tanks, std::vector<Handle>& alive)
+	{
+		alive.clear();
+		size_t changedCount = 0;
+		for (size_t i = 0; i < tanks.size(); i++)
+		{
+			Tank& tank = tanks[i];
+			if (i % 3 == 0)
+			{
+				// 音符を塔の直下に移す
+				transforms.SetParent(tank.parts[TANK_SCORE], tank.parts[TANK_TOWER]);
+				changedCount++;
+			}
+			if (i % 5 == 0)
+			{
+				// 左エンジンを外す
+				transforms.Destroy(tank.parts[TANK_ENGINE_L]);
+				tank.parts[TANK_ENGINE_L] = TransformHierarchy::INVALID_HANDLE;
+			}
+			if (i % 7 == 0)
+			{
+				// 換気扇の羽根を付ける（深さ２）
+				const Handle blade = transforms.Create(tank.parts[TANK_FAN]);
+				transforms.SetTranslation(blade, Float3{ 0.1f, 0.0f, 0.0f });
+				alive.push_back(blade);
+				changedCount++;
+			}
+			for (Handle part : tank.parts)
+			{
+				if (part != TransformHierarchy::INVALID_HANDLE)
+				{
+					alive.push_back(part);
+				}
+			}
+		}
+		return changedCount;
+	}
+
+	// 同じ変更を加えた２つの階層の、今と直前のワールド行列がビット単位で一致するか
+	bool IsSameWorlds(const TransformHierarchy& a, const TransformHierarchy& b, const std::vector<Handle>& handles)
+	{
+		for (Handle handle : handles)
+		{
+			if (std::memcmp(&a.GetWorld(handle), &b.GetWorld(handle), sizeof(Float4x4)) != 0
+				|| std::memcmp(&a.GetPreviousWorld(handle), &b.GetPreviousWorld(handle), sizeof(Float4x4)) != 0)
+			{
+				return false;
+			}
+		}
+		return a.GetRebuiltCount() == b.GetRebuiltCount();
+	}
+
+	// 同じ変更を加えながら、逐次計算と並列計算の結果を比べる（一致しなかったフレーム数を返す）
+	int CompareParallel(size_t tankCount, int frameCount, JobSystem& jobs)
+	{
+		TransformHierarchy serial, parallel;
+		std::vector<Tank> serialTanks, parallelTanks;
+		CreateTanks(serial, serialTanks, tankCount);
+		CreateTanks(parallel, parallelTanks, tankCount);
+		std::vector<Handle> alive = GetHandles(serialTanks);
+		int mismatchCount = 0;
+		for (int frame = 0; frame < frameCount; frame++)
+		{
+			// 動かす・回す・止める・親子関係を変えるを一通り含める
+			if (frame == frameCount / 2)
+			{
+				EditTanks(serial, serialTanks, alive);
+				EditTanks(parallel, parallelTanks, alive);
+			}
+			else if (frame % 3 == 0)
+			{
+				MoveTanks(serial, serialTanks, frame);
+				MoveTanks(parallel, parallelTanks, frame);
+			}
+			else if (frame % 3 == 1)
+			{
+				SpinFans(serial, serialTanks, frame);
+				SpinFans(parallel, parallelTanks, frame);
+			}
+			serial.Update(nullptr);
+			parallel.Update(&jobs);
+			if (!IsSameWorlds(serial, parallel, alive))
+			{
+				mismatchCount++;
+			}
+		}
+		return mismatchCount;
+	}
+
+	// 変更を加えて Update するのを frameCount 回繰り返し、Update だけにかかった秒数と再計算した数を返す
+	template<typename Change>
+	double TimeUpdate(TransformHierarchy& transforms, JobSystem* jobs, int frameCount, const Change& change,
+		size_t& rebuilt)
+	{
+		Clock& clock = GetDefaultClock();
+		uint64_t ticks = 0;
+		rebuilt = 0;
+		for (int frame = 0; frame < frameCount; frame++)
+		{
+			change(frame);
+			const uint64_t begin = clock.GetCounter();
+			transforms.Update(jobs);
+			ticks += clock.GetCounter() - begin;
+			rebuilt += transforms.GetRebuiltCount();
+		}
+		return static_cast<double>(ticks) / clock.GetFrequency();
+	}
+
+	// 逐次計算の Update の時間を表示する
+	template<typename Change>
+	void MeasureUpdate(const char* name, TransformHierarchy& transforms, int frameCount, const Change& change)
+	{
+		size_t rebuilt = 0;
+		const double seconds = TimeUpdate(transforms, nullptr, frameCount, change, rebuilt);
+		std::printf("%-12s %9.1f us/frame, %6.2f ns/rebuilt node, %zu rebuilt/frame\n", name,
+			seconds * 1e6 / frameCount, rebuilt > 0 ? seconds * 1e9 / rebuilt : 0.0, rebuilt / frameCount);
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	size_t tankCount = 5000;
+	int frameCount = 200;
+	unsigned threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+	size_t scalingNodeCount = 100000;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "-n" && i + 1 < argc)
+		{
+			tankCount = static_cast<size_t>(std::max(std::atoll(argv[++i]), 1ll));
+		}
+		else if (arg == "-f" && i + 1 < argc)
+		{
+			frameCount = std::max(std::atoi(argv[++i]), 1);
+		}
+		else if (arg == "-j" && i + 1 < argc)
+		{
+			threadCount = static_cast<unsigned>(std::max(std::atoi(argv[++i]), 1));
+		}
+		else if (arg == "-objects" && i + 1 < argc)
+		{
+			scalingNodeCount = static_cast<size_t>(std::max(std::atoll(argv[++i]), 1ll));
+		}
+		else
+		{
+			std::fprintf(stderr, "usage: TransformBench [-n tanks] [-f frames] [-j max_threads] [-objects nodes]\n");
+			return 2;
+		}
+	}
+
+	TransformHierarchy transforms;
+	std::vector<Tank> tanks;
+	CreateTanks(transforms, tanks, tankCount);
+	const std::vector<Handle> handles = GetHandles(tanks);
+	const size_t nodeCount = handles.size();
+	std::printf("tanks: %zu (%zu nodes)\n", tankCount, nodeCount);
+
+	// 最初は全て計算し、変更が無ければ何もしない
+	int errors = 0;
+	transforms.Update();
+	errors += Check(transforms.GetRebuiltCount() == nodeCount, "first update rebuilds every node");
+	errors += Check(GetMaxError(transforms, handles) <= TOLERANCE, "first update matches naive composition");
+	transforms.Update();
+	errors += Check(transforms.GetRebuiltCount() == 0, "unchanged update rebuilds nothing");
+
+	// 子を持たないノードはそれだけ、塔を動かすと子孫も全て計算し直す
+	SpinFans(transforms, tanks, 1);
+	transforms.Update();
+	errors += Check(transforms.GetRebuiltCount() == tankCount, "fan spin rebuilds only the fans");
+	errors += Check(GetMaxError(transforms, handles) <= TOLERANCE, "fan spin matches naive composition");
+	MoveTanks(transforms, tanks, 1);
+	transforms.Update();
+	errors += Check(transforms.GetRebuiltCount() == nodeCount, "tower move rebuilds whole subtrees");
+	errors += Check(GetMaxError(transforms, handles) <= TOLERANCE, "tower move matches naive composition");
+	// 前の状態は、直前の Update の前のワールド行列
+	const Float4x4 previous = transforms.GetWorld(tanks[0].parts[TANK_SCORE]);
+	MoveTanks(transforms, tanks, 2);
+	transforms.Update();
+	errors += Check(std::equal(&previous.m[0][0], &previous.m[0][0] + 16,
+		&transforms.GetPreviousWorld(tanks[0].parts[TANK_SCORE]).m[0][0]), "previous world is kept");
+
+	// 全て動かしても、毎フレーム親をたどって合成するより速いこと
+	{
+		Clock& clock = GetDefaultClock();
+		uint64_t begin = clock.GetCounter();
+		float sink = 0.0f;
+		for (int frame = 0; frame < frameCount; frame++)
+		{
+			for (Handle handle : handles)
+			{
+				sink += ComposeNaive(transforms, handle).m[3][0];
+			}
+		}
+		const double seconds = ToSeconds(clock, begin, clock.GetCounter());
+		std::printf("%-12s %9.1f us/frame, %6.2f ns/node (checksum %g)\n", "naive",
+			seconds * 1e6 / frameCount, seconds * 1e9 / (static_cast<double>(frameCount) * nodeCount), sink);
+	}
+	MeasureUpdate("all moving", transforms, frameCount, [&](int frame) { MoveTanks(transforms, tanks, frame); });
+	MeasureUpdate("fans only", transforms, frameCount, [&](int frame) { SpinFans(transforms, tanks, frame); });
+	MeasureUpdate("static", transforms, frameCount, [](int) {});
+	errors += Check(GetMaxError(transforms, handles) <= TOLERANCE, "after measuring matches naive composition");
+
+	// 親の付け替え・破棄・追加の後も並べ替えて正しく計算する
+	std::vector<Handle> alive;
+	const size_t changedCount = EditTanks(transforms, tanks, alive);
+	transforms.Update();
+	errors += Check(transforms.GetCount() == alive.size(), "live node count after edits");
+	errors += Check(transforms.GetRebuiltCount() == changedCount, "edits rebuild only changed nodes");
+	errors += Check(GetMaxError(transforms, alive) <= TOLERANCE, "edits match naive composition");
+	errors += Check(transforms.GetParent(tanks[0].parts[TANK_SCORE]) == tanks[0].parts[TANK_TOWER], "reparent");
+	MoveTanks(transforms, tanks, 3);
+	transforms.Update();
+	errors += Check(GetMaxError(transforms, alive) <= TOLERANCE, "move after edits matches naive composition");
+	std::printf("max error: %g\n", GetMaxError(transforms, alive));
+
+	// 並列計算は逐次計算とビット単位で一致する（ワーカーが１つも無くても並列の経路を通す）
+	{
+		JobSystem jobs(std::max(threadCount, 2u) - 1);
+		const int mismatchCount = CompareParallel(tankCount, 30, jobs);
+		std::printf("parallel vs serial: %d mismatched frame%s (%u threads)\n", mismatchCount,
+			mismatchCount == 1 ? "" : "s", jobs.GetThreadCount());
+		errors += Check(mismatchCount == 0, "parallel update matches serial update");
+	}
+
+	// スレッド数ごとの、全てのノードが動くときの Update の時間
+	{
+		TransformHierarchy scaling;
+		std::vector<Tank> scalingTanks;
+		CreateTanks(scaling, scalingTanks, std::max(scalingNodeCount / TANK_PARTS_NUM, static_cast<size_t>(1)));
+		scaling.Update();
+		std::printf("scaling: %zu nodes, all moving\n", scaling.GetCount());
+		double serialSeconds = 0.0;
+		for (unsigned threads = 1; threads <= threadCount; threads++)
+		{
+			// １スレッドはジョブシステムを使わない逐次計算
+			std::unique_ptr<JobSystem> jobs;
+			if (threads > 1)
+			{
+				jobs = std::make_unique<JobSystem>(threads - 1);
+			}
+			size_t rebuilt = 0;
+			const double seconds = TimeUpdate(scaling, jobs.get(), frameCount,
+				[&](int frame) { MoveTanks(scaling, scalingTanks, frame); }, rebuilt);
+			if (threads == 1)
+			{
+				serialSeconds = seconds;
+			}
+			std::printf("%2u thread%s %9.1f us/frame, %.2fx\n", threads, threads == 1 ? " " : "s",
+				seconds * 1e6 / frameCount, seconds > 0.0 ? serialSeconds / seconds : 0.0);
+		}
+	}
+
+	if (errors > 0)
+	{
+		std::fprintf(stderr, "%d checks failed\n", errors);
+		return 1;
+	}
+	std::printf("checks: ok\n");
+	return 0;
+}
@@ -0,0 +1,250 @@
+﻿/// <summary>
+/// 行列をまとめて合成する関数の誤差を確かめ、性能を測るコマンドラインツール
+///
+/// 使い方: TransformKernelBench [-n 行列の数] [-r 繰り返す回数]
+/// SIMD の sin / cos を倍精度の std::sin / std::cos と比べ、角度の大きさごとの最大誤差を表示する
+/// SIMD の合成を ComposeTransformsScalar と比べ（親行列の有無の両方）、最大の絶対誤差と相対誤差を表示する
+/// 端数の扱いで結果が変わらないことと、AVX2 と SSE2 の結果が一致することも確かめ、
+/// 使える実装ごとに１行列あたりの時間を表示する
+/// 確かめた結果が合わなければ 1 を返す
+///
+/// Windows 以外では次のようにビルドする（-mavx2 を付けると AVX2 の実装も確かめる）
+///   g++ -std=c++14 -O2 -I../../GameEngineTK Main.cpp ../../GameEngineTK/TransformKernel.cpp
+///       ../../GameEngineTK/Clock.cpp -o TransformKernelBench
+/// </summary>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "Clock.h"
+#include "TransformKernel.h"
+
+namespace
+{
+	// sin / cos の絶対誤差の許容値（|x| が SINCOS_RANGE 未満のとき）
+	const double SINCOS_TOLERANCE = 1e-6;
+	// 範囲の縮約の精度を保てる角度の上限（Cephes の sinf と同じ）
+	const float SINCOS_RANGE = 8192.0f;
+	// 合成した行列の誤差の許容値（行の大きさに対する相対誤差）
+	const double COMPOSE_TOLERANCE = 1e-5;
+	// 合成で使う角度の範囲
+	const float ANGLE_RANGE = 50.0f;
+
+	// 合成する関数
+	typedef void(*ComposeFunc)(const Float3* scales, const Float3* rotations, const Float3* translations,
+		const Float4x4* parent, Float4x4* worlds, size_t count);
+	// sin と cos を同時に求める関数
+	typedef void(*SinCosFunc)(const float* angles, float* sines, float* cosines, size_t count);
+
+	// 確かめる実装
+	struct Kernel
+	{
+		const char* name;
+		ComposeFunc compose;
+		SinCosFunc sinCos;
+	};
+
+	// 再現できる乱数（xorshift）
+	float Random(uint32_t& state, float low, float high)
+	{
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		return low + (high - low) * static_cast<float>(state & 0xffffff) / 16777216.0f;
+	}
+
+	Float3 RandomFloat3(uint32_t& state, float low, float high)
+	{
+		return Float3{ Random(state, low, high), Random(state, low, high), Random(state, low, high) };
+	}
+
+	// 誤差
+	struct Error
+	{
+		double absolute;
+		double relative;
+	};
+
+	// 行列の配列の最大誤差
+	// 相対誤差は同じ行の最も大きい要素との比（足し合わせて打ち消し合った要素を厳しく見すぎないように）で、
+	// 行の要素が全て 1 未満なら絶対誤差
+	Error GetMaxError(const std::vector<Float4x4>& values, const std::vector<Float4x4>& expected)
+	{
+		Error error = { 0.0, 0.0 };
+		for (size_t k = 0; k < values.size(); k++)
+		{
+			for (int i = 0; i < 4; i++)
+			{
+				double rowScale = 1.0;
+				for (int j = 0; j < 4; j++)
+				{
+					rowScale = std::max(rowScale, std::fabs(static_cast<double>(expected[k].m[i][j])));
+				}
+				for (int j = 0; j < 4; j++)
+				{
+					const double difference = std::fabs(static_cast<double>(values[k].m[i][j]) - expected[k].m[i][j]);
+					error.absolute = std::max(error.absolute, difference);
+					error.relative = std::max(error.relative, difference / rowScale);
+				}
+			}
+		}
+		return error;
+	}
+
+	// 確かめた結果を表示して数える
+	int Check(bool condition, const char* name, const char* kernel)
+	{
+		if (!condition)
+		{
+			std::fprintf(stderr, "check failed: %s (%s)\n", name, kernel);
+			return 1;
+		}
+		return 0;
+	}
+
+	// sin / cos を [-range, range] の一様な角度で確かめ、最大の絶対誤差を返す
+	double GetSinCosError(SinCosFunc sinCos, float range, size_t count)
+	{
+		uint32_t random = 88172645u;
+		std::vector<float> angles(count), sines(count), cosines(count);
+		for (float& angle : angles)
+		{
+			angle = Random(random, -range, range);
+		}
+		// 象限の境目の近くを含める
+		for (size_t i = 0; i < count && i < 64; i++)
+		{
+			angles[i] = static_cast<float>((static_cast<double>(i) - 32.0) * 0.78539816339744831);
+		}
+		sinCos(angles.data(), sines.data(), cosines.data(), count);
+		double error = 0.0;
+		for (size_t i = 0; i < count; i++)
+		{
+			error = std::max(error, std::fabs(sines[i] - std::sin(static_cast<double>(angles[i]))));
+			error = std::max(error, std::fabs(cosines[i] - std::cos(static_cast<double>(angles[i]))));
+		}
+		return error;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	size_t count = 100000;
+	int repeatCount = 20;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "-n" && i + 1 < argc)
+		{
+			count = static_cast<size_t>(std::max(std::atoll(argv[++i]), 1ll));
+		}
+		else if (arg == "-r" && i + 1 < argc)
+		{
+			repeatCount = std::max(std::atoi(argv[++i]), 1);
+		}
+		else
+		{
+			std::fprintf(stderr, "usage: TransformKernelBench [-n matrices] [-r repeats]\n");
+			return 2;
+		}
+	}
+
+	std::vector<Kernel> kernels;
+#if TRANSFORM_KERNEL_SSE2
+	kernels.push_back(Kernel{ "SSE2", &ComposeTransformsSSE2, &SinCosSSE2 });
+#endif
+#if TRANSFORM_KERNEL_AVX2
+	kernels.push_back(Kernel{ "AVX2", &ComposeTransformsAVX2, &SinCosAVX2 });
+#endif
+
+	// 端数が出るように８の倍数から外す
+	count += 3;
+	uint32_t random = 2463534242u;
+	std::vector<Float3> scales(count), rotations(count), translations(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		scales[i] = RandomFloat3(random, 0.1f, 10.0f);
+		rotations[i] = RandomFloat3(random, -ANGLE_RANGE, ANGLE_RANGE);
+		translations[i] = RandomFloat3(random, -1000.0f, 1000.0f);
+	}
+	std::vector<Float4x4> parent(1);
+	ComposeTransformsScalar(&scales[0], &rotations[0], &translations[0], nullptr, parent.data(), 1);
+
+	std::vector<Float4x4> expected(count), expectedWithParent(count), worlds(count), worldsWithParent(count);
+	ComposeTransformsScalar(scales.data(), rotations.data(), translations.data(), nullptr, expected.data(), count);
+	ComposeTransformsScalar(scales.data(), rotations.data(), translations.data(), &parent[0],
+		expectedWithParent.data(), count);
+
+	int errors = 0;
+	std::vector<Float4x4> firstWorlds;
+	for (const Kernel& kernel : kernels)
+	{
+		// sin / cos（角度の大きさごと）
+		const double smallError = GetSinCosError(kernel.sinCos, 3.14159265f, count);
+		const double mediumError = GetSinCosError(kernel.sinCos, ANGLE_RANGE, count);
+		const double largeError = GetSinCosError(kernel.sinCos, SINCOS_RANGE, count);
+		std::printf("%s sincos: max abs error %.3g (|x| < pi), %.3g (|x| < %g), %.3g (|x| < %g)\n", kernel.name,
+			smallError, mediumError, ANGLE_RANGE, largeError, SINCOS_RANGE);
+		errors += Check(std::max(std::max(smallError, mediumError), largeError) <= SINCOS_TOLERANCE, "sincos error",
+			kernel.name);
+
+		// 合成（親行列なしとあり）
+		kernel.compose(scales.data(), rotations.data(), translations.data(), nullptr, worlds.data(), count);
+		kernel.compose(scales.data(), rotations.data(), translations.data(), &parent[0], worldsWithParent.data(), count);
+		const Error error = GetMaxError(worlds, expected);
+		const Error errorWithParent = GetMaxError(worldsWithParent, expectedWithParent);
+		std::printf("%s compose: max abs error %.3g, max rel error %.3g (with parent: %.3g, %.3g)\n", kernel.name,
+			error.absolute, error.relative, errorWithParent.absolute, errorWithParent.relative);
+		errors += Check(error.relative <= COMPOSE_TOLERANCE && errorWithParent.relative <= COMPOSE_TOLERANCE,
+			"compose error", kernel.name);
+
+		// １個ずつ合成しても（全て端数として扱っても）同じ結果
+		bool isSame = true;
+		for (size_t i = 0; i < count && isSame; i += 997)
+		{
+			Float4x4 single;
+			kernel.compose(&scales[i], &rotations[i], &translations[i], &parent[0], &single, 1);
+			isSame = std::memcmp(&single, &worldsWithParent[i], sizeof(Float4x4)) == 0;
+		}
+		errors += Check(isSame, "tail matches batch", kernel.name);
+
+		// 実装が違っても同じ結果
+		if (firstWorlds.empty())
+		{
+			firstWorlds = worldsWithParent;
+		}
+		else
+		{
+			errors += Check(std::memcmp(firstWorlds.data(), worldsWithParent.data(), count * sizeof(Float4x4)) == 0,
+				"bit-identical to SSE2", kernel.name);
+		}
+	}
+
+	// 実装ごとの時間
+	Clock& clock = GetDefaultClock();
+	std::vector<Kernel> timed(1, Kernel{ "scalar", &ComposeTransformsScalar, nullptr });
+	timed.insert(timed.end(), kernels.begin(), kernels.end());
+	for (const Kernel& kernel : timed)
+	{
+		const uint64_t begin = clock.GetCounter();
+		for (int r = 0; r < repeatCount; r++)
+		{
+			kernel.compose(scales.data(), rotations.data(), translations.data(), &parent[0], worldsWithParent.data(), count);
+		}
+		const double seconds = static_cast<double>(clock.GetCounter() - begin) / clock.GetFrequency();
+		std::printf("%-6s %6.2f ns/matrix\n", kernel.name, seconds * 1e9 / (static_cast<double>(count) * repeatCount));
+	}
+
+	if (errors > 0)
+	{
+		std::fprintf(stderr, "%d checks failed\n", errors);
+		return 1;
+	}
+	std::printf("checks: ok\n");
+	return 0;
+}